@@ -0,0 +1,92 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class Mesh;
+
+enum class AssetState
+{
+	Loading,
+	Ready,
+	Failed,
+	Evicted		// Unloaded to stay under the memory budget
+};
+
+// --------------------------------------------------------
+// What every asset handle has, whatever it holds
+// --------------------------------------------------------
+class AssetBase
+{
+public:
+	virtual ~AssetBase() {}
+
+	AssetState GetState() const { return state; }
+	bool IsReady() const { return state == AssetState::Ready; }
+	const std::wstring& GetPath() const { return path; }
+
+	// Bytes of GPU memory the loaded resource takes (0 while
+	// it's a placeholder)
+	size_t GetMemorySize() const { return memorySize; }
+	uint64_t GetLastUsedFrame() const { return lastUsedFrame; }
+
+protected:
+	friend class AssetManager;
+
+	std::wstring path;
+	AssetState state = AssetState::Loading;
+	size_t memorySize = 0;
+
+	// Stamped by Use() from the manager's frame counter
+	const uint64_t* frameClock = nullptr;
+	mutable uint64_t lastUsedFrame = 0;
+	mutable bool wanted = false;
+
+	void MarkUsed() const
+	{
+		lastUsedFrame = *frameClock;
+		wanted = true;
+	}
+
+	// Drops the loaded resource for the placeholder
+	virtual void Unload() = 0;
+};
+
+// --------------------------------------------------------
+// Handle to one asset, handed out by AssetManager before the
+// asset has been loaded
+//
+// - Get() is a placeholder while loading (and stays one if
+//    loading fails), so a handle can be drawn with right away
+// - Use() is Get() for drawing: it marks the asset as used
+//    this frame, so it's the last to be evicted, and has an
+//    evicted asset loaded again
+// - Only AssetManager::Update() changes it, on the main
+//    thread, so the main thread can read it without locking
+// --------------------------------------------------------
+template<typename Resource>
+class Asset : public AssetBase
+{
+public:
+	const Resource& Get() const { return resource; }
+
+	const Resource& Use() const
+	{
+		MarkUsed();
+		return resource;
+	}
+
+private:
+	friend class AssetManager;
+
+	Resource resource;
+	Resource placeholder;
+
+	void Unload() override { resource = placeholder; }
+};
+
+using MeshAsset = Asset<std::shared_ptr<Mesh>>;
+using TextureAsset = Asset<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>;
@@ -0,0 +1,743 @@
+#include "AssetCooker.h"
+#include "Brdf.h"
+#include "DdsFile.h"
+#include "IblPrefilter.h"
+#include "LightProbes.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MeshCooker.h"
+#include "PackArchive.h"
+#include "SceneFile.h"
+#include "TextureCooker.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cwctype>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+	const char* DatabaseHeader = "AssetCooker";
+
+	enum class CookRule
+	{
+		Mesh,
+		Scene,
+		Texture,
+		PackedMasks,
+		EnvironmentLut,
+		Environment,
+		LightProbes,
+		Copy
+	};
+
+	// Size and modification time tell whether the hash of an
+	// input from the last run can be reused
+	struct InputStamp
+	{
+		uint64_t Size = 0;
+		uint64_t Time = 0;
+		uint64_t Hash = 0;
+	};
+
+	struct JobRecord
+	{
+		uint64_t Key = 0;
+		std::vector<std::string> Outputs;
+	};
+
+	// Everything the last run knew, by file name (relative to
+	// the source or output folder, UTF-8, '/' separated)
+	struct CookDatabase
+	{
+		std::map<std::string, InputStamp> Inputs;
+		std::map<std::string, JobRecord> Jobs;
+	};
+
+	// One unit of work: inputs (the first one names the job)
+	// turned into outputs by a rule; generated files are named
+	// after their output instead
+	// - Reads are outputs of other jobs it needs, so it runs
+	//    after them, and again whenever they change
+	struct CookJob
+	{
+		std::string Name;
+		CookRule Rule = CookRule::Copy;
+		std::vector<std::string> Inputs;
+		std::vector<std::string> Reads;
+		std::vector<std::string> Outputs;
+		uint64_t Key = 0;
+		bool Dirty = false;
+		bool Failed = false;
+	};
+
+	std::string ToName(const std::filesystem::path& relativePath)
+	{
+		std::u8string utf8 = relativePath.generic_u8string();
+		return std::string((const char*)utf8.data(), utf8.size());
+	}
+
+	std::filesystem::path ToPath(const std::wstring& folder, const std::string& name)
+	{
+		return std::filesystem::path(folder) / std::filesystem::path(std::u8string((const char8_t*)name.data(), name.size()));
+	}
+
+	std::wstring LowerExtension(const std::filesystem::path& path)
+	{
+		std::wstring extension = path.extension().wstring();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](wchar_t c) { return (wchar_t)towlower(c); });
+		return extension;
+	}
+
+	// A folder path without its trailing separator, so names can
+	// be appended to it
+	std::filesystem::path WithoutTrailingSeparator(const std::wstring& folder)
+	{
+		std::filesystem::path path(folder);
+		return path.has_filename() ? path : path.parent_path();
+	}
+
+	// --------------------------------------------------------
+	// Picks the rule for a source file and names its outputs
+	// - False for files that aren't cooked at all: mesh caches
+	//    the game writes next to sources, temp files and packs
+	// - Masks each make a job for their packed texture, which
+	//    the caller merges with the other masks of its material
+	// --------------------------------------------------------
+	bool MakeJob(const std::string& name, CookJob& job)
+	{
+		std::filesystem::path path(std::u8string((const char8_t*)name.data(), name.size()));
+		std::wstring extension = LowerExtension(path);
+		if (extension == L".mesh" || extension == L".tmp" || extension == L".pack")
+			return false;
+
+		job.Name = name;
+		job.Inputs.push_back(name);
+		if (extension == L".obj")
+		{
+			job.Rule = CookRule::Mesh;
+			job.Outputs.push_back(ToName(path.replace_extension(L".mesh")));
+		}
+		else if (extension == L".scene")
+		{
+			job.Rule = CookRule::Scene;
+			job.Outputs.push_back(ToName(path.replace_extension(L".scenebin")));
+		}
+		else if (extension == L".png" && TextureCooker::GetKind(path.wstring()) == TextureKind::Mask)
+		{
+			job.Rule = CookRule::PackedMasks;
+			job.Outputs.push_back(ToName(std::filesystem::path(TextureCooker::GetPackedPath(path.wstring())).replace_extension(L".dds")));
+		}
+		else if (extension == L".png")
+		{
+			job.Rule = CookRule::Texture;
+			job.Outputs.push_back(ToName(path.replace_extension(L".dds")));
+		}
+		else
+		{
+			job.Rule = CookRule::Copy;
+			job.Outputs.push_back(name);
+		}
+		return true;
+	}
+
+	// The cooked albedo map of a scene material (the game's
+	// materials are named after their textures)
+	std::string GetAlbedoMapName(const char* material)
+	{
+		return std::string(material) + ".dds";
+	}
+
+	// --------------------------------------------------------
+	// Files computed rather than cooked from a source
+	// - The sky's lighting when any of its 6 faces (+X, -X, +Y,
+	//    -Y, +Z, -Z) is there; the job fails, naming the rest,
+	//    unless all of them are
+	// - Light probes for each .scene, reading the cooked meshes,
+	//    albedo maps and sky lighting it uses (those some job
+	//    makes), so they come after the jobs making them
+	// --------------------------------------------------------
+	std::vector<CookJob> MakeGeneratedJobs(const std::wstring& sourceFolder, const std::vector<CookJob>& sourceJobs, const std::map<std::string, InputStamp>& inputs)
+	{
+		std::vector<CookJob> jobs;
+
+		CookJob lut;
+		lut.Name = "brdf_lut.dds";
+		lut.Rule = CookRule::EnvironmentLut;
+		lut.Outputs.push_back(lut.Name);
+		jobs.push_back(lut);
+
+		CookJob environment;
+		environment.Name = "sky.ibl";
+		environment.Rule = CookRule::Environment;
+		environment.Inputs = { "right.png", "left.png", "up.png", "down.png", "front.png", "back.png" };
+		environment.Outputs.push_back(environment.Name);
+		if (std::any_of(environment.Inputs.begin(), environment.Inputs.end(), [&](const std::string& face) { return inputs.count(face) != 0; }))
+			jobs.push_back(environment);
+
+		std::set<std::string> produced;
+		for (const CookJob& job : jobs)
+			produced.insert(job.Outputs.begin(), job.Outputs.end());
+		for (const CookJob& job : sourceJobs)
+			produced.insert(job.Outputs.begin(), job.Outputs.end());
+
+		for (const CookJob& job : sourceJobs)
+		{
+			if (job.Rule != CookRule::Scene)
+				continue;
+
+			CookJob probes;
+			probes.Name = ToName(std::filesystem::path(job.Outputs[0]).replace_extension(L".probes"));
+			probes.Rule = CookRule::LightProbes;
+			probes.Inputs.push_back(job.Inputs[0]);
+			probes.Outputs.push_back(probes.Name);
+
+			// A scene that doesn't parse reads nothing; its job fails
+			std::set<std::string> reads = { environment.Name };
+			SceneArrays scene;
+			if (SceneFile::LoadText(ToPath(sourceFolder, job.Inputs[0]).wstring(), scene))
+			{
+				for (const SceneName& mesh : scene.Meshes)
+					reads.insert(mesh.Text);
+				for (const SceneName& material : scene.Materials)
+					reads.insert(GetAlbedoMapName(material.Text));
+			}
+			std::copy_if(reads.begin(), reads.end(), std::back_inserter(probes.Reads), [&](const std::string& read) { return produced.count(read) != 0; });
+			jobs.push_back(probes);
+		}
+		return jobs;
+	}
+
+	// Hashes everything that decides a job's outputs: its
+	// inputs' hashes, and the keys of the jobs making its reads
+	uint64_t GetJobKey(const CookJob& job, const std::map<std::string, InputStamp>& inputs, const std::map<std::string, uint64_t>& outputKeys)
+	{
+		std::ostringstream key;
+		key << DatabaseHeader << ' ' << AssetCooker::Version << ' ';
+		switch (job.Rule)
+		{
+		case CookRule::Mesh: key << "mesh " << MeshCache::Version; break;
+		case CookRule::Scene: key << "scene " << SceneFile::Version; break;
+		case CookRule::Texture: key << "texture " << TextureCooker::Version; break;
+		case CookRule::PackedMasks: key << "masks " << TextureCooker::Version; break;
+		case CookRule::EnvironmentLut: key << "brdf lut " << Brdf::LutVersion << ' ' << Brdf::LutSize << ' ' << Brdf::LutSampleCount; break;
+		case CookRule::Environment: key << "environment " << IblPrefilter::Version << ' ' << IblPrefilter::SpecularSize << ' ' << IblPrefilter::SpecularMipCount << ' ' << IblPrefilter::SampleCount; break;
+		case CookRule::LightProbes: key << "light probes " << LightProbes::Version << ' ' << LightProbes::RayCount << ' ' << LightProbes::MaxProbesPerAxis << ' ' << SHADED_LIGHT_COUNT; break;
+		case CookRule::Copy: key << "copy"; break;
+		}
+
+		for (const std::string& input : job.Inputs)
+			key << '\n' << input << ' ' << std::hex << inputs.at(input).Hash << std::dec;
+		for (const std::string& read : job.Reads)
+			key << "\nreads " << read << ' ' << std::hex << outputKeys.at(read) << std::dec;
+
+		std::string text = key.str();
+		return MeshCache::HashBytes(text.data(), text.size());
+	}
+
+	bool HashFile(const std::filesystem::path& path, uint64_t& hash)
+	{
+		MappedFile file;
+		if (!file.Open(path.wstring()))
+			return false;
+
+		hash = MeshCache::HashBytes(file.GetData(), file.GetSize());
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// Reads the last run's database
+	// - One record per line: "input <size> <time> <hash> <name>",
+	//    "job <key> <name>", then "output <name>" for each of
+	//    that job's outputs
+	// - A missing or older database just means a full cook
+	// --------------------------------------------------------
+	void LoadDatabase(const std::wstring& path, CookDatabase& database)
+	{
+		std::ifstream file{ std::filesystem::path(path) };
+		std::string line;
+		if (!std::getline(file, line) || line != std::string(DatabaseHeader) + " " + std::to_string(AssetCooker::Version))
+			return;
+
+		JobRecord* job = nullptr;
+		while (std::getline(file, line))
+		{
+			std::istringstream fields(line);
+			std::string type;
+			fields >> type;
+
+			if (type == "input")
+			{
+				InputStamp stamp;
+				fields >> stamp.Size >> stamp.Time >> std::hex >> stamp.Hash;
+				std::string name;
+				if (fields.get() == ' ' && std::getline(fields, name) && !name.empty())
+					database.Inputs[name] = stamp;
+			}
+			else if (type == "job")
+			{
+				uint64_t key = 0;
+				fields >> std::hex >> key;
+				std::string name;
+				job = nullptr;
+				if (fields.get() == ' ' && std::getline(fields, name) && !name.empty())
+				{
+					job = &database.Jobs[name];
+					job->Key = key;
+				}
+			}
+			else if (type == "output" && job)
+			{
+				std::string name;
+				if (fields.get() == ' ' && std::getline(fields, name) && !name.empty())
+					job->Outputs.push_back(name);
+			}
+		}
+	}
+
+	// Written to a temporary file first and then renamed, like
+	// the mesh cache and the pack
+	bool SaveDatabase(const std::wstring& path, const CookDatabase& database)
+	{
+		std::filesystem::path tempPath(path);
+		tempPath += L".tmp";
+
+		{
+			std::ofstream file(tempPath, std::ios::out | std::ios::trunc);
+			if (!file)
+				return false;
+
+			file << DatabaseHeader << ' ' << AssetCooker::Version << '\n';
+			for (const auto& [name, stamp] : database.Inputs)
+				file << "input " << stamp.Size << ' ' << stamp.Time << ' ' << std::hex << stamp.Hash << std::dec << ' ' << name << '\n';
+			for (const auto& [name, job] : database.Jobs)
+			{
+				file << "job " << std::hex << job.Key << std::dec << ' ' << name << '\n';
+				for (const std::string& output : job.Outputs)
+					file << "output " << output << '\n';
+			}
+
+			if (!file)
+				return false;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, path, error);
+		return !error;
+	}
+
+	// Copies through a temp file, so an interrupted cook never
+	// leaves a half-written output behind
+	bool CopyInput(const std::filesystem::path& source, const std::filesystem::path& output)
+	{
+		std::filesystem::path tempPath = output;
+		tempPath += L".tmp";
+
+		std::error_code error;
+		std::filesystem::copy_file(source, tempPath, std::filesystem::copy_options::overwrite_existing, error);
+		if (!error)
+			std::filesystem::rename(tempPath, output, error);
+		if (error)
+		{
+			std::error_code ignored;
+			std::filesystem::remove(tempPath, ignored);
+			return false;
+		}
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// What a scene's light probes are baked for, from the cooked
+	// files its job reads
+	// - Entities are placed as Transformation places them
+	// - Albedo is the material's map alone, as the game's
+	//    materials aren't tinted
+	// --------------------------------------------------------
+	LightProbeScene MakeProbeScene(const SceneArrays& scene, const CookJob& job, const std::wstring& outputFolder)
+	{
+		auto isRead = [&](const std::string& name) { return std::find(job.Reads.begin(), job.Reads.end(), name) != job.Reads.end(); };
+
+		LightProbeScene probeScene;
+		for (size_t i = 0; i < scene.MeshIndices.size(); i++)
+		{
+			const XMFLOAT3& position = scene.Positions[i];
+			const XMFLOAT3& rotation = scene.Rotations[i];
+			const XMFLOAT3& scale = scene.Scales[i];
+
+			ProbeInstance instance;
+			instance.MeshPath = ToPath(outputFolder, scene.Meshes[scene.MeshIndices[i]].Text).wstring();
+			XMStoreFloat4x4(&instance.World, XMMatrixScaling(scale.x, scale.y, scale.z) *
+				XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z) * XMMatrixTranslation(position.x, position.y, position.z));
+
+			std::string albedoMap = GetAlbedoMapName(scene.Materials[scene.MaterialIndices[i]].Text);
+			if (isRead(albedoMap))
+				instance.AlbedoMap = ToPath(outputFolder, albedoMap).wstring();
+			instance.Static = (scene.Flags[i] & SceneFile::EntityStatic) != 0;
+			probeScene.Instances.push_back(instance);
+		}
+
+		probeScene.Lights = scene.Lights;
+		probeScene.ShadedLightCount = SHADED_LIGHT_COUNT;
+
+		PrefilteredEnvironment environment;
+		if (isRead("sky.ibl") && IblPrefilter::Load(ToPath(outputFolder, "sky.ibl").wstring(), environment))
+			probeScene.SkyIrradiance = environment.Irradiance;
+		return probeScene;
+	}
+
+	bool RunJob(const CookJob& job, const std::wstring& sourceFolder, const std::wstring& outputFolder)
+	{
+		std::filesystem::path source = job.Inputs.empty() ? std::filesystem::path() : ToPath(sourceFolder, job.Inputs[0]);
+		std::filesystem::path output = ToPath(outputFolder, job.Outputs[0]);
+
+		std::error_code error;
+		std::filesystem::create_directories(output.parent_path(), error);
+
+		switch (job.Rule)
+		{
+		case CookRule::Mesh:
+		{
+			CookedMesh cooked;
+			if (!MeshCooker::CookObj(source.wstring(), cooked))
+				return false;
+			return MeshCache::Save(source.wstring(), output.wstring(), MeshCooker::Pack(cooked));
+		}
+
+		case CookRule::Scene:
+		{
+			SceneArrays scene;
+			if (!SceneFile::LoadText(source.wstring(), scene))
+				return false;
+			return SceneFile::Save(output.wstring(), SceneFile::GetData(scene));
+		}
+
+		case CookRule::Texture:
+		{
+			std::vector<Image> mips;
+			if (!TextureCooker::CookPng(source.wstring(), mips))
+				return false;
+			return DdsFile::Save(output.wstring(), mips);
+		}
+
+		case CookRule::PackedMasks:
+		{
+			std::vector<std::wstring> maskFiles;
+			for (const std::string& input : job.Inputs)
+				maskFiles.push_back(ToPath(sourceFolder, input).wstring());
+
+			std::vector<Image> mips;
+			if (!TextureCooker::CookPackedMasks(maskFiles, mips))
+				return false;
+			return DdsFile::Save(output.wstring(), mips);
+		}
+
+		case CookRule::EnvironmentLut:
+		{
+			auto start = std::chrono::steady_clock::now();
+			std::vector<Image> mips = { Brdf::IntegrateEnvironmentLut() };
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+			printf("%s: %ux%u %s, %u samples per texel, %.1f ms\n", job.Name.c_str(), mips[0].Width, mips[0].Height,
+				TextureCooker::GetFormatName(mips[0].Format), Brdf::LutSampleCount, elapsed.count());
+			return DdsFile::Save(output.wstring(), mips);
+		}
+
+		case CookRule::Environment:
+		{
+			std::vector<std::wstring> faceFiles;
+			for (const std::string& input : job.Inputs)
+				faceFiles.push_back(ToPath(sourceFolder, input).wstring());
+
+			auto start = std::chrono::steady_clock::now();
+			PrefilteredEnvironment environment;
+			if (!IblPrefilter::PrefilterFiles(faceFiles, environment))
+				return false;
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+			printf("%s: SH irradiance + %u specular mips of %ux%u, %u samples each, %.1f ms\n", job.Name.c_str(), environment.SpecularMipCount,
+				environment.SpecularSize, environment.SpecularSize, IblPrefilter::SampleCount, elapsed.count());
+			return IblPrefilter::Save(output.wstring(), environment);
+		}
+
+		case CookRule::LightProbes:
+		{
+			SceneArrays scene;
+			if (!SceneFile::LoadText(source.wstring(), scene))
+				return false;
+
+			auto start = std::chrono::steady_clock::now();
+			LightProbeGrid grid;
+			if (!LightProbes::Bake(MakeProbeScene(scene, job, outputFolder), grid))
+				return false;
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+			printf("%s: %zu light probes (%ux%ux%u), %u rays each, %.1f ms\n", job.Name.c_str(), grid.Probes.size(),
+				grid.CountX, grid.CountY, grid.CountZ, LightProbes::RayCount, elapsed.count());
+			return LightProbes::Save(output.wstring(), grid);
+		}
+
+		case CookRule::Copy:
+			return CopyInput(source, output);
+		}
+		return false;
+	}
+}
+
+std::wstring AssetCooker::GetPackPath(const std::wstring& outputFolder)
+{
+	std::filesystem::path path = WithoutTrailingSeparator(outputFolder);
+	path += L".pack";
+	return path.wstring();
+}
+
+std::wstring AssetCooker::GetDatabasePath(const std::wstring& outputFolder)
+{
+	std::filesystem::path path = WithoutTrailingSeparator(outputFolder);
+	path += L".cookdb";
+	return path.wstring();
+}
+
+// --------------------------------------------------------
+// Brings the output folder (and its pack) up to date with
+// the source folder
+//
+// 1. Gather the source files and reuse the last run's hashes
+//     of the ones with the same size and time; hash the rest
+//     on the thread pool
+// 2. Make one job per source (plus the generated files') and
+//     compare its key with the last run's
+// 3. Run the dirty jobs on the thread pool, those reading
+//     other jobs' outputs once the rest are done
+// 4. Delete outputs no job produces anymore, save the
+//     database and rebuild the pack if anything in it changed
+// --------------------------------------------------------
+bool AssetCooker::Cook(const std::wstring& sourceFolder, const std::wstring& outputFolder, CookStats& stats)
+{
+	auto start = std::chrono::steady_clock::now();
+	stats = CookStats();
+
+	CookDatabase previous;
+	LoadDatabase(GetDatabasePath(outputFolder), previous);
+
+	// Every source file, with its stamp from the file system
+	CookDatabase current;
+	std::vector<std::string> sources;
+	{
+		std::error_code error;
+		std::filesystem::recursive_directory_iterator it(sourceFolder, error);
+		if (error)
+		{
+			printf("Could not read source folder %ls\n", sourceFolder.c_str());
+			return false;
+		}
+
+		for (; it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+		{
+			if (error)
+				return false;
+			if (!it->is_regular_file(error))
+				continue;
+
+			InputStamp stamp;
+			stamp.Size = (uint64_t)it->file_size(error);
+			stamp.Time = (uint64_t)it->last_write_time(error).time_since_epoch().count();
+			if (error)
+				return false;
+
+			std::string name = ToName(std::filesystem::relative(it->path(), sourceFolder, error));
+			current.Inputs[name] = stamp;
+			sources.push_back(name);
+		}
+		std::sort(sources.begin(), sources.end());
+	}
+
+	// Only inputs that changed since the last run are read
+	std::vector<std::string> toHash;
+	for (auto& [name, stamp] : current.Inputs)
+	{
+		auto last = previous.Inputs.find(name);
+		if (last != previous.Inputs.end() && last->second.Size == stamp.Size && last->second.Time == stamp.Time)
+			stamp.Hash = last->second.Hash;
+		else
+			toHash.push_back(name);
+	}
+
+	std::vector<char> hashFailed(toHash.size(), 0);
+	ThreadPool::Get().ParallelFor(toHash.size(), [&](size_t i)
+	{
+		uint64_t hash = 0;
+		hashFailed[i] = !HashFile(ToPath(sourceFolder, toHash[i]), hash);
+		current.Inputs.at(toHash[i]).Hash = hash;
+	});
+	stats.HashedCount = (unsigned int)toHash.size();
+
+	std::set<std::string> unreadable;
+	for (size_t i = 0; i < toHash.size(); i++)
+	{
+		if (hashFailed[i])
+		{
+			unreadable.insert(toHash[i]);
+			current.Inputs.erase(toHash[i]);
+		}
+	}
+
+	// One job per source, except masks packed together: the
+	// first one (by name) makes the job, the rest are inputs
+	std::vector<CookJob> jobs;
+	std::map<std::string, size_t> packedJobs;
+	for (const std::string& name : sources)
+	{
+		CookJob job;
+		if (!MakeJob(name, job))
+			continue;
+
+		if (job.Rule == CookRule::PackedMasks)
+		{
+			auto packed = packedJobs.try_emplace(job.Outputs[0], jobs.size());
+			if (!packed.second)
+			{
+				jobs[packed.first->second].Inputs.push_back(name);
+				continue;
+			}
+		}
+		jobs.push_back(job);
+	}
+
+	for (const CookJob& job : MakeGeneratedJobs(sourceFolder, jobs, current.Inputs))
+		jobs.push_back(job);
+
+	// Jobs reading another's output fail along with it
+	std::map<std::string, size_t> producers;
+	for (size_t j = 0; j < jobs.size(); j++)
+	{
+		for (const std::string& output : jobs[j].Outputs)
+			producers[output] = j;
+	}
+	auto failedRead = [&](const CookJob& job)
+	{
+		return std::find_if(job.Reads.begin(), job.Reads.end(), [&](const std::string& read) { return jobs[producers.at(read)].Failed; });
+	};
+
+	// Dirty when its key changed or an output has gone missing
+	// - Jobs with reads come after the jobs making them, so
+	//    their keys are known by then
+	std::vector<size_t> dirty;
+	std::map<std::string, uint64_t> outputKeys;
+	for (size_t j = 0; j < jobs.size(); j++)
+	{
+		CookJob& job = jobs[j];
+		auto missing = std::find_if(job.Inputs.begin(), job.Inputs.end(), [&](const std::string& input) { return current.Inputs.count(input) == 0; });
+		if (missing != job.Inputs.end())
+		{
+			if (unreadable.count(*missing))
+				printf("%s: could not read\n", missing->c_str());
+			else
+				printf("%s: %s is missing\n", job.Name.c_str(), missing->c_str());
+			job.Failed = true;
+			continue;
+		}
+
+		auto failed = failedRead(job);
+		if (failed != job.Reads.end())
+		{
+			printf("%s: %s failed\n", job.Name.c_str(), failed->c_str());
+			job.Failed = true;
+			continue;
+		}
+
+		job.Key = GetJobKey(job, current.Inputs, outputKeys);
+		for (const std::string& output : job.Outputs)
+			outputKeys[output] = job.Key;
+
+		auto last = previous.Jobs.find(job.Name);
+		job.Dirty = last == previous.Jobs.end() || last->second.Key != job.Key || last->second.Outputs != job.Outputs;
+		for (size_t o = 0; o < job.Outputs.size() && !job.Dirty; o++)
+		{
+			std::error_code error;
+			job.Dirty = !std::filesystem::exists(ToPath(outputFolder, job.Outputs[o]), error);
+		}
+
+		if (job.Dirty)
+			dirty.push_back(j);
+	}
+
+	for (bool withReads : { false, true })
+	{
+		std::vector<size_t> wave;
+		std::copy_if(dirty.begin(), dirty.end(), std::back_inserter(wave), [&](size_t j) { return jobs[j].Reads.empty() != withReads; });
+
+		ThreadPool::Get().ParallelFor(wave.size(), [&](size_t i)
+		{
+			CookJob& job = jobs[wave[i]];
+			auto failed = failedRead(job);
+			if (failed != job.Reads.end())
+			{
+				printf("%s: %s failed\n", job.Name.c_str(), failed->c_str());
+				job.Failed = true;
+				return;
+			}
+
+			job.Failed = !RunJob(job, sourceFolder, outputFolder);
+			if (job.Failed)
+				printf("%s: cook failed\n", job.Name.c_str());
+		});
+	}
+
+	// Failed jobs are recorded without a key, so they run again
+	// next time but their old outputs are still tracked
+	std::set<std::string> outputs;
+	for (const CookJob& job : jobs)
+	{
+		JobRecord& record = current.Jobs[job.Name];
+		record.Key = job.Failed ? 0 : job.Key;
+		record.Outputs = job.Outputs;
+		outputs.insert(job.Outputs.begin(), job.Outputs.end());
+
+		stats.JobCount++;
+		stats.CookedCount += job.Dirty && !job.Failed;
+		stats.UpToDateCount += !job.Dirty && !job.Failed;
+		stats.FailedCount += job.Failed;
+	}
+
+	for (const auto& [name, record] : previous.Jobs)
+	{
+		for (const std::string& output : record.Outputs)
+		{
+			std::error_code error;
+			if (!outputs.count(output) && std::filesystem::remove(ToPath(outputFolder, output), error))
+				stats.RemovedCount++;
+		}
+	}
+
+	bool succeeded = stats.FailedCount == 0;
+	if (!SaveDatabase(GetDatabasePath(outputFolder), current))
+	{
+		printf("Could not write %ls\n", GetDatabasePath(outputFolder).c_str());
+		succeeded = false;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(outputFolder, error);
+	std::wstring packPath = GetPackPath(outputFolder);
+	if (!PackArchive::IsUpToDate(outputFolder, packPath))
+	{
+		stats.PackRebuilt = true;
+		if (!PackArchive::Build(outputFolder, packPath))
+		{
+			printf("Could not write %ls\n", packPath.c_str());
+			succeeded = false;
+		}
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	stats.Milliseconds = elapsed.count();
+	return succeeded;
+}
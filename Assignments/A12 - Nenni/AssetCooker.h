@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// --------------------------------------------------------
+// What one AssetCooker::Cook() run did
+// --------------------------------------------------------
+struct CookStats
+{
+	unsigned int JobCount = 0;
+	unsigned int CookedCount = 0;		// Jobs that ran
+	unsigned int UpToDateCount = 0;		// Jobs skipped because nothing changed
+	unsigned int FailedCount = 0;
+	unsigned int HashedCount = 0;		// Inputs whose size or time changed, so were read
+	unsigned int RemovedCount = 0;		// Outputs no job produces anymore
+	bool PackRebuilt = false;
+	double Milliseconds = 0.0;
+};
+
+// --------------------------------------------------------
+// Offline asset cooker: turns a source folder (assets/) into
+// the runtime-ready files the game loads, plus a .pack of them
+//
+// - Every source file is the input of one job with a rule:
+//    - .obj: cooked into a .mesh (see MeshCooker), welded,
+//       optimized, with tangents, LODs and meshlets, so the
+//       game never parses or optimizes anything
+//    - .scene: converted to a .scenebin (see SceneFile), so
+//       the game maps its entities instead of parsing them
+//    - .png: compressed into a .dds with mips (see
+//       TextureCooker), so the game never decodes textures
+//    - Mask .pngs of one material ("_ao", "_roughness",
+//       "_metal"): packed together into one "_orm" .dds, a
+//       job with all of them as inputs
+//    - Everything else (.mtl, .glb, .meshz) is copied as it
+//       is for now
+//    - .mesh caches, temp files and packs are skipped
+// - Plus generated files, computed rather than converted:
+//    - The split sum BRDF lookup table (brdf_lut.dds, see
+//       Brdf), from no inputs at all
+//    - The sky's image based lighting (sky.ibl, see
+//       IblPrefilter), from its 6 face .pngs; the cook
+//       fails, naming them, when only some are there
+//    - Light probes for each .scene (.probes, see
+//       LightProbes), baked from its lights and the cooked
+//       meshes, albedo maps and sky.ibl it uses
+// - A job's key hashes the cooker and rule versions with the
+//    names and content hashes of its inputs (if any), and the
+//    keys of the jobs whose outputs it reads; it only runs
+//    when the key differs from the last run or one of its
+//    outputs is missing
+// - The database next to the output folder (.cookdb, text)
+//    holds every input's size, time and hash, so unchanged
+//    inputs aren't read again, and every job's key and
+//    outputs, so outputs of jobs that are gone get deleted
+// - Jobs that need to run are spread over the thread pool;
+//    jobs reading other jobs' outputs run after all the rest
+// --------------------------------------------------------
+namespace AssetCooker
+{
+	// Bump whenever a rule's output changes so everything re-cooks
+	const uint32_t Version = 1;
+
+	// Cooks every changed input; false if any job failed or the
+	// pack couldn't be written
+	bool Cook(const std::wstring& sourceFolder, const std::wstring& outputFolder, CookStats& stats);
+
+	// Files written next to the output folder ("cooked" ->
+	// "cooked.pack" and "cooked.cookdb")
+	std::wstring GetPackPath(const std::wstring& outputFolder);
+	std::wstring GetDatabasePath(const std::wstring& outputFolder);
+}
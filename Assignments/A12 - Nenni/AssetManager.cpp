@@ -0,0 +1,773 @@
+#include "AssetManager.h"
+#include "AsyncFileReader.h"
+#include "DdsFile.h"
+#include "Graphics.h"
+#include "PngDecoder.h"
+#include "ThreadPool.h"
+#include "Vfs.h"
+#include "WICTextureLoader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cwctype>
+#include <filesystem>
+
+namespace
+{
+	// Time Update() may spend creating textures each frame (at
+	// least one asset is always published, so loading can't stall)
+	const double CreateBudgetMilliseconds = 4.0;
+
+	// --------------------------------------------------------
+	// A unit cube (-0.5 to 0.5) drawn in place of meshes that
+	// are still loading
+	// --------------------------------------------------------
+	std::shared_ptr<Mesh> CreatePlaceholderMesh()
+	{
+		// Normal and tangent of each face; the bitangent (normal x
+		// tangent) points down the face, so corners go clockwise
+		const XMFLOAT3 faces[6][2] =
+		{
+			{ { 0, 0, -1 }, { 1, 0, 0 } },
+			{ { 0, 0, 1 }, { -1, 0, 0 } },
+			{ { 1, 0, 0 }, { 0, 0, 1 } },
+			{ { -1, 0, 0 }, { 0, 0, -1 } },
+			{ { 0, 1, 0 }, { 1, 0, 0 } },
+			{ { 0, -1, 0 }, { 1, 0, 0 } },
+		};
+		const XMFLOAT2 corners[4] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+
+		Vertex vertices[24] = {};
+		unsigned int indices[36] = {};
+		for (unsigned int f = 0; f < 6; f++)
+		{
+			XMVECTOR normal = XMLoadFloat3(&faces[f][0]);
+			XMVECTOR tangent = XMLoadFloat3(&faces[f][1]);
+			XMVECTOR bitangent = XMVector3Cross(normal, tangent);
+
+			for (unsigned int c = 0; c < 4; c++)
+			{
+				Vertex& vertex = vertices[f * 4 + c];
+				XMVECTOR position = XMVectorScale(normal, 0.5f);
+				position = XMVectorAdd(position, XMVectorScale(tangent, corners[c].x - 0.5f));
+				position = XMVectorAdd(position, XMVectorScale(bitangent, corners[c].y - 0.5f));
+				XMStoreFloat3(&vertex.Position, position);
+				vertex.UV = corners[c];
+				vertex.Normal = faces[f][0];
+				vertex.Tangent = faces[f][1];
+			}
+
+			const unsigned int quad[6] = { 0, 1, 2, 0, 2, 3 };
+			for (unsigned int i = 0; i < 6; i++)
+				indices[f * 6 + i] = f * 4 + quad[i];
+		}
+
+		return std::make_shared<Mesh>(indices, vertices, 36, 24);
+	}
+
+	// A 1x1 texture of one color
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreatePlaceholderTexture(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+	{
+		const uint8_t pixel[4] = { r, g, b, a };
+
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = 1;
+		desc.Height = 1;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		D3D11_SUBRESOURCE_DATA data = {};
+		data.pSysMem = pixel;
+		data.SysMemPitch = sizeof(pixel);
+
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+		if (SUCCEEDED(Graphics::Device->CreateTexture2D(&desc, &data, texture.GetAddressOf())))
+			Graphics::Device->CreateShaderResourceView(texture.Get(), 0, srv.GetAddressOf());
+		return srv;
+	}
+
+	// --------------------------------------------------------
+	// An immutable texture of decoded mips (mips[0] is the
+	// full size one), so nothing goes through the context
+	// --------------------------------------------------------
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateTexture(const std::vector<Image>& mips)
+	{
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = mips[0].Width;
+		desc.Height = mips[0].Height;
+		desc.MipLevels = (UINT)mips.size();
+		desc.ArraySize = 1;
+		desc.Format = (DXGI_FORMAT)DdsFile::GetDxgiFormat(mips[0].Format);
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		std::vector<D3D11_SUBRESOURCE_DATA> data(mips.size());
+		for (size_t i = 0; i < mips.size(); i++)
+		{
+			data[i].pSysMem = mips[i].Pixels.data();
+			data[i].SysMemPitch = (UINT)mips[i].GetRowPitch();
+		}
+
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+		if (SUCCEEDED(Graphics::Device->CreateTexture2D(&desc, data.data(), texture.GetAddressOf())))
+			Graphics::Device->CreateShaderResourceView(texture.Get(), 0, srv.GetAddressOf());
+		return srv;
+	}
+
+	// Bits per pixel of the formats textures are created with
+	// (block compressed ones averaged over their 4x4 blocks)
+	size_t BitsPerPixel(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_R32G32B32A32_FLOAT:
+			return 128;
+		case DXGI_FORMAT_R32G32B32_FLOAT:
+			return 96;
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		case DXGI_FORMAT_R16G16B16A16_UNORM:
+		case DXGI_FORMAT_R32G32_FLOAT:
+			return 64;
+		case DXGI_FORMAT_R16_FLOAT:
+		case DXGI_FORMAT_R16_UNORM:
+		case DXGI_FORMAT_R8G8_UNORM:
+		case DXGI_FORMAT_B5G6R5_UNORM:
+		case DXGI_FORMAT_B5G5R5A1_UNORM:
+			return 16;
+		case DXGI_FORMAT_R8_UNORM:
+		case DXGI_FORMAT_A8_UNORM:
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+		case DXGI_FORMAT_BC5_UNORM:
+		case DXGI_FORMAT_BC5_SNORM:
+		case DXGI_FORMAT_BC6H_UF16:
+		case DXGI_FORMAT_BC6H_SF16:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			return 8;
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+		case DXGI_FORMAT_BC4_UNORM:
+		case DXGI_FORMAT_BC4_SNORM:
+			return 4;
+		default:
+			return 32;
+		}
+	}
+
+	bool IsBlockCompressed(DXGI_FORMAT format)
+	{
+		return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM) ||
+			(format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+	}
+
+	size_t MemorySize(const std::shared_ptr<Mesh>& mesh)
+	{
+		return mesh->GetMemorySize();
+	}
+
+	// --------------------------------------------------------
+	// Bytes of a texture from its desc: every mip of every
+	// array slice (6 for a cube map)
+	// --------------------------------------------------------
+	size_t MemorySize(const Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+	{
+		Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+		srv->GetResource(resource.GetAddressOf());
+		if (FAILED(resource.As(&texture)))
+			return 0;
+
+		D3D11_TEXTURE2D_DESC desc = {};
+		texture->GetDesc(&desc);
+		size_t bits = BitsPerPixel(desc.Format);
+		bool blocks = IsBlockCompressed(desc.Format);
+
+		size_t bytes = 0;
+		for (unsigned int mip = 0; mip < desc.MipLevels; mip++)
+		{
+			size_t width = std::max(desc.Width >> mip, 1u);
+			size_t height = std::max(desc.Height >> mip, 1u);
+			if (blocks)
+			{
+				width = (width + 3) / 4 * 4;
+				height = (height + 3) / 4 * 4;
+			}
+			bytes += width * height * bits / 8;
+		}
+		return bytes * desc.ArraySize;
+	}
+}
+
+AssetManager::AssetManager(size_t memoryBudget, size_t uploadBudget)
+{
+	poolJobs = 0;
+	stopping = false;
+	loadingCount = 0;
+	loadedCount = 0;
+	failedCount = 0;
+	decodeMilliseconds = 0;
+	frame = 0;
+	memoryUsed = 0;
+	this->memoryBudget = memoryBudget;
+	this->uploadBudget = uploadBudget;
+
+	placeholderMesh = CreatePlaceholderMesh();
+	placeholderTextures[(int)TexturePlaceholder::White] = CreatePlaceholderTexture(255, 255, 255, 255);
+	placeholderTextures[(int)TexturePlaceholder::FlatNormal] = CreatePlaceholderTexture(128, 128, 255, 255);
+	placeholderTextures[(int)TexturePlaceholder::Masks] = CreatePlaceholderTexture(255, 255, 0, 255);
+	placeholderTextures[(int)TexturePlaceholder::Black] = CreatePlaceholderTexture(0, 0, 0, 255);
+
+	loader = std::thread(&AssetManager::LoaderLoop, this);
+}
+
+// --------------------------------------------------------
+// Drops requests that haven't started and waits for the
+// ones that have (their results are thrown away)
+// - The loader is joined first, since it submits decodes
+// --------------------------------------------------------
+AssetManager::~AssetManager()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		workAvailable.notify_all();
+	}
+	loader.join();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	poolJobsDone.wait(lock, [this] { return poolJobs == 0; });
+}
+
+std::shared_ptr<MeshAsset> AssetManager::LoadMesh(const std::wstring& path)
+{
+	std::wstring key = CanonicalPath(path);
+	MeshEntry entry;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		MeshEntry& existing = meshes[key];
+		if (existing.Asset)
+			return existing.Asset;
+
+		existing.Asset = std::make_shared<MeshAsset>();
+		existing.Asset->path = key;
+		existing.Asset->frameClock = &frame;
+		existing.Asset->resource = placeholderMesh;
+		existing.Asset->placeholder = placeholderMesh;
+		existing.Path = path;
+		entry = existing;
+	}
+
+	QueueMesh(entry);
+	return entry.Asset;
+}
+
+// --------------------------------------------------------
+// Builds a mesh on the thread pool
+// - Called without the lock, since a pool without workers
+//    runs the job right here
+// --------------------------------------------------------
+void AssetManager::QueueMesh(const MeshEntry& entry)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		poolJobs++;
+		StartLoad();
+	}
+
+	std::shared_ptr<MeshAsset> asset = entry.Asset;
+	std::wstring path = entry.Path;
+	ThreadPool::Get().Submit([this, asset, path]()
+	{
+		std::shared_ptr<MeshLoad> load = std::make_shared<MeshLoad>();
+		load->Target = asset;
+
+		bool skip;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			skip = stopping;
+		}
+
+		if (!skip)
+		{
+			try
+			{
+				load->Result = std::make_shared<Mesh>(path);
+			}
+			catch (const std::exception& error)
+			{
+				printf("%ls: %s\n", path.c_str(), error.what());
+			}
+		}
+
+		// Notified under the lock, since the destructor may be
+		// waiting to free it
+		std::lock_guard<std::mutex> lock(mutex);
+		finishedMeshes.push_back(load);
+		poolJobs--;
+		poolJobsDone.notify_all();
+	});
+}
+
+std::shared_ptr<TextureAsset> AssetManager::LoadTexture(const std::wstring& path, TexturePlaceholder placeholder)
+{
+	return RequestTexture(CanonicalPath(path), { path }, nullptr, placeholderTextures[(int)placeholder]);
+}
+
+std::shared_ptr<TextureAsset> AssetManager::LoadTexture(const std::vector<std::wstring>& paths, TextureCreator create, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> placeholder)
+{
+	std::wstring key;
+	for (const std::wstring& path : paths)
+		key += (key.empty() ? L"" : L"|") + CanonicalPath(path);
+	return RequestTexture(key, paths, create, placeholder);
+}
+
+std::shared_ptr<TextureAsset> AssetManager::RequestTexture(const std::wstring& key, const std::vector<std::wstring>& paths, TextureCreator create, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> placeholder)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	TextureEntry& existing = textures[key];
+	if (existing.Asset)
+		return existing.Asset;
+
+	existing.Asset = std::make_shared<TextureAsset>();
+	existing.Asset->path = key;
+	existing.Asset->frameClock = &frame;
+	existing.Asset->resource = placeholder;
+	existing.Asset->placeholder = placeholder;
+	existing.Paths = paths;
+	existing.Create = create;
+
+	QueueTexture(existing);
+	return existing.Asset;
+}
+
+// Hands a texture to the loader thread (under the lock)
+void AssetManager::QueueTexture(const TextureEntry& entry)
+{
+	std::shared_ptr<TextureLoad> load = std::make_shared<TextureLoad>();
+	load->Target = entry.Asset;
+	load->Paths = entry.Paths;
+	load->Create = entry.Create;
+	textureRequests.push_back(load);
+	StartLoad();
+
+	workAvailable.notify_one();
+}
+
+// Counts a new load (under the lock)
+void AssetManager::StartLoad()
+{
+	if (loadingCount == 0)
+		firstRequest = std::chrono::steady_clock::now();
+	loadingCount++;
+}
+
+// --------------------------------------------------------
+// Reads every texture requested since the last batch, and
+// hands each one to the thread pool to decode as soon as its
+// last file has arrived, while the rest are still being read
+//
+// - Packed files are used where they are mapped; loose ones
+//    are read together (see AsyncFileReader) into buffers the
+//    load then owns
+// - Loads are decoded (and handed to Update()) even when a
+//    file couldn't be read, so they are marked as failed there
+// --------------------------------------------------------
+void AssetManager::LoaderLoop()
+{
+	while (true)
+	{
+		std::vector<std::shared_ptr<TextureLoad>> batch;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workAvailable.wait(lock, [this] { return stopping || !textureRequests.empty(); });
+			if (stopping)
+				return;
+			batch.swap(textureRequests);
+		}
+
+		// Submitted without the lock, since a pool without
+		// workers runs the job right here
+		auto decode = [this](const std::shared_ptr<TextureLoad>& load)
+		{
+			for (const ByteSpan& file : load->Files)
+				load->Failed |= file.Data == nullptr;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				poolJobs++;
+			}
+			ThreadPool::Get().Submit([this, load]() { DecodeTexture(load); });
+		};
+
+		AsyncFileReader reads;
+		for (const std::shared_ptr<TextureLoad>& load : batch)
+		{
+			size_t fileCount = load->Paths.size();
+			load->Files.resize(fileCount);
+			load->LooseFiles.resize(fileCount);
+
+			for (size_t f = 0; f < fileCount; f++)
+			{
+				if (Vfs::ReadPacked(load->Paths[f], load->Files[f]))
+					continue;
+
+				load->FilesPending++;
+				reads.QueueOwned(load->Paths[f], [load, f, &decode](const ByteSpan& data, std::unique_ptr<char[]> buffer)
+				{
+					load->LooseFiles[f] = std::move(buffer);
+					load->Files[f] = data;
+					if (--load->FilesPending == 0)
+						decode(load);
+				});
+			}
+
+			if (load->FilesPending == 0)
+				decode(load);
+		}
+		reads.Run();
+
+		// Files that couldn't be read never arrived
+		for (const std::shared_ptr<TextureLoad>& load : batch)
+		{
+			if (load->FilesPending > 0)
+			{
+				load->FilesPending = 0;
+				decode(load);
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Decodes a texture's files on the thread pool, then hands
+// it to Update()
+//
+// - .DDS files are only copied out (they're stored as the GPU
+//    uses them, see AssetCooker)
+// - A single .PNG also gets its mips here, so Update() can
+//    create the texture without the immediate context
+// - The files are freed once read; other kinds are kept for
+//    WIC, except for a creator's (which only takes images)
+// --------------------------------------------------------
+void AssetManager::DecodeTexture(const std::shared_ptr<TextureLoad>& load)
+{
+	bool skip;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		skip = stopping;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (!skip && !load->Failed)
+	{
+		bool readable = true;
+		for (const ByteSpan& file : load->Files)
+			readable &= PngDecoder::IsPng(file.Data, file.Size) || DdsFile::IsDds(file.Data, file.Size);
+
+		if (readable)
+		{
+			// A .DDS brings its own mips (a single one only gets more
+			// in formats GenerateMips() can filter); a creator only
+			// gets the full size image of each file
+			std::vector<Image> mips;
+			for (size_t f = 0; f < load->Files.size() && !load->Failed; f++)
+			{
+				const ByteSpan& file = load->Files[f];
+				mips.resize(1);
+				if (DdsFile::IsDds(file.Data, file.Size))
+					load->Failed = !DdsFile::Parse(file.Data, file.Size, mips);
+				else
+					load->Failed = !PngDecoder::Decode(file.Data, file.Size, mips[0]);
+
+				if (load->Failed)
+					break;
+				if (load->Create)
+					load->Images.push_back(std::move(mips[0]));
+				else if (mips.size() > 1 || (mips[0].Format != ImageFormat::R8 && mips[0].Format != ImageFormat::RGBA8))
+					load->Images = std::move(mips);
+				else
+					Images::GenerateMips(std::move(mips[0]), load->Images);
+			}
+
+			load->Files.clear();
+			load->LooseFiles.clear();
+		}
+		else if (load->Create)
+		{
+			load->Failed = true;
+		}
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+	// Notified under the lock, since the destructor may be
+	// waiting to free it
+	std::lock_guard<std::mutex> lock(mutex);
+	decodeMilliseconds += elapsed.count();
+	finishedTextures.push_back(load);
+	poolJobs--;
+	poolJobsDone.notify_all();
+}
+
+// --------------------------------------------------------
+// Publishes finished meshes, then creates textures, until
+// the frame's upload (or creation time) budget is spent
+// --------------------------------------------------------
+void AssetManager::Update()
+{
+	frame++;
+	ReloadUsed();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		publishQueue.insert(publishQueue.end(), finishedMeshes.begin(), finishedMeshes.end());
+		finishedMeshes.clear();
+		createQueue.insert(createQueue.end(), finishedTextures.begin(), finishedTextures.end());
+		finishedTextures.clear();
+	}
+
+	// Meshes first, since they're cheap to publish and whole
+	// cells of the world wait on them
+	size_t uploaded = 0;
+	unsigned int published = 0;
+	while (!publishQueue.empty() && (published == 0 || uploaded < uploadBudget))
+	{
+		std::shared_ptr<MeshLoad> load = publishQueue.front();
+		publishQueue.pop_front();
+		Publish(*load->Target, load->Result);
+		uploaded += load->Target->memorySize;
+		published++;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	while (!createQueue.empty() && (published == 0 || uploaded < uploadBudget))
+	{
+		std::shared_ptr<TextureLoad> load = createQueue.front();
+		createQueue.pop_front();
+
+		// Files that weren't decoded (not PNGs) get their mipmaps
+		// from WIC, which needs the immediate context
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+		if (!load->Failed && load->Create)
+			srv = load->Create(load->Images);
+		else if (!load->Failed && !load->Images.empty())
+			srv = CreateTexture(load->Images);
+		else if (!load->Failed)
+			CreateWICTextureFromMemory(Graphics::Device.Get(), Graphics::Context.Get(), (const uint8_t*)load->Files[0].Data, load->Files[0].Size, 0, srv.GetAddressOf());
+
+		if (!srv)
+			printf("%ls: could not load texture\n", load->Target->path.c_str());
+		Publish(*load->Target, srv);
+		uploaded += load->Target->memorySize;
+		published++;
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		if (elapsed.count() >= CreateBudgetMilliseconds)
+			break;
+	}
+
+	EvictOverBudget();
+}
+
+// --------------------------------------------------------
+// Loads evicted assets again once something has used them
+// since they were evicted
+// --------------------------------------------------------
+void AssetManager::ReloadUsed()
+{
+	for (size_t i = 0; i < evictedMeshes.size();)
+	{
+		MeshEntry entry = evictedMeshes[i];
+		if (!entry.Asset->wanted)
+		{
+			i++;
+			continue;
+		}
+
+		evictedMeshes[i] = evictedMeshes.back();
+		evictedMeshes.pop_back();
+		entry.Asset->state = AssetState::Loading;
+		QueueMesh(entry);
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t i = 0; i < evictedTextures.size();)
+	{
+		if (!evictedTextures[i].Asset->wanted)
+		{
+			i++;
+			continue;
+		}
+
+		evictedTextures[i].Asset->state = AssetState::Loading;
+		QueueTexture(evictedTextures[i]);
+		evictedTextures[i] = evictedTextures.back();
+		evictedTextures.pop_back();
+	}
+}
+
+// --------------------------------------------------------
+// Evicts the least recently used assets until the loaded
+// ones fit the budget
+//
+// - Anything used last frame is kept (it would only load
+//    again right away), even if that leaves it over budget
+// - Assets are found by a full scan, which is only done
+//    when over budget
+// --------------------------------------------------------
+void AssetManager::EvictOverBudget()
+{
+	if (memoryUsed <= memoryBudget)
+		return;
+
+	std::vector<AssetBase*> candidates;
+	std::vector<MeshEntry> meshCandidates;
+	std::vector<TextureEntry> textureCandidates;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& [key, entry] : meshes)
+		{
+			if (entry.Asset->IsReady() && entry.Asset->lastUsedFrame + 1 < frame)
+				meshCandidates.push_back(entry);
+		}
+		for (auto& [key, entry] : textures)
+		{
+			if (entry.Asset->IsReady() && entry.Asset->lastUsedFrame + 1 < frame)
+				textureCandidates.push_back(entry);
+		}
+	}
+
+	// Least recently used first, meshes and textures together
+	for (MeshEntry& entry : meshCandidates)
+		candidates.push_back(entry.Asset.get());
+	for (TextureEntry& entry : textureCandidates)
+		candidates.push_back(entry.Asset.get());
+	std::sort(candidates.begin(), candidates.end(), [](const AssetBase* a, const AssetBase* b) { return a->lastUsedFrame < b->lastUsedFrame; });
+
+	unsigned int evictedCount = 0;
+	size_t evictedBytes = 0;
+	for (AssetBase* asset : candidates)
+	{
+		if (memoryUsed <= memoryBudget)
+			break;
+
+		asset->Unload();
+		asset->state = AssetState::Evicted;
+		asset->wanted = false;
+		memoryUsed -= asset->memorySize;
+		evictedBytes += asset->memorySize;
+		asset->memorySize = 0;
+		evictedCount++;
+	}
+
+	// Kept so they can be loaded again
+	for (MeshEntry& entry : meshCandidates)
+	{
+		if (entry.Asset->state == AssetState::Evicted)
+			evictedMeshes.push_back(entry);
+	}
+	for (TextureEntry& entry : textureCandidates)
+	{
+		if (entry.Asset->state == AssetState::Evicted)
+			evictedTextures.push_back(entry);
+	}
+
+	if (evictedCount > 0)
+	{
+		printf("Evicted %u assets (%.1f MB), %.1f of %.1f MB used\n", evictedCount,
+			evictedBytes / (1024.0 * 1024.0), memoryUsed / (1024.0 * 1024.0), memoryBudget / (1024.0 * 1024.0));
+	}
+}
+
+unsigned int AssetManager::GetLoadingCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return loadingCount;
+}
+
+size_t AssetManager::GetMemoryUsed() const
+{
+	return memoryUsed;
+}
+
+size_t AssetManager::GetMemoryBudget() const
+{
+	return memoryBudget;
+}
+
+void AssetManager::SetMemoryBudget(size_t bytes)
+{
+	memoryBudget = bytes;
+}
+
+size_t AssetManager::GetUploadBudget() const
+{
+	return uploadBudget;
+}
+
+void AssetManager::SetUploadBudget(size_t bytesPerFrame)
+{
+	uploadBudget = bytesPerFrame;
+}
+
+uint64_t AssetManager::GetFrame() const
+{
+	return frame;
+}
+
+std::wstring AssetManager::CanonicalPath(const std::wstring& path)
+{
+	std::error_code error;
+	std::filesystem::path absolute = std::filesystem::absolute(path, error);
+	std::wstring canonical = (error ? std::filesystem::path(path) : absolute).lexically_normal().make_preferred().wstring();
+
+#ifdef _WIN32
+	std::transform(canonical.begin(), canonical.end(), canonical.begin(), [](wchar_t c) { return (wchar_t)towlower(c); });
+#endif
+	return canonical;
+}
+
+// --------------------------------------------------------
+// Swaps a load's result in for the placeholder, or marks it
+// as failed (keeping the placeholder), and reports once
+// nothing is loading anymore
+// - A new asset counts as used this frame, so it isn't
+//    evicted before it could be drawn
+// --------------------------------------------------------
+template<typename Resource>
+void AssetManager::Publish(Asset<Resource>& asset, const Resource& result)
+{
+	if (result)
+	{
+		asset.resource = result;
+		asset.state = AssetState::Ready;
+		asset.memorySize = MemorySize(result);
+		asset.lastUsedFrame = frame;
+		memoryUsed += asset.memorySize;
+	}
+	else
+	{
+		asset.state = AssetState::Failed;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	loadingCount--;
+	(result ? loadedCount : failedCount)++;
+	if (loadingCount > 0)
+		return;
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - firstRequest;
+	printf("Streamed %u assets in %.1f ms (%u failed, %.1f ms of texture decoding on %u threads)\n",
+		loadedCount + failedCount, elapsed.count(), failedCount, decodeMilliseconds, ThreadPool::Get().GetThreadCount());
+	loadedCount = 0;
+	failedCount = 0;
+	decodeMilliseconds = 0;
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Asset.h"
+#include "Image.h"
+#include "Mesh.h"
+#include "PackArchive.h"
+
+// What a texture shows until its file has been loaded
+enum class TexturePlaceholder
+{
+	White,		// Albedo
+	FlatNormal,	// Normal maps
+	Masks,		// Packed occlusion, roughness and metalness: unoccluded, fully rough, not metal
+	Black		// Lookup tables: nothing until they're in
+};
+
+// Makes a texture out of files that have all been decoded
+// (like a cubemap's faces), on the main thread; null if it can't
+using TextureCreator = std::function<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>(const std::vector<Image>& images)>;
+
+// --------------------------------------------------------
+// Loads meshes and textures in the background, once each
+//
+// - Assets are keyed by their canonical path, so every
+//    request for the same file (from any thread, even while
+//    it is still loading) gets the same handle and one load
+// - Handles come back right away with a placeholder (a small
+//    cube, or a 1x1 texture) that Update() swaps for the real
+//    asset once it's ready
+// - Meshes are built on the thread pool (buffer creation is
+//    free-threaded); texture files are read in batches by a
+//    loader thread (see AsyncFileReader), then decoded (see
+//    PngDecoder) with their mipmaps on the thread pool, or
+//    just copied out for .DDS files (see DdsFile), so Update()
+//    only creates the textures, within a time budget per frame
+// - Other kinds of files are decoded by WIC in Update()
+//    instead, which needs the immediate context for mipmaps
+// - Loaded assets count their size (from the buffer and
+//    texture descs) against a memory budget; when it's over,
+//    Update() evicts the least recently used ones (back to
+//    their placeholder) and they load again once they are
+//    used (see Asset::Use()) - memory is only freed once
+//    nothing else holds the resource
+// - Update() publishes at most the upload budget's bytes of
+//    finished assets per frame (but always at least one), and
+//    leaves the rest for the next frames, so streaming in many
+//    assets at once doesn't make a frame spike
+// - Destroying the manager waits for the loads in flight, so
+//    it must happen before Vfs::Unmount()
+// --------------------------------------------------------
+class AssetManager
+{
+public:
+	AssetManager(size_t memoryBudget, size_t uploadBudget);
+	~AssetManager();
+
+	AssetManager(const AssetManager&) = delete;
+	AssetManager& operator=(const AssetManager&) = delete;
+
+	std::shared_ptr<MeshAsset> LoadMesh(const std::wstring& path);
+	std::shared_ptr<TextureAsset> LoadTexture(const std::wstring& path, TexturePlaceholder placeholder = TexturePlaceholder::White);
+
+	// A texture made from several files by create; placeholder
+	// may be null
+	std::shared_ptr<TextureAsset> LoadTexture(const std::vector<std::wstring>& paths, TextureCreator create, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> placeholder);
+
+	// Swaps finished loads in for their placeholders, reloads
+	// evicted assets that were used and evicts what's over
+	// the budget (once per frame, on the main thread)
+	void Update();
+
+	// Assets requested but not ready (or failed) yet
+	unsigned int GetLoadingCount() const;
+
+	// Bytes of every loaded asset, and how many are allowed
+	// (main thread only)
+	size_t GetMemoryUsed() const;
+	size_t GetMemoryBudget() const;
+	void SetMemoryBudget(size_t bytes);
+
+	// Bytes of loaded assets Update() publishes per frame
+	size_t GetUploadBudget() const;
+	void SetUploadBudget(size_t bytesPerFrame);
+
+	// Frames so far (Update() calls), which Asset::Use() stamps
+	uint64_t GetFrame() const;
+
+	// Key of a path: normalized, and case-folded on Windows
+	static std::wstring CanonicalPath(const std::wstring& path);
+
+private:
+	// What it takes to load an asset (again)
+	struct MeshEntry
+	{
+		std::shared_ptr<MeshAsset> Asset;
+		std::wstring Path;
+	};
+
+	struct TextureEntry
+	{
+		std::shared_ptr<TextureAsset> Asset;
+		std::vector<std::wstring> Paths;
+		TextureCreator Create;
+	};
+
+	struct MeshLoad
+	{
+		std::shared_ptr<MeshAsset> Target;
+		std::shared_ptr<Mesh> Result;
+	};
+
+	struct TextureLoad
+	{
+		std::shared_ptr<TextureAsset> Target;
+		std::vector<std::wstring> Paths;
+		TextureCreator Create;
+		std::vector<ByteSpan> Files;
+		std::vector<std::unique_ptr<char[]>> LooseFiles;	// Owns Files that aren't packed
+		size_t FilesPending = 0;	// Not read yet (loader thread only)
+		std::vector<Image> Images;	// Every file, or a single file's mips
+		bool Failed = false;
+	};
+
+	std::shared_ptr<Mesh> placeholderMesh;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> placeholderTextures[4];
+
+	// Every asset ever requested, by canonical path (or paths)
+	std::unordered_map<std::wstring, MeshEntry> meshes;
+	std::unordered_map<std::wstring, TextureEntry> textures;
+
+	// Shared with the loader thread and the pool
+	mutable std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable poolJobsDone;
+	std::vector<std::shared_ptr<TextureLoad>> textureRequests;
+	std::vector<std::shared_ptr<MeshLoad>> finishedMeshes;
+	std::vector<std::shared_ptr<TextureLoad>> finishedTextures;
+	unsigned int poolJobs;
+	bool stopping;
+	std::thread loader;
+
+	// Loads since the count was last zero, for the report
+	unsigned int loadingCount;
+	unsigned int loadedCount;
+	unsigned int failedCount;
+	double decodeMilliseconds;	// Summed over the pool's threads
+	std::chrono::steady_clock::time_point firstRequest;
+
+	// Main thread only
+	std::deque<std::shared_ptr<MeshLoad>> publishQueue;
+	std::deque<std::shared_ptr<TextureLoad>> createQueue;
+	std::vector<MeshEntry> evictedMeshes;
+	std::vector<TextureEntry> evictedTextures;
+	uint64_t frame;
+	size_t memoryUsed;
+	size_t memoryBudget;
+	size_t uploadBudget;
+
+	void LoaderLoop();
+	void StartLoad();
+	void QueueMesh(const MeshEntry& entry);
+	void QueueTexture(const TextureEntry& entry);
+	void DecodeTexture(const std::shared_ptr<TextureLoad>& load);
+	std::shared_ptr<TextureAsset> RequestTexture(const std::wstring& key, const std::vector<std::wstring>& paths, TextureCreator create, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> placeholder);
+	void ReloadUsed();
+	void EvictOverBudget();
+
+	template<typename Resource>
+	void Publish(Asset<Resource>& asset, const Resource& result);
+};
@@ -0,0 +1,570 @@
+#include "AsyncFileReader.h"
+#include "ThreadPool.h"
+#include "Vfs.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace
+{
+	// Largest single read (ReadFile takes a DWORD, io_uring a u32)
+	const uint64_t MaxReadSize = 1u << 30;
+
+#ifdef _WIN32
+	typedef HANDLE FileHandle;
+	const FileHandle NoFile = INVALID_HANDLE_VALUE;
+#else
+	typedef int FileHandle;
+	const FileHandle NoFile = -1;
+#endif
+
+	void CloseFile(FileHandle file)
+	{
+		if (file == NoFile)
+			return;
+#ifdef _WIN32
+		CloseHandle(file);
+#else
+		::close(file);
+#endif
+	}
+
+	// One loose file being read into its own buffer
+	struct LooseRead
+	{
+		size_t Request = 0;
+		FileHandle File = NoFile;
+		uint64_t Size = 0;
+		uint64_t Done = 0;
+		std::unique_ptr<char[]> Buffer;
+		bool Failed = false;
+
+		LooseRead() = default;
+		LooseRead(LooseRead&& other) noexcept :
+			Request(other.Request), File(other.File), Size(other.Size), Done(other.Done),
+			Buffer(std::move(other.Buffer)), Failed(other.Failed)
+		{
+			other.File = NoFile;
+		}
+		~LooseRead() { CloseFile(File); }
+	};
+
+	bool OpenForRead(const std::wstring& path, LooseRead& read)
+	{
+#ifdef _WIN32
+		read.File = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+		if (read.File == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize = {};
+		if (!GetFileSizeEx(read.File, &fileSize))
+			return false;
+		read.Size = (uint64_t)fileSize.QuadPart;
+#else
+		read.File = ::open(std::filesystem::path(path).string().c_str(), O_RDONLY | O_CLOEXEC);
+		if (read.File < 0)
+		{
+			read.File = NoFile;
+			return false;
+		}
+
+		struct stat info = {};
+		if (fstat(read.File, &info) != 0)
+			return false;
+		read.Size = (uint64_t)info.st_size;
+#endif
+
+		read.Buffer.reset(new char[read.Size > 0 ? (size_t)read.Size : 1]);
+		return true;
+	}
+
+	// Reads the rest of a file on this thread, at explicit offsets
+	// (so any number of threads can read at once)
+	bool ReadRemaining(LooseRead& read)
+	{
+		while (read.Done < read.Size)
+		{
+			uint64_t chunk = std::min(read.Size - read.Done, MaxReadSize);
+#ifdef _WIN32
+			OVERLAPPED offset = {};
+			offset.Offset = (DWORD)read.Done;
+			offset.OffsetHigh = (DWORD)(read.Done >> 32);
+			DWORD bytes = 0;
+			if (!ReadFile(read.File, read.Buffer.get() + read.Done, (DWORD)chunk, &bytes, &offset) || bytes == 0)
+				return false;
+#else
+			ssize_t bytes = pread(read.File, read.Buffer.get() + read.Done, (size_t)chunk, (off_t)read.Done);
+			if (bytes < 0 && errno == EINTR)
+				continue;
+			if (bytes <= 0)
+				return false;
+#endif
+			read.Done += (uint64_t)bytes;
+		}
+		return true;
+	}
+
+	// Asks the OS to start paging in packed files now, all at once,
+	// rather than one fault at a time as they're decoded
+	void Prefetch(const std::vector<ByteSpan>& spans)
+	{
+#ifdef _WIN32
+		std::vector<WIN32_MEMORY_RANGE_ENTRY> ranges;
+		for (const ByteSpan& span : spans)
+		{
+			if (span.Size > 0)
+				ranges.push_back({ (PVOID)span.Data, span.Size });
+		}
+		if (!ranges.empty())
+			PrefetchVirtualMemory(GetCurrentProcess(), ranges.size(), &ranges[0], 0);
+#else
+		uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+		for (const ByteSpan& span : spans)
+		{
+			if (span.Size == 0)
+				continue;
+			uintptr_t start = (uintptr_t)span.Data & ~(pageSize - 1);
+			madvise((void*)start, (uintptr_t)span.Data + span.Size - start, MADV_WILLNEED);
+		}
+#endif
+	}
+
+	// --------------------------------------------------------
+	// Loose reads on the thread pool, one job per file, with
+	// finished reads queued up for the calling thread
+	// --------------------------------------------------------
+	class PoolReads
+	{
+	public:
+		explicit PoolReads(std::vector<LooseRead>& reads) : reads(reads), started(0), finished(0), handedOut(0) {}
+
+		// Jobs use the reads, so they must all be done first
+		~PoolReads()
+		{
+			std::unique_lock<std::mutex> lock(finishedMutex);
+			readFinished.wait(lock, [this]() { return finished == started; });
+		}
+
+		void Start()
+		{
+			started = reads.size();
+			for (size_t i = 0; i < reads.size(); i++)
+			{
+				ThreadPool::Get().Submit([this, i]()
+				{
+					reads[i].Failed = !ReadRemaining(reads[i]);
+
+					std::lock_guard<std::mutex> lock(finishedMutex);
+					completed.push_back(i);
+					finished++;
+					readFinished.notify_all();
+				});
+			}
+		}
+
+		// The next read to finish, or false once all have
+		bool WaitNext(size_t& index)
+		{
+			if (handedOut == started)
+				return false;
+
+			std::unique_lock<std::mutex> lock(finishedMutex);
+			readFinished.wait(lock, [this]() { return !completed.empty(); });
+			index = completed.front();
+			completed.pop_front();
+			handedOut++;
+			return true;
+		}
+
+	private:
+		std::vector<LooseRead>& reads;
+		std::mutex finishedMutex;
+		std::condition_variable readFinished;
+		std::deque<size_t> completed;
+		size_t started;
+		size_t finished;
+		size_t handedOut;
+	};
+
+#ifdef __linux__
+	// --------------------------------------------------------
+	// Loose reads through io_uring, set up with raw system calls
+	//
+	// - Every read goes into the submission ring and the whole
+	//    batch is submitted with a single io_uring_enter
+	// - Reads that come back short (or past MaxReadSize) go
+	//    back in for the rest, at their new offset
+	// - At most one completion ring's worth is ever in flight,
+	//    so completions can't overflow
+	// --------------------------------------------------------
+	class UringReads
+	{
+	public:
+		explicit UringReads(std::vector<LooseRead>& reads) :
+			reads(reads), vectors(reads.size()), ring(-1),
+			sqRing(MAP_FAILED), cqRing(MAP_FAILED), sqeMemory(MAP_FAILED),
+			sqRingSize(0), cqRingSize(0), sqeMemorySize(0),
+			queued(0), inFlight(0), handedOut(0)
+		{
+		}
+
+		// Waits out anything the kernel may still write into
+		~UringReads()
+		{
+			while (inFlight > 0 || queued > 0)
+			{
+				if (!Enter(1))
+					break;
+				Reap();
+			}
+
+			if (sqeMemory != MAP_FAILED)
+				munmap(sqeMemory, sqeMemorySize);
+			if (cqRing != MAP_FAILED && cqRing != sqRing)
+				munmap(cqRing, cqRingSize);
+			if (sqRing != MAP_FAILED)
+				munmap(sqRing, sqRingSize);
+			if (ring >= 0)
+				::close(ring);
+		}
+
+		// Creates the ring and submits every read
+		// - False, with nothing submitted, when io_uring isn't
+		//    available (old kernels, or blocked by a sandbox)
+		bool Start()
+		{
+			unsigned int entries = 1;
+			while (entries < reads.size() && entries < 256)
+				entries *= 2;
+
+			io_uring_params params = {};
+			ring = (int)syscall(__NR_io_uring_setup, entries, &params);
+			if (ring < 0)
+				return false;
+
+			sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+			cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+			sqeMemorySize = params.sq_entries * sizeof(io_uring_sqe);
+
+			// Newer kernels map both rings at once
+			bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+			if (singleMap)
+				sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+			sqRing = mmap(0, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+			if (sqRing == MAP_FAILED)
+				return false;
+			cqRing = singleMap ? sqRing : mmap(0, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+			if (cqRing == MAP_FAILED)
+				return false;
+			sqeMemory = mmap(0, sqeMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+			if (sqeMemory == MAP_FAILED)
+				return false;
+
+			char* sq = (char*)sqRing;
+			sqHead = (unsigned int*)(sq + params.sq_off.head);
+			sqTail = (unsigned int*)(sq + params.sq_off.tail);
+			sqMask = *(unsigned int*)(sq + params.sq_off.ring_mask);
+			sqEntries = params.sq_entries;
+			sqArray = (unsigned int*)(sq + params.sq_off.array);
+			sqes = (io_uring_sqe*)sqeMemory;
+
+			char* cq = (char*)cqRing;
+			cqHead = (unsigned int*)(cq + params.cq_off.head);
+			cqTail = (unsigned int*)(cq + params.cq_off.tail);
+			cqMask = *(unsigned int*)(cq + params.cq_off.ring_mask);
+			cqEntries = params.cq_entries;
+			cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+			for (size_t i = 0; i < reads.size(); i++)
+			{
+				if (reads[i].Size == 0)
+					ready.push_back(i);
+				else
+					unsubmitted.push_back(i);
+			}
+
+			Fill();
+			if (!Enter(0))
+			{
+				// Nothing reached the kernel, so the pool can take over
+				queued = 0;
+				return false;
+			}
+			return true;
+		}
+
+		// The next read to finish, or false once all have
+		bool WaitNext(size_t& index)
+		{
+			while (ready.empty())
+			{
+				if (handedOut == reads.size())
+					return false;
+
+				Fill();
+				if (!Enter(1))
+				{
+					// The ring broke mid-batch: give up on whatever
+					// the kernel doesn't already have
+					for (size_t i : unsubmitted)
+					{
+						reads[i].Failed = true;
+						ready.push_back(i);
+					}
+					unsubmitted.clear();
+					continue;
+				}
+				Reap();
+			}
+
+			index = ready.front();
+			ready.pop_front();
+			handedOut++;
+			return true;
+		}
+
+	private:
+		std::vector<LooseRead>& reads;
+		std::vector<iovec> vectors;
+		int ring;
+
+		void* sqRing;
+		void* cqRing;
+		void* sqeMemory;
+		size_t sqRingSize;
+		size_t cqRingSize;
+		size_t sqeMemorySize;
+
+		unsigned int* sqHead = nullptr;
+		unsigned int* sqTail = nullptr;
+		unsigned int* sqArray = nullptr;
+		unsigned int sqMask = 0;
+		unsigned int sqEntries = 0;
+		io_uring_sqe* sqes = nullptr;
+
+		unsigned int* cqHead = nullptr;
+		unsigned int* cqTail = nullptr;
+		unsigned int cqMask = 0;
+		unsigned int cqEntries = 0;
+		io_uring_cqe* cqes = nullptr;
+
+		std::deque<size_t> unsubmitted;	// Not in the ring yet
+		std::deque<size_t> ready;		// Finished, not handed out yet
+		unsigned int queued;			// In the ring, not submitted yet
+		unsigned int inFlight;			// Submitted, not completed yet
+		size_t handedOut;
+
+		// Moves waiting reads into free submission slots
+		void Fill()
+		{
+			unsigned int tail = *sqTail;
+			unsigned int head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+			while (!unsubmitted.empty() && tail - head < sqEntries && inFlight + queued < cqEntries)
+			{
+				size_t i = unsubmitted.front();
+				unsubmitted.pop_front();
+
+				LooseRead& read = reads[i];
+				vectors[i].iov_base = read.Buffer.get() + read.Done;
+				vectors[i].iov_len = (size_t)std::min(read.Size - read.Done, MaxReadSize);
+
+				unsigned int slot = tail & sqMask;
+				io_uring_sqe& sqe = sqes[slot];
+				memset(&sqe, 0, sizeof(sqe));
+				sqe.opcode = IORING_OP_READV;
+				sqe.fd = read.File;
+				sqe.off = read.Done;
+				sqe.addr = (uint64_t)(uintptr_t)&vectors[i];
+				sqe.len = 1;
+				sqe.user_data = i;
+				sqArray[slot] = slot;
+
+				tail++;
+				queued++;
+			}
+			__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+		}
+
+		// Submits everything queued, waiting for some completions
+		bool Enter(unsigned int waitFor)
+		{
+			while (true)
+			{
+				int submitted = (int)syscall(__NR_io_uring_enter, ring, queued, waitFor, waitFor > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+				if (submitted >= 0)
+				{
+					queued -= (unsigned int)submitted;
+					inFlight += (unsigned int)submitted;
+					return true;
+				}
+				if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+					return false;
+			}
+		}
+
+		void Reap()
+		{
+			unsigned int head = *cqHead;
+			unsigned int tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+			for (; head != tail; head++)
+			{
+				const io_uring_cqe& cqe = cqes[head & cqMask];
+				size_t i = (size_t)cqe.user_data;
+				LooseRead& read = reads[i];
+				inFlight--;
+
+				if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+					unsubmitted.push_back(i);
+				else if (cqe.res <= 0)
+				{
+					read.Failed = true;
+					ready.push_back(i);
+				}
+				else
+				{
+					read.Done += (uint64_t)cqe.res;
+					if (read.Done < read.Size)
+						unsubmitted.push_back(i);
+					else
+						ready.push_back(i);
+				}
+			}
+			__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+		}
+	};
+#endif
+}
+
+AsyncFileReader::AsyncFileReader() : usedUring(false)
+{
+}
+
+void AsyncFileReader::Queue(const std::wstring& path, Callback onRead)
+{
+	requests.push_back({ path, std::move(onRead), nullptr });
+}
+
+void AsyncFileReader::QueueOwned(const std::wstring& path, OwningCallback onRead)
+{
+	requests.push_back({ path, nullptr, std::move(onRead) });
+}
+
+// --------------------------------------------------------
+// Starts every read, then runs callbacks as reads finish
+// - Loose reads are started before anything else, so they're
+//    in flight while packed files are handed out
+// - Each loose buffer is freed right after its callback, or
+//    handed to it (see QueueOwned())
+// --------------------------------------------------------
+bool AsyncFileReader::Run()
+{
+	// Callbacks may queue more files, for the next Run()
+	std::vector<Request> batch;
+	batch.swap(requests);
+
+	bool allRead = true;
+	std::vector<size_t> packed;
+	std::vector<ByteSpan> packedData;
+	std::vector<LooseRead> loose;
+	loose.reserve(batch.size());
+	for (size_t i = 0; i < batch.size(); i++)
+	{
+		ByteSpan data;
+		if (Vfs::ReadPacked(batch[i].Path, data))
+		{
+			packed.push_back(i);
+			packedData.push_back(data);
+			continue;
+		}
+
+		loose.emplace_back();
+		loose.back().Request = i;
+		if (!OpenForRead(batch[i].Path, loose.back()))
+		{
+			loose.pop_back();
+			allRead = false;
+		}
+	}
+
+	// Loose files go to io_uring when possible, the pool otherwise
+	usedUring = false;
+#ifdef __linux__
+	UringReads uring(loose);
+	usedUring = !loose.empty() && uring.Start();
+#endif
+	PoolReads pool(loose);
+	if (!usedUring)
+		pool.Start();
+
+	Prefetch(packedData);
+	for (size_t p = 0; p < packed.size(); p++)
+	{
+		Request& request = batch[packed[p]];
+		if (request.OnReadOwned)
+			request.OnReadOwned(packedData[p], nullptr);
+		else
+			request.OnRead(packedData[p]);
+	}
+
+	size_t index = 0;
+	while (true)
+	{
+#ifdef __linux__
+		if (usedUring ? !uring.WaitNext(index) : !pool.WaitNext(index))
+			break;
+#else
+		if (!pool.WaitNext(index))
+			break;
+#endif
+
+		LooseRead& read = loose[index];
+		CloseFile(read.File);
+		read.File = NoFile;
+		if (read.Failed)
+		{
+			allRead = false;
+			continue;
+		}
+
+		ByteSpan data;
+		data.Data = read.Buffer.get();
+		data.Size = (size_t)read.Size;
+		Request& request = batch[read.Request];
+		if (request.OnReadOwned)
+			request.OnReadOwned(data, std::move(read.Buffer));
+		else
+			request.OnRead(data);
+		read.Buffer.reset();
+	}
+
+	return allRead;
+}
+
+const char* AsyncFileReader::GetBackendName() const
+{
+	return usedUring ? "io_uring" : "thread pool";
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "PackArchive.h"
+
+// --------------------------------------------------------
+// Reads a batch of files at once, handing each one to its
+// callback as soon as it has arrived
+//
+// - Queue() every file, then Run(): all reads are started
+//    together and callbacks run on the calling thread (so
+//    they can use the immediate context) in completion order,
+//    decoding one file while the rest are still being read
+// - Packed files (see Vfs) need no reads: their pages are
+//    prefetched for the whole batch and they complete first
+// - Loose files are read with one io_uring submission on
+//    Linux, and with positional reads (pread / ReadFile at an
+//    offset) on the thread pool elsewhere, or when io_uring
+//    isn't available
+// - Spans passed to callbacks are only valid during the call,
+//    unless the file was queued with QueueOwned(), which hands
+//    its buffer over instead of freeing it
+// - Run() waits on pool jobs, so it must not be called from
+//    inside one
+// --------------------------------------------------------
+class AsyncFileReader
+{
+public:
+	using Callback = std::function<void(const ByteSpan& data)>;
+
+	// Also gets the buffer a loose file was read into (data
+	// points into it); empty for packed files, whose data stays
+	// mapped with the pack
+	using OwningCallback = std::function<void(const ByteSpan& data, std::unique_ptr<char[]> buffer)>;
+
+	AsyncFileReader();
+
+	AsyncFileReader(const AsyncFileReader&) = delete;
+	AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+	void Queue(const std::wstring& path, Callback onRead);
+	void QueueOwned(const std::wstring& path, OwningCallback onRead);
+
+	// Reads everything queued and waits for the last callback
+	// - Files that can't be read are skipped (no callback), and
+	//    make this return false
+	bool Run();
+
+	// "io_uring" or "thread pool", for the loose files of the
+	// last Run()
+	const char* GetBackendName() const;
+
+private:
+	struct Request
+	{
+		std::wstring Path;
+		Callback OnRead;
+		OwningCallback OnReadOwned;
+	};
+
+	std::vector<Request> requests;
+	bool usedUring;
+};
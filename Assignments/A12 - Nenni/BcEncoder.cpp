@@ -0,0 +1,709 @@
+#include "BcEncoder.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BC_ENCODER_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	// Refinement passes per block (each fits endpoints to the
+	// indices the last one picked)
+	const int RefineIterations = 3;
+
+	// BC7 interpolation weights (out of 64) for 4-bit indices
+	const int Bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// --------------------------------------------------------
+	// Four floats processed together: SSE when available,
+	// plain loops otherwise (same results either way)
+	// --------------------------------------------------------
+#ifdef BC_ENCODER_SSE
+	struct Float4
+	{
+		__m128 v;
+	};
+
+	inline Float4 Load(const float* lanes) { return { _mm_loadu_ps(lanes) }; }
+	inline Float4 Splat(float a) { return { _mm_set1_ps(a) }; }
+	inline void Store(float* lanes, Float4 a) { _mm_storeu_ps(lanes, a.v); }
+	inline Float4 operator+(Float4 a, Float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+	inline Float4 operator-(Float4 a, Float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+	inline Float4 operator*(Float4 a, Float4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+
+	// x where a < b, y elsewhere
+	inline Float4 SelectLess(Float4 a, Float4 b, Float4 x, Float4 y)
+	{
+		__m128 mask = _mm_cmplt_ps(a.v, b.v);
+		return { _mm_or_ps(_mm_and_ps(mask, x.v), _mm_andnot_ps(mask, y.v)) };
+	}
+#else
+	struct Float4
+	{
+		float v[4];
+	};
+
+	template<typename Op>
+	inline Float4 Map(Float4 a, Float4 b, Op op)
+	{
+		Float4 r;
+		for (int i = 0; i < 4; i++)
+			r.v[i] = op(a.v[i], b.v[i]);
+		return r;
+	}
+
+	inline Float4 Load(const float* lanes) { return { { lanes[0], lanes[1], lanes[2], lanes[3] } }; }
+	inline Float4 Splat(float a) { return { { a, a, a, a } }; }
+	inline void Store(float* lanes, Float4 a) { for (int i = 0; i < 4; i++) lanes[i] = a.v[i]; }
+	inline Float4 operator+(Float4 a, Float4 b) { return Map(a, b, [](float x, float y) { return x + y; }); }
+	inline Float4 operator-(Float4 a, Float4 b) { return Map(a, b, [](float x, float y) { return x - y; }); }
+	inline Float4 operator*(Float4 a, Float4 b) { return Map(a, b, [](float x, float y) { return x * y; }); }
+
+	inline Float4 SelectLess(Float4 a, Float4 b, Float4 x, Float4 y)
+	{
+		Float4 r;
+		for (int i = 0; i < 4; i++)
+			r.v[i] = a.v[i] < b.v[i] ? x.v[i] : y.v[i];
+		return r;
+	}
+#endif
+
+	// A block's 16 pixels (row by row) as 0-255 floats, one array
+	// per channel, so 4 pixels of a channel load together
+	struct Block
+	{
+		float Channels[4][16];
+	};
+
+	// Palette entries as 0-255 floats, in the block's channel order
+	struct Palette
+	{
+		float Colors[16][4];
+		unsigned int Size = 0;
+	};
+
+	void LoadBlock(const Image& source, unsigned int blockX, unsigned int blockY, Block& block)
+	{
+		for (unsigned int y = 0; y < 4; y++)
+		{
+			size_t sourceY = std::min(blockY * 4 + y, source.Height - 1);
+			for (unsigned int x = 0; x < 4; x++)
+			{
+				size_t sourceX = std::min(blockX * 4 + x, source.Width - 1);
+				size_t pixel = sourceY * source.Width + sourceX;
+				unsigned int i = y * 4 + x;
+
+				if (source.Format == ImageFormat::R8)
+				{
+					float gray = source.Pixels[pixel];
+					block.Channels[0][i] = block.Channels[1][i] = block.Channels[2][i] = gray;
+					block.Channels[3][i] = 255.0f;
+				}
+				else
+				{
+					for (unsigned int c = 0; c < 4; c++)
+						block.Channels[c][i] = source.Pixels[pixel * 4 + c];
+				}
+			}
+		}
+	}
+
+	// --------------------------------------------------------
+	// Picks the nearest palette entry for every pixel, over
+	// channelCount channels starting at firstChannel, and
+	// returns the summed squared error
+	// - Ties go to the lower index, like a scalar search would
+	// --------------------------------------------------------
+	float FindIndices(const Block& block, const Palette& palette, unsigned int firstChannel, unsigned int channelCount, uint8_t indices[16])
+	{
+		float total = 0.0f;
+		for (unsigned int group = 0; group < 16; group += 4)
+		{
+			Float4 pixel[4];
+			for (unsigned int c = 0; c < channelCount; c++)
+				pixel[c] = Load(&block.Channels[firstChannel + c][group]);
+
+			Float4 bestError = Splat(FLT_MAX);
+			Float4 bestIndex = Splat(0.0f);
+			for (unsigned int p = 0; p < palette.Size; p++)
+			{
+				Float4 error = Splat(0.0f);
+				for (unsigned int c = 0; c < channelCount; c++)
+				{
+					Float4 difference = pixel[c] - Splat(palette.Colors[p][c]);
+					error = error + difference * difference;
+				}
+				bestIndex = SelectLess(error, bestError, Splat((float)p), bestIndex);
+				bestError = SelectLess(error, bestError, error, bestError);
+			}
+
+			float errors[4];
+			float lanes[4];
+			Store(errors, bestError);
+			Store(lanes, bestIndex);
+			for (unsigned int i = 0; i < 4; i++)
+			{
+				indices[group + i] = (uint8_t)lanes[i];
+				total += errors[i];
+			}
+		}
+		return total;
+	}
+
+	// --------------------------------------------------------
+	// Starting endpoints for several channels: the block's
+	// extremes along its principal axis (the covariance
+	// matrix's main eigenvector, by power iteration)
+	// --------------------------------------------------------
+	void PrincipalEndpoints(const Block& block, unsigned int channelCount, float end0[4], float end1[4])
+	{
+		float mean[4] = {};
+		float low[4] = { 255, 255, 255, 255 };
+		float high[4] = {};
+		for (unsigned int c = 0; c < channelCount; c++)
+		{
+			for (unsigned int i = 0; i < 16; i++)
+			{
+				mean[c] += block.Channels[c][i];
+				low[c] = std::min(low[c], block.Channels[c][i]);
+				high[c] = std::max(high[c], block.Channels[c][i]);
+			}
+			mean[c] /= 16.0f;
+		}
+
+		float covariance[4][4] = {};
+		for (unsigned int i = 0; i < 16; i++)
+		{
+			for (unsigned int a = 0; a < channelCount; a++)
+			{
+				for (unsigned int b = 0; b < channelCount; b++)
+					covariance[a][b] += (block.Channels[a][i] - mean[a]) * (block.Channels[b][i] - mean[b]);
+			}
+		}
+
+		// The bounding box diagonal is usually close already
+		float axis[4] = {};
+		for (unsigned int c = 0; c < channelCount; c++)
+			axis[c] = high[c] - low[c];
+
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			float length = 0.0f;
+			for (unsigned int a = 0; a < channelCount; a++)
+			{
+				for (unsigned int b = 0; b < channelCount; b++)
+					next[a] += covariance[a][b] * axis[b];
+				length += next[a] * next[a];
+			}
+
+			// A flat block has no axis; any will do
+			if (length < 1e-12f)
+				break;
+
+			length = sqrtf(length);
+			for (unsigned int c = 0; c < channelCount; c++)
+				axis[c] = next[c] / length;
+		}
+
+		float axisLength = 0.0f;
+		for (unsigned int c = 0; c < channelCount; c++)
+			axisLength += axis[c] * axis[c];
+		if (axisLength < 1e-12f)
+		{
+			for (unsigned int c = 0; c < channelCount; c++)
+				end0[c] = end1[c] = mean[c];
+			return;
+		}
+
+		float lowest = FLT_MAX;
+		float highest = -FLT_MAX;
+		for (unsigned int i = 0; i < 16; i++)
+		{
+			float t = 0.0f;
+			for (unsigned int c = 0; c < channelCount; c++)
+				t += (block.Channels[c][i] - mean[c]) * axis[c];
+			lowest = std::min(lowest, t);
+			highest = std::max(highest, t);
+		}
+
+		for (unsigned int c = 0; c < channelCount; c++)
+		{
+			end0[c] = std::clamp(mean[c] + axis[c] * lowest / axisLength, 0.0f, 255.0f);
+			end1[c] = std::clamp(mean[c] + axis[c] * highest / axisLength, 0.0f, 255.0f);
+		}
+	}
+
+	// --------------------------------------------------------
+	// Least squares endpoints for the indices picked, where
+	// weights[index] is how far toward end1 each index is
+	// - False when every pixel uses the same weight, which
+	//    leaves the endpoints undetermined
+	// --------------------------------------------------------
+	bool FitEndpoints(const Block& block, const uint8_t indices[16], const float* weights, unsigned int firstChannel, unsigned int channelCount, float end0[4], float end1[4])
+	{
+		float aa = 0.0f;
+		float ab = 0.0f;
+		float bb = 0.0f;
+		float ax[4] = {};
+		float bx[4] = {};
+		for (unsigned int i = 0; i < 16; i++)
+		{
+			float b = weights[indices[i]];
+			float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (unsigned int c = 0; c < channelCount; c++)
+			{
+				ax[c] += a * block.Channels[firstChannel + c][i];
+				bx[c] += b * block.Channels[firstChannel + c][i];
+			}
+		}
+
+		float determinant = aa * bb - ab * ab;
+		if (fabsf(determinant) < 1e-6f)
+			return false;
+
+		for (unsigned int c = 0; c < channelCount; c++)
+		{
+			end0[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+			end1[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	// Least significant bit first, like every BC format
+	struct BitWriter
+	{
+		uint8_t* Target;
+		unsigned int Position = 0;
+
+		void Write(uint32_t value, unsigned int bits)
+		{
+			for (unsigned int i = 0; i < bits; i++, Position++)
+				Target[Position / 8] |= (uint8_t)(((value >> i) & 1) << (Position % 8));
+		}
+	};
+
+	struct BitReader
+	{
+		const uint8_t* Source;
+		unsigned int Position = 0;
+
+		uint32_t Read(unsigned int bits)
+		{
+			uint32_t value = 0;
+			for (unsigned int i = 0; i < bits; i++, Position++)
+				value |= (uint32_t)((Source[Position / 8] >> (Position % 8)) & 1) << i;
+			return value;
+		}
+	};
+
+	// --------------------------------------------------------
+	// BC1: two RGB 5:6:5 endpoints and 2-bit indices
+	// --------------------------------------------------------
+	uint16_t To565(const float color[4])
+	{
+		unsigned int r = (unsigned int)(color[0] * 31.0f / 255.0f + 0.5f);
+		unsigned int g = (unsigned int)(color[1] * 63.0f / 255.0f + 0.5f);
+		unsigned int b = (unsigned int)(color[2] * 31.0f / 255.0f + 0.5f);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	void Expand565(uint16_t color, int rgb[3])
+	{
+		int r = (color >> 11) & 31;
+		int g = (color >> 5) & 63;
+		int b = color & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	// 4 colors when color0 > color1, else 3 and transparent black
+	void Bc1Palette(uint16_t color0, uint16_t color1, Palette& palette)
+	{
+		int a[3], b[3];
+		Expand565(color0, a);
+		Expand565(color1, b);
+		bool fourColors = color0 > color1;
+		palette.Size = fourColors ? 4 : 3;
+
+		for (int c = 0; c < 3; c++)
+		{
+			palette.Colors[0][c] = (float)a[c];
+			palette.Colors[1][c] = (float)b[c];
+			palette.Colors[2][c] = (float)(fourColors ? (2 * a[c] + b[c] + 1) / 3 : (a[c] + b[c] + 1) / 2);
+			palette.Colors[3][c] = (float)(fourColors ? (a[c] + 2 * b[c] + 1) / 3 : 0);
+		}
+		palette.Colors[0][3] = palette.Colors[1][3] = palette.Colors[2][3] = 255.0f;
+		palette.Colors[3][3] = fourColors ? 255.0f : 0.0f;
+	}
+
+	void EncodeBc1(const Block& block, uint8_t* out)
+	{
+		const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+		float end0[4], end1[4];
+		PrincipalEndpoints(block, 3, end0, end1);
+
+		float bestError = FLT_MAX;
+		for (int iteration = 0; iteration < RefineIterations; iteration++)
+		{
+			// The larger endpoint goes first, for the 4 color mode
+			uint16_t color0 = To565(end0);
+			uint16_t color1 = To565(end1);
+			if (color0 < color1)
+				std::swap(color0, color1);
+
+			Palette palette;
+			Bc1Palette(color0, color1, palette);
+			uint8_t indices[16];
+			float error = FindIndices(block, palette, 0, 3, indices);
+			if (error < bestError)
+			{
+				bestError = error;
+				uint32_t bits = 0;
+				for (int i = 0; i < 16; i++)
+					bits |= (uint32_t)indices[i] << (i * 2);
+				memcpy(out, &color0, 2);
+				memcpy(out + 2, &color1, 2);
+				memcpy(out + 4, &bits, 4);
+			}
+
+			// One color already says it all
+			if (color0 == color1 || !FitEndpoints(block, indices, weights, 0, 3, end0, end1))
+				break;
+		}
+	}
+
+	void DecodeBc1(const uint8_t* block, uint8_t pixels[16][4])
+	{
+		uint16_t color0, color1;
+		uint32_t bits;
+		memcpy(&color0, block, 2);
+		memcpy(&color1, block + 2, 2);
+		memcpy(&bits, block + 4, 4);
+
+		Palette palette;
+		Bc1Palette(color0, color1, palette);
+		for (int i = 0; i < 16; i++)
+		{
+			unsigned int index = (bits >> (i * 2)) & 3;
+			for (int c = 0; c < 4; c++)
+				pixels[i][c] = (uint8_t)palette.Colors[index][c];
+		}
+	}
+
+	// --------------------------------------------------------
+	// BC4: two 8-bit endpoints and 3-bit indices, for one
+	// channel
+	// --------------------------------------------------------
+
+	// 8 values when end0 > end1, else 6 and then 0 and 255
+	void Bc4Palette(int end0, int end1, Palette& palette)
+	{
+		palette.Size = 8;
+		palette.Colors[0][0] = (float)end0;
+		palette.Colors[1][0] = (float)end1;
+		for (int i = 2; i < 8; i++)
+		{
+			int value;
+			if (end0 > end1)
+				value = ((8 - i) * end0 + (i - 1) * end1 + 3) / 7;
+			else if (i < 6)
+				value = ((6 - i) * end0 + (i - 1) * end1 + 2) / 5;
+			else
+				value = i == 6 ? 0 : 255;
+			palette.Colors[i][0] = (float)value;
+		}
+	}
+
+	void EncodeBc4(const Block& block, unsigned int channel, uint8_t* out)
+	{
+		const float weights[8] = { 0.0f, 1.0f, 1.0f / 7, 2.0f / 7, 3.0f / 7, 4.0f / 7, 5.0f / 7, 6.0f / 7 };
+
+		float end0[4] = { 0 };
+		float end1[4] = { 255 };
+		for (int i = 0; i < 16; i++)
+		{
+			end0[0] = std::max(end0[0], block.Channels[channel][i]);
+			end1[0] = std::min(end1[0], block.Channels[channel][i]);
+		}
+
+		float bestError = FLT_MAX;
+		for (int iteration = 0; iteration < RefineIterations; iteration++)
+		{
+			// The larger endpoint goes first, for 8 values
+			int first = (int)(end0[0] + 0.5f);
+			int second = (int)(end1[0] + 0.5f);
+			if (first < second)
+				std::swap(first, second);
+
+			Palette palette;
+			Bc4Palette(first, second, palette);
+			uint8_t indices[16];
+			float error = FindIndices(block, palette, channel, 1, indices);
+			if (error < bestError)
+			{
+				bestError = error;
+				uint64_t bits = 0;
+				for (int i = 0; i < 16; i++)
+					bits |= (uint64_t)indices[i] << (i * 3);
+				out[0] = (uint8_t)first;
+				out[1] = (uint8_t)second;
+				for (int i = 0; i < 6; i++)
+					out[2 + i] = (uint8_t)(bits >> (i * 8));
+			}
+
+			if (first == second || !FitEndpoints(block, indices, weights, channel, 1, end0, end1))
+				break;
+		}
+	}
+
+	void DecodeBc4(const uint8_t* block, uint8_t values[16])
+	{
+		Palette palette;
+		Bc4Palette(block[0], block[1], palette);
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; i++)
+			bits |= (uint64_t)block[2 + i] << (i * 8);
+		for (int i = 0; i < 16; i++)
+			values[i] = (uint8_t)palette.Colors[(bits >> (i * 3)) & 7][0];
+	}
+
+	// --------------------------------------------------------
+	// BC7 mode 6: RGBA endpoints of 7 bits plus a shared low
+	// bit (p-bit) each, and 4-bit indices
+	// --------------------------------------------------------
+	void Bc7Palette(const int end0[4], const int end1[4], Palette& palette)
+	{
+		palette.Size = 16;
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 4; c++)
+				palette.Colors[i][c] = (float)((end0[c] * (64 - Bc7Weights[i]) + end1[c] * Bc7Weights[i] + 32) >> 6);
+		}
+	}
+
+	// 7 bits of an endpoint channel, given its p-bit
+	int QuantizeBc7(float value, int pBit)
+	{
+		return std::clamp((int)((value - pBit) / 2.0f + 0.5f), 0, 127);
+	}
+
+	void EncodeBc7(const Block& block, uint8_t* out)
+	{
+		float weights[16];
+		for (int i = 0; i < 16; i++)
+			weights[i] = Bc7Weights[i] / 64.0f;
+
+		float end0[4], end1[4];
+		PrincipalEndpoints(block, 4, end0, end1);
+
+		float bestError = FLT_MAX;
+		int bestEnds[2][4] = {};
+		int bestPBits[2] = {};
+		uint8_t bestIndices[16] = {};
+		for (int iteration = 0; iteration < RefineIterations; iteration++)
+		{
+			// Every p-bit pair, since they shift all 4 channels
+			float iterationError = FLT_MAX;
+			uint8_t iterationIndices[16] = {};
+			for (int pBits = 0; pBits < 4; pBits++)
+			{
+				int pBit0 = pBits & 1;
+				int pBit1 = pBits >> 1;
+				int ends[2][4];
+				int expanded[2][4];
+				for (int c = 0; c < 4; c++)
+				{
+					ends[0][c] = QuantizeBc7(end0[c], pBit0);
+					ends[1][c] = QuantizeBc7(end1[c], pBit1);
+					expanded[0][c] = ends[0][c] * 2 + pBit0;
+					expanded[1][c] = ends[1][c] * 2 + pBit1;
+				}
+
+				Palette palette;
+				Bc7Palette(expanded[0], expanded[1], palette);
+				uint8_t indices[16];
+				float error = FindIndices(block, palette, 0, 4, indices);
+				if (error < iterationError)
+				{
+					iterationError = error;
+					memcpy(iterationIndices, indices, 16);
+				}
+				if (error < bestError)
+				{
+					bestError = error;
+					memcpy(bestEnds, ends, sizeof(ends));
+					bestPBits[0] = pBit0;
+					bestPBits[1] = pBit1;
+					memcpy(bestIndices, indices, 16);
+				}
+			}
+
+			if (bestError == 0.0f || !FitEndpoints(block, iterationIndices, weights, 0, 4, end0, end1))
+				break;
+		}
+
+		// The first index has an implied high bit of 0, so swap
+		// the endpoints (and flip every index) when it's set
+		if (bestIndices[0] >= 8)
+		{
+			std::swap(bestEnds[0], bestEnds[1]);
+			std::swap(bestPBits[0], bestPBits[1]);
+			for (int i = 0; i < 16; i++)
+				bestIndices[i] = (uint8_t)(15 - bestIndices[i]);
+		}
+
+		memset(out, 0, 16);
+		BitWriter writer = { out };
+		writer.Write(1 << 6, 7);
+		for (int c = 0; c < 4; c++)
+		{
+			writer.Write(bestEnds[0][c], 7);
+			writer.Write(bestEnds[1][c], 7);
+		}
+		writer.Write(bestPBits[0], 1);
+		writer.Write(bestPBits[1], 1);
+		for (int i = 0; i < 16; i++)
+			writer.Write(bestIndices[i], i == 0 ? 3 : 4);
+	}
+
+	void DecodeBc7(const uint8_t* block, uint8_t pixels[16][4])
+	{
+		BitReader reader = { block };
+		if (reader.Read(7) != 1 << 6)
+		{
+			memset(pixels, 0, 16 * 4);
+			return;
+		}
+
+		int ends[2][4];
+		for (int c = 0; c < 4; c++)
+		{
+			ends[0][c] = reader.Read(7);
+			ends[1][c] = reader.Read(7);
+		}
+		int pBit0 = reader.Read(1);
+		int pBit1 = reader.Read(1);
+		for (int c = 0; c < 4; c++)
+		{
+			ends[0][c] = ends[0][c] * 2 + pBit0;
+			ends[1][c] = ends[1][c] * 2 + pBit1;
+		}
+
+		Palette palette;
+		Bc7Palette(ends[0], ends[1], palette);
+		for (int i = 0; i < 16; i++)
+		{
+			unsigned int index = reader.Read(i == 0 ? 3 : 4);
+			for (int c = 0; c < 4; c++)
+				pixels[i][c] = (uint8_t)palette.Colors[index][c];
+		}
+	}
+}
+
+bool BcEncoder::Encode(const Image& source, ImageFormat format, Image& out)
+{
+	if (source.IsBlockCompressed() || source.Width == 0 || source.Height == 0 || source.Pixels.size() < source.GetSize())
+		return false;
+
+	out.Width = source.Width;
+	out.Height = source.Height;
+	out.Format = format;
+	if (!out.IsBlockCompressed())
+		return false;
+	out.Pixels.assign(out.GetSize(), 0);
+
+	unsigned int blocksAcross = out.GetRowElements();
+	unsigned int blockSize = out.GetElementSize();
+	ThreadPool::Get().ParallelFor(out.GetRowCount(), [&](size_t blockY)
+	{
+		uint8_t* target = &out.Pixels[blockY * out.GetRowPitch()];
+		for (unsigned int blockX = 0; blockX < blocksAcross; blockX++, target += blockSize)
+		{
+			Block block;
+			LoadBlock(source, blockX, (unsigned int)blockY, block);
+
+			switch (format)
+			{
+			case ImageFormat::BC1: EncodeBc1(block, target); break;
+			case ImageFormat::BC4: EncodeBc4(block, 0, target); break;
+			case ImageFormat::BC5: EncodeBc4(block, 0, target); EncodeBc4(block, 1, target + 8); break;
+			case ImageFormat::BC7: EncodeBc7(block, target); break;
+			default: break;
+			}
+		}
+	});
+	return true;
+}
+
+bool BcEncoder::Decode(const Image& source, Image& out)
+{
+	if (!source.IsBlockCompressed() || source.Pixels.size() < source.GetSize())
+		return false;
+
+	out.Width = source.Width;
+	out.Height = source.Height;
+	out.Format = source.Format == ImageFormat::BC4 ? ImageFormat::R8 : ImageFormat::RGBA8;
+	out.Pixels.resize(out.GetSize());
+
+	unsigned int channels = out.GetElementSize();
+	unsigned int blocksAcross = source.GetRowElements();
+	unsigned int blockSize = source.GetElementSize();
+	ThreadPool::Get().ParallelFor(source.GetRowCount(), [&](size_t blockY)
+	{
+		const uint8_t* block = &source.Pixels[blockY * source.GetRowPitch()];
+		for (unsigned int blockX = 0; blockX < blocksAcross; blockX++, block += blockSize)
+		{
+			uint8_t pixels[16][4] = {};
+			uint8_t red[16], green[16];
+			switch (source.Format)
+			{
+			case ImageFormat::BC1:
+				DecodeBc1(block, pixels);
+				break;
+			case ImageFormat::BC4:
+				DecodeBc4(block, red);
+				for (int i = 0; i < 16; i++)
+					pixels[i][0] = red[i];
+				break;
+			case ImageFormat::BC5:
+				DecodeBc4(block, red);
+				DecodeBc4(block + 8, green);
+				for (int i = 0; i < 16; i++)
+				{
+					pixels[i][0] = red[i];
+					pixels[i][1] = green[i];
+					pixels[i][3] = 255;
+				}
+				break;
+			default:
+				DecodeBc7(block, pixels);
+				break;
+			}
+
+			// Only the part of the block inside the image
+			for (unsigned int y = 0; y < 4 && blockY * 4 + y < out.Height; y++)
+			{
+				for (unsigned int x = 0; x < 4 && blockX * 4 + x < out.Width; x++)
+				{
+					uint8_t* pixel = &out.Pixels[((blockY * 4 + y) * out.Width + blockX * 4 + x) * channels];
+					memcpy(pixel, pixels[y * 4 + x], channels);
+				}
+			}
+		}
+	});
+	return true;
+}
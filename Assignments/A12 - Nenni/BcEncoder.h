@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Image.h"
+
+// --------------------------------------------------------
+// Block compression (BC1, BC4, BC5 and BC7) of decoded
+// images, so textures go to the GPU as they are stored
+//
+// - Every 4x4 block is encoded on its own: endpoints start at
+//    the extremes along the block's principal axis (or of its
+//    one channel), then are refined by least squares against
+//    the indices they pick, keeping whichever encodes best
+// - The index search, the inner loop, runs 4 pixels at a
+//    time with SSE; rows of blocks are spread over the pool
+// - BC1 is always opaque (its 4 color mode); BC4 encodes R
+//    and BC5 R and G
+// - BC7 only uses mode 6 (a single subset of RGBA endpoints
+//    with 16 levels between them), so blocks with several
+//    unrelated colors lose more than with a full BC7 encoder
+// - Partial blocks at the edges repeat the last row and column
+// --------------------------------------------------------
+namespace BcEncoder
+{
+	// source is R8 or RGBA8 (gray counts as RGB) and format a
+	// block compressed one; false otherwise
+	bool Encode(const Image& source, ImageFormat format, Image& out);
+
+	// Back to pixels, as the GPU would sample them: RGBA8 for
+	// BC1, BC5 (blue 0, alpha 255) and BC7, R8 for BC4
+	// - Only BC7 mode 6 blocks (what Encode() writes) decode;
+	//    blocks of other modes come back transparent black
+	bool Decode(const Image& source, Image& out);
+}
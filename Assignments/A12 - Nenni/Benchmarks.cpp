@@ -0,0 +1,1181 @@
+#include "Benchmarks.h"
+#include "Brdf.h"
+#include "GltfLoader.h"
+#include "IblPrefilter.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MeshCodec.h"
+#include "ObjParser.h"
+#include "PathHelpers.h"
+#include "PngDecoder.h"
+#include "SceneFile.h"
+#include "TangentGenerator.h"
+#include "TextureCooker.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const int TimedRuns = 5;
+
+	// Fastest of several runs, in milliseconds
+	double BestTime(const std::function<void()>& run)
+	{
+		double best = 1e30;
+		for (int i = 0; i < TimedRuns; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			run();
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			best = std::min(best, elapsed.count());
+		}
+		return best;
+	}
+
+	// --------------------------------------------------------
+	// A gently rippled, UV mapped grid of side x side quads
+	// - Normals come from the height function, so tangents
+	//    have real work to do in the orthonormalization
+	// --------------------------------------------------------
+	void MakeGrid(unsigned int side, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+	{
+		unsigned int row = side + 1;
+		vertices.resize((size_t)row * row);
+		for (unsigned int y = 0; y < row; y++)
+		{
+			for (unsigned int x = 0; x < row; x++)
+			{
+				float u = (float)x / side;
+				float v = (float)y / side;
+				float height = 0.05f * sinf(u * 40.0f) * cosf(v * 40.0f);
+				float dx = 2.0f * cosf(u * 40.0f) * cosf(v * 40.0f);
+				float dz = -2.0f * sinf(u * 40.0f) * sinf(v * 40.0f);
+				float length = sqrtf(dx * dx + 1 + dz * dz);
+
+				Vertex& vertex = vertices[(size_t)y * row + x];
+				vertex.Position = XMFLOAT3(u, height, v);
+				vertex.UV = XMFLOAT2(u, 1.0f - v);
+				vertex.Normal = XMFLOAT3(-dx / length, 1 / length, -dz / length);
+				vertex.Tangent = XMFLOAT3(0, 0, 0);
+			}
+		}
+
+		indices.clear();
+		indices.reserve((size_t)side * side * 6);
+		for (unsigned int y = 0; y < side; y++)
+		{
+			for (unsigned int x = 0; x < side; x++)
+			{
+				unsigned int i = y * row + x;
+				unsigned int quad[6] = { i, i + row, i + 1, i + 1, i + row, i + row + 1 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+	}
+
+	// Largest angle between two sets of tangents, in degrees
+	float MaxAngleDegrees(const std::vector<Vertex>& a, const std::vector<Vertex>& b)
+	{
+		float worst = 0;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			const XMFLOAT3& p = a[i].Tangent;
+			const XMFLOAT3& q = b[i].Tangent;
+			XMFLOAT3 cross(p.y * q.z - p.z * q.y, p.z * q.x - p.x * q.z, p.x * q.y - p.y * q.x);
+			float sine = sqrtf(cross.x * cross.x + cross.y * cross.y + cross.z * cross.z);
+			float cosine = p.x * q.x + p.y * q.y + p.z * q.z;
+			worst = std::max(worst, atan2f(sine, cosine) * (180.0f / XM_PI));
+		}
+		return worst;
+	}
+
+	// The grid as .OBJ text, with every corner as v/vt/vn
+	std::string WriteObj(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+	{
+		std::string text;
+		char line[128];
+		for (const Vertex& v : vertices)
+		{
+			snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+				v.Position.x, v.Position.y, v.Position.z, v.UV.x, v.UV.y, v.Normal.x, v.Normal.y, v.Normal.z);
+			text += line;
+		}
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			unsigned int a = indices[i] + 1, b = indices[i + 1] + 1, c = indices[i + 2] + 1;
+			snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+			text += line;
+		}
+		return text;
+	}
+
+	// --------------------------------------------------------
+	// The grid as a .GLB: one tightly packed float buffer view
+	// per attribute (tangents as VEC4) and 32-bit indices
+	// --------------------------------------------------------
+	std::vector<char> WriteGlb(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+	{
+		size_t count = vertices.size();
+		std::vector<float> positions, normals, uvs, tangents;
+		XMFLOAT3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX), boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (const Vertex& v : vertices)
+		{
+			positions.insert(positions.end(), { v.Position.x, v.Position.y, v.Position.z });
+			normals.insert(normals.end(), { v.Normal.x, v.Normal.y, v.Normal.z });
+			uvs.insert(uvs.end(), { v.UV.x, v.UV.y });
+			tangents.insert(tangents.end(), { v.Tangent.x, v.Tangent.y, v.Tangent.z, 1.0f });
+			boundsMin = XMFLOAT3(std::min(boundsMin.x, v.Position.x), std::min(boundsMin.y, v.Position.y), std::min(boundsMin.z, v.Position.z));
+			boundsMax = XMFLOAT3(std::max(boundsMax.x, v.Position.x), std::max(boundsMax.y, v.Position.y), std::max(boundsMax.z, v.Position.z));
+		}
+
+		std::vector<char> bin;
+		std::string views;
+		auto addView = [&](const void* data, size_t size)
+		{
+			char view[128];
+			snprintf(view, sizeof(view), "%s{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}", views.empty() ? "" : ",", bin.size(), size);
+			views += view;
+			bin.insert(bin.end(), (const char*)data, (const char*)data + size);
+		};
+		addView(&positions[0], positions.size() * sizeof(float));
+		addView(&normals[0], normals.size() * sizeof(float));
+		addView(&uvs[0], uvs.size() * sizeof(float));
+		addView(&tangents[0], tangents.size() * sizeof(float));
+		addView(&indices[0], indices.size() * sizeof(unsigned int));
+
+		char accessors[1024];
+		snprintf(accessors, sizeof(accessors),
+			"{\"bufferView\":0,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\",\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]},"
+			"{\"bufferView\":1,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\"},"
+			"{\"bufferView\":2,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC2\"},"
+			"{\"bufferView\":3,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC4\"},"
+			"{\"bufferView\":4,\"componentType\":5125,\"count\":%zu,\"type\":\"SCALAR\"}",
+			count, boundsMin.x, boundsMin.y, boundsMin.z, boundsMax.x, boundsMax.y, boundsMax.z,
+			count, count, count, indices.size());
+
+		std::string json =
+			"{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+			"\"meshes\":[{\"name\":\"grid\",\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2,\"TANGENT\":3},\"indices\":4}]}],"
+			"\"buffers\":[{\"byteLength\":" + std::to_string(bin.size()) + "}],"
+			"\"bufferViews\":[" + views + "],"
+			"\"accessors\":[" + accessors + "]}";
+
+		// Chunks are 4 byte aligned (every view above is a multiple of 4)
+		while (json.size() % 4 != 0)
+			json += ' ';
+
+		uint32_t header[5] = { 0x46546C67, 2, (uint32_t)(12 + 8 + json.size() + 8 + bin.size()), (uint32_t)json.size(), 0x4E4F534A };
+		uint32_t binHeader[2] = { (uint32_t)bin.size(), 0x004E4942 };
+
+		std::vector<char> glb(header[2]);
+		char* out = &glb[0];
+		memcpy(out, header, sizeof(header));
+		memcpy(out + sizeof(header), json.data(), json.size());
+		memcpy(out + sizeof(header) + json.size(), binHeader, sizeof(binHeader));
+		memcpy(out + sizeof(header) + json.size() + sizeof(binHeader), bin.data(), bin.size());
+		return glb;
+	}
+
+	// --------------------------------------------------------
+	// Shapes scattered over a square that grows with the count,
+	// from a seeded generator so every run times the same scene
+	// --------------------------------------------------------
+	SceneArrays MakeScene(unsigned int entityCount)
+	{
+		SceneArrays scene;
+		for (const char* name : { "cube.mesh", "cylinder.mesh", "helix.mesh", "sphere.mesh", "torus.mesh" })
+		{
+			SceneName mesh = {};
+			strcpy(mesh.Text, name);
+			scene.Meshes.push_back(mesh);
+		}
+		for (const char* name : { "cobblestone", "floor", "wood" })
+		{
+			SceneName material = {};
+			strcpy(material.Text, name);
+			scene.Materials.push_back(material);
+		}
+
+		float size = sqrtf((float)entityCount) * 4.0f;
+		unsigned int seed = 12345;
+		auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+		auto unit = [&next]() { return (next() & 0xFFFF) / 65535.0f; };
+		for (unsigned int i = 0; i < entityCount; i++)
+		{
+			float scale = 0.5f + unit() * 1.5f;
+			scene.MeshIndices.push_back(next() % 5);
+			scene.MaterialIndices.push_back(next() % 3);
+			scene.Positions.push_back(XMFLOAT3(unit() * size, unit() * 2.0f - 2.0f, unit() * size));
+			scene.Rotations.push_back(XMFLOAT3(0, unit() * XM_2PI, 0));
+			scene.Scales.push_back(XMFLOAT3(scale, scale, scale));
+			scene.Flags.push_back(i % 4 == 0 ? SceneFile::EntityStatic : 0);
+		}
+
+		Light sun = {};
+		sun.Type = LIGHT_TYPE_DIRECTIONAL;
+		sun.Direction = XMFLOAT3(0, -1, 1);
+		sun.Color = XMFLOAT3(0.8f, 0.8f, 0.8f);
+		sun.Intensity = 1.0f;
+		scene.Lights.push_back(sun);
+
+		Light spot = {};
+		spot.Type = LIGHT_TYPE_SPOT;
+		spot.Direction = XMFLOAT3(0, -1, 0);
+		spot.Position = XMFLOAT3(size * 0.5f, 5.0f, size * 0.5f);
+		spot.Color = XMFLOAT3(1, 0.9f, 0.7f);
+		spot.Intensity = 3.0f;
+		spot.Range = 20.0f;
+		spot.SpotInnerAngle = XMConvertToRadians(10.0f);
+		spot.SpotOuterAngle = XMConvertToRadians(25.0f);
+		scene.Lights.push_back(spot);
+		return scene;
+	}
+
+	// Whether two scenes have the same meshes and materials per
+	// entity, by name (the text form numbers them by first use,
+	// so indices can differ), the same flags and the same types
+	// of lights
+	bool SameNames(const SceneData& a, const SceneData& b)
+	{
+		if (a.EntityCount != b.EntityCount || a.LightCount != b.LightCount)
+			return false;
+
+		for (unsigned int i = 0; i < a.LightCount; i++)
+		{
+			if (a.Lights[i].Type != b.Lights[i].Type)
+				return false;
+		}
+
+		for (unsigned int i = 0; i < a.EntityCount; i++)
+		{
+			if (strcmp(a.Meshes[a.MeshIndices[i]].Text, b.Meshes[b.MeshIndices[i]].Text) != 0 ||
+				strcmp(a.Materials[a.MaterialIndices[i]].Text, b.Materials[b.MaterialIndices[i]].Text) != 0 ||
+				a.Flags[i] != b.Flags[i])
+				return false;
+		}
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// The 6 faces of a sky: blue gradient above, brown ground
+	// below and a small, bright sun, so every mip has detail
+	// --------------------------------------------------------
+	std::vector<Image> MakeSky(unsigned int faceSize)
+	{
+		// Face (u, v) to direction, in +X, -X, +Y, -Y, +Z, -Z order
+		const float axes[6][3][3] =
+		{
+			{ { 0, 0, -1 }, { 0, -1, 0 }, { 1, 0, 0 } },
+			{ { 0, 0, 1 }, { 0, -1, 0 }, { -1, 0, 0 } },
+			{ { 1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } },
+			{ { 1, 0, 0 }, { 0, 0, -1 }, { 0, -1, 0 } },
+			{ { 1, 0, 0 }, { 0, -1, 0 }, { 0, 0, 1 } },
+			{ { -1, 0, 0 }, { 0, -1, 0 }, { 0, 0, -1 } },
+		};
+		const float sun[3] = { 0.4f, 0.6f, 0.69282f };
+
+		std::vector<Image> faces(6);
+		for (int f = 0; f < 6; f++)
+		{
+			Image& face = faces[f];
+			face.Width = faceSize;
+			face.Height = faceSize;
+			face.Format = ImageFormat::RGBA8;
+			face.Pixels.resize(face.GetSize());
+			for (unsigned int y = 0; y < faceSize; y++)
+			{
+				for (unsigned int x = 0; x < faceSize; x++)
+				{
+					float u = (x + 0.5f) / faceSize * 2.0f - 1.0f;
+					float v = (y + 0.5f) / faceSize * 2.0f - 1.0f;
+					float direction[3];
+					for (int c = 0; c < 3; c++)
+						direction[c] = axes[f][0][c] * u + axes[f][1][c] * v + axes[f][2][c];
+					float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+					float up = direction[1] / length;
+					float toSun = (direction[0] * sun[0] + direction[1] * sun[1] + direction[2] * sun[2]) / length;
+					float sunAmount = powf(std::max(toSun, 0.0f), 500.0f);
+
+					uint8_t* pixel = &face.Pixels[((size_t)y * faceSize + x) * 4];
+					float color[3] = { 0.35f, 0.25f, 0.15f };
+					if (up > 0)
+					{
+						color[0] = 0.3f + 0.3f * (1 - up);
+						color[1] = 0.5f + 0.3f * (1 - up);
+						color[2] = 0.9f;
+					}
+					for (int c = 0; c < 3; c++)
+						pixel[c] = (uint8_t)(std::min(color[c] + sunAmount, 1.0f) * 255.0f + 0.5f);
+					pixel[3] = 255;
+				}
+			}
+		}
+		return faces;
+	}
+
+	bool SameTangents(const std::vector<Vertex>& a, const std::vector<Vertex>& b)
+	{
+		for (size_t i = 0; i < a.size(); i++)
+			if (memcmp(&a[i].Tangent, &b[i].Tangent, sizeof(XMFLOAT3)) != 0)
+				return false;
+		return true;
+	}
+
+	// Repeatable pseudo random numbers in [0, 1) (xorshift)
+	float NextRandom(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	XMFLOAT3 RandomDirection(uint32_t& state)
+	{
+		while (true)
+		{
+			float x = NextRandom(state) * 2.0f - 1.0f;
+			float y = NextRandom(state) * 2.0f - 1.0f;
+			float z = NextRandom(state) * 2.0f - 1.0f;
+			float length = sqrtf(x * x + y * y + z * z);
+			if (length > 0.1f && length <= 1.0f)
+				return XMFLOAT3(x / length, y / length, z / length);
+		}
+	}
+
+	// --------------------------------------------------------
+	// Lights.hlsli transcribed one pixel at a time, as plainly
+	// as the shader reads (pow() and all), for Brdf's 8-wide
+	// port to be checked against
+	// --------------------------------------------------------
+	namespace Hlsl
+	{
+		const float PI = 3.14159265359f;
+
+		XMFLOAT3 operator+(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.x + b.x, a.y + b.y, a.z + b.z); }
+		XMFLOAT3 operator-(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+		XMFLOAT3 operator-(XMFLOAT3 a) { return XMFLOAT3(-a.x, -a.y, -a.z); }
+		XMFLOAT3 operator*(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.x * b.x, a.y * b.y, a.z * b.z); }
+		XMFLOAT3 operator*(XMFLOAT3 a, float b) { return XMFLOAT3(a.x * b, a.y * b, a.z * b); }
+		XMFLOAT3 operator*(float a, XMFLOAT3 b) { return b * a; }
+		XMFLOAT3 operator/(XMFLOAT3 a, float b) { return XMFLOAT3(a.x / b, a.y / b, a.z / b); }
+		XMFLOAT3 operator-(float a, XMFLOAT3 b) { return XMFLOAT3(a - b.x, a - b.y, a - b.z); }
+
+		float saturate(float a) { return std::clamp(a, 0.0f, 1.0f); }
+		float dot(XMFLOAT3 a, XMFLOAT3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+		float length(XMFLOAT3 a) { return sqrtf(dot(a, a)); }
+		float distance(XMFLOAT3 a, XMFLOAT3 b) { return length(a - b); }
+		XMFLOAT3 normalize(XMFLOAT3 a) { return a / length(a); }
+
+		float Diffuse(XMFLOAT3 normal, XMFLOAT3 lightDirection)
+		{
+			return saturate(dot(normal, lightDirection));
+		}
+
+		float Attenuate(const Light& light, XMFLOAT3 worldPos)
+		{
+			float dist = distance(light.Position, worldPos);
+			float att = saturate(1.0f - (dist * dist / (light.Range * light.Range)));
+			return att * att;
+		}
+
+		float GGX(XMFLOAT3 n, XMFLOAT3 h, float roughness)
+		{
+			float NdotH2 = powf(saturate(dot(n, h)), 2);
+			float a2 = powf(roughness, 2);
+
+			float denom = NdotH2 * (a2 - 1) + 1;
+
+			return a2 / (PI * powf(denom, 2));
+		}
+
+		XMFLOAT3 Schlick(XMFLOAT3 v, XMFLOAT3 h, XMFLOAT3 f0)
+		{
+			float VdotH = saturate(dot(v, h));
+
+			return f0 + (1 - f0) * powf(1 - VdotH, 5);
+		}
+
+		float SchlickGGX(XMFLOAT3 n, XMFLOAT3 v, float roughness)
+		{
+			float k = powf(roughness + 1, 2) / 8.0f;
+			float NdotV = saturate(dot(n, v));
+
+			return 1 / (NdotV * (1 - k) + k);
+		}
+
+		XMFLOAT3 MicrofacetBRDF(XMFLOAT3 n, XMFLOAT3 l, XMFLOAT3 v, float roughness, XMFLOAT3 f0, XMFLOAT3& F_out)
+		{
+			XMFLOAT3 h = normalize(v + l);
+
+			float D = GGX(n, h, roughness);
+			XMFLOAT3 F = Schlick(v, h, f0);
+			float G = SchlickGGX(n, v, roughness) * SchlickGGX(n, l, roughness);
+
+			F_out = F;
+
+			XMFLOAT3 specularResult = (D * F * G) / 4;
+
+			return specularResult * std::max(dot(n, l), 0.0f);
+		}
+
+		XMFLOAT3 DiffuseEnergyConserve(float diffuse, XMFLOAT3 specular, float metalness)
+		{
+			return diffuse * (1 - specular) * (1 - metalness);
+		}
+
+		XMFLOAT3 DirectionalLight(const Light& light, XMFLOAT3 normal, XMFLOAT3 worldPos, XMFLOAT3 camPos, float roughness, float metalness, XMFLOAT3 surfaceColor, XMFLOAT3 specularColor)
+		{
+			XMFLOAT3 lightDirection = normalize(-light.Direction);
+			XMFLOAT3 camDirection = normalize(camPos - worldPos);
+
+			XMFLOAT3 F;
+
+			float diffusion = Diffuse(normal, lightDirection);
+			XMFLOAT3 specular = MicrofacetBRDF(normal, lightDirection, camDirection, roughness, specularColor, F);
+
+			XMFLOAT3 balanceDiff = DiffuseEnergyConserve(diffusion, F, metalness);
+
+			return (balanceDiff * surfaceColor + specular) * light.Intensity * light.Color;
+		}
+
+		XMFLOAT3 PointLight(const Light& light, XMFLOAT3 normal, XMFLOAT3 worldPos, XMFLOAT3 camPos, float roughness, float metalness, XMFLOAT3 surfaceColor, XMFLOAT3 specularColor)
+		{
+			XMFLOAT3 lightDirection = normalize(light.Position - worldPos);
+			XMFLOAT3 camDirection = normalize(camPos - worldPos);
+
+			XMFLOAT3 F;
+
+			float diffusion = Diffuse(normal, lightDirection);
+			XMFLOAT3 specular = MicrofacetBRDF(normal, lightDirection, camDirection, roughness, specularColor, F);
+			float attenuate = Attenuate(light, worldPos);
+
+			XMFLOAT3 balanceDiff = DiffuseEnergyConserve(diffusion, F, metalness);
+
+			return (balanceDiff * surfaceColor + specular) * attenuate * light.Intensity * light.Color;
+		}
+
+		XMFLOAT3 SpotLight(const Light& light, XMFLOAT3 normal, XMFLOAT3 worldPos, XMFLOAT3 camPos, float roughness, float metalness, XMFLOAT3 surfaceColor, XMFLOAT3 specularColor)
+		{
+			XMFLOAT3 lightDirection = normalize(light.Position - worldPos);
+			XMFLOAT3 camDirection = normalize(camPos - worldPos);
+
+			XMFLOAT3 F;
+
+			float angle = dot(-lightDirection, normalize(light.Direction));
+
+			float outer = cosf(light.SpotOuterAngle);
+			float inner = cosf(light.SpotInnerAngle);
+			float spotTerm = saturate((angle - outer) / (inner - outer));
+
+			float diffusion = Diffuse(normal, lightDirection);
+			XMFLOAT3 specular = MicrofacetBRDF(normal, lightDirection, camDirection, roughness, specularColor, F);
+			float attenuation = Attenuate(light, worldPos);
+
+			XMFLOAT3 balanceDiff = DiffuseEnergyConserve(diffusion, F, metalness);
+
+			return (balanceDiff * surfaceColor + specular) * attenuation * spotTerm * light.Intensity * light.Color;
+		}
+
+		// The pixel shader's switch over light types
+		XMFLOAT3 ShadeLight(const Light& light, XMFLOAT3 normal, XMFLOAT3 worldPos, XMFLOAT3 camPos, float roughness, float metalness, XMFLOAT3 surfaceColor, XMFLOAT3 specularColor)
+		{
+			switch (light.Type)
+			{
+			case LIGHT_TYPE_DIRECTIONAL: return DirectionalLight(light, normal, worldPos, camPos, roughness, metalness, surfaceColor, specularColor);
+			case LIGHT_TYPE_POINT: return PointLight(light, normal, worldPos, camPos, roughness, metalness, surfaceColor, specularColor);
+			case LIGHT_TYPE_SPOT: return SpotLight(light, normal, worldPos, camPos, roughness, metalness, surfaceColor, specularColor);
+			}
+			return XMFLOAT3(0, 0, 0);
+		}
+	}
+
+	XMFLOAT3 GetLane(const Float3x8& lanes, unsigned int i)
+	{
+		return XMFLOAT3(lanes.X[i], lanes.Y[i], lanes.Z[i]);
+	}
+
+	void SetLane(Float3x8& lanes, unsigned int i, const XMFLOAT3& value)
+	{
+		lanes.X[i] = value.x;
+		lanes.Y[i] = value.y;
+		lanes.Z[i] = value.z;
+	}
+
+	// Difference relative to the reference, or absolute below 1
+	float LaneError(const Float3x8& lanes, unsigned int i, const XMFLOAT3& reference)
+	{
+		XMFLOAT3 value = GetLane(lanes, i);
+		float error = 0.0f;
+		error = std::max(error, fabsf(value.x - reference.x) / std::max(1.0f, fabsf(reference.x)));
+		error = std::max(error, fabsf(value.y - reference.y) / std::max(1.0f, fabsf(reference.y)));
+		error = std::max(error, fabsf(value.z - reference.z) / std::max(1.0f, fabsf(reference.z)));
+		return error;
+	}
+
+	// --------------------------------------------------------
+	// The split sum scale and bias the slow way, as a reference
+	// for Brdf's importance sampled lookup table
+	// - A midpoint rule over half vectors (dense in theta, so
+	//    even the sharpest lobes get many steps), in double;
+	//    dL = 4 (v dot h) dH turns the BRDF times n dot l into
+	//    D * G * (n dot l) * (v dot h), with the same remapped
+	//    k = roughness / 2 the table uses
+	// - V is in the xz plane, so half of phi is enough
+	// --------------------------------------------------------
+	void IntegrateEnvironmentBruteForce(double roughness, double NdotV, double& scale, double& bias)
+	{
+		const int ThetaSteps = 4096;
+		const int PhiSteps = 256;
+		const double Pi = 3.14159265358979323846;
+
+		double Vx = sqrt(1.0 - NdotV * NdotV);
+		double Vz = NdotV;
+		double a2 = roughness * roughness;
+		double k = roughness / 2.0;
+		auto schlickGGX = [k](double NdotX) { return 1.0 / (NdotX * (1.0 - k) + k); };
+
+		double dTheta = Pi / 2.0 / ThetaSteps;
+		double dPhi = Pi / PhiSteps;
+		scale = 0.0;
+		bias = 0.0;
+		for (int t = 0; t < ThetaSteps; t++)
+		{
+			double theta = (t + 0.5) * dTheta;
+			double cosTheta = cos(theta);
+			double sinTheta = sin(theta);
+			double denom = cosTheta * cosTheta * (a2 - 1.0) + 1.0;
+			double D = a2 / (Pi * denom * denom);
+
+			for (int p = 0; p < PhiSteps; p++)
+			{
+				double phi = (p + 0.5) * dPhi;
+				double VdotH = Vx * sinTheta * cos(phi) + Vz * cosTheta;
+				double NdotL = 2.0 * VdotH * cosTheta - Vz;
+				if (VdotH <= 0.0 || NdotL <= 0.0)
+					continue;
+
+				double weight = D * schlickGGX(NdotV) * schlickGGX(NdotL) * NdotL * VdotH * sinTheta * dTheta * dPhi * 2.0;
+				double Fc = pow(1.0 - VdotH, 5.0);
+				scale += (1.0 - Fc) * weight;
+				bias += Fc * weight;
+			}
+		}
+	}
+}
+
+void Benchmarks::RunAll(const std::vector<unsigned int>& sceneSizes)
+{
+	printf("Running benchmarks (%u threads)\n\n", ThreadPool::Get().GetThreadCount());
+	TangentGeneration();
+	GlbLoading();
+	PackingRoundTrip(FixPath(L"../../assets/"));
+	MeshCompression(FixPath(L"../../assets/"));
+	SceneLoading(sceneSizes);
+	TextureDecoding(FixPath(L"../../assets/"));
+	TextureCompression(FixPath(L"../../assets/"));
+	EnvironmentPrefilter();
+	Brdf();
+}
+
+void Benchmarks::TangentGeneration(unsigned int triangleCount)
+{
+	unsigned int side = (unsigned int)ceil(sqrt(triangleCount / 2.0));
+
+	std::vector<Vertex> grid;
+	std::vector<unsigned int> indices;
+	MakeGrid(side, grid, indices);
+	unsigned int vertexCount = (unsigned int)grid.size();
+	unsigned int indexCount = (unsigned int)indices.size();
+
+	std::vector<Vertex> scalar = grid;
+	std::vector<Vertex> accumulated = grid;
+	std::vector<Vertex> mikk = grid;
+
+	double scalarTime = BestTime([&]() { TangentGenerator::GenerateScalar(&scalar[0], vertexCount, &indices[0], indexCount); });
+	double accumulatedTime = BestTime([&]() { TangentGenerator::Generate(&accumulated[0], vertexCount, &indices[0], indexCount); });
+	double mikkTime = BestTime([&]() { TangentGenerator::Generate(&mikk[0], vertexCount, &indices[0], indexCount, TangentMode::MikkTSpace); });
+
+	// The reduction order is fixed, so a second run must match bit for bit
+	std::vector<Vertex> again = grid;
+	TangentGenerator::Generate(&again[0], vertexCount, &indices[0], indexCount);
+
+	printf("Tangent generation, %u triangles, %u vertices (best of %d):\n", indexCount / 3, vertexCount, TimedRuns);
+	printf("  Scalar:              %8.2f ms\n", scalarTime);
+	printf("  Threads:             %8.2f ms (%.2fx)\n", accumulatedTime, scalarTime / accumulatedTime);
+	printf("  MikkTSpace mode:     %8.2f ms (%.2fx)\n", mikkTime, scalarTime / mikkTime);
+	printf("  Max difference from scalar: %.5f degrees, repeat run identical: %s\n",
+		MaxAngleDegrees(scalar, accumulated), SameTangents(accumulated, again) ? "yes" : "NO");
+	printf("  MikkTSpace vs accumulated: up to %.3f degrees apart\n\n", MaxAngleDegrees(accumulated, mikk));
+}
+
+void Benchmarks::GlbLoading(unsigned int triangleCount)
+{
+	unsigned int side = (unsigned int)ceil(sqrt(triangleCount / 2.0));
+
+	std::vector<Vertex> grid;
+	std::vector<unsigned int> indices;
+	MakeGrid(side, grid, indices);
+	TangentGenerator::Generate(&grid[0], (unsigned int)grid.size(), &indices[0], (unsigned int)indices.size());
+
+	std::string obj = WriteObj(grid, indices);
+	std::vector<char> glb = WriteGlb(grid, indices);
+
+	// Everything it takes to get from .OBJ text to GPU ready vertices
+	double objTime = BestTime([&]()
+	{
+		ObjMeshData mesh;
+		ObjParser::Parse(obj.data(), obj.size(), mesh);
+		TangentGenerator::Generate(&mesh.Vertices[0], (unsigned int)mesh.Vertices.size(), &mesh.Indices[0], (unsigned int)mesh.Indices.size());
+
+		XMFLOAT3 boundsMin, boundsMax;
+		MeshCache::CalculateBounds(&mesh.Vertices[0], (unsigned int)mesh.Vertices.size(), boundsMin, boundsMax);
+		std::vector<PackedVertex> packed(mesh.Vertices.size());
+		VertexPacking::PackVertices(&mesh.Vertices[0], (unsigned int)mesh.Vertices.size(), VertexPacking::QuantizationFromBounds(boundsMin, boundsMax), &packed[0]);
+	});
+
+	GltfMeshData loaded;
+	double glbTime = BestTime([&]() { GltfLoader::Parse(&glb[0], glb.size(), loaded); });
+
+	printf(".GLB loading, %zu triangles, %zu vertices (best of %d):\n", indices.size() / 3, grid.size(), TimedRuns);
+	printf("  .OBJ (%6.1f MB):     %8.2f ms\n", obj.size() / 1048576.0, objTime);
+	printf("  .GLB (%6.1f MB):     %8.2f ms (%.2fx)\n", glb.size() / 1048576.0, glbTime, objTime / glbTime);
+	printf("  %u streams read in place, %u converted, indices %s\n\n",
+		loaded.DirectStreams, loaded.ConvertedStreams, loaded.IndicesInPlace ? "used from the file" : "converted");
+}
+
+void Benchmarks::PackingRoundTrip(const std::wstring& assetFolder, unsigned int triangleCount)
+{
+	printf("Vertex packing round trips (bounds: position %.2g, uv %.2g, directions %.4f deg):\n",
+		VertexPacking::MaxPositionError, VertexPacking::MaxUVError, VertexPacking::MaxDirectionErrorDegrees);
+
+	bool passed = true;
+	auto check = [&](const std::wstring& name, const std::vector<Vertex>& vertices)
+	{
+		XMFLOAT3 boundsMin, boundsMax;
+		MeshCache::CalculateBounds(&vertices[0], (unsigned int)vertices.size(), boundsMin, boundsMax);
+		PackingError error = VertexPacking::ValidateRoundTrip(&vertices[0], (unsigned int)vertices.size(), VertexPacking::QuantizationFromBounds(boundsMin, boundsMax));
+
+		bool within = VertexPacking::IsWithinBounds(error);
+		passed = passed && within;
+		printf("  %-24ls position %.2g, uv %.2g, normal %.4f deg, tangent %.4f deg  %s\n",
+			name.c_str(), error.Position, error.UV, error.NormalDegrees, error.TangentDegrees, within ? "PASS" : "FAIL");
+	};
+
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(assetFolder, error))
+	{
+		if (entry.path().extension() != L".obj")
+			continue;
+
+		ObjMeshData obj;
+		if (!ObjParser::Load(entry.path().wstring(), obj) || obj.Vertices.empty())
+			continue;
+		TangentGenerator::Generate(&obj.Vertices[0], (unsigned int)obj.Vertices.size(), &obj.Indices[0], (unsigned int)obj.Indices.size());
+		check(entry.path().filename().wstring(), obj.Vertices);
+	}
+
+	unsigned int side = (unsigned int)ceil(sqrt(triangleCount / 2.0));
+	std::vector<Vertex> grid;
+	std::vector<unsigned int> gridIndices;
+	MakeGrid(side, grid, gridIndices);
+	TangentGenerator::Generate(&grid[0], (unsigned int)grid.size(), &gridIndices[0], (unsigned int)gridIndices.size());
+	check(L"Grid", grid);
+
+	printf("  %s\n\n", passed ? "PASS" : "FAIL");
+}
+
+void Benchmarks::MeshCompression(const std::wstring& assetFolder, unsigned int triangleCount)
+{
+	printf("Mesh compression round trips:\n");
+
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(assetFolder, error))
+	{
+		if (entry.path().extension() != L".obj")
+			continue;
+
+		// Welded and with tangents, like the vertices Mesh builds
+		ObjMeshData obj;
+		if (!ObjParser::Load(entry.path().wstring(), obj) || obj.Vertices.empty())
+			continue;
+		TangentGenerator::Generate(&obj.Vertices[0], (unsigned int)obj.Vertices.size(), &obj.Indices[0], (unsigned int)obj.Indices.size());
+
+		std::vector<uint8_t> encoded = MeshCodec::Encode(&obj.Vertices[0], (unsigned int)obj.Vertices.size(), &obj.Indices[0], (unsigned int)obj.Indices.size());
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		bool same =
+			MeshCodec::Decode(&encoded[0], encoded.size(), vertices, indices) &&
+			vertices.size() == obj.Vertices.size() && indices == obj.Indices &&
+			memcmp(&vertices[0], &obj.Vertices[0], sizeof(Vertex) * vertices.size()) == 0;
+
+		size_t rawSize = sizeof(Vertex) * obj.Vertices.size() + sizeof(unsigned int) * obj.Indices.size();
+		printf("  %-24ls %9zu -> %9zu bytes (%5.1f%%) %s\n",
+			entry.path().filename().wstring().c_str(), rawSize, encoded.size(), 100.0 * encoded.size() / rawSize,
+			same ? "identical" : "MISMATCH");
+	}
+
+	// Decoding speed on a big mesh, in output bytes per second
+	unsigned int side = (unsigned int)ceil(sqrt(triangleCount / 2.0));
+	std::vector<Vertex> grid;
+	std::vector<unsigned int> gridIndices;
+	MakeGrid(side, grid, gridIndices);
+	TangentGenerator::Generate(&grid[0], (unsigned int)grid.size(), &gridIndices[0], (unsigned int)gridIndices.size());
+
+	// An index past the last vertex has to fail to decode, both
+	// stored (a lone triangle) and compressed (the grid)
+	bool rejected = true;
+	for (unsigned int vertexCount : { 3u, (unsigned int)grid.size() })
+	{
+		std::vector<unsigned int> badIndices(vertexCount == 3 ? std::vector<unsigned int>{ 0, 1, 2 } : gridIndices);
+		badIndices[badIndices.size() / 2] = 1000000 + vertexCount;
+		std::vector<uint8_t> bad = MeshCodec::Encode(&grid[0], vertexCount, &badIndices[0], (unsigned int)badIndices.size());
+
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		rejected = rejected && !MeshCodec::Decode(&bad[0], bad.size(), vertices, indices);
+	}
+	printf("  Indices past the last vertex rejected: %s\n", rejected ? "yes" : "NO");
+
+	std::vector<uint8_t> encoded;
+	double encodeTime = BestTime([&]() { encoded = MeshCodec::Encode(&grid[0], (unsigned int)grid.size(), &gridIndices[0], (unsigned int)gridIndices.size()); });
+
+	std::vector<Vertex> vertices(grid.size());
+	std::vector<unsigned int> indices(gridIndices.size());
+	double decodeTime = BestTime([&]() { MeshCodec::Decode(&encoded[0], encoded.size(), &vertices[0], &indices[0]); });
+
+	size_t rawSize = sizeof(Vertex) * grid.size() + sizeof(unsigned int) * gridIndices.size();
+	bool same = indices == gridIndices && memcmp(&vertices[0], &grid[0], sizeof(Vertex) * grid.size()) == 0;
+	printf("  Grid, %zu triangles:     %9zu -> %9zu bytes (%5.1f%%) %s\n",
+		gridIndices.size() / 3, rawSize, encoded.size(), 100.0 * encoded.size() / rawSize, same ? "identical" : "MISMATCH");
+	printf("  Encode: %8.2f ms, decode: %8.2f ms (%.2f GB/s, one thread)\n\n",
+		encodeTime, decodeTime, rawSize / (decodeTime * 1e6));
+}
+
+void Benchmarks::SceneLoading(const std::vector<unsigned int>& entityCounts)
+{
+	std::error_code error;
+	std::wstring binaryPath = (std::filesystem::temp_directory_path(error) / L"benchmark.scenebin").wstring();
+
+	for (unsigned int entityCount : entityCounts)
+	{
+		SceneArrays scene = MakeScene(entityCount);
+		std::string text = SceneFile::ToText(SceneFile::GetData(scene));
+		if (!SceneFile::Save(binaryPath, SceneFile::GetData(scene)))
+		{
+			printf("Scene loading: couldn't write %ls\n\n", binaryPath.c_str());
+			return;
+		}
+
+		SceneArrays parsed;
+		double textTime = BestTime([&]() { SceneFile::ParseText(text.data(), text.size(), parsed); });
+
+		// Mapping is all there is to it, so the file is opened (and
+		// closed) every run
+		MappedFile file;
+		SceneData loaded;
+		double binaryTime = BestTime([&]()
+		{
+			file.Close();
+			SceneFile::Load(binaryPath, file, loaded);
+		});
+
+		bool same =
+			loaded.EntityCount == entityCount && parsed.MeshIndices.size() == entityCount &&
+			memcmp(loaded.MeshIndices, scene.MeshIndices.data(), entityCount * sizeof(uint32_t)) == 0 &&
+			memcmp(loaded.MaterialIndices, scene.MaterialIndices.data(), entityCount * sizeof(uint32_t)) == 0 &&
+			memcmp(loaded.Positions, scene.Positions.data(), entityCount * sizeof(XMFLOAT3)) == 0 &&
+			memcmp(loaded.Rotations, scene.Rotations.data(), entityCount * sizeof(XMFLOAT3)) == 0 &&
+			memcmp(loaded.Scales, scene.Scales.data(), entityCount * sizeof(XMFLOAT3)) == 0 &&
+			memcmp(loaded.Flags, scene.Flags.data(), entityCount * sizeof(uint32_t)) == 0 &&
+			loaded.LightCount == scene.Lights.size() &&
+			memcmp(loaded.Lights, scene.Lights.data(), scene.Lights.size() * sizeof(Light)) == 0 &&
+			SameNames(SceneFile::GetData(parsed), SceneFile::GetData(scene));
+
+		printf("Scene loading, %u entities (best of %d):\n", entityCount, TimedRuns);
+		printf("  .scene    (%6.1f MB): %8.2f ms\n", text.size() / 1048576.0, textTime);
+		printf("  .scenebin (%6.1f MB): %8.3f ms (%.0fx)\n", file.GetSize() / 1048576.0, binaryTime, textTime / binaryTime);
+		printf("  Both match the generated scene: %s\n\n", same ? "yes" : "NO");
+	}
+
+	std::filesystem::remove(binaryPath, error);
+}
+
+void Benchmarks::TextureDecoding(const std::wstring& assetFolder)
+{
+	// Mapped up front, so only decoding is timed
+	std::vector<MappedFile> files;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(assetFolder, error))
+	{
+		if (entry.path().extension() != L".png")
+			continue;
+
+		files.emplace_back();
+		if (!files.back().Open(entry.path().wstring()))
+			files.pop_back();
+	}
+
+	if (files.empty())
+	{
+		printf("Texture decoding: no .PNG files in %ls\n\n", assetFolder.c_str());
+		return;
+	}
+
+	// What AssetManager does for each texture on a worker thread
+	std::vector<std::vector<Image>> decoded(files.size());
+	std::vector<uint8_t> succeeded(files.size());	// Not vector<bool>, which threads can't write apart
+	auto decode = [&](size_t i)
+	{
+		Image image;
+		succeeded[i] = PngDecoder::Decode(files[i].GetData(), files[i].GetSize(), image);
+		Images::GenerateMips(std::move(image), decoded[i]);
+	};
+
+	double sequentialTime = BestTime([&]()
+	{
+		for (size_t i = 0; i < files.size(); i++)
+			decode(i);
+	});
+	double parallelTime = BestTime([&]() { ThreadPool::Get().ParallelFor(files.size(), decode); });
+
+	size_t fileBytes = 0;
+	size_t pixelBytes = 0;
+	unsigned int failed = 0;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		fileBytes += files[i].GetSize();
+		for (const Image& mip : decoded[i])
+			pixelBytes += mip.Pixels.size();
+		failed += succeeded[i] ? 0 : 1;
+	}
+
+	printf("Texture decoding, %zu .PNG files, %.1f MB -> %.1f MB with mips (best of %d):\n",
+		files.size(), fileBytes / 1048576.0, pixelBytes / 1048576.0, TimedRuns);
+	printf("  One at a time:       %8.2f ms\n", sequentialTime);
+	printf("  Thread pool:         %8.2f ms (%.2fx)\n", parallelTime, sequentialTime / parallelTime);
+	printf("  Failed to decode: %u\n\n", failed);
+}
+
+void Benchmarks::TextureCompression(const std::wstring& assetFolder)
+{
+	// The largest file of each kind, as the most telling one
+	std::filesystem::path largest[4];
+	uintmax_t largestSize[4] = {};
+	std::map<std::wstring, std::vector<std::filesystem::path>> materialMasks;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(assetFolder, error))
+	{
+		if (entry.path().extension() != L".png")
+			continue;
+		if (TextureCooker::GetKind(entry.path().wstring()) == TextureKind::Mask)
+			materialMasks[TextureCooker::GetPackedPath(entry.path().wstring())].push_back(entry.path());
+
+		int kind = (int)TextureCooker::GetKind(entry.path().wstring());
+		uintmax_t size = entry.file_size(error);
+		if (!error && size > largestSize[kind])
+		{
+			largest[kind] = entry.path();
+			largestSize[kind] = size;
+		}
+	}
+
+	printf("Texture compression, full mip chains (one run each):\n");
+	for (const std::filesystem::path& path : largest)
+	{
+		MappedFile file;
+		Image source;
+		if (path.empty() || !file.Open(path.wstring()) || !PngDecoder::Decode(file.GetData(), file.GetSize(), source))
+			continue;
+		TextureKind kind = TextureCooker::GetKind(path.wstring());
+
+		std::vector<ImageFormat> formats = { TextureCooker::GetFormat(kind) };
+		if (kind == TextureKind::Color)
+			formats.insert(formats.begin(), ImageFormat::BC1);
+
+		for (ImageFormat format : formats)
+		{
+			std::vector<Image> mips;
+			double psnr = 0.0;
+			auto start = std::chrono::steady_clock::now();
+			TextureCooker::Cook(source, kind, format, mips, &psnr);
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+			// Against the same mips uncompressed (RGBA8, or R8 for masks)
+			size_t before = 0;
+			size_t after = 0;
+			for (const Image& mip : mips)
+			{
+				before += (size_t)mip.Width * mip.Height * (kind == TextureKind::Mask ? 1 : 4);
+				after += mip.GetSize();
+			}
+
+			printf("  %-24ls %4ux%-4u %-5s %8.1f ms, %.1fx smaller, PSNR %6.2f dB\n",
+				path.filename().wstring().c_str(), source.Width, source.Height, TextureCooker::GetFormatName(format),
+				elapsed.count(), (double)before / after, psnr);
+		}
+	}
+
+	// Separately, every mask costs a bind, a fetch and its own mips
+	for (const auto& [packedPath, maskPaths] : materialMasks)
+	{
+		Image masks[3];
+		size_t separateSize = 0;
+		for (const std::filesystem::path& path : maskPaths)
+		{
+			MappedFile file;
+			Image& mask = masks[(int)TextureCooker::GetMaskChannel(path.wstring())];
+			if (!file.Open(path.wstring()) || !PngDecoder::Decode(file.GetData(), file.GetSize(), mask))
+				continue;
+
+			std::vector<Image> mips;
+			TextureCooker::Cook(mask, TextureKind::Mask, ImageFormat::BC4, mips);
+			for (const Image& mip : mips)
+				separateSize += mip.GetSize();
+		}
+
+		auto present = [&](MaskChannel channel) { const Image& mask = masks[(int)channel]; return mask.Pixels.empty() ? nullptr : &mask; };
+		Image packed = TextureCooker::PackMasks(present(MaskChannel::Occlusion), present(MaskChannel::Roughness), present(MaskChannel::Metalness));
+		if (packed.Pixels.empty() || separateSize == 0)
+			continue;
+
+		for (ImageFormat format : { ImageFormat::BC1, ImageFormat::BC7 })
+		{
+			std::vector<Image> mips;
+			double psnr = 0.0;
+			TextureCooker::Cook(packed, TextureKind::Packed, format, mips, &psnr);
+			size_t packedSize = 0;
+			for (const Image& mip : mips)
+				packedSize += mip.GetSize();
+
+			printf("  %-24ls %4ux%-4u %-5s %zu masks, %.2f -> %.2f MB, PSNR %6.2f dB\n",
+				std::filesystem::path(packedPath).filename().wstring().c_str(), packed.Width, packed.Height,
+				TextureCooker::GetFormatName(format), maskPaths.size(), separateSize / 1048576.0, packedSize / 1048576.0, psnr);
+		}
+	}
+	printf("\n");
+}
+
+void Benchmarks::EnvironmentPrefilter(unsigned int faceSize)
+{
+	std::error_code error;
+	std::wstring cachePath = (std::filesystem::temp_directory_path(error) / L"benchmark.ibl").wstring();
+	std::vector<Image> faces = MakeSky(faceSize);
+
+	// Few runs, as each one is a whole prefilter
+	PrefilteredEnvironment prefiltered;
+	bool succeeded = true;
+	double prefilterTime = 1e30;
+	for (int i = 0; i < 2; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		succeeded = IblPrefilter::Prefilter(faces, prefiltered) && succeeded;
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		prefilterTime = std::min(prefilterTime, elapsed.count());
+	}
+
+	if (!succeeded || !IblPrefilter::Save(cachePath, prefiltered))
+	{
+		printf("Environment prefilter: couldn't prefilter or write %ls\n\n", cachePath.c_str());
+		return;
+	}
+
+	PrefilteredEnvironment loaded;
+	double loadTime = BestTime([&]() { succeeded = IblPrefilter::Load(cachePath, loaded); });
+
+	bool same = succeeded && memcmp(&loaded.Irradiance, &prefiltered.Irradiance, sizeof(SphericalHarmonics9)) == 0 &&
+		loaded.Specular.size() == prefiltered.Specular.size();
+	for (size_t i = 0; same && i < loaded.Specular.size(); i++)
+		same = loaded.Specular[i].Pixels == prefiltered.Specular[i].Pixels;
+
+	// A cut short file has to be turned away
+	PrefilteredEnvironment truncated;
+	std::filesystem::resize_file(cachePath, std::filesystem::file_size(cachePath, error) - 1, error);
+	bool rejected = !error && !IblPrefilter::Load(cachePath, truncated);
+
+	printf("Environment prefilter, 6 %ux%u faces -> SH irradiance + %u specular mips of %ux%u (%u samples):\n",
+		faceSize, faceSize, prefiltered.SpecularMipCount, prefiltered.SpecularSize, prefiltered.SpecularSize, IblPrefilter::SampleCount);
+	printf("  Prefilter:  %8.2f ms\n", prefilterTime);
+	printf("  File load:  %8.3f ms (%.0fx)\n", loadTime, prefilterTime / loadTime);
+	printf("  File matches: %s, truncated file rejected: %s\n\n", same ? "yes" : "NO", rejected ? "yes" : "NO");
+
+	std::filesystem::remove(cachePath, error);
+}
+
+void Benchmarks::Brdf(unsigned int surfaceCount)
+{
+	// ::Brdf, as this function's name hides the namespace
+	const unsigned int Lanes = ::Brdf::Lanes;
+	const float Tolerance = 1e-4f;
+	const float LutTolerance = 1.0f / 255.0f;
+
+	// Random surfaces in a 10 unit box, seen from one side
+	uint32_t state = 12345;
+	std::vector<SurfaceBatch> batches((surfaceCount + Lanes - 1) / Lanes);
+	for (SurfaceBatch& batch : batches)
+	{
+		for (unsigned int i = 0; i < Lanes; i++)
+		{
+			SetLane(batch.Normal, i, RandomDirection(state));
+			SetLane(batch.WorldPosition, i, XMFLOAT3(NextRandom(state) * 10 - 5, NextRandom(state) * 10 - 5, NextRandom(state) * 10 - 5));
+			SetLane(batch.SurfaceColor, i, XMFLOAT3(NextRandom(state), NextRandom(state), NextRandom(state)));
+			float f0 = 0.04f + 0.96f * NextRandom(state);
+			SetLane(batch.SpecularColor, i, XMFLOAT3(f0, f0, f0));
+			batch.Roughness[i] = 0.05f + 0.95f * NextRandom(state);
+			batch.Metalness[i] = NextRandom(state);
+		}
+	}
+	XMFLOAT3 camPos(0, 2, -15);
+
+	// One light of each type, reaching most of the box
+	Light lights[3] = {};
+	lights[0].Type = LIGHT_TYPE_DIRECTIONAL;
+	lights[0].Direction = XMFLOAT3(0.3f, -1.0f, 0.5f);
+	lights[0].Intensity = 1.0f;
+	lights[0].Color = XMFLOAT3(0.8f, 0.8f, 0.8f);
+	lights[1].Type = LIGHT_TYPE_POINT;
+	lights[1].Position = XMFLOAT3(2, 3, -2);
+	lights[1].Range = 12.0f;
+	lights[1].Intensity = 2.0f;
+	lights[1].Color = XMFLOAT3(1.0f, 0.6f, 0.3f);
+	lights[2].Type = LIGHT_TYPE_SPOT;
+	lights[2].Position = XMFLOAT3(-3, 6, -3);
+	lights[2].Direction = XMFLOAT3(0.5f, -1.0f, 0.5f);
+	lights[2].Range = 20.0f;
+	lights[2].Intensity = 3.0f;
+	lights[2].Color = XMFLOAT3(0.3f, 0.5f, 1.0f);
+	lights[2].SpotInnerAngle = 0.3f;
+	lights[2].SpotOuterAngle = 0.7f;
+
+	printf("BRDF, 8-wide port (see Brdf) vs. Lights.hlsli one pixel at a time, %zu surfaces:\n", batches.size() * Lanes);
+	bool passed = true;
+
+	// The BRDF alone, toward a random light direction per lane
+	// (flipped to the normal's side, like a lit pixel's)
+	{
+		std::vector<Float3x8> l(batches.size()), v(batches.size());
+		for (size_t b = 0; b < batches.size(); b++)
+		{
+			for (unsigned int i = 0; i < Lanes; i++)
+			{
+				XMFLOAT3 direction = RandomDirection(state);
+				if (Hlsl::dot(direction, GetLane(batches[b].Normal, i)) < 0.0f)
+					direction = XMFLOAT3(-direction.x, -direction.y, -direction.z);
+				SetLane(l[b], i, direction);
+
+				XMFLOAT3 position = GetLane(batches[b].WorldPosition, i);
+				SetLane(v[b], i, Hlsl::normalize(XMFLOAT3(camPos.x - position.x, camPos.y - position.y, camPos.z - position.z)));
+			}
+		}
+
+		std::vector<Float3x8> specular(batches.size()), fresnel(batches.size());
+		double wideTime = BestTime([&]()
+		{
+			for (size_t b = 0; b < batches.size(); b++)
+				::Brdf::MicrofacetBRDF(batches[b].Normal, l[b], v[b], batches[b].Roughness, batches[b].SpecularColor, specular[b], fresnel[b]);
+		});
+
+		std::vector<XMFLOAT3> referenceSpecular(batches.size() * Lanes), referenceFresnel(batches.size() * Lanes);
+		double scalarTime = BestTime([&]()
+		{
+			for (size_t b = 0; b < batches.size(); b++)
+			{
+				for (unsigned int i = 0; i < Lanes; i++)
+				{
+					referenceSpecular[b * Lanes + i] = Hlsl::MicrofacetBRDF(GetLane(batches[b].Normal, i), GetLane(l[b], i), GetLane(v[b], i),
+						batches[b].Roughness[i], GetLane(batches[b].SpecularColor, i), referenceFresnel[b * Lanes + i]);
+				}
+			}
+		});
+
+		float maxError = 0.0f;
+		for (size_t b = 0; b < batches.size(); b++)
+		{
+			for (unsigned int i = 0; i < Lanes; i++)
+			{
+				maxError = std::max(maxError, LaneError(specular[b], i, referenceSpecular[b * Lanes + i]));
+				maxError = std::max(maxError, LaneError(fresnel[b], i, referenceFresnel[b * Lanes + i]));
+			}
+		}
+
+		passed = passed && maxError <= Tolerance;
+		printf("  %-16s scalar %8.2f ms, 8-wide %8.2f ms (%4.1fx), max error %.2e %s\n", "MicrofacetBRDF",
+			scalarTime, wideTime, scalarTime / wideTime, maxError, maxError <= Tolerance ? "PASS" : "FAIL");
+	}
+
+	const char* lightNames[3] = { "DirectionalLight", "PointLight", "SpotLight" };
+	for (int t = 0; t < 3; t++)
+	{
+		const Light& light = lights[t];
+
+		std::vector<Float3x8> shaded(batches.size());
+		double wideTime = BestTime([&]()
+		{
+			for (size_t b = 0; b < batches.size(); b++)
+				::Brdf::ShadeLight(light, batches[b], camPos, shaded[b]);
+		});
+
+		std::vector<XMFLOAT3> reference(batches.size() * Lanes);
+		double scalarTime = BestTime([&]()
+		{
+			for (size_t b = 0; b < batches.size(); b++)
+			{
+				const SurfaceBatch& batch = batches[b];
+				for (unsigned int i = 0; i < Lanes; i++)
+				{
+					reference[b * Lanes + i] = Hlsl::ShadeLight(light, GetLane(batch.Normal, i), GetLane(batch.WorldPosition, i), camPos,
+						batch.Roughness[i], batch.Metalness[i], GetLane(batch.SurfaceColor, i), GetLane(batch.SpecularColor, i));
+				}
+			}
+		});
+
+		float maxError = 0.0f;
+		for (size_t b = 0; b < batches.size(); b++)
+		{
+			for (unsigned int i = 0; i < Lanes; i++)
+				maxError = std::max(maxError, LaneError(shaded[b], i, reference[b * Lanes + i]));
+		}
+
+		passed = passed && maxError <= Tolerance;
+		printf("  %-16s scalar %8.2f ms, 8-wide %8.2f ms (%4.1fx), max error %.2e %s\n", lightNames[t],
+			scalarTime, wideTime, scalarTime / wideTime, maxError, maxError <= Tolerance ? "PASS" : "FAIL");
+	}
+
+	// The cooked lookup table against brute force, at every 8th
+	// texel across and down
+	auto start = std::chrono::steady_clock::now();
+	Image lut = ::Brdf::IntegrateEnvironmentLut();
+	std::chrono::duration<double, std::milli> lutTime = std::chrono::steady_clock::now() - start;
+
+	const unsigned int Step = 8;
+	unsigned int side = (lut.Width + Step - 1) / Step;
+	std::vector<float> texelErrors((size_t)side * side, 0.0f);
+	ThreadPool::Get().ParallelFor(texelErrors.size(), [&](size_t t)
+	{
+		unsigned int x = (unsigned int)(t % side) * Step;
+		unsigned int y = (unsigned int)(t / side) * Step;
+		double scale = 0.0;
+		double bias = 0.0;
+		IntegrateEnvironmentBruteForce((y + 0.5) / lut.Height, (x + 0.5) / lut.Width, scale, bias);
+
+		const uint16_t* texel = (const uint16_t*)&lut.Pixels[y * lut.GetRowPitch() + x * 4];
+		texelErrors[t] = (float)std::max(fabs(texel[0] / 65535.0 - scale), fabs(texel[1] / 65535.0 - bias));
+	});
+	float lutError = *std::max_element(texelErrors.begin(), texelErrors.end());
+
+	passed = passed && lutError <= LutTolerance;
+	printf("  Environment LUT  %ux%u, %u samples: %.1f ms, max error vs. brute force (%zu texels) %.2e %s\n",
+		lut.Width, lut.Height, ::Brdf::LutSampleCount, lutTime.count(), texelErrors.size(), lutError, lutError <= LutTolerance ? "PASS" : "FAIL");
+	printf("  %s\n\n", passed ? "PASS" : "FAIL");
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// CPU benchmarks of the asset pipeline, run by starting the
+// program with -benchmark (see Main.cpp)
+//
+// - Each benchmark builds its own synthetic input, times the
+//    best of several runs and prints the results
+// --------------------------------------------------------
+namespace Benchmarks
+{
+	// sceneSizes are the entity counts SceneLoading() times
+	void RunAll(const std::vector<unsigned int>& sceneSizes = { 1000, 10000, 100000 });
+
+	// Scalar vs threaded tangents on a grid of about
+	// triangleCount triangles
+	void TangentGeneration(unsigned int triangleCount = 1000000);
+
+	// The same grid loaded from in-memory .OBJ text (parse, tangents
+	// and packing) vs. a .GLB with tangents (see GltfLoader)
+	void GlbLoading(unsigned int triangleCount = 1000000);
+
+	// Packs every .OBJ in a folder (welded, with tangents, as
+	// the cooker does) and the tangent grid, then checks each
+	// round trip against VertexPacking's documented error bounds
+	// - Prints the worst errors and PASS or FAIL for each, and
+	//    overall
+	void PackingRoundTrip(const std::wstring& assetFolder, unsigned int triangleCount = 1000000);
+
+	// Round trips every .OBJ in a folder through MeshCodec (which
+	// must be bit exact), checks indices past the last vertex
+	// fail to decode, then times decoding a large grid
+	void MeshCompression(const std::wstring& assetFolder, unsigned int triangleCount = 1000000);
+
+	// Scenes of each size as .scene text (parsed from memory) vs.
+	// a .scenebin (mapped from a temp file), see SceneFile
+	void SceneLoading(const std::vector<unsigned int>& entityCounts);
+
+	// Decoding every .PNG in a folder (with mips, see PngDecoder)
+	// one after another, like startup did, vs. on the thread pool
+	void TextureDecoding(const std::wstring& assetFolder);
+
+	// Cooking the largest .PNG of each kind in a folder (see
+	// TextureCooker), color ones as both BC1 and BC7: time, size
+	// and PSNR against the .PNG
+	// - Then each material's masks packed into one texture, as
+	//    BC1 and BC7, against cooking them one by one (BC4)
+	void TextureCompression(const std::wstring& assetFolder);
+
+	// Prefiltering a synthetic sky of faceSize faces for image
+	// based lighting (see IblPrefilter) vs. reading the results
+	// back from a saved file, as the game does
+	void EnvironmentPrefilter(unsigned int faceSize = 512);
+
+	// Brdf's 8-wide lighting vs. Lights.hlsli transcribed one
+	// pixel at a time, on surfaceCount random surfaces: speed,
+	// and whether every lane matches within a tolerance
+	// - Then its environment lookup table vs. a brute force
+	//    integration of the same BRDF
+	// - Prints PASS or FAIL for each, and overall
+	void Brdf(unsigned int surfaceCount = 1 << 18);
+}
@@ -0,0 +1,374 @@
+#include "Brdf.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#define BRDF_AVX 1
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BRDF_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	const float Pi = 3.14159265359f;
+
+	// --------------------------------------------------------
+	// Eight floats processed together: one AVX register, two
+	// SSE ones, or plain loops without either
+	// --------------------------------------------------------
+#if defined(BRDF_AVX)
+	struct Float8
+	{
+		__m256 v;
+	};
+
+	inline Float8 Load(const float* lanes) { return { _mm256_loadu_ps(lanes) }; }
+	inline Float8 Splat(float a) { return { _mm256_set1_ps(a) }; }
+	inline void Store(float* lanes, Float8 a) { _mm256_storeu_ps(lanes, a.v); }
+	inline Float8 operator+(Float8 a, Float8 b) { return { _mm256_add_ps(a.v, b.v) }; }
+	inline Float8 operator-(Float8 a, Float8 b) { return { _mm256_sub_ps(a.v, b.v) }; }
+	inline Float8 operator*(Float8 a, Float8 b) { return { _mm256_mul_ps(a.v, b.v) }; }
+	inline Float8 operator/(Float8 a, Float8 b) { return { _mm256_div_ps(a.v, b.v) }; }
+	inline Float8 Min(Float8 a, Float8 b) { return { _mm256_min_ps(a.v, b.v) }; }
+	inline Float8 Max(Float8 a, Float8 b) { return { _mm256_max_ps(a.v, b.v) }; }
+	inline Float8 Sqrt(Float8 a) { return { _mm256_sqrt_ps(a.v) }; }
+	inline Float8 IfPositive(Float8 test, Float8 a) { return { _mm256_and_ps(_mm256_cmp_ps(test.v, _mm256_setzero_ps(), _CMP_GT_OQ), a.v) }; }
+#elif defined(BRDF_SSE)
+	struct Float8
+	{
+		__m128 lo;
+		__m128 hi;
+	};
+
+	template<typename Op>
+	inline Float8 Halves(Float8 a, Float8 b, Op op) { return { op(a.lo, b.lo), op(a.hi, b.hi) }; }
+
+	inline Float8 Load(const float* lanes) { return { _mm_loadu_ps(lanes), _mm_loadu_ps(lanes + 4) }; }
+	inline Float8 Splat(float a) { return { _mm_set1_ps(a), _mm_set1_ps(a) }; }
+	inline void Store(float* lanes, Float8 a) { _mm_storeu_ps(lanes, a.lo); _mm_storeu_ps(lanes + 4, a.hi); }
+	inline Float8 operator+(Float8 a, Float8 b) { return Halves(a, b, [](__m128 x, __m128 y) { return _mm_add_ps(x, y); }); }
+	inline Float8 operator-(Float8 a, Float8 b) { return Halves(a, b, [](__m128 x, __m128 y) { return _mm_sub_ps(x, y); }); }
+	inline Float8 operator*(Float8 a, Float8 b) { return Halves(a, b, [](__m128 x, __m128 y) { return _mm_mul_ps(x, y); }); }
+	inline Float8 operator/(Float8 a, Float8 b) { return Halves(a, b, [](__m128 x, __m128 y) { return _mm_div_ps(x, y); }); }
+	inline Float8 Min(Float8 a, Float8 b) { return Halves(a, b, [](__m128 x, __m128 y) { return _mm_min_ps(x, y); }); }
+	inline Float8 Max(Float8 a, Float8 b) { return Halves(a, b, [](__m128 x, __m128 y) { return _mm_max_ps(x, y); }); }
+	inline Float8 Sqrt(Float8 a) { return { _mm_sqrt_ps(a.lo), _mm_sqrt_ps(a.hi) }; }
+	inline Float8 IfPositive(Float8 test, Float8 a)
+	{
+		return Halves(test, a, [](__m128 x, __m128 y) { return _mm_and_ps(_mm_cmpgt_ps(x, _mm_setzero_ps()), y); });
+	}
+#else
+	struct Float8
+	{
+		float v[8];
+	};
+
+	template<typename Op>
+	inline Float8 Map(Float8 a, Float8 b, Op op)
+	{
+		Float8 r;
+		for (int i = 0; i < 8; i++)
+			r.v[i] = op(a.v[i], b.v[i]);
+		return r;
+	}
+
+	inline Float8 Load(const float* lanes) { Float8 r; for (int i = 0; i < 8; i++) r.v[i] = lanes[i]; return r; }
+	inline Float8 Splat(float a) { Float8 r; for (int i = 0; i < 8; i++) r.v[i] = a; return r; }
+	inline void Store(float* lanes, Float8 a) { for (int i = 0; i < 8; i++) lanes[i] = a.v[i]; }
+	inline Float8 operator+(Float8 a, Float8 b) { return Map(a, b, [](float x, float y) { return x + y; }); }
+	inline Float8 operator-(Float8 a, Float8 b) { return Map(a, b, [](float x, float y) { return x - y; }); }
+	inline Float8 operator*(Float8 a, Float8 b) { return Map(a, b, [](float x, float y) { return x * y; }); }
+	inline Float8 operator/(Float8 a, Float8 b) { return Map(a, b, [](float x, float y) { return x / y; }); }
+	inline Float8 Min(Float8 a, Float8 b) { return Map(a, b, [](float x, float y) { return std::min(x, y); }); }
+	inline Float8 Max(Float8 a, Float8 b) { return Map(a, b, [](float x, float y) { return std::max(x, y); }); }
+	inline Float8 Sqrt(Float8 a) { Float8 r; for (int i = 0; i < 8; i++) r.v[i] = sqrtf(a.v[i]); return r; }
+	inline Float8 IfPositive(Float8 test, Float8 a) { return Map(test, a, [](float x, float y) { return x > 0.0f ? y : 0.0f; }); }
+#endif
+
+	inline Float8 Saturate(Float8 a) { return Min(Max(a, Splat(0.0f)), Splat(1.0f)); }
+
+	struct Vector8
+	{
+		Float8 x, y, z;
+	};
+
+	inline Vector8 Load(const Float3x8& lanes) { return { Load(lanes.X), Load(lanes.Y), Load(lanes.Z) }; }
+	inline Vector8 Splat(const XMFLOAT3& a) { return { Splat(a.x), Splat(a.y), Splat(a.z) }; }
+	inline void Store(Float3x8& lanes, const Vector8& a) { Store(lanes.X, a.x); Store(lanes.Y, a.y); Store(lanes.Z, a.z); }
+	inline Vector8 operator+(const Vector8& a, const Vector8& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	inline Vector8 operator-(const Vector8& a, const Vector8& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	inline Vector8 operator*(const Vector8& a, const Vector8& b) { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+	inline Vector8 operator*(const Vector8& a, Float8 b) { return { a.x * b, a.y * b, a.z * b }; }
+	inline Vector8 operator/(const Vector8& a, Float8 b) { return { a.x / b, a.y / b, a.z / b }; }
+	inline Float8 Dot(const Vector8& a, const Vector8& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline Float8 Length(const Vector8& a) { return Sqrt(Dot(a, a)); }
+	inline Vector8 Normalize(const Vector8& a) { return a / Length(a); }
+
+	// The rest of SurfaceBatch, loaded once per light
+	struct Surface
+	{
+		Vector8 Normal;
+		Vector8 WorldPosition;
+		Vector8 SurfaceColor;
+		Vector8 SpecularColor;
+		Float8 Roughness;
+		Float8 Metalness;
+	};
+
+	Surface Load(const SurfaceBatch& batch)
+	{
+		return { Load(batch.Normal), Load(batch.WorldPosition), Load(batch.SurfaceColor), Load(batch.SpecularColor),
+			Load(batch.Roughness), Load(batch.Metalness) };
+	}
+
+	// --------------------------------------------------------
+	// Lights.hlsli, function by function
+	// --------------------------------------------------------
+	Float8 Diffuse(const Vector8& normal, const Vector8& lightDirection)
+	{
+		return Saturate(Dot(normal, lightDirection));
+	}
+
+	Float8 Attenuate(const Light& light, const Vector8& worldPos)
+	{
+		Float8 dist = Length(Splat(light.Position) - worldPos);
+		Float8 att = Saturate(Splat(1.0f) - (dist * dist / Splat(light.Range * light.Range)));
+		return att * att;
+	}
+
+	Float8 GGX(const Vector8& n, const Vector8& h, Float8 roughness)
+	{
+		Float8 NdotH = Saturate(Dot(n, h));
+		Float8 NdotH2 = NdotH * NdotH;
+		Float8 a2 = roughness * roughness;
+
+		Float8 denom = NdotH2 * (a2 - Splat(1.0f)) + Splat(1.0f);
+
+		return a2 / (Splat(Pi) * (denom * denom));
+	}
+
+	Vector8 Schlick(const Vector8& v, const Vector8& h, const Vector8& f0)
+	{
+		Float8 VdotH = Saturate(Dot(v, h));
+		Float8 x = Splat(1.0f) - VdotH;
+		Float8 x5 = x * x * x * x * x;
+
+		Vector8 one = { Splat(1.0f), Splat(1.0f), Splat(1.0f) };
+		return f0 + (one - f0) * x5;
+	}
+
+	// The shader's form, already divided by n dot v; k is its
+	// remapped roughness
+	Float8 SchlickGGX(Float8 NdotV, Float8 k)
+	{
+		return Splat(1.0f) / (NdotV * (Splat(1.0f) - k) + k);
+	}
+
+	Float8 SchlickGGX(const Vector8& n, const Vector8& v, Float8 roughness)
+	{
+		Float8 r = roughness + Splat(1.0f);
+		Float8 k = r * r / Splat(8.0f);
+		return SchlickGGX(Saturate(Dot(n, v)), k);
+	}
+
+	Vector8 MicrofacetBRDF(const Vector8& n, const Vector8& l, const Vector8& v, Float8 roughness, const Vector8& f0, Vector8& F_out)
+	{
+		Vector8 h = Normalize(v + l);
+
+		Float8 D = GGX(n, h, roughness);
+		Vector8 F = Schlick(v, h, f0);
+		Float8 G = SchlickGGX(n, v, roughness) * SchlickGGX(n, l, roughness);
+
+		F_out = F;
+
+		Vector8 specularResult = (F * D * G) / Splat(4.0f);
+
+		return specularResult * Max(Dot(n, l), Splat(0.0f));
+	}
+
+	// What every light type shares: balanceDiff * surfaceColor + specular
+	Vector8 Reflect(const Surface& surface, const Vector8& lightDirection, const Vector8& camDirection)
+	{
+		Vector8 F;
+
+		Float8 diffusion = Diffuse(surface.Normal, lightDirection);
+		Vector8 specular = MicrofacetBRDF(surface.Normal, lightDirection, camDirection, surface.Roughness, surface.SpecularColor, F);
+
+		// DiffuseEnergyConserve()
+		Vector8 one = { Splat(1.0f), Splat(1.0f), Splat(1.0f) };
+		Vector8 balanceDiff = (one - F) * diffusion * (Splat(1.0f) - surface.Metalness);
+
+		return balanceDiff * surface.SurfaceColor + specular;
+	}
+
+	Vector8 CamDirection(const Surface& surface, const XMFLOAT3& camPos)
+	{
+		return Normalize(Splat(camPos) - surface.WorldPosition);
+	}
+
+	// Van der Corput sequence, for Hammersley points
+	float RadicalInverse(uint32_t bits)
+	{
+		bits = (bits << 16) | (bits >> 16);
+		bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+		bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+		bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+		bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+		return bits * 2.3283064365386963e-10f;
+	}
+
+	uint16_t ToUnorm16(float value)
+	{
+		return (uint16_t)(std::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+	}
+}
+
+void Brdf::MicrofacetBRDF(const Float3x8& n, const Float3x8& l, const Float3x8& v, const float roughness[Lanes], const Float3x8& f0,
+	Float3x8& specular, Float3x8& fresnel)
+{
+	Vector8 F;
+	Store(specular, ::MicrofacetBRDF(Load(n), Load(l), Load(v), Load(roughness), Load(f0), F));
+	Store(fresnel, F);
+}
+
+void Brdf::DirectionalLight(const Light& light, const SurfaceBatch& surfaces, const XMFLOAT3& camPos, Float3x8& out)
+{
+	Surface surface = Load(surfaces);
+	Vector8 lightDirection = Normalize(Splat(XMFLOAT3(-light.Direction.x, -light.Direction.y, -light.Direction.z)));
+
+	Vector8 result = Reflect(surface, lightDirection, CamDirection(surface, camPos)) * Splat(light.Intensity) * Splat(light.Color);
+	Store(out, result);
+}
+
+void Brdf::PointLight(const Light& light, const SurfaceBatch& surfaces, const XMFLOAT3& camPos, Float3x8& out)
+{
+	Surface surface = Load(surfaces);
+	Vector8 lightDirection = Normalize(Splat(light.Position) - surface.WorldPosition);
+	Float8 attenuate = Attenuate(light, surface.WorldPosition);
+
+	Vector8 result = Reflect(surface, lightDirection, CamDirection(surface, camPos)) * attenuate * Splat(light.Intensity) * Splat(light.Color);
+	Store(out, result);
+}
+
+void Brdf::SpotLight(const Light& light, const SurfaceBatch& surfaces, const XMFLOAT3& camPos, Float3x8& out)
+{
+	Surface surface = Load(surfaces);
+	Vector8 lightDirection = Normalize(Splat(light.Position) - surface.WorldPosition);
+
+	Vector8 spotDirection = Normalize(Splat(light.Direction));
+	Float8 angle = Splat(0.0f) - Dot(lightDirection, spotDirection);
+
+	float outer = cosf(light.SpotOuterAngle);
+	float inner = cosf(light.SpotInnerAngle);
+	Float8 spotTerm = Saturate((angle - Splat(outer)) / Splat(inner - outer));
+
+	Float8 attenuation = Attenuate(light, surface.WorldPosition);
+
+	Vector8 result = Reflect(surface, lightDirection, CamDirection(surface, camPos)) * attenuation * spotTerm * Splat(light.Intensity) * Splat(light.Color);
+	Store(out, result);
+}
+
+void Brdf::ShadeLight(const Light& light, const SurfaceBatch& surfaces, const XMFLOAT3& camPos, Float3x8& out)
+{
+	switch (light.Type)
+	{
+	case LIGHT_TYPE_DIRECTIONAL: DirectionalLight(light, surfaces, camPos, out); break;
+	case LIGHT_TYPE_POINT: PointLight(light, surfaces, camPos, out); break;
+	case LIGHT_TYPE_SPOT: SpotLight(light, surfaces, camPos, out); break;
+	default: out = {}; break;
+	}
+}
+
+// --------------------------------------------------------
+// Karis' split sum ("Real Shading in Unreal Engine 4"), with
+// V in the xz plane and N = +Z
+// - GGX samples H with pdf D * (n dot h); the estimator then
+//    reduces to G * (v dot h) / ((n dot h) * (n dot v)), and
+//    the shader's SchlickGGX has that n dot v divided out
+// - Every lane shares the same Hammersley points, but each
+//    turns them into its own H, as roughness differs
+// --------------------------------------------------------
+void Brdf::IntegrateEnvironmentBRDF(const float roughness[Lanes], const float NdotV[Lanes], unsigned int sampleCount,
+	float scale[Lanes], float bias[Lanes])
+{
+	Float8 NoV = Load(NdotV);
+	Float8 Vx = Sqrt(Max(Splat(1.0f) - NoV * NoV, Splat(0.0f)));
+	Float8 Vz = NoV;
+
+	Float8 alpha = Load(roughness);
+	Float8 alphaSquared = alpha * alpha;
+	Float8 k = alpha * Splat(0.5f);
+	Float8 viewTerm = SchlickGGX(NoV, k);
+
+	Float8 A = Splat(0.0f);
+	Float8 B = Splat(0.0f);
+	for (unsigned int i = 0; i < sampleCount; i++)
+	{
+		float phi = 2.0f * Pi * i / sampleCount;
+		Float8 u = Splat(RadicalInverse(i));
+
+		Float8 cosTheta = Sqrt((Splat(1.0f) - u) / (Splat(1.0f) + (alphaSquared - Splat(1.0f)) * u));
+		Float8 sinTheta = Sqrt(Max(Splat(1.0f) - cosTheta * cosTheta, Splat(0.0f)));
+		Float8 Hx = sinTheta * Splat(cosf(phi));
+		Float8 Hz = cosTheta;
+
+		// L = reflect(-V, H); only its z (n dot l) matters
+		Float8 VoH = Vx * Hx + Vz * Hz;
+		Float8 NoL = Splat(2.0f) * VoH * Hz - Vz;
+
+		Float8 lightTerm = SchlickGGX(Saturate(NoL), k);
+		Float8 visibility = IfPositive(NoL, viewTerm * lightTerm * NoL * Saturate(VoH) / Hz);
+
+		Float8 x = Splat(1.0f) - Saturate(VoH);
+		Float8 Fc = x * x * x * x * x;
+		A = A + (Splat(1.0f) - Fc) * visibility;
+		B = B + Fc * visibility;
+	}
+
+	Store(scale, A / Splat((float)sampleCount));
+	Store(bias, B / Splat((float)sampleCount));
+}
+
+// --------------------------------------------------------
+// One row (one roughness) per job, 8 texels at a time
+// - Roughness and n dot v never reach 0 at texel centers,
+//    where the integral is degenerate
+// --------------------------------------------------------
+Image Brdf::IntegrateEnvironmentLut(unsigned int size, unsigned int sampleCount)
+{
+	Image lut;
+	lut.Width = size;
+	lut.Height = size;
+	lut.Format = ImageFormat::RG16;
+	lut.Pixels.resize(lut.GetSize());
+
+	ThreadPool::Get().ParallelFor(size, [&](size_t y)
+	{
+		uint16_t* row = (uint16_t*)&lut.Pixels[y * lut.GetRowPitch()];
+		float roughness[Lanes];
+		std::fill(roughness, roughness + Lanes, (y + 0.5f) / size);
+
+		for (unsigned int x = 0; x < size; x += Lanes)
+		{
+			// Lanes past the edge repeat the last texel
+			float NdotV[Lanes];
+			for (unsigned int i = 0; i < Lanes; i++)
+				NdotV[i] = (std::min(x + i, size - 1) + 0.5f) / size;
+
+			float scale[Lanes];
+			float bias[Lanes];
+			IntegrateEnvironmentBRDF(roughness, NdotV, sampleCount, scale, bias);
+
+			for (unsigned int i = 0; i < Lanes && x + i < size; i++)
+			{
+				row[(x + i) * 2] = ToUnorm16(scale[i]);
+				row[(x + i) * 2 + 1] = ToUnorm16(bias[i]);
+			}
+		}
+	});
+	return lut;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <DirectXMath.h>
+#include "Image.h"
+#include "Lights.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Eight 3-vectors, one per lane (structure of arrays)
+// --------------------------------------------------------
+struct Float3x8
+{
+	float X[8];
+	float Y[8];
+	float Z[8];
+};
+
+// --------------------------------------------------------
+// What the pixel shader hands the lighting functions, for
+// eight pixels at once
+// --------------------------------------------------------
+struct SurfaceBatch
+{
+	Float3x8 Normal;			// Unit length
+	Float3x8 WorldPosition;
+	Float3x8 SurfaceColor;		// Linear (already raised to 2.2)
+	Float3x8 SpecularColor;		// f0
+	float Roughness[8];
+	float Metalness[8];
+};
+
+// --------------------------------------------------------
+// A C++ port of the lighting in Lights.hlsli, 8 lanes wide
+// (AVX when it's enabled, two SSE halves otherwise)
+//
+// - Same math, same order, same quirks as the shader (its
+//    SchlickGGX is already divided by n dot v, so the BRDF's
+//    denominator is just 4), so results match it to float
+//    precision and can stand in for it: in offline
+//    precompute, or as the reference shading checks compare
+//    against
+// - Lanes are independent; fill unused ones with any valid
+//    surface
+// - Also integrates the split sum BRDF lookup table that the
+//    pixel shader's ambient specular reads (see AssetCooker)
+// --------------------------------------------------------
+namespace Brdf
+{
+	const unsigned int Lanes = 8;
+
+	// Bump whenever the lookup table changes
+	const uint32_t LutVersion = 1;
+
+	const unsigned int LutSize = 64;
+
+	// Enough for every texel to be within one 8-bit step of the
+	// exact integral (see Benchmarks::Brdf())
+	const unsigned int LutSampleCount = 4096;
+
+	// Cook-Torrance specular (GGX, Schlick, Schlick-GGX) toward
+	// l, already times n dot l, and the Fresnel term it used
+	// - n, l and v unit length; roughness is GGX alpha
+	void MicrofacetBRDF(const Float3x8& n, const Float3x8& l, const Float3x8& v, const float roughness[Lanes], const Float3x8& f0,
+		Float3x8& specular, Float3x8& fresnel);
+
+	// Light reflected toward camPos by each surface (no shadows)
+	void DirectionalLight(const Light& light, const SurfaceBatch& surfaces, const XMFLOAT3& camPos, Float3x8& out);
+	void PointLight(const Light& light, const SurfaceBatch& surfaces, const XMFLOAT3& camPos, Float3x8& out);
+	void SpotLight(const Light& light, const SurfaceBatch& surfaces, const XMFLOAT3& camPos, Float3x8& out);
+
+	// Whichever of the above light.Type picks, like the pixel
+	// shader's switch; black for unknown types
+	void ShadeLight(const Light& light, const SurfaceBatch& surfaces, const XMFLOAT3& camPos, Float3x8& out);
+
+	// --------------------------------------------------------
+	// The split sum scale and bias for f0 at each lane's
+	// roughness and n dot v: the GGX lobe integrated over
+	// light directions with sampleCount importance samples
+	// - Uses the shader's GGX and SchlickGGX, with k remapped to
+	//    roughness / 2 as image based lighting needs (Karis)
+	// --------------------------------------------------------
+	void IntegrateEnvironmentBRDF(const float roughness[Lanes], const float NdotV[Lanes], unsigned int sampleCount,
+		float scale[Lanes], float bias[Lanes]);
+
+	// The whole lookup table on the thread pool: RG16, n dot v
+	// across (u) and roughness down (v), texel centers sampled
+	Image IntegrateEnvironmentLut(unsigned int size = LutSize, unsigned int sampleCount = LutSampleCount);
+}
@@ -16,6 +16,11 @@ struct VertexBufferData
 	XMFLOAT4X4 worldInvTranspose;
 	XMFLOAT4X4 lightView;
 	XMFLOAT4X4 lightProjection;
+
+	XMFLOAT3 positionCenter;   // Mesh quantization (see VertexPacking)
+	float padding0;
+	XMFLOAT3 positionExtent;
+	float padding1;
 };
 
 struct PixelBufferData 
@@ -32,4 +37,10 @@ struct PixelBufferData
 	float time;
 
 	Light lights[5];
+
+	XMFLOAT4 irradiance[9];    // Probes/sky SH irradiance, RGB (see SphericalHarmonics)
+
+	float specularMipCount;    // Of the sky's prefiltered cube map (0 = not ready)
+	float roughnessOnlyMasks;  // 1 when the mask map is one channel, roughness alone (see TextureCooker)
+	XMFLOAT2 padding0;
 };
\ No newline at end of file
@@ -0,0 +1,33 @@
+#include <cstdio>
+#include <filesystem>
+#include "AssetCooker.h"
+
+// --------------------------------------------------------
+// Entry point of the offline asset cooker (a console app)
+//
+// - Usage: AssetCooker <source folder> <output folder>
+// - Run after every build of the game (see its post-build
+//    step); with nothing changed it only stats the sources
+// - Returns non-zero if anything failed, which fails the build
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	if (argc != 3)
+	{
+		printf("Usage: AssetCooker <source folder> <output folder>\n");
+		return 2;
+	}
+
+	std::wstring sourceFolder = std::filesystem::path(argv[1]).wstring();
+	std::wstring outputFolder = std::filesystem::path(argv[2]).wstring();
+
+	CookStats stats;
+	bool succeeded = AssetCooker::Cook(sourceFolder, outputFolder, stats);
+
+	printf("AssetCooker: %u jobs, %u cooked, %u up to date, %u failed; %u inputs hashed, %u stale outputs removed, pack %s (%.1f ms)\n",
+		stats.JobCount, stats.CookedCount, stats.UpToDateCount, stats.FailedCount,
+		stats.HashedCount, stats.RemovedCount,
+		stats.PackRebuilt ? "rebuilt" : "up to date",
+		stats.Milliseconds);
+	return succeeded ? 0 : 1;
+}
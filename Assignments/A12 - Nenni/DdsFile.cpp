@@ -0,0 +1,252 @@
+#include "DdsFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+	// DDS_HEADER flags and caps
+	const uint32_t HeaderCaps = 0x1;
+	const uint32_t HeaderHeight = 0x2;
+	const uint32_t HeaderWidth = 0x4;
+	const uint32_t HeaderPixelFormat = 0x1000;
+	const uint32_t HeaderMipCount = 0x20000;
+	const uint32_t HeaderLinearSize = 0x80000;
+	const uint32_t CapsComplex = 0x8;
+	const uint32_t CapsTexture = 0x1000;
+	const uint32_t CapsMipmap = 0x400000;
+	const uint32_t Caps2Cubemap = 0x200;
+	const uint32_t Caps2Volume = 0x200000;
+
+	// DDS_PIXELFORMAT flags
+	const uint32_t PixelAlpha = 0x1;
+	const uint32_t PixelFourCC = 0x4;
+	const uint32_t PixelRgb = 0x40;
+	const uint32_t PixelLuminance = 0x20000;
+
+	const uint32_t DimensionTexture2D = 3;
+	const uint32_t MiscTextureCube = 0x4;
+
+	constexpr uint32_t FourCC(char a, char b, char c, char d)
+	{
+		return (uint32_t)(uint8_t)a | ((uint32_t)(uint8_t)b << 8) | ((uint32_t)(uint8_t)c << 16) | ((uint32_t)(uint8_t)d << 24);
+	}
+
+	struct PixelFormat
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t FourCC;
+		uint32_t BitCount;
+		uint32_t RedMask;
+		uint32_t GreenMask;
+		uint32_t BlueMask;
+		uint32_t AlphaMask;
+	};
+
+	struct Header
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t Height;
+		uint32_t Width;
+		uint32_t PitchOrLinearSize;
+		uint32_t Depth;
+		uint32_t MipCount;
+		uint32_t Reserved[11];
+		PixelFormat Format;
+		uint32_t Caps;
+		uint32_t Caps2;
+		uint32_t Caps3;
+		uint32_t Caps4;
+		uint32_t Reserved2;
+	};
+
+	struct HeaderDx10
+	{
+		uint32_t DxgiFormat;
+		uint32_t Dimension;
+		uint32_t MiscFlags;
+		uint32_t ArraySize;
+		uint32_t MiscFlags2;
+	};
+
+	static_assert(sizeof(Header) == 124, "DDS_HEADER is 124 bytes");
+	static_assert(sizeof(HeaderDx10) == 20, "DDS_HEADER_DXT10 is 20 bytes");
+
+	const ImageFormat AllFormats[] = { ImageFormat::R8, ImageFormat::RGBA8, ImageFormat::RG16, ImageFormat::BC1, ImageFormat::BC4, ImageFormat::BC5, ImageFormat::BC7 };
+
+	// The format of a pixel format that isn't DX10, if it's one
+	// of the few Image can hold
+	bool FromLegacy(const PixelFormat& format, ImageFormat& out)
+	{
+		if (format.Flags & PixelFourCC)
+		{
+			switch (format.FourCC)
+			{
+			case FourCC('D', 'X', 'T', '1'): out = ImageFormat::BC1; return true;
+			case FourCC('A', 'T', 'I', '1'): case FourCC('B', 'C', '4', 'U'): out = ImageFormat::BC4; return true;
+			case FourCC('A', 'T', 'I', '2'): case FourCC('B', 'C', '5', 'U'): out = ImageFormat::BC5; return true;
+			default: return false;
+			}
+		}
+
+		if ((format.Flags & PixelRgb) && format.BitCount == 32 && format.RedMask == 0xFF && format.GreenMask == 0xFF00 &&
+			format.BlueMask == 0xFF0000 && ((format.Flags & PixelAlpha) == 0 || format.AlphaMask == 0xFF000000))
+		{
+			out = ImageFormat::RGBA8;
+			return true;
+		}
+		if ((format.Flags & PixelLuminance) && format.BitCount == 8 && format.RedMask == 0xFF)
+		{
+			out = ImageFormat::R8;
+			return true;
+		}
+		return false;
+	}
+}
+
+uint32_t DdsFile::GetDxgiFormat(ImageFormat format)
+{
+	switch (format)
+	{
+	case ImageFormat::R8: return 61;	// DXGI_FORMAT_R8_UNORM
+	case ImageFormat::RG16: return 35;	// DXGI_FORMAT_R16G16_UNORM
+	case ImageFormat::BC1: return 71;	// DXGI_FORMAT_BC1_UNORM
+	case ImageFormat::BC4: return 80;	// DXGI_FORMAT_BC4_UNORM
+	case ImageFormat::BC5: return 83;	// DXGI_FORMAT_BC5_UNORM
+	case ImageFormat::BC7: return 98;	// DXGI_FORMAT_BC7_UNORM
+	default: return 28;					// DXGI_FORMAT_R8G8B8A8_UNORM
+	}
+}
+
+bool DdsFile::IsDds(const void* data, size_t size)
+{
+	uint32_t magic = 0;
+	if (size < sizeof(magic))
+		return false;
+	memcpy(&magic, data, sizeof(magic));
+	return magic == Magic;
+}
+
+bool DdsFile::Parse(const void* data, size_t size, std::vector<Image>& mips)
+{
+	mips.clear();
+
+	const uint8_t* bytes = (const uint8_t*)data;
+	Header header;
+	if (!IsDds(data, size) || size < sizeof(Magic) + sizeof(Header))
+		return false;
+	memcpy(&header, bytes + sizeof(Magic), sizeof(Header));
+	size_t offset = sizeof(Magic) + sizeof(Header);
+
+	if (header.Size != sizeof(Header) || header.Format.Size != sizeof(PixelFormat) ||
+		(header.Caps2 & (Caps2Cubemap | Caps2Volume)) || header.Width == 0 || header.Height == 0)
+		return false;
+
+	ImageFormat format = ImageFormat::RGBA8;
+	if ((header.Format.Flags & PixelFourCC) && header.Format.FourCC == FourCC('D', 'X', '1', '0'))
+	{
+		HeaderDx10 extended;
+		if (size < offset + sizeof(HeaderDx10))
+			return false;
+		memcpy(&extended, bytes + offset, sizeof(HeaderDx10));
+		offset += sizeof(HeaderDx10);
+
+		if (extended.Dimension != DimensionTexture2D || extended.ArraySize != 1 || (extended.MiscFlags & MiscTextureCube))
+			return false;
+
+		const ImageFormat* found = std::find_if(std::begin(AllFormats), std::end(AllFormats),
+			[&](ImageFormat candidate) { return GetDxgiFormat(candidate) == extended.DxgiFormat; });
+		if (found == std::end(AllFormats))
+			return false;
+		format = *found;
+	}
+	else if (!FromLegacy(header.Format, format))
+	{
+		return false;
+	}
+
+	// A full chain has one more mip than the bits of the larger side
+	uint32_t largest = std::max(header.Width, header.Height);
+	uint32_t fullChain = 1;
+	while (largest >>= 1)
+		fullChain++;
+	uint32_t mipCount = (header.Flags & HeaderMipCount) ? std::clamp(header.MipCount, 1u, fullChain) : 1;
+
+	mips.resize(mipCount);
+	for (uint32_t i = 0; i < mipCount; i++)
+	{
+		Image& mip = mips[i];
+		mip.Width = std::max(header.Width >> i, 1u);
+		mip.Height = std::max(header.Height >> i, 1u);
+		mip.Format = format;
+
+		size_t mipSize = mip.GetSize();
+		if (size - offset < mipSize)
+		{
+			mips.clear();
+			return false;
+		}
+		mip.Pixels.assign(bytes + offset, bytes + offset + mipSize);
+		offset += mipSize;
+	}
+	return true;
+}
+
+bool DdsFile::Save(const std::wstring& path, const std::vector<Image>& mips)
+{
+	if (mips.empty())
+		return false;
+	for (size_t i = 0; i < mips.size(); i++)
+	{
+		if (mips[i].Format != mips[0].Format || mips[i].Pixels.size() != mips[i].GetSize() ||
+			mips[i].Width != std::max(mips[0].Width >> i, 1u) || mips[i].Height != std::max(mips[0].Height >> i, 1u))
+			return false;
+	}
+
+	Header header = {};
+	header.Size = sizeof(Header);
+	header.Flags = HeaderCaps | HeaderHeight | HeaderWidth | HeaderPixelFormat | HeaderMipCount | HeaderLinearSize;
+	header.Height = mips[0].Height;
+	header.Width = mips[0].Width;
+	header.PitchOrLinearSize = (uint32_t)mips[0].GetSize();
+	header.MipCount = (uint32_t)mips.size();
+	header.Format.Size = sizeof(PixelFormat);
+	header.Format.Flags = PixelFourCC;
+	header.Format.FourCC = FourCC('D', 'X', '1', '0');
+	header.Caps = CapsTexture | (mips.size() > 1 ? CapsComplex | CapsMipmap : 0);
+
+	HeaderDx10 extended = {};
+	extended.DxgiFormat = GetDxgiFormat(mips[0].Format);
+	extended.Dimension = DimensionTexture2D;
+	extended.ArraySize = 1;
+
+	std::filesystem::path tempPath(path);
+	tempPath += L".tmp";
+
+	{
+		std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		file.write((const char*)&Magic, sizeof(Magic));
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)&extended, sizeof(extended));
+		for (const Image& mip : mips)
+			file.write((const char*)mip.Pixels.data(), mip.Pixels.size());
+		if (!file)
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Image.h"
+
+// --------------------------------------------------------
+// .DDS texture files: a 2D image and its mips, stored as the
+// GPU uses them, so loading one is a copy instead of a decode
+//
+// - Save() always writes the DX10 extended header (with the
+//    DXGI format); Parse() also reads the older DXT1, ATI1/BC4U
+//    and ATI2/BC5U codes and plain 32-bit RGBA
+// - Only formats Image can hold are read: no cube maps,
+//    arrays, volumes or other DXGI formats
+// --------------------------------------------------------
+namespace DdsFile
+{
+	const uint32_t Magic = 0x20534444; // "DDS "
+
+	// DXGI_FORMAT value of a format
+	uint32_t GetDxgiFormat(ImageFormat format);
+
+	// Whether data starts with the .DDS magic
+	bool IsDds(const void* data, size_t size);
+
+	// Every mip in the file, copied out of data; false if it
+	// isn't a .DDS this can read or is cut short
+	bool Parse(const void* data, size_t size, std::vector<Image>& mips);
+
+	// mips[0] is the full size image, and each one after it half
+	// the size of the one before, all in the same format
+	// - Written to a temp file that then replaces path
+	bool Save(const std::wstring& path, const std::vector<Image>& mips);
+}
@@ -1,9 +1,34 @@
 #include "Entity.h"
+#include "Window.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Coarsest LOD whose error covers at most this many pixels on screen
+	const float MaxPixelError = 1.0f;
+
+	// A coarser LOD must beat the limit by this factor before it is
+	// used, so an entity near a boundary doesn't flicker between LODs
+	const float LodHysteresis = 0.75f;
+}
 
 Entity::Entity(shared_ptr<Mesh> inMesh, shared_ptr<Material> inMaterial) {
 	mesh = inMesh;
 	transform = make_shared<Transformation>();
 	material = inMaterial;
+	submeshMaterials.resize(inMesh->GetSubmeshCount());
+	visibleRanges.resize(inMesh->GetSubmeshCount());
+	isStatic = false;
+	currentLod = 0;
+	visibleIndexCount = 0;
+}
+
+Entity::Entity(shared_ptr<MeshAsset> inMeshAsset, shared_ptr<Material> inMaterial)
+	: Entity(inMeshAsset->Get(), inMaterial)
+{
+	meshAsset = inMeshAsset;
 }
 
 shared_ptr<Mesh> Entity::GetMesh()
@@ -26,10 +51,187 @@ void Entity::SetMaterial(shared_ptr<Material> newMaterial)
 	material = newMaterial;
 }
 
-void Entity::Draw()
+bool Entity::IsStatic()
+{
+	return isStatic;
+}
+
+void Entity::SetStatic(bool newStatic)
+{
+	isStatic = newStatic;
+}
+
+bool Entity::UpdateMesh()
+{
+	if (!meshAsset || meshAsset->Get() == mesh)
+		return false;
+
+	mesh = meshAsset->Get();
+	submeshMaterials.assign(mesh->GetSubmeshCount(), nullptr);
+	visibleRanges.assign(mesh->GetSubmeshCount(), {});
+	currentLod = 0;
+	visibleIndexCount = 0;
+	return true;
+}
+
+shared_ptr<Material> Entity::GetSubmeshMaterial(unsigned int submesh)
+{
+	return submeshMaterials[submesh] ? submeshMaterials[submesh] : material;
+}
+
+void Entity::SetSubmeshMaterial(unsigned int submesh, shared_ptr<Material> newMaterial)
+{
+	submeshMaterials[submesh] = newMaterial;
+}
+
+unsigned int Entity::GetLod()
+{
+	return currentLod;
+}
+
+// --------------------------------------------------------
+// Picks the level of detail to draw from the camera
+//
+// - Projects each LOD's error (scaled by the entity) at the
+//    nearest point of its bounding sphere into pixels
+// - Goes finer as soon as the current LOD is over the limit,
+//    but only goes coarser once the next LOD is well under it
+// --------------------------------------------------------
+unsigned int Entity::SelectLod(shared_ptr<Camera> camera)
 {
-	Graphics::Context->VSSetShader(material->GetVertexShader().Get(), 0, 0);
-	Graphics::Context->PSSetShader(material->GetPixelShader().Get(), 0, 0);
+	unsigned int lodCount = mesh->GetLodCount();
+	currentLod = std::min(currentLod, lodCount - 1);
+	if (lodCount == 1)
+		return currentLod;
+
+	XMFLOAT3 boundsMin = mesh->GetBoundsMin();
+	XMFLOAT3 boundsMax = mesh->GetBoundsMax();
+	XMFLOAT3& scale = transform->GetScale();
+	float maxScale = std::max({ fabsf(scale.x), fabsf(scale.y), fabsf(scale.z) });
+
+	// Bounding sphere in world space
+	XMFLOAT4X4 worldMatrix = transform->GetWorldMatrix();
+	XMVECTOR localCenter = XMVectorScale(XMVectorAdd(XMLoadFloat3(&boundsMin), XMLoadFloat3(&boundsMax)), 0.5f);
+	XMVECTOR center = XMVector3Transform(localCenter, XMLoadFloat4x4(&worldMatrix));
+	float radius = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&boundsMax), XMLoadFloat3(&boundsMin)))) * 0.5f * maxScale;
+
+	XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+	float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&cameraPosition), center))) - radius;
+
+	// Inside the sphere everything is as close as it can get
+	if (distance <= 0.001f)
+	{
+		currentLod = 0;
+		return currentLod;
+	}
+
+	// _22 of the projection is cot(fov / 2), so this is how many
+	// pixels one world unit covers at that distance
+	float pixelsPerUnit = camera->GetProjectionMatrix()._22 * Window::Height() * 0.5f / distance;
+	auto pixelError = [&](unsigned int lod) { return mesh->GetLod(lod).Error * maxScale * pixelsPerUnit; };
+
+	while (currentLod > 0 && pixelError(currentLod) > MaxPixelError)
+		currentLod--;
+	while (currentLod + 1 < lodCount && pixelError(currentLod + 1) <= MaxPixelError * LodHysteresis)
+		currentLod++;
+
+	return currentLod;
+}
+
+// --------------------------------------------------------
+// Finds the meshlets of the current LOD the camera can see,
+// one submesh at a time (so ranges never mix materials)
+//
+// - Runs in the mesh's local space: the frustum comes from
+//    world * view * projection and the camera is moved by the
+//    inverse world matrix, so meshlet bounds are used as is
+// - Mirrored transforms flip which side of a triangle is the
+//    front, so those skip the back-facing cone test
+// --------------------------------------------------------
+void Entity::CullMeshlets(shared_ptr<Camera> camera, bool enabled)
+{
+	unsigned int submeshCount = (unsigned int)visibleRanges.size();
+	if (!enabled || mesh->GetMeshletCount() == 0)
+	{
+		visibleIndexCount = 0;
+		for (unsigned int s = 0; s < submeshCount; s++)
+		{
+			IndexRange range = mesh->GetSubmeshRange(currentLod, s);
+			visibleRanges[s].assign(range.Count > 0 ? 1 : 0, range);
+			visibleIndexCount += range.Count;
+		}
+		return;
+	}
+
+	XMFLOAT4X4 worldMatrix = transform->GetWorldMatrix();
+	XMFLOAT4X4 viewMatrix = camera->GetViewMatrix();
+	XMFLOAT4X4 projectionMatrix = camera->GetProjectionMatrix();
+	XMMATRIX world = XMLoadFloat4x4(&worldMatrix);
+
+	XMFLOAT4X4 localToClip;
+	XMStoreFloat4x4(&localToClip, world * XMLoadFloat4x4(&viewMatrix) * XMLoadFloat4x4(&projectionMatrix));
+
+	XMVECTOR determinant;
+	XMMATRIX worldInverse = XMMatrixInverse(&determinant, world);
+	XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+	XMFLOAT3 localCamera;
+	XMStoreFloat3(&localCamera, XMVector3Transform(XMLoadFloat3(&cameraPosition), worldInverse));
+
+	MeshletFrustum frustum = Meshlets::MakeFrustum(localToClip, localCamera, XMVectorGetX(determinant) > 0);
+	visibleIndexCount = 0;
+	for (unsigned int s = 0; s < submeshCount; s++)
+	{
+		unsigned int meshletCount = 0;
+		const Meshlet* meshlets = mesh->GetSubmeshMeshlets(currentLod, s, meshletCount);
+		visibleIndexCount += Meshlets::Cull(meshlets, meshletCount, frustum, visibleRanges[s]);
+	}
+}
+
+unsigned int Entity::GetVisibleTriangleCount()
+{
+	return visibleIndexCount / 3;
+}
+
+unsigned int Entity::GetDrawRangeCount()
+{
+	size_t count = 0;
+	for (const vector<IndexRange>& ranges : visibleRanges)
+		count += ranges.size();
+	return (unsigned int)count;
+}
+
+// --------------------------------------------------------
+// Draws every submesh with its material
+//
+// - The mesh's buffers are bound once, then each submesh is
+//    drawn as its visible ranges of them
+// - bindMaterial sets up what a material needs besides its
+//    shaders (textures, constant buffers); it only runs when
+//    the material changes from one submesh to the next
+// --------------------------------------------------------
+void Entity::Draw(const function<void(shared_ptr<Material>)>& bindMaterial)
+{
+	// Keeps the mesh from being evicted (see AssetManager)
+	if (meshAsset)
+		meshAsset->Use();
+
+	mesh->BindBuffers();
+
+	shared_ptr<Material> bound;
+	for (unsigned int s = 0; s < visibleRanges.size(); s++)
+	{
+		if (visibleRanges[s].empty())
+			continue;
+
+		shared_ptr<Material> submeshMaterial = GetSubmeshMaterial(s);
+		if (submeshMaterial != bound)
+		{
+			Graphics::Context->VSSetShader(submeshMaterial->GetVertexShader().Get(), 0, 0);
+			Graphics::Context->PSSetShader(submeshMaterial->GetPixelShader().Get(), 0, 0);
+			bindMaterial(submeshMaterial);
+			bound = submeshMaterial;
+		}
 
-	mesh->Draw();
+		mesh->DrawRanges(visibleRanges[s]);
+	}
 }
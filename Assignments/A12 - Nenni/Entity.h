@@ -1,9 +1,12 @@
 #pragma once
 
+#include <functional>
 #include <memory>
+#include "Asset.h"
 #include "Mesh.h"
 #include "Transformation.h"
 #include "Material.h"
+#include "Camera.h"
 
 using namespace std;
 
@@ -12,17 +15,52 @@ class Entity
 public:
 	Entity(shared_ptr<Mesh> inMesh, shared_ptr<Material> inMaterial);
 
+	// Draws the asset's placeholder until UpdateMesh() picks up
+	// the loaded mesh
+	Entity(shared_ptr<MeshAsset> inMeshAsset, shared_ptr<Material> inMaterial);
+
 	shared_ptr<Mesh> GetMesh();
 	shared_ptr<Transformation> GetTransform();
 	shared_ptr<Material> GetMaterial();
 
 	void SetMaterial(shared_ptr<Material> newMaterial);
 
-	void Draw();
+	// Static entities never move (see SceneFile::EntityStatic),
+	// so baked lighting can count on them
+	bool IsStatic();
+	void SetStatic(bool newStatic);
+
+	// Switches to the mesh asset's current mesh; true if it
+	// changed, which resets the submesh materials
+	bool UpdateMesh();
+
+	// Submeshes use the entity's material unless given their own
+	shared_ptr<Material> GetSubmeshMaterial(unsigned int submesh);
+	void SetSubmeshMaterial(unsigned int submesh, shared_ptr<Material> newMaterial);
+
+	unsigned int GetLod();
+	unsigned int SelectLod(shared_ptr<Camera> camera);
+
+	void CullMeshlets(shared_ptr<Camera> camera, bool enabled);
+	unsigned int GetVisibleTriangleCount();
+	unsigned int GetDrawRangeCount();
+
+	void Draw(const function<void(shared_ptr<Material>)>& bindMaterial);
 
 private:
 	shared_ptr<Mesh> mesh;
+	shared_ptr<MeshAsset> meshAsset;
 	shared_ptr<Transformation> transform;
 	shared_ptr<Material> material;
+	vector<shared_ptr<Material>> submeshMaterials;
+	bool isStatic;
+
+	// Level of detail drawn (see SelectLod)
+	unsigned int currentLod;
+
+	// Index ranges of the current LOD that survived culling,
+	// for each submesh
+	vector<vector<IndexRange>> visibleRanges;
+	unsigned int visibleIndexCount;
 };
 
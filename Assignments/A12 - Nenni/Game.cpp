@@ -3,7 +3,10 @@
 #include "Vertex.h"
 #include "Input.h"
 #include "PathHelpers.h"
+#include "SceneFile.h"
+#include "TextureCooker.h"
 #include "Window.h"
+#include "Vfs.h"
 
 // This code assumes files are in "ImGui" subfolder!
 // Adjust as necessary for your own folder structure and project setup
@@ -11,13 +14,14 @@
 #include "ImGui/imgui_impl_dx11.h"
 #include "ImGui/imgui_impl_win32.h"
 
-// Needed to load textures
-#include "WICTextureLoader.h"
-
 // Needed for a helper function to load pre-compiled shader files
 #pragma comment(lib, "d3dcompiler.lib")
 #include <d3dcompiler.h>
 
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
 // For the DirectX Math library
 using namespace DirectX;
 using namespace std;
@@ -51,23 +55,25 @@ Game::Game()
 
 	D3D11_INPUT_ELEMENT_DESC inputElements[4] = {};
 
-	// Set up the first element - a position, which is 3 float values
-	inputElements[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;				// Most formats are described as color channels; really it just means "Three 32-bit floats"
+	// The vertex buffers hold PackedVertex (20 bytes), see VertexPacking.h
+
+	// Set up the first element - a position, quantized to the mesh's bounds
+	inputElements[0].Format = DXGI_FORMAT_R16G16B16A16_SNORM;			// Four 16-bit values, read as floats from -1 to 1
 	inputElements[0].SemanticName = "POSITION";							// This is "POSITION" - needs to match the semantics in our vertex shader input!
 	inputElements[0].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;	// How far into the vertex is this?  Assume it's after the previous element
 
-	// Set up the second element - UV coords, which is 2 more float values
-	inputElements[1].Format = DXGI_FORMAT_R32G32_FLOAT;					// 2x 32-bit floats
+	// Set up the second element - UV coords, which is 2 half floats
+	inputElements[1].Format = DXGI_FORMAT_R16G16_FLOAT;					// 2x 16-bit floats
 	inputElements[1].SemanticName = "TEXCOORD";							// Match our vertex shader input!
 	inputElements[1].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;	// After the previous element
 
-	// Set up the second element - UV coords, which is 3 more float values
-	inputElements[2].Format = DXGI_FORMAT_R32G32B32_FLOAT;				// 3x 32-bit floats
+	// Set up the third element - a normal, octahedral encoded into 2 values
+	inputElements[2].Format = DXGI_FORMAT_R16G16_SNORM;					// 2x 16-bit snorm
 	inputElements[2].SemanticName = "NORMAL";							// Match our vertex shader input!
 	inputElements[2].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;	// After the previous element
 
-	// Set up the fourth element - a tangent, which is 3 more float values
-	inputElements[3].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+	// Set up the fourth element - a tangent, octahedral encoded like the normal
+	inputElements[3].Format = DXGI_FORMAT_R16G16_SNORM;
 	inputElements[3].SemanticName = "TANGENT";
 	inputElements[3].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
 
@@ -109,12 +115,26 @@ Game::Game()
 		//ImGui::StyleColorsClassic();
 	}
 
+	// Mount the pack of cooked assets (written by the AssetCooker
+	// project after every build), so every asset below is read out
+	// of one mapping instead of being opened and stat'ed itself
+	Vfs::Mount(FixPath(L"../../cooked.pack"), FixPath(L"../../cooked/"));
+
 	// Helper methods for loading shaders, creating some basic
 	// geometry to draw and some simple camera matrices.
 	//  - You'll be expanding and/or replacing these later
 	LoadAssets();
 	CreateEntities();
+	CreateWorld();
 	CreateShadowMap();
+
+	// Same as the default state, but for counter-clockwise meshes
+	D3D11_RASTERIZER_DESC rastDesc = {};
+	rastDesc.FillMode = D3D11_FILL_SOLID;
+	rastDesc.CullMode = D3D11_CULL_BACK;
+	rastDesc.FrontCounterClockwise = true;
+	rastDesc.DepthClipEnable = true;
+	Graphics::Device->CreateRasterizerState(&rastDesc, &counterClockwiseRasterizer);
 }
 
 
@@ -130,6 +150,10 @@ Game::~Game()
 	ImGui_ImplDX11_Shutdown();
 	ImGui_ImplWin32_Shutdown();
 	ImGui::DestroyContext();
+
+	// Loads in flight read from the pack
+	assets.reset();
+	Vfs::Unmount();
 }
 
 
@@ -149,41 +173,38 @@ void Game::LoadAssets()
 	sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
 	Graphics::Device->CreateSamplerState(&sampDesc, sampler.GetAddressOf());
 
-	// Loading Base Textures
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobbleSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodSRV;
+	D3D11_SAMPLER_DESC clampDesc = {};
+	clampDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	clampDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	clampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	clampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	clampDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	Graphics::Device->CreateSamplerState(&clampDesc, clampSampler.GetAddressOf());
+
+	// Every asset loads in the background, and shows a
+	// placeholder until it's ready (see AssetManager)
+	// - Assets that haven't been drawn lately are unloaded once
+	//    they take more than the budget
+	// - At most 8 MB of loaded assets go live per frame
+	assets = make_unique<AssetManager>(512ull * 1024 * 1024, 8ull * 1024 * 1024);
 
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../assets/cobblestone.png").c_str(), 0, cobbleSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../assets/floor.png").c_str(), 0, floorSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../assets/wood.png").c_str(), 0, woodSRV.GetAddressOf());
+	// Loading Base Textures
+	shared_ptr<TextureAsset> cobbleTexture	= assets->LoadTexture(FixPath(L"../../cooked/cobblestone.dds"));
+	shared_ptr<TextureAsset> floorTexture	= assets->LoadTexture(FixPath(L"../../cooked/floor.dds"));
+	shared_ptr<TextureAsset> woodTexture	= assets->LoadTexture(FixPath(L"../../cooked/wood.dds"));
 
 	// Loading Texture Normals
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobbleNormalSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorNormalSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodNormalSRV;
-
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../assets/cobblestone_normals.png").c_str(), 0, cobbleNormalSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../assets/floor_normals.png").c_str(), 0, floorNormalSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../assets/wood_normals.png").c_str(), 0, woodNormalSRV.GetAddressOf());
-
-	// Loading Texture Roughs
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobbleRoughnessSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorRoughnessSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodRoughnessSRV;
+	shared_ptr<TextureAsset> cobbleNormals	= assets->LoadTexture(FixPath(L"../../cooked/cobblestone_normals.dds"), TexturePlaceholder::FlatNormal);
+	shared_ptr<TextureAsset> floorNormals	= assets->LoadTexture(FixPath(L"../../cooked/floor_normals.dds"), TexturePlaceholder::FlatNormal);
+	shared_ptr<TextureAsset> woodNormals	= assets->LoadTexture(FixPath(L"../../cooked/wood_normals.dds"), TexturePlaceholder::FlatNormal);
 
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../assets/cobblestone_roughness.png").c_str(), 0, cobbleRoughnessSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../assets/floor_roughness.png").c_str(), 0, floorRoughnessSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../assets/wood_roughness.png").c_str(), 0, woodRoughnessSRV.GetAddressOf());
+	// Loading Texture Masks (roughness and metal, packed by the cooker)
+	shared_ptr<TextureAsset> cobbleMasks	= assets->LoadTexture(FixPath(L"../../cooked/cobblestone_orm.dds"), TexturePlaceholder::Masks);
+	shared_ptr<TextureAsset> floorMasks		= assets->LoadTexture(FixPath(L"../../cooked/floor_orm.dds"), TexturePlaceholder::Masks);
+	shared_ptr<TextureAsset> woodMasks		= assets->LoadTexture(FixPath(L"../../cooked/wood_orm.dds"), TexturePlaceholder::Masks);
 
-	// Loading Texture Metal
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobbleMetalSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorMetalSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodMetalSRV;
-
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../assets/cobblestone_metal.png").c_str(), 0, cobbleMetalSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../assets/floor_metal.png").c_str(), 0, floorMetalSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../assets/wood_metal.png").c_str(), 0, woodMetalSRV.GetAddressOf());
+	// Generated by the cooker, not from a source texture
+	environmentBrdf = assets->LoadTexture(FixPath(L"../../cooked/brdf_lut.dds"), TexturePlaceholder::Black);
 
 	// Loading Shaders
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> basicVS	= LoadVertexShader(FixPath(L"VertexShader.cso").c_str());
@@ -203,42 +224,40 @@ void Game::LoadAssets()
 		mat->AddSampler(0, sampler);
 	}
 
-	materials[0]->AddTextureSRV(0, cobbleSRV);
-	materials[0]->AddTextureSRV(1, cobbleNormalSRV);
-	materials[0]->AddTextureSRV(2, cobbleRoughnessSRV);
-	materials[0]->AddTextureSRV(3, cobbleMetalSRV);
+	materials[0]->AddTexture(0, cobbleTexture);
+	materials[0]->AddTexture(1, cobbleNormals);
+	materials[0]->AddTexture(2, cobbleMasks);
 
-	materials[1]->AddTextureSRV(0, floorSRV);
-	materials[1]->AddTextureSRV(1, floorNormalSRV);
-	materials[1]->AddTextureSRV(2, floorRoughnessSRV);
-	materials[1]->AddTextureSRV(3, floorMetalSRV);
+	materials[1]->AddTexture(0, floorTexture);
+	materials[1]->AddTexture(1, floorNormals);
+	materials[1]->AddTexture(2, floorMasks);
 
-	materials[2]->AddTextureSRV(0, woodSRV);
-	materials[2]->AddTextureSRV(1, woodNormalSRV);
-	materials[2]->AddTextureSRV(2, woodRoughnessSRV);
-	materials[2]->AddTextureSRV(3, woodMetalSRV);
+	materials[2]->AddTexture(0, woodTexture);
+	materials[2]->AddTexture(1, woodNormals);
+	materials[2]->AddTexture(2, woodMasks);
 
 	// Loading Meshes
-	shapes[0] = make_shared<Mesh>(FixPath(L"../../assets/cube.obj").c_str());
-	shapes[1] = make_shared<Mesh>(FixPath(L"../../assets/cylinder.obj").c_str());
-	shapes[2] = make_shared<Mesh>(FixPath(L"../../assets/helix.obj").c_str());
-	shapes[3] = make_shared<Mesh>(FixPath(L"../../assets/quad.obj").c_str());
-	shapes[4] = make_shared<Mesh>(FixPath(L"../../assets/quad_double_sided.obj").c_str());
-	shapes[5] = make_shared<Mesh>(FixPath(L"../../assets/sphere.obj").c_str());
-	shapes[6] = make_shared<Mesh>(FixPath(L"../../assets/torus.obj").c_str());
+	shapes[0] = assets->LoadMesh(FixPath(L"../../cooked/cube.mesh"));
+	shapes[1] = assets->LoadMesh(FixPath(L"../../cooked/cylinder.mesh"));
+	shapes[2] = assets->LoadMesh(FixPath(L"../../cooked/helix.mesh"));
+	shapes[3] = assets->LoadMesh(FixPath(L"../../cooked/quad.mesh"));
+	shapes[4] = assets->LoadMesh(FixPath(L"../../cooked/quad_double_sided.mesh"));
+	shapes[5] = assets->LoadMesh(FixPath(L"../../cooked/sphere.mesh"));
+	shapes[6] = assets->LoadMesh(FixPath(L"../../cooked/torus.mesh"));
 
 	// Creates skybox
-	sky = make_shared<Sky>(
-		FixPath(L"../../assets/right.png").c_str(),
-		FixPath(L"../../assets/left.png").c_str(),
-		FixPath(L"../../assets/up.png").c_str(),
-		FixPath(L"../../assets/down.png").c_str(),
-		FixPath(L"../../assets/front.png").c_str(),
-		FixPath(L"../../assets/back.png").c_str(),
+	sky = make_shared<Sky>(*assets,
+		FixPath(L"../../cooked/right.dds"),
+		FixPath(L"../../cooked/left.dds"),
+		FixPath(L"../../cooked/up.dds"),
+		FixPath(L"../../cooked/down.dds"),
+		FixPath(L"../../cooked/front.dds"),
+		FixPath(L"../../cooked/back.dds"),
+		FixPath(L"../../cooked/sky.ibl"),
 		shapes[0], skyVS, skyPS, sampler);
 
-	//Create Lights
-	for (int i = 0; i < 1; i++) {
+	//Create Lights (the scene's own replace these)
+	for (int i = 0; i < SHADED_LIGHT_COUNT; i++) {
 		lights[i] = {};
 	}
 
@@ -280,20 +299,165 @@ void Game::LoadAssets()
 }
 
 // --------------------------------------------------------
-// Creates entities to put in window
+// Creates the hand placed entities listed in the scene file
+//
+// - Maps the cooked .scenebin (see SceneFile), or parses the
+//    .scene text when it hasn't been cooked
+// - Mesh names are files in the cooked folder, and material
+//    names pick one of the materials (the first one when
+//    the name is unknown)
+// - The scene's first lights replace the default ones; the
+//    light probes AssetCooker baked for it (with any further
+//    lights) are read alongside
 // --------------------------------------------------------
 void Game::CreateEntities() 
 {
-	entities[0] = make_shared<Entity>(shapes[4], materials[2]);
-	entities[1] = make_shared<Entity>(shapes[0], materials[0]);
-	entities[2] = make_shared<Entity>(shapes[5], materials[1]);
-	entities[3] = make_shared<Entity>(shapes[2], materials[0]);
+	MappedFile sceneFile;
+	SceneArrays parsedScene;
+	SceneData scene;
+	if (!SceneFile::Load(FixPath(L"../../cooked/scene.scenebin"), sceneFile, scene))
+	{
+		if (!SceneFile::LoadText(FixPath(L"../../assets/scene.scene"), parsedScene))
+		{
+			printf("Couldn't load the scene\n");
+			parsedScene = SceneArrays();
+		}
+		scene = SceneFile::GetData(parsedScene);
+	}
 
-	entities[0]->GetTransform()->MoveAbsolute(0, -3, 0);
-	entities[0]->GetTransform()->Scale(20, 1, 20);
+	vector<shared_ptr<MeshAsset>> sceneMeshes;
+	for (unsigned int i = 0; i < scene.MeshCount; i++)
+		sceneMeshes.push_back(assets->LoadMesh(FixPath(L"../../cooked/" + NarrowToWide(scene.Meshes[i].Text))));
 
-	entities[2]->GetTransform()->MoveAbsolute(-4, 0, 0);
-	entities[3]->GetTransform()->MoveAbsolute(4, 0, 0);
+	const char* materialNames[] = { "cobblestone", "floor", "wood" };
+	vector<shared_ptr<Material>> sceneMaterials;
+	for (unsigned int i = 0; i < scene.MaterialCount; i++)
+	{
+		auto name = find_if(begin(materialNames), end(materialNames), [&](const char* n) { return strcmp(n, scene.Materials[i].Text) == 0; });
+		sceneMaterials.push_back(materials[name == end(materialNames) ? 0 : name - begin(materialNames)]);
+	}
+
+	entities.reserve(scene.EntityCount);
+	for (unsigned int i = 0; i < scene.EntityCount; i++)
+	{
+		shared_ptr<Entity> ent = make_shared<Entity>(sceneMeshes[scene.MeshIndices[i]], sceneMaterials[scene.MaterialIndices[i]]);
+		ent->GetTransform()->SetPosition(scene.Positions[i]);
+		ent->GetTransform()->SetRotation(scene.Rotations[i]);
+		ent->GetTransform()->SetScale(scene.Scales[i]);
+		ent->SetStatic((scene.Flags[i] & SceneFile::EntityStatic) != 0);
+		ApplyMtlMaterials(ent);
+		entities.push_back(ent);
+	}
+
+	for (unsigned int i = 0; i < scene.LightCount && i < SHADED_LIGHT_COUNT; i++)
+		lights[i] = scene.Lights[i];
+
+	if (!LightProbes::Load(FixPath(L"../../cooked/scene.probes"), lightProbes))
+		printf("No light probes for the scene; entities use the sky's light\n");
+}
+
+// --------------------------------------------------------
+// Fills a large world around the hand placed entities with
+// scattered shapes, which load cell by cell as the camera
+// gets close (see WorldPartition)
+// - Every cell's shapes come from a hash of its coordinates,
+//    so the world is the same every run
+// - The cells around the origin are left empty
+// --------------------------------------------------------
+void Game::CreateWorld()
+{
+	const unsigned int cellCount = 32;
+	const float cellSize = 16.0f;
+	const float halfSize = cellCount * cellSize * 0.5f;
+	world = make_unique<WorldPartition>(*assets, vector<shared_ptr<Material>>(begin(materials), end(materials)),
+		XMFLOAT2(-halfSize, -halfSize), cellSize, cellCount, cellCount, 48.0f, 64.0f);
+
+	const wchar_t* meshes[] = { L"../../cooked/cylinder.mesh", L"../../cooked/helix.mesh", L"../../cooked/sphere.mesh", L"../../cooked/torus.mesh", L"../../cooked/cube.mesh" };
+	for (unsigned int z = 0; z < cellCount; z++)
+	{
+		for (unsigned int x = 0; x < cellCount; x++)
+		{
+			float minX = x * cellSize - halfSize;
+			float minZ = z * cellSize - halfSize;
+			if (fabsf(minX + cellSize * 0.5f) < cellSize && fabsf(minZ + cellSize * 0.5f) < cellSize)
+				continue;
+
+			unsigned int seed = (z * cellCount + x) * 2654435761u;
+			auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+			auto unit = [&next]() { return (next() & 0xFFFF) / 65535.0f; };
+
+			for (unsigned int i = 0; i < 4; i++)
+			{
+				CellEntity entity;
+				entity.MeshPath = FixPath(meshes[next() % 5]);
+				entity.MaterialIndex = next() % 3;
+				entity.Position = XMFLOAT3(minX + unit() * cellSize, unit() * 2.0f - 2.0f, minZ + unit() * cellSize);
+				entity.Rotation = XMFLOAT3(0, unit() * XM_2PI, 0);
+				float scale = 0.5f + unit() * 1.5f;
+				entity.Scale = XMFLOAT3(scale, scale, scale);
+				world->AddEntity(entity);
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Gives an entity's submeshes the materials from its mesh's
+// .mtl file (submeshes without one keep the entity's)
+//
+// - Each starts as a copy of the entity's material (shaders,
+//    sampler, textures), then takes the .mtl's color,
+//    roughness and whichever texture maps it names
+// - The maps load in the background (see AssetManager), so
+//    they start out as placeholders instead of the copies
+// - .png maps load as the .dds the cooker made of them, and
+//    roughness and metalness maps as the masks it packed
+//    them into (see TextureCooker)
+// - Roughness and metalness maps without a mask suffix (like
+//    "_roughness") were never packed, so they're skipped with
+//    a warning, keeping the entity material's masks
+// - Runs again whenever the entity's mesh finishes loading
+// --------------------------------------------------------
+void Game::ApplyMtlMaterials(shared_ptr<Entity> entity)
+{
+	shared_ptr<Mesh> mesh = entity->GetMesh();
+	unordered_map<string, shared_ptr<Material>> created;
+
+	for (unsigned int s = 0; s < mesh->GetSubmeshCount(); s++)
+	{
+		const MtlMaterial* mtl = mesh->GetSubmeshMtl(s);
+		if (!mtl)
+			continue;
+
+		shared_ptr<Material>& mat = created[mtl->Name];
+		if (!mat)
+		{
+			mat = make_shared<Material>(*entity->GetMaterial());
+			mat->SetTint(XMFLOAT4(mtl->Diffuse.x, mtl->Diffuse.y, mtl->Diffuse.z, mtl->Opacity));
+			mat->SetRoughness(mtl->Roughness);
+
+			// Same slots as LoadAssets: albedo, normal, masks
+			const wstring& maskMap = mtl->RoughnessMap.empty() ? mtl->MetalnessMap : mtl->RoughnessMap;
+			wstring packedMasks = TextureCooker::GetPackedPath(maskMap);
+			if (!maskMap.empty() && packedMasks.empty() && unpackedMaskMaps.insert(maskMap).second)
+				printf("%s: %ls has no mask suffix (_roughness, _metal...), so it wasn't packed; keeping the entity's masks\n", mtl->Name.c_str(), maskMap.c_str());
+
+			const wstring maps[] = { mtl->DiffuseMap, mtl->NormalMap, packedMasks };
+			const TexturePlaceholder placeholders[] = { TexturePlaceholder::White, TexturePlaceholder::FlatNormal, TexturePlaceholder::Masks };
+			for (unsigned int slot = 0; slot < 3; slot++)
+			{
+				if (maps[slot].empty())
+					continue;
+
+				filesystem::path map = maps[slot];
+				if (_wcsicmp(map.extension().c_str(), L".png") == 0)
+					map.replace_extension(L".dds");
+				mat->AddTexture(slot, assets->LoadTexture(map.wstring(), placeholders[slot]));
+			}
+		}
+
+		entity->SetSubmeshMaterial(s, mat);
+	}
 }
 
 // --------------------------------------------------------
@@ -316,10 +480,30 @@ void Game::Update(float deltaTime, float totalTime)
 {
 	Game::ResetUI(deltaTime);
 
+	// Swap in whatever finished loading, and stream the world's
+	// cells around the camera; entities whose mesh changed need
+	// its .mtl materials again
+	assets->Update();
+	bool worldChanged = world->Update(camera->GetTransform()->GetPosition(), [this](shared_ptr<Entity> ent) { ApplyMtlMaterials(ent); });
+	if (worldChanged || drawEntities.empty())
+	{
+		drawEntities.assign(begin(entities), end(entities));
+		drawEntities.insert(drawEntities.end(), world->GetEntities().begin(), world->GetEntities().end());
+	}
+
+	for (auto& ent : drawEntities)
+	{
+		if (ent->UpdateMesh())
+			ApplyMtlMaterials(ent);
+	}
+
 	camera->Update(deltaTime);
 
-	for (int i = 1; i < 4; i++) {
-		entities[i]->GetTransform()->Rotation(0, deltaTime, 0);
+
+	// Everything but the static entities spins
+	for (auto& ent : entities) {
+		if (!ent->IsStatic())
+			ent->GetTransform()->Rotation(0, deltaTime, 0);
 	}
 
 	// Example input checking: Quit if the escape key is pressed
@@ -342,9 +526,19 @@ void Game::Draw(float deltaTime, float totalTime)
 		Graphics::Context->ClearDepthStencilView(Graphics::DepthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
 	}
 
+	// Pick each entity's LOD once, so the shadow map and the
+	// scene draw the same triangles
+	// - Meshlet culling only applies to the camera's view, since
+	//    the shadow map needs casters the camera can't see
+	for (auto& ent : drawEntities)
+	{
+		ent->SelectLod(camera);
+		ent->CullMeshlets(camera, meshletCulling);
+	}
+
 	RenderShadowMap();
 
-	Graphics::Context->PSSetShaderResources(4, 1, shadowSRV.GetAddressOf());
+	Graphics::Context->PSSetShaderResources(3, 1, shadowSRV.GetAddressOf());
 	Graphics::Context->PSSetSamplers(1, 1, shadowSampler.GetAddressOf());
 
 	constVertBuffData.projection = camera->GetProjectionMatrix();
@@ -355,6 +549,17 @@ void Game::Draw(float deltaTime, float totalTime)
 	constPixBuffData.camPosition = camera->GetTransform()->GetPosition();
 	memcpy(&constPixBuffData.lights, &lights[0], sizeof(lights));
 
+	// Sky lighting (no sky ambient if it wasn't cooked; the
+	// probes' diffuse light still applies)
+	SphericalHarmonics9 skyIrradiance;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> skySpecular;
+	unsigned int skySpecularMips = 0;
+	sky->GetEnvironment(skyIrradiance, skySpecular, skySpecularMips);
+	constPixBuffData.specularMipCount = (float)skySpecularMips;
+	Graphics::Context->PSSetShaderResources(4, 1, skySpecular.GetAddressOf());
+	Graphics::Context->PSSetShaderResources(5, 1, environmentBrdf->Use().GetAddressOf());
+	Graphics::Context->PSSetSamplers(2, 1, clampSampler.GetAddressOf());
+
 	constVertBuffData.lightView = lightViewMatrix;
 	constVertBuffData.lightProjection = lightProjectionMatrix;
 
@@ -362,28 +567,56 @@ void Game::Draw(float deltaTime, float totalTime)
 	// - Binds constant buffer
 	// - Collects world data for entity (pos, rot, scale)
 	// - Maps/copies/unmaps data
-	// - sets Vertex and Index buffers
-	for (shared_ptr ent : entities) {
-
-		std::shared_ptr<Material> mat = ent->GetMaterial();
-
-		mat->BindTextureAndSampler();
+	// - Blends its ambient light from the probes around it,
+	//    fading to the sky's outside them (except for static
+	//    entities, which they're baked against: probes next to
+	//    one only see half of it)
+	// - Binds each submesh's material and draws it
+	// - Picks the rasterizer state matching the mesh's winding
+	for (shared_ptr ent : drawEntities) {
+		Graphics::Context->RSSetState(ent->GetMesh()->IsFrontCounterClockwise() ? counterClockwiseRasterizer.Get() : 0);
 
 		constVertBuffData.world = ent->GetTransform()->GetWorldMatrix();
 		constVertBuffData.worldInvTranspose = ent->GetTransform()->GetWorldInverseTransposeMatrix();
+		constVertBuffData.positionCenter = ent->GetMesh()->GetQuantization().Center;
+		constVertBuffData.positionExtent = ent->GetMesh()->GetQuantization().Extent;
 
 		Graphics::FillAndBindNextConstantBuffer(&constVertBuffData, sizeof(VertexBufferData), D3D11_VERTEX_SHADER, 0);
 
-		constPixBuffData.colorTint = mat->GetTint();
-		constPixBuffData.uvScale = mat->GetUVScale();
-		constPixBuffData.uvOffset = mat->GetUVOffset();
-		constPixBuffData.roughness = mat->GetRoughness();
-		constPixBuffData.ambientColor = ambientColor;
-
-		Graphics::FillAndBindNextConstantBuffer(&constPixBuffData, sizeof(PixelBufferData), D3D11_PIXEL_SHADER, 0);
+		SphericalHarmonics9 probeIrradiance;
+		float probeWeight = ent->IsStatic() ? 0.0f : LightProbes::Sample(lightProbes, ent->GetTransform()->GetPosition(), probeIrradiance);
+		for (unsigned int i = 0; i < SphericalHarmonics::CoefficientCount; i++)
+		{
+			const XMFLOAT3& fromSky = skyIrradiance.Coefficients[i];
+			const XMFLOAT3& fromProbes = probeIrradiance.Coefficients[i];
+			constPixBuffData.irradiance[i] = XMFLOAT4(
+				fromSky.x + (fromProbes.x - fromSky.x) * probeWeight,
+				fromSky.y + (fromProbes.y - fromSky.y) * probeWeight,
+				fromSky.z + (fromProbes.z - fromSky.z) * probeWeight, 0.0f);
+		}
 
-		ent->Draw();
+		ent->Draw([&](shared_ptr<Material> mat)
+		{
+			mat->BindTextureAndSampler();
+
+			constPixBuffData.colorTint = mat->GetTint();
+			constPixBuffData.uvScale = mat->GetUVScale();
+			constPixBuffData.uvOffset = mat->GetUVOffset();
+			constPixBuffData.roughness = mat->GetRoughness();
+			constPixBuffData.ambientColor = ambientColor;
+
+			// One channel mask maps (BC4, or R8 when uncompressed)
+			// are roughness alone
+			D3D11_SHADER_RESOURCE_VIEW_DESC maskDesc = {};
+			Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> maskMap = mat->GetTexture(2);
+			if (maskMap)
+				maskMap->GetDesc(&maskDesc);
+			constPixBuffData.roughnessOnlyMasks = maskDesc.Format == DXGI_FORMAT_BC4_UNORM || maskDesc.Format == DXGI_FORMAT_R8_UNORM ? 1.0f : 0.0f;
+
+			Graphics::FillAndBindNextConstantBuffer(&constPixBuffData, sizeof(PixelBufferData), D3D11_PIXEL_SHADER, 0);
+		});
 	}
+	Graphics::Context->RSSetState(0);
 
 	sky->Draw(camera);
 
@@ -504,6 +737,9 @@ void Game::CreateShadowMap()
 	shadowRastDesc.SlopeScaledDepthBias = 1.0f; // Bias more based on slope
 	Graphics::Device->CreateRasterizerState(&shadowRastDesc, &shadowRasterizer);
 
+	shadowRastDesc.FrontCounterClockwise = true;
+	Graphics::Device->CreateRasterizerState(&shadowRastDesc, &shadowRasterizerCounterClockwise);
+
 	D3D11_SAMPLER_DESC shadowSampDesc = {};
 	shadowSampDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR;
 	shadowSampDesc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
@@ -517,8 +753,6 @@ void Game::CreateShadowMap()
 void Game::RenderShadowMap() {
 	Graphics::Context->ClearDepthStencilView(shadowDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
 
-	Graphics::Context->RSSetState(shadowRasterizer.Get());
-
 	ID3D11RenderTargetView* nullRTV[1] = { nullptr };
 	Graphics::Context->OMSetRenderTargets(1, nullRTV, shadowDSV.Get());
 
@@ -536,6 +770,10 @@ void Game::RenderShadowMap() {
 		XMFLOAT4X4 world;
 		XMFLOAT4X4 view;
 		XMFLOAT4X4 proj;
+		XMFLOAT3 positionCenter;
+		float padding0;
+		XMFLOAT3 positionExtent;
+		float padding1;
 	};
 
 	ShadowVSData vsData = {};
@@ -543,12 +781,16 @@ void Game::RenderShadowMap() {
 	vsData.proj = lightProjectionMatrix;
 
 	// Loop and draw all entities
-	for (auto& e : entities)
+	for (auto& e : drawEntities)
 	{
+		Graphics::Context->RSSetState(e->GetMesh()->IsFrontCounterClockwise() ? shadowRasterizerCounterClockwise.Get() : shadowRasterizer.Get());
+
 		vsData.world = e->GetTransform()->GetWorldMatrix();
+		vsData.positionCenter = e->GetMesh()->GetQuantization().Center;
+		vsData.positionExtent = e->GetMesh()->GetQuantization().Extent;
 		Graphics::FillAndBindNextConstantBuffer(&vsData, sizeof(ShadowVSData), D3D11_VERTEX_SHADER, 0);
 
-		e->GetMesh()->Draw();
+		e->GetMesh()->Draw(e->GetLod());
 	}
 
 	viewport.Width = (float)Window::Width();
@@ -613,9 +855,11 @@ void Game::ShowUIWindow() {
 
 	MaterialUI();
 
-	// ShowStats(); **Broken
+	ShowStats();
+
+	WorldStats();
 
-	// TransformStats(); **Broken
+	TransformStats();
 
 	CameraStats();
 
@@ -636,37 +880,33 @@ void Game::GraphicChangeUI() {
 
 
 // --------------------------------------------------------
-// Creates subsection for shape statistics
+// Creates subsection for asset and shape statistics
+// - Shapes are named after their mesh file, and show the
+//    placeholder's counts until they're loaded
 // --------------------------------------------------------
 void Game::ShowStats() 
 {
-	if (ImGui::TreeNode("Meshes")) 
-	{
-		if (ImGui::TreeNode("Triangle"))
-		{
-			ImGui::Text("Triangles: %d", shapes[0]->GetIndexCount() / 3);
-			ImGui::Text("Vertices: %d", shapes[0]->GetVertexCount());
-			ImGui::Text("Indices: %d", shapes[0]->GetIndexCount());
-
-			ImGui::TreePop();
-		}
+	ImGui::Text("Assets Loading: %u", assets->GetLoadingCount());
+	ImGui::Text("Asset Memory: %.1f MB", assets->GetMemoryUsed() / (1024.0 * 1024.0));
 
-		if (ImGui::TreeNode("Rectangle"))
-		{
-			ImGui::Text("Triangles: %d", shapes[1]->GetIndexCount() / 3);
-			ImGui::Text("Vertices: %d", shapes[1]->GetVertexCount());
-			ImGui::Text("Indices: %d", shapes[1]->GetIndexCount());
+	int budgetMB = (int)(assets->GetMemoryBudget() / (1024 * 1024));
+	if (ImGui::SliderInt("Asset Budget (MB)", &budgetMB, 1, 1024))
+		assets->SetMemoryBudget((size_t)budgetMB * 1024 * 1024);
 
-			ImGui::TreePop();
-		}
-
-		if (ImGui::TreeNode("Star"))
+	if (ImGui::TreeNode("Meshes")) 
+	{
+		for (shared_ptr<MeshAsset> shape : shapes)
 		{
-			ImGui::Text("Triangles: %d", shapes[2]->GetIndexCount() / 3);
-			ImGui::Text("Vertices: %d", shapes[2]->GetVertexCount());
-			ImGui::Text("Indices: %d", shapes[2]->GetIndexCount());
+			string name = WideToNarrow(filesystem::path(shape->GetPath()).stem().wstring());
+			if (ImGui::TreeNode(name.c_str()))
+			{
+				ImGui::Text("Loaded: %s", shape->IsReady() ? "yes" : "no");
+				ImGui::Text("Triangles: %d", shape->Get()->GetIndexCount() / 3);
+				ImGui::Text("Vertices: %d", shape->Get()->GetVertexCount());
+				ImGui::Text("Indices: %d", shape->Get()->GetIndexCount());
 
-			ImGui::TreePop();
+				ImGui::TreePop();
+			}
 		}
 
 		ImGui::TreePop();
@@ -675,12 +915,31 @@ void Game::ShowStats()
 
 // --------------------------------------------------------
 // Creates ability to transform entity using ImGui
+// - Meshlet culling can be turned off to compare how many
+//    triangles each entity draws without it
+// - Every drawn entity (streamed ones too) is counted by the
+//    LOD it picked, and each hand placed one shows its own
 // --------------------------------------------------------
 void Game::TransformStats() 
 {	
 	int i = 0;
 	if (ImGui::TreeNode("Entities")) 
 	{
+		ImGui::Checkbox("Meshlet Culling", &meshletCulling);
+
+		unsigned int visibleTriangles = 0;
+		vector<unsigned int> lodEntities;
+		for (auto& ent : drawEntities)
+		{
+			visibleTriangles += ent->GetVisibleTriangleCount();
+			if (ent->GetLod() >= lodEntities.size())
+				lodEntities.resize(ent->GetLod() + 1, 0);
+			lodEntities[ent->GetLod()]++;
+		}
+		ImGui::Text("Visible Triangles (every entity drawn): %u", visibleTriangles);
+		for (size_t lod = 0; lod < lodEntities.size(); lod++)
+			ImGui::BulletText("LOD %zu: %u entities", lod, lodEntities[lod]);
+
 		for (auto& ent : entities) 
 		{
 			ImGui::PushID(i);
@@ -691,10 +950,25 @@ void Game::TransformStats()
 
 			if (ImGui::TreeNode(("Entity " + std::to_string(i)).c_str()))
 			{
-				ImGui::DragFloat3("Position", &pos.x, 0.0f, -1.0f, 1.0f);
-				ImGui::DragFloat3("Rotation", &rot.x, 0.0f, -1.0f, 1.0f);
-				ImGui::DragFloat3("Scale", &scale.x, 0.0f, 0.0f, 2.0f);
+				ImGui::DragFloat3("Position", &pos.x, 0.05f);
+				ImGui::DragFloat3("Rotation", &rot.x, 0.01f);
+				ImGui::DragFloat3("Scale", &scale.x, 0.01f, 0.01f, 10.0f);
 				ImGui::Text("Mesh Index Count: %d", ent->GetMesh()->GetIndexCount());
+				ImGui::Text("LOD: %u of 0-%u (%u triangles)",
+					ent->GetLod(), ent->GetMesh()->GetLodCount() - 1,
+					ent->GetMesh()->GetLod(ent->GetLod()).IndexCount / 3);
+				ImGui::Text("Visible Triangles: %u in %u draws",
+					ent->GetVisibleTriangleCount(), ent->GetDrawRangeCount());
+
+				// Meshes with a single submesh have nothing to list
+				shared_ptr<Mesh> mesh = ent->GetMesh();
+				unsigned int submeshCount = mesh->GetSubmeshCount();
+				for (unsigned int s = 0; submeshCount > 1 && s < submeshCount; s++)
+				{
+					const MeshSubmesh& submesh = mesh->GetSubmesh(s);
+					ImGui::BulletText("Submesh %s: %s (%u triangles)", submesh.Name, submesh.Material,
+						mesh->GetSubmeshRange(ent->GetLod(), s).Count / 3);
+				}
 
 				ImGui::TreePop();
 			}
@@ -707,6 +981,23 @@ void Game::TransformStats()
 	}
 }
 
+// --------------------------------------------------------
+// Shows how much of the streamed world is in around the
+// camera (see WorldPartition)
+// --------------------------------------------------------
+void Game::WorldStats() 
+{
+	if (ImGui::TreeNode("World")) 
+	{
+		ImGui::Text("Cells Loaded: %u of %u", world->GetLoadedCellCount(), world->GetCellCount());
+		ImGui::Text("Cells Loading: %u", world->GetLoadingCellCount());
+		ImGui::Text("Streamed Entities: %zu", world->GetEntities().size());
+		ImGui::Text("Entities Drawn: %zu", drawEntities.size());
+
+		ImGui::TreePop();
+	}
+}
+
 void Game::CameraStats() 
 {
 	if (ImGui::TreeNode("Cameras")) 
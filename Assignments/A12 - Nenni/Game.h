@@ -4,6 +4,7 @@
 #include <wrl/client.h>
 #include <DirectXMath.h>
 #include <memory>
+#include <unordered_set>
 #include "Mesh.h"
 #include "BufferStructs.h"
 #include "Entity.h"
@@ -11,6 +12,9 @@
 #include "Material.h"
 #include "Lights.h"
 #include "Sky.h"
+#include "AssetManager.h"
+#include "WorldPartition.h"
+#include "LightProbes.h"
 
 using namespace std;
 
@@ -34,11 +38,18 @@ private:
 	// List of Materials
 	shared_ptr<Material> materials[3];
 
-	// List of Meshes
-	shared_ptr<Mesh> shapes[7];
+	// List of Meshes (placeholders until they've loaded)
+	shared_ptr<MeshAsset> shapes[7];
 
-	// List of Entities
-	shared_ptr<Entity> entities[4];
+	// Hand placed entities, from the scene file
+	vector<shared_ptr<Entity>> entities;
+
+	// Cells of entities that stream in around the camera
+	unique_ptr<WorldPartition> world;
+
+	// Entities drawn this frame: the ones above and the loaded
+	// cells' (rebuilt whenever the world changes)
+	vector<shared_ptr<Entity>> drawEntities;
 
 	// List of Cameras
 	shared_ptr<Camera> cameras[3];
@@ -46,6 +57,9 @@ private:
 	// Variables for UI manipulation
 	float background[4];
 
+	// Skip meshlets outside the view or facing away (see Meshlets)
+	bool meshletCulling = true;
+
 	// Colors for triangle
 	float color1[4] = { 1.0f, 0.0f, 0.0f, 1.0f };
 	float color2[4] = { 0.0f, 1.0f, 0.0f, 1.0f };
@@ -54,7 +68,7 @@ private:
 
 	XMFLOAT3 ambientColor;
 
-	Light lights[1];
+	Light lights[SHADED_LIGHT_COUNT];
 
 	VertexBufferData constVertBuffData;
 
@@ -67,12 +81,31 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> LoadVertexShader(const wchar_t* shaderPath);
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> LoadPixelShader(const wchar_t* shaderPath);
 
+	// Loads every mesh and texture in the background
+	unique_ptr<AssetManager> assets;
+
 	shared_ptr<Sky> sky;
 
+	// Split sum BRDF lookup table for the sky's specular light
+	// (see Brdf), read with clamped UVs so its edges don't wrap
+	shared_ptr<TextureAsset> environmentBrdf;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> clampSampler;
+
+	// Light probes AssetCooker baked over the hand placed
+	// entities (see LightProbes), giving each entity its own
+	// ambient light in place of the sky's
+	LightProbeGrid lightProbes;
+
+	// .mtl roughness/metalness maps that weren't packed into
+	// masks, so they're only warned about once
+	unordered_set<wstring> unpackedMaskMaps;
+
 	// Helper Methods
 
 	void LoadAssets();
 	void CreateEntities();
+	void CreateWorld();
+	void ApplyMtlMaterials(shared_ptr<Entity> entity);
 
 	// Refreshes ImGui 
 	void ResetUI(float deltaTime);
@@ -85,6 +118,8 @@ private:
 
 	void TransformStats();
 
+	void WorldStats();
+
 	void CameraStats();
 
 	void MaterialUI();
@@ -107,11 +142,16 @@ private:
 	// Shader-related Construct
 	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
 
+	// Front faces counter-clockwise, for meshes that keep that
+	// winding (see Mesh::IsFrontCounterClockwise)
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> counterClockwiseRasterizer;
+
 	// Shadow-related Variables
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> shadowVS;
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizer;
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizerCounterClockwise;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler;
 	DirectX::XMFLOAT4X4 lightViewMatrix;
 	DirectX::XMFLOAT4X4 lightProjectionMatrix;
@@ -32,6 +32,9 @@ struct VertexToPixel_Sky
     float3 sampleDir		: DIRECTION;
 };
 
+// Packed vertex (see VertexPacking.h on the C++ side)
+// - Position is snorm, quantized to the mesh's bounds
+// - Normal and tangent are octahedral encoded
 struct VertexShaderInput
 {
 	// Data type
@@ -39,10 +42,25 @@ struct VertexShaderInput
 	//  |   Name          Semantic
 	//  |    |                |
 	//  v    v                v
-    float3 localPosition	: POSITION; // XYZ position
+    float4 localPosition	: POSITION; // XYZ position (snorm, quantized)
     float2 uv				: TEXCOORD;
-    float3 normal			: NORMAL;
-    float3 tangent			: TANGENT;
+    float2 normal			: NORMAL;   // Octahedral
+    float2 tangent			: TANGENT;  // Octahedral
 };
 
+// Turns a quantized position back into local space
+float3 DequantizePosition(float4 packedPosition, float3 center, float3 extent)
+{
+    return center + packedPosition.xyz * extent;
+}
+
+// Decodes an octahedral encoded unit vector
+float3 OctahedralDecode(float2 encoded)
+{
+    float3 n = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float t = saturate(-n.z);
+    n.xy += n.xy >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
 #endif
\ No newline at end of file
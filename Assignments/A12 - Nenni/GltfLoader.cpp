@@ -0,0 +1,880 @@
+#include "GltfLoader.h"
+#include "Json.h"
+#include "TangentGenerator.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <tuple>
+
+namespace
+{
+	const uint32_t GlbMagic = 0x46546C67;	// "glTF"
+	const uint32_t JsonChunk = 0x4E4F534A;	// "JSON"
+	const uint32_t BinChunk = 0x004E4942;	// "BIN\0"
+
+	// Accessor component types
+	const unsigned int ComponentByte = 5120;
+	const unsigned int ComponentUnsignedByte = 5121;
+	const unsigned int ComponentShort = 5122;
+	const unsigned int ComponentUnsignedShort = 5123;
+	const unsigned int ComponentUnsignedInt = 5125;
+	const unsigned int ComponentFloat = 5126;
+
+	const unsigned int TrianglesMode = 4;
+
+	// Vertices packed by each parallel job
+	const unsigned int PackBlockSize = 4096;
+
+	// --------------------------------------------------------
+	// Where an accessor's elements are in the binary chunk
+	// - Data is null when the attribute is missing
+	// --------------------------------------------------------
+	struct Accessor
+	{
+		const char* Data = nullptr;
+		size_t Stride = 0;
+		unsigned int Count = 0;
+		unsigned int ComponentType = 0;
+		unsigned int Components = 0;
+		bool Normalized = false;
+	};
+
+	// A node that draws a mesh, with its transform from the root
+	struct Instance
+	{
+		unsigned int Mesh;
+		XMFLOAT4X4 World;
+		XMFLOAT4X4 NormalMatrix;
+		bool Identity;
+		bool Mirrored;
+	};
+
+	// --------------------------------------------------------
+	// Vertices of one or more primitives of an instance that
+	// use the same attribute accessors (so they share them)
+	// --------------------------------------------------------
+	struct VertexSet
+	{
+		unsigned int Instance;
+		size_t PositionIndex = 0;
+		Accessor Position;
+		Accessor Normal;
+		Accessor UV;
+		Accessor Tangent;
+		unsigned int VertexStart = 0;
+
+		// Backing for attributes that had to be generated
+		std::vector<Vertex> Generated;
+	};
+
+	struct PrimitiveRef
+	{
+		unsigned int Set;
+		Accessor Indices;
+		unsigned int IndexCount;
+		std::string Name;
+		int Material;
+	};
+
+	unsigned int ComponentSize(unsigned int componentType)
+	{
+		switch (componentType)
+		{
+		case ComponentByte:
+		case ComponentUnsignedByte: return 1;
+		case ComponentShort:
+		case ComponentUnsignedShort: return 2;
+		case ComponentUnsignedInt:
+		case ComponentFloat: return 4;
+		default: return 0;
+		}
+	}
+
+	unsigned int ComponentCount(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		return 0;
+	}
+
+	// Non-negative whole numbers (offsets, counts, indices)
+	bool ToSize(const JsonValue& value, size_t fallback, size_t& out)
+	{
+		if (value.IsNull())
+		{
+			out = fallback;
+			return true;
+		}
+
+		double number = value.Number(-1);
+		if (!(number >= 0 && number <= 4294967295.0) || number != floor(number))
+			return false;
+
+		out = (size_t)number;
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// Finds an accessor's elements in the binary chunk, making
+	// sure every one of them is inside its buffer view
+	// --------------------------------------------------------
+	bool GetAccessor(const JsonValue& root, const char* bin, size_t binSize, const JsonValue& index, Accessor& out)
+	{
+		size_t accessorIndex;
+		if (!index.IsNumber() || !ToSize(index, 0, accessorIndex))
+			return false;
+
+		const JsonValue& accessor = root["accessors"][accessorIndex];
+		if (!accessor.IsObject() || accessor.Has("sparse") || !accessor.Has("bufferView"))
+			return false;
+
+		size_t viewIndex, bufferIndex;
+		if (!ToSize(accessor["bufferView"], 0, viewIndex))
+			return false;
+		const JsonValue& view = root["bufferViews"][viewIndex];
+		if (!view.IsObject() || !ToSize(view["buffer"], 0, bufferIndex))
+			return false;
+
+		// Only the .GLB's own binary chunk
+		if (!bin || bufferIndex != 0 || root["buffers"][bufferIndex].Has("uri"))
+			return false;
+
+		size_t viewOffset, viewLength, viewStride, accessorOffset, count;
+		if (!ToSize(view["byteOffset"], 0, viewOffset) ||
+			!ToSize(view["byteLength"], 0, viewLength) ||
+			!ToSize(view["byteStride"], 0, viewStride) ||
+			!ToSize(accessor["byteOffset"], 0, accessorOffset) ||
+			!ToSize(accessor["count"], 0, count))
+			return false;
+
+		unsigned int componentType = (unsigned int)accessor["componentType"].Number();
+		unsigned int components = ComponentCount(accessor["type"].String());
+		size_t elementSize = (size_t)ComponentSize(componentType) * components;
+		size_t stride = viewStride > 0 ? viewStride : elementSize;
+		if (elementSize == 0 || count == 0 || stride < elementSize)
+			return false;
+
+		if (viewOffset > binSize || viewLength > binSize - viewOffset ||
+			accessorOffset > viewLength || elementSize > viewLength - accessorOffset ||
+			(count - 1) > (viewLength - accessorOffset - elementSize) / stride)
+			return false;
+
+		out.Data = bin + viewOffset + accessorOffset;
+		out.Stride = stride;
+		out.Count = (unsigned int)count;
+		out.ComponentType = componentType;
+		out.Components = components;
+		out.Normalized = accessor["normalized"].Bool();
+		return true;
+	}
+
+	// One component as a float (normalized integers as the
+	// glTF spec maps them)
+	float ReadComponent(const char* p, unsigned int componentType, bool normalized)
+	{
+		switch (componentType)
+		{
+		case ComponentFloat:
+		{
+			float value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+		case ComponentByte:
+		{
+			float value = (float)*(const int8_t*)p;
+			return normalized ? std::max(value / 127.0f, -1.0f) : value;
+		}
+		case ComponentUnsignedByte:
+		{
+			float value = (float)*(const uint8_t*)p;
+			return normalized ? value / 255.0f : value;
+		}
+		case ComponentShort:
+		{
+			int16_t value;
+			memcpy(&value, p, sizeof(value));
+			return normalized ? std::max(value / 32767.0f, -1.0f) : (float)value;
+		}
+		case ComponentUnsignedShort:
+		{
+			uint16_t value;
+			memcpy(&value, p, sizeof(value));
+			return normalized ? value / 65535.0f : (float)value;
+		}
+		default:
+		{
+			uint32_t value;
+			memcpy(&value, p, sizeof(value));
+			return (float)value;
+		}
+		}
+	}
+
+	// Reads up to count components of element i; float data is
+	// copied as it is, anything else converted one at a time
+	inline void ReadFloats(const Accessor& accessor, unsigned int i, float* out, unsigned int count)
+	{
+		const char* p = accessor.Data + i * accessor.Stride;
+		count = std::min(count, accessor.Components);
+
+		if (accessor.ComponentType == ComponentFloat)
+		{
+			memcpy(out, p, sizeof(float) * count);
+			return;
+		}
+
+		unsigned int size = ComponentSize(accessor.ComponentType);
+		for (unsigned int c = 0; c < count; c++)
+			out[c] = ReadComponent(p + c * size, accessor.ComponentType, accessor.Normalized);
+	}
+
+	inline unsigned int ReadIndex(const Accessor& accessor, unsigned int i)
+	{
+		const char* p = accessor.Data + i * accessor.Stride;
+		switch (accessor.ComponentType)
+		{
+		case ComponentUnsignedByte:
+			return *(const uint8_t*)p;
+		case ComponentUnsignedShort:
+		{
+			uint16_t value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+		default:
+		{
+			uint32_t value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+		}
+	}
+
+	// Index i of a primitive, which counts up when it has no indices
+	inline unsigned int PrimitiveIndex(const PrimitiveRef& primitive, unsigned int i)
+	{
+		return primitive.Indices.Data ? ReadIndex(primitive.Indices, i) : i;
+	}
+
+	// Copies a JSON array of count numbers (leaving out alone
+	// when it isn't one)
+	void ReadNumbers(const JsonValue& array, float* out, size_t count)
+	{
+		if (array.Size() != count)
+			return;
+		for (size_t i = 0; i < count; i++)
+			out[i] = (float)array[i].Number(out[i]);
+	}
+
+	// --------------------------------------------------------
+	// A node's local transform as a DirectX (row vector) matrix
+	// - glTF matrices are column major for column vectors, so
+	//    reading them in order gives the transpose we need
+	// - Otherwise it's translation * rotation * scale in glTF's
+	//    order, which is scale * rotation * translation here
+	// --------------------------------------------------------
+	XMMATRIX NodeMatrix(const JsonValue& node)
+	{
+		if (node["matrix"].Size() == 16)
+		{
+			XMFLOAT4X4 m = {};
+			ReadNumbers(node["matrix"], &m.m[0][0], 16);
+			return XMLoadFloat4x4(&m);
+		}
+
+		float t[3] = { 0, 0, 0 };
+		float r[4] = { 0, 0, 0, 1 };
+		float s[3] = { 1, 1, 1 };
+		ReadNumbers(node["translation"], t, 3);
+		ReadNumbers(node["rotation"], r, 4);
+		ReadNumbers(node["scale"], s, 3);
+		return
+			XMMatrixScaling(s[0], s[1], s[2]) *
+			XMMatrixRotationQuaternion(XMVectorSet(r[0], r[1], r[2], r[3])) *
+			XMMatrixTranslation(t[0], t[1], t[2]);
+	}
+
+	void CollectInstances(const JsonValue& root, const JsonValue& nodeIndex, FXMMATRIX parent, size_t depth, std::vector<Instance>& out)
+	{
+		const JsonValue& nodes = root["nodes"];
+		size_t index;
+		if (!nodeIndex.IsNumber() || !ToSize(nodeIndex, 0, index) || index >= nodes.Size())
+			return;
+
+		// Nodes form a tree, so anything deeper than the node count is a cycle
+		if (depth > nodes.Size())
+			return;
+
+		const JsonValue& node = nodes[index];
+		XMMATRIX world = NodeMatrix(node) * parent;
+
+		size_t mesh;
+		if (node["mesh"].IsNumber() && ToSize(node["mesh"], 0, mesh) && mesh < root["meshes"].Size())
+		{
+			Instance instance;
+			instance.Mesh = (unsigned int)mesh;
+			XMStoreFloat4x4(&instance.World, world);
+
+			XMVECTOR determinant;
+			XMMATRIX inverse = XMMatrixInverse(&determinant, world);
+			XMStoreFloat4x4(&instance.NormalMatrix, XMMatrixTranspose(inverse));
+			instance.Mirrored = XMVectorGetX(determinant) < 0;
+
+			XMFLOAT4X4 identity;
+			XMStoreFloat4x4(&identity, XMMatrixIdentity());
+			instance.Identity = memcmp(&identity, &instance.World, sizeof(XMFLOAT4X4)) == 0;
+			out.push_back(instance);
+		}
+
+		const JsonValue& children = node["children"];
+		for (size_t c = 0; c < children.Size(); c++)
+			CollectInstances(root, children[c], world, depth + 1, out);
+	}
+
+	// The default scene's mesh nodes, or every mesh once when
+	// the file has no scenes
+	std::vector<Instance> FindInstances(const JsonValue& root)
+	{
+		std::vector<Instance> instances;
+		const JsonValue& scenes = root["scenes"];
+		if (scenes.Size() == 0)
+		{
+			for (size_t m = 0; m < root["meshes"].Size(); m++)
+			{
+				Instance instance;
+				instance.Mesh = (unsigned int)m;
+				XMStoreFloat4x4(&instance.World, XMMatrixIdentity());
+				instance.NormalMatrix = instance.World;
+				instance.Identity = true;
+				instance.Mirrored = false;
+				instances.push_back(instance);
+			}
+			return instances;
+		}
+
+		const JsonValue& sceneNodes = scenes[(size_t)root["scene"].Number(0)]["nodes"];
+		for (size_t n = 0; n < sceneNodes.Size(); n++)
+			CollectInstances(root, sceneNodes[n], XMMatrixIdentity(), 0, instances);
+		return instances;
+	}
+
+	// --------------------------------------------------------
+	// Bounds of a set's positions after its node transform and
+	// the Z flip
+	// - The accessor's min/max (required by the spec) are used
+	//    when present, otherwise the positions are scanned
+	// - Transformed min/max corners give conservative bounds
+	// --------------------------------------------------------
+	void SetBounds(const JsonValue& accessor, const VertexSet& set, const Instance& instance, XMFLOAT3& boundsMin, XMFLOAT3& boundsMax)
+	{
+		float low[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float high[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		const JsonValue& min = accessor["min"];
+		const JsonValue& max = accessor["max"];
+		if (min.Size() >= 3 && max.Size() >= 3 && set.Position.ComponentType == ComponentFloat)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				low[c] = (float)min[c].Number();
+				high[c] = (float)max[c].Number();
+			}
+		}
+		else
+		{
+			for (unsigned int i = 0; i < set.Position.Count; i++)
+			{
+				float p[3] = {};
+				ReadFloats(set.Position, i, p, 3);
+				for (int c = 0; c < 3; c++)
+				{
+					low[c] = std::min(low[c], p[c]);
+					high[c] = std::max(high[c], p[c]);
+				}
+			}
+		}
+
+		XMMATRIX world = XMLoadFloat4x4(&instance.World);
+		for (int corner = 0; corner < 8; corner++)
+		{
+			XMFLOAT3 p;
+			XMStoreFloat3(&p, XMVector3TransformCoord(XMVectorSet(
+				corner & 1 ? high[0] : low[0],
+				corner & 2 ? high[1] : low[1],
+				corner & 4 ? high[2] : low[2], 1), world));
+			p.z = -p.z;
+
+			boundsMin = XMFLOAT3(std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z));
+			boundsMax = XMFLOAT3(std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z));
+		}
+	}
+
+	// Area weighted (unnormalized cross products) smooth normals
+	void GenerateNormals(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+	{
+		for (Vertex& vertex : vertices)
+			vertex.Normal = XMFLOAT3(0, 0, 0);
+
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t + 1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t + 2]].Position);
+			XMVECTOR normal = XMVector3Cross(p1 - p0, p2 - p0);
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				XMFLOAT3& n = vertices[indices[t + corner]].Normal;
+				XMStoreFloat3(&n, XMLoadFloat3(&n) + normal);
+			}
+		}
+
+		for (Vertex& vertex : vertices)
+			XMStoreFloat3(&vertex.Normal, XMVector3Normalize(XMLoadFloat3(&vertex.Normal)));
+	}
+
+	// Points an accessor at one member of an array of Vertex
+	Accessor VertexAccessor(const std::vector<Vertex>& vertices, const float* member, unsigned int components)
+	{
+		Accessor accessor;
+		accessor.Data = (const char*)member;
+		accessor.Stride = sizeof(Vertex);
+		accessor.Count = (unsigned int)vertices.size();
+		accessor.ComponentType = ComponentFloat;
+		accessor.Components = components;
+		return accessor;
+	}
+
+	// --------------------------------------------------------
+	// Fills in a set's missing normals and/or tangents
+	// - Works in the file's own space (before transforms and the
+	//    Z flip), where front faces are counter-clockwise
+	// - All of the set's attributes are copied into a Vertex
+	//    array and the accessors pointed at it
+	// --------------------------------------------------------
+	void GenerateAttributes(VertexSet& set, const std::vector<PrimitiveRef>& primitives, unsigned int setIndex)
+	{
+		std::vector<unsigned int> indices;
+		for (const PrimitiveRef& primitive : primitives)
+		{
+			if (primitive.Set != setIndex)
+				continue;
+			for (unsigned int i = 0; i < primitive.IndexCount; i++)
+				indices.push_back(PrimitiveIndex(primitive, i));
+		}
+
+		std::vector<Vertex>& vertices = set.Generated;
+		vertices.assign(set.Position.Count, Vertex{});
+		for (unsigned int i = 0; i < set.Position.Count; i++)
+		{
+			ReadFloats(set.Position, i, &vertices[i].Position.x, 3);
+			if (set.UV.Data)
+				ReadFloats(set.UV, i, &vertices[i].UV.x, 2);
+			if (set.Normal.Data)
+				ReadFloats(set.Normal, i, &vertices[i].Normal.x, 3);
+			if (set.Tangent.Data)
+				ReadFloats(set.Tangent, i, &vertices[i].Tangent.x, 3);
+		}
+
+		if (!set.Normal.Data)
+			GenerateNormals(vertices, indices);
+		if (!set.Tangent.Data && !indices.empty())
+			TangentGenerator::Generate(&vertices[0], (unsigned int)vertices.size(), &indices[0], (unsigned int)indices.size());
+
+		set.Position = VertexAccessor(vertices, &vertices[0].Position.x, 3);
+		set.UV = VertexAccessor(vertices, &vertices[0].UV.x, 2);
+		set.Normal = VertexAccessor(vertices, &vertices[0].Normal.x, 3);
+		set.Tangent = VertexAccessor(vertices, &vertices[0].Tangent.x, 3);
+	}
+
+	// --------------------------------------------------------
+	// Reads, transforms and packs every vertex of a set
+	// - One Vertex at a time on the stack, in parallel blocks
+	// --------------------------------------------------------
+	void PackSet(const VertexSet& set, const Instance& instance, const VertexQuantization& quantization, PackedVertex* out)
+	{
+		unsigned int count = set.Position.Count;
+		unsigned int blockCount = (count + PackBlockSize - 1) / PackBlockSize;
+
+		ThreadPool::Get().ParallelFor(blockCount, [&](size_t block)
+		{
+			XMMATRIX world = XMLoadFloat4x4(&instance.World);
+			XMMATRIX normalMatrix = XMLoadFloat4x4(&instance.NormalMatrix);
+
+			unsigned int start = (unsigned int)block * PackBlockSize;
+			unsigned int end = std::min(start + PackBlockSize, count);
+			for (unsigned int i = start; i < end; i++)
+			{
+				Vertex vertex = {};
+				ReadFloats(set.Position, i, &vertex.Position.x, 3);
+				ReadFloats(set.Normal, i, &vertex.Normal.x, 3);
+				ReadFloats(set.Tangent, i, &vertex.Tangent.x, 3);
+				if (set.UV.Data)
+					ReadFloats(set.UV, i, &vertex.UV.x, 2);
+
+				if (!instance.Identity)
+				{
+					XMStoreFloat3(&vertex.Position, XMVector3TransformCoord(XMLoadFloat3(&vertex.Position), world));
+					XMStoreFloat3(&vertex.Normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&vertex.Normal), normalMatrix)));
+					XMStoreFloat3(&vertex.Tangent, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&vertex.Tangent), world)));
+				}
+
+				// Right-handed to left-handed
+				vertex.Position.z = -vertex.Position.z;
+				vertex.Normal.z = -vertex.Normal.z;
+				vertex.Tangent.z = -vertex.Tangent.z;
+
+				out[i] = VertexPacking::Pack(vertex, quantization);
+			}
+		});
+	}
+
+	// --------------------------------------------------------
+	// Uses the file's index data as the whole index buffer when
+	// it already is one: a single vertex set (so no offsets), no
+	// mirrored node (so no winding change), and every primitive's
+	// 16/32-bit indices following the previous one's
+	// --------------------------------------------------------
+	bool UseIndicesInPlace(const std::vector<VertexSet>& sets, const std::vector<Instance>& instances, const std::vector<PrimitiveRef>& primitives, GltfMeshData& out)
+	{
+		if (sets.size() != 1 || instances[sets[0].Instance].Mirrored)
+			return false;
+
+		const Accessor& first = primitives[0].Indices;
+		if (!first.Data || (first.ComponentType != ComponentUnsignedShort && first.ComponentType != ComponentUnsignedInt))
+			return false;
+
+		unsigned int size = ComponentSize(first.ComponentType);
+		const char* next = first.Data;
+		unsigned int indexCount = 0;
+		for (const PrimitiveRef& primitive : primitives)
+		{
+			const Accessor& indices = primitive.Indices;
+			if (indices.Data != next || indices.ComponentType != first.ComponentType ||
+				indices.Stride != size || indices.Count != primitive.IndexCount)
+				return false;
+
+			next += (size_t)size * indices.Count;
+			indexCount += indices.Count;
+		}
+
+		out.Indices = first.Data;
+		out.IndexStride = size;
+		out.IndexCount = indexCount;
+		out.IndicesInPlace = true;
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// Builds the index buffer: each primitive's indices offset
+	// to its set's vertices, reversed for mirrored nodes (whose
+	// front faces are clockwise in the file), in 16 bits when
+	// every vertex fits
+	// --------------------------------------------------------
+	template<typename T>
+	void ConvertIndices(const std::vector<VertexSet>& sets, const std::vector<Instance>& instances, const std::vector<PrimitiveRef>& primitives, T* out)
+	{
+		for (const PrimitiveRef& primitive : primitives)
+		{
+			const VertexSet& set = sets[primitive.Set];
+			bool reverse = instances[set.Instance].Mirrored;
+			for (unsigned int i = 0; i < primitive.IndexCount; i += 3)
+			{
+				out[0] = (T)(set.VertexStart + PrimitiveIndex(primitive, i));
+				out[1] = (T)(set.VertexStart + PrimitiveIndex(primitive, reverse ? i + 2 : i + 1));
+				out[2] = (T)(set.VertexStart + PrimitiveIndex(primitive, reverse ? i + 1 : i + 2));
+				out += 3;
+			}
+		}
+	}
+
+	// Decodes %XX escapes in a relative URI
+	std::string DecodeUri(const std::string& uri)
+	{
+		std::string decoded;
+		for (size_t i = 0; i < uri.size(); i++)
+		{
+			if (uri[i] == '%' && i + 2 < uri.size() && isxdigit((unsigned char)uri[i + 1]) && isxdigit((unsigned char)uri[i + 2]))
+			{
+				decoded += (char)strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16);
+				i += 2;
+			}
+			else
+				decoded += uri[i];
+		}
+		return decoded;
+	}
+
+	// The file of a texture, relative to the .GLB (or empty when
+	// the image is embedded, which isn't supported)
+	std::wstring TexturePath(const JsonValue& root, const JsonValue& textureInfo)
+	{
+		size_t textureIndex, imageIndex;
+		if (!textureInfo["index"].IsNumber() || !ToSize(textureInfo["index"], 0, textureIndex))
+			return std::wstring();
+
+		const JsonValue& source = root["textures"][textureIndex]["source"];
+		if (!source.IsNumber() || !ToSize(source, 0, imageIndex))
+			return std::wstring();
+
+		const std::string& uri = root["images"][imageIndex]["uri"].String();
+		if (uri.empty() || uri.compare(0, 5, "data:") == 0)
+			return std::wstring();
+
+		return std::filesystem::path(DecodeUri(uri)).wstring();
+	}
+
+	// --------------------------------------------------------
+	// glTF's metallic-roughness materials as MtlMaterials
+	// - glTF roughness is perceptual, and our lighting takes
+	//    alpha = roughness^2 (see MtlParser)
+	// - Unnamed materials are called "material<index>"
+	// --------------------------------------------------------
+	void ReadMaterials(const JsonValue& root, std::vector<MtlMaterial>& out)
+	{
+		const JsonValue& materials = root["materials"];
+		for (size_t m = 0; m < materials.Size(); m++)
+		{
+			const JsonValue& material = materials[m];
+			const JsonValue& pbr = material["pbrMetallicRoughness"];
+
+			MtlMaterial mtl;
+			mtl.Name = material["name"].String();
+			if (mtl.Name.empty())
+				mtl.Name = "material" + std::to_string(m);
+
+			float color[4] = { 1, 1, 1, 1 };
+			ReadNumbers(pbr["baseColorFactor"], color, 4);
+			mtl.Diffuse = XMFLOAT3(color[0], color[1], color[2]);
+			mtl.Opacity = color[3];
+
+			float roughness = (float)pbr["roughnessFactor"].Number(1);
+			mtl.Roughness = roughness * roughness;
+			mtl.Metalness = (float)pbr["metallicFactor"].Number(1);
+			mtl.DiffuseMap = TexturePath(root, pbr["baseColorTexture"]);
+			mtl.NormalMap = TexturePath(root, material["normalTexture"]);
+			out.push_back(mtl);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Reads a .GLB file (see Vfs) and loads it, making texture
+// paths full paths
+// - Returns false if the file can't be read or isn't a
+//    valid .GLB with at least one triangle
+// --------------------------------------------------------
+bool GltfLoader::Load(const std::wstring& path, MappedFile& file, GltfMeshData& out)
+{
+	ByteSpan data;
+	if (!Vfs::Read(path, file, data) || !Parse(data.Data, data.Size, out))
+		return false;
+
+	std::filesystem::path folder = std::filesystem::path(path).parent_path();
+	for (MtlMaterial& material : out.Materials)
+	{
+		for (std::wstring* map : { &material.DiffuseMap, &material.NormalMap })
+		{
+			if (!map->empty())
+				*map = (folder / *map).wstring();
+		}
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Loads a .GLB that is already in memory (which out.Indices
+// may point into)
+// --------------------------------------------------------
+bool GltfLoader::Parse(const char* data, size_t size, GltfMeshData& out)
+{
+	out = GltfMeshData();
+
+	// 12 byte header, then chunks of { length, type, data }
+	uint32_t header[3];
+	if (size < 20)
+		return false;
+	memcpy(header, data, sizeof(header));
+	if (header[0] != GlbMagic || header[1] != 2 || header[2] > size)
+		return false;
+	size = header[2];
+
+	uint32_t chunk[2];
+	memcpy(chunk, data + 12, sizeof(chunk));
+	if (chunk[1] != JsonChunk || chunk[0] > size - 20)
+		return false;
+
+	JsonValue root;
+	if (!Json::Parse(data + 20, chunk[0], root))
+		return false;
+
+	// The binary chunk, if there is one, follows the JSON
+	const char* bin = nullptr;
+	size_t binSize = 0;
+	size_t binHeader = 20 + (size_t)chunk[0];
+	if (binHeader + 8 <= size)
+	{
+		memcpy(chunk, data + binHeader, sizeof(chunk));
+		if (chunk[1] == BinChunk && chunk[0] <= size - binHeader - 8)
+		{
+			bin = data + binHeader + 8;
+			binSize = chunk[0];
+		}
+	}
+
+	// Every triangle primitive of every mesh node, with primitives of
+	// the same node that use the same attributes sharing vertices
+	std::vector<Instance> instances = FindInstances(root);
+	std::vector<VertexSet> sets;
+	std::vector<PrimitiveRef> primitives;
+	std::map<std::tuple<unsigned int, double, double, double, double>, unsigned int> setLookup;
+
+	for (unsigned int n = 0; n < instances.size(); n++)
+	{
+		const JsonValue& mesh = root["meshes"][instances[n].Mesh];
+		const JsonValue& meshPrimitives = mesh["primitives"];
+		for (size_t p = 0; p < meshPrimitives.Size(); p++)
+		{
+			const JsonValue& primitive = meshPrimitives[p];
+			const JsonValue& attributes = primitive["attributes"];
+			if (primitive["mode"].Number(TrianglesMode) != TrianglesMode)
+				continue;
+
+			auto key = std::make_tuple(n,
+				attributes["POSITION"].Number(-1),
+				attributes["NORMAL"].Number(-1),
+				attributes["TEXCOORD_0"].Number(-1),
+				attributes["TANGENT"].Number(-1));
+
+			auto found = setLookup.find(key);
+			unsigned int setIndex;
+			if (found != setLookup.end())
+				setIndex = found->second;
+			else
+			{
+				VertexSet set;
+				set.Instance = n;
+				ToSize(attributes["POSITION"], 0, set.PositionIndex);
+				if (!GetAccessor(root, bin, binSize, attributes["POSITION"], set.Position) || set.Position.Components < 3)
+					continue;
+
+				// Unusable optional attributes are treated as missing
+				auto optional = [&](const char* name, unsigned int components, Accessor& accessor)
+				{
+					if (!GetAccessor(root, bin, binSize, attributes[name], accessor) ||
+						accessor.Components < components || accessor.Count != set.Position.Count)
+						accessor = Accessor();
+				};
+				optional("NORMAL", 3, set.Normal);
+				optional("TEXCOORD_0", 2, set.UV);
+				optional("TANGENT", 3, set.Tangent);
+
+				setIndex = (unsigned int)sets.size();
+				setLookup[key] = setIndex;
+				sets.push_back(std::move(set));
+			}
+
+			PrimitiveRef ref;
+			ref.Set = setIndex;
+			ref.Name = mesh["name"].String();
+			ref.Material = primitive["material"].IsNumber() ? (int)primitive["material"].Number() : -1;
+			if (primitive.Has("indices"))
+			{
+				if (!GetAccessor(root, bin, binSize, primitive["indices"], ref.Indices) || ref.Indices.Components != 1 ||
+					ref.Indices.ComponentType == ComponentByte || ref.Indices.ComponentType == ComponentShort || ref.Indices.ComponentType == ComponentFloat)
+					continue;
+				ref.IndexCount = ref.Indices.Count / 3 * 3;
+			}
+			else
+				ref.IndexCount = sets[setIndex].Position.Count / 3 * 3;
+
+			// Every index has to be one of the set's vertices
+			bool valid = true;
+			unsigned int vertexCount = sets[setIndex].Position.Count;
+			for (unsigned int i = 0; i < ref.IndexCount && valid; i++)
+				valid = PrimitiveIndex(ref, i) < vertexCount;
+			if (!valid)
+				return false;
+
+			if (ref.IndexCount > 0)
+				primitives.push_back(ref);
+		}
+	}
+
+	if (primitives.empty())
+		return false;
+
+	// Place each set's vertices, count streams, and find the bounds
+	XMFLOAT3 boundsMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 boundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	size_t vertexCount = 0;
+	for (unsigned int s = 0; s < sets.size(); s++)
+	{
+		VertexSet& set = sets[s];
+		set.VertexStart = (unsigned int)vertexCount;
+		vertexCount += set.Position.Count;
+		if (vertexCount > UINT32_MAX)
+			return false;
+
+		for (const Accessor* accessor : { &set.Position, &set.Normal, &set.UV, &set.Tangent })
+		{
+			if (accessor->Data && accessor->ComponentType == ComponentFloat)
+				out.DirectStreams++;
+			else if (accessor->Data || accessor != &set.UV)
+				out.ConvertedStreams++;
+		}
+
+		SetBounds(root["accessors"][set.PositionIndex], set, instances[set.Instance], boundsMin, boundsMax);
+	}
+	out.BoundsMin = boundsMin;
+	out.BoundsMax = boundsMax;
+
+	for (unsigned int s = 0; s < sets.size(); s++)
+	{
+		if (!sets[s].Normal.Data || !sets[s].Tangent.Data)
+			GenerateAttributes(sets[s], primitives, s);
+	}
+
+	VertexQuantization quantization = VertexPacking::QuantizationFromBounds(boundsMin, boundsMax);
+	out.Vertices.resize(vertexCount);
+	for (const VertexSet& set : sets)
+		PackSet(set, instances[set.Instance], quantization, &out.Vertices[set.VertexStart]);
+
+	// Primitives become submeshes in file order
+	ReadMaterials(root, out.Materials);
+	unsigned int indexStart = 0;
+	for (const PrimitiveRef& primitive : primitives)
+	{
+		GltfPrimitive result;
+		result.Name = primitive.Name;
+		if (primitive.Material >= 0 && primitive.Material < (int)out.Materials.size())
+			result.Material = out.Materials[primitive.Material].Name;
+		result.IndexStart = indexStart;
+		result.IndexCount = primitive.IndexCount;
+		out.Primitives.push_back(result);
+		indexStart += primitive.IndexCount;
+	}
+
+	if (!UseIndicesInPlace(sets, instances, primitives, out))
+	{
+		out.IndexCount = indexStart;
+		out.IndexStride = vertexCount < VertexPacking::MaxShortIndexVertices ? sizeof(uint16_t) : sizeof(unsigned int);
+		out.IndexStorage.resize((size_t)indexStart * out.IndexStride);
+		if (out.IndexStride == sizeof(uint16_t))
+			ConvertIndices(sets, instances, primitives, (uint16_t*)&out.IndexStorage[0]);
+		else
+			ConvertIndices(sets, instances, primitives, (unsigned int*)&out.IndexStorage[0]);
+		out.Indices = &out.IndexStorage[0];
+	}
+	return true;
+}
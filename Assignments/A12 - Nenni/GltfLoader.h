@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Vfs.h"
+#include "MtlParser.h"
+#include "VertexPacking.h"
+
+// --------------------------------------------------------
+// One glTF mesh primitive, as a range of the index buffer
+// - Name is the glTF mesh's name, Material the name of the
+//    primitive's material (matching GltfMeshData::Materials)
+// --------------------------------------------------------
+struct GltfPrimitive
+{
+	std::string Name;
+	std::string Material;
+	unsigned int IndexStart;
+	unsigned int IndexCount;
+};
+
+// --------------------------------------------------------
+// Result of loading a .GLB file
+//
+// - Every triangle primitive of the default scene, with node
+//    transforms baked in, converted to DirectX's left-handed
+//    space by flipping Z
+// - Winding is NOT flipped (so the indices can be used as
+//    they are): front faces are counter-clockwise
+// - Vertices are already packed for the GPU, quantized to
+//    BoundsMin/BoundsMax
+// - Indices either point straight into the mapped file (when
+//    the file's index data is already the whole index buffer)
+//    or into IndexStorage
+// --------------------------------------------------------
+struct GltfMeshData
+{
+	std::vector<PackedVertex> Vertices;
+	const void* Indices = nullptr;
+	unsigned int IndexCount = 0;
+	unsigned int IndexStride = sizeof(unsigned int);
+	std::vector<char> IndexStorage;
+
+	std::vector<GltfPrimitive> Primitives;
+
+	// One per glTF material (pbrMetallicRoughness factors, and
+	// base color/normal textures that are separate files)
+	std::vector<MtlMaterial> Materials;
+
+	XMFLOAT3 BoundsMin = XMFLOAT3(0, 0, 0);
+	XMFLOAT3 BoundsMax = XMFLOAT3(0, 0, 0);
+
+	// Vertex attribute streams read in place vs. ones that had to
+	// be converted (normalized integers, or generated normals and
+	// tangents), and whether the index buffer is the file's own
+	unsigned int DirectStreams = 0;
+	unsigned int ConvertedStreams = 0;
+	bool IndicesInPlace = false;
+};
+
+// --------------------------------------------------------
+// Binary glTF 2.0 (.GLB) loading
+//
+// - The file is mapped (or read from the pack, see Vfs) and the
+//    JSON chunk parsed; every accessor is then read straight
+//    out of the binary chunk
+// - Tightly packed float positions, normals, tangents and uvs
+//    are read in place and packed directly into PackedVertex
+//    (no intermediate Vertex array), in parallel
+// - 16/32-bit index data that already forms the whole index
+//    buffer is handed to the GPU from the mapped file; other
+//    index data (8-bit, split up, or shared by several nodes)
+//    is converted
+// - Bounds come from the POSITION accessors' min/max
+// - Missing normals or tangents are generated (see
+//    TangentGenerator), which needs a temporary Vertex array
+// - Only buffers stored in the .GLB itself are supported, and
+//    sparse accessors and non-triangle primitives are skipped
+// --------------------------------------------------------
+namespace GltfLoader
+{
+	// file (only opened for unpacked files, see Vfs) must stay
+	// open while out is used (see Indices)
+	bool Load(const std::wstring& path, MappedFile& file, GltfMeshData& out);
+	bool Parse(const char* data, size_t size, GltfMeshData& out);
+}
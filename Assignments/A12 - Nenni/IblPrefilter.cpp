@@ -0,0 +1,626 @@
+#include "IblPrefilter.h"
+#include "BcEncoder.h"
+#include "DdsFile.h"
+#include "MappedFile.h"
+#include "PngDecoder.h"
+#include "ThreadPool.h"
+#include "Vfs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IBL_PREFILTER_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	const float Pi = 3.14159265359f;
+	const float Gamma = 2.2f;
+
+	// Largest faces irradiance is projected from; more detail
+	// than that doesn't change 9 coefficients
+	const unsigned int IrradianceSize = 64;
+
+	// --------------------------------------------------------
+	// Four floats processed together (here, a texel's RGBA):
+	// SSE when available, plain loops otherwise
+	// --------------------------------------------------------
+#ifdef IBL_PREFILTER_SSE
+	struct Float4
+	{
+		__m128 v;
+	};
+
+	inline Float4 Load(const float* lanes) { return { _mm_loadu_ps(lanes) }; }
+	inline Float4 Splat(float a) { return { _mm_set1_ps(a) }; }
+	inline void Store(float* lanes, Float4 a) { _mm_storeu_ps(lanes, a.v); }
+	inline Float4 operator+(Float4 a, Float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+	inline Float4 operator-(Float4 a, Float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+	inline Float4 operator*(Float4 a, Float4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+#else
+	struct Float4
+	{
+		float v[4];
+	};
+
+	template<typename Op>
+	inline Float4 Map(Float4 a, Float4 b, Op op)
+	{
+		Float4 r;
+		for (int i = 0; i < 4; i++)
+			r.v[i] = op(a.v[i], b.v[i]);
+		return r;
+	}
+
+	inline Float4 Load(const float* lanes) { return { { lanes[0], lanes[1], lanes[2], lanes[3] } }; }
+	inline Float4 Splat(float a) { return { { a, a, a, a } }; }
+	inline void Store(float* lanes, Float4 a) { for (int i = 0; i < 4; i++) lanes[i] = a.v[i]; }
+	inline Float4 operator+(Float4 a, Float4 b) { return Map(a, b, [](float x, float y) { return x + y; }); }
+	inline Float4 operator-(Float4 a, Float4 b) { return Map(a, b, [](float x, float y) { return x - y; }); }
+	inline Float4 operator*(Float4 a, Float4 b) { return Map(a, b, [](float x, float y) { return x * y; }); }
+#endif
+
+	// One mip of a cube map as light: 4 floats (RGBA) per
+	// texel, rows packed
+	struct CubeLevel
+	{
+		unsigned int Size = 0;
+		std::vector<float> Faces[6];
+	};
+
+	// How each face's direction follows from (s, t), both -1 to
+	// 1 (s to the right, t down): for x, y and z, the factors
+	// of s and t and a constant
+	const float FaceAxes[6][3][3] =
+	{
+		{ { 0, 0, 1 }, { 0, -1, 0 }, { -1, 0, 0 } },	// +X
+		{ { 0, 0, -1 }, { 0, -1, 0 }, { 1, 0, 0 } },	// -X
+		{ { 1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } },		// +Y
+		{ { 1, 0, 0 }, { 0, 0, -1 }, { 0, -1, 0 } },	// -Y
+		{ { 1, 0, 0 }, { 0, -1, 0 }, { 0, 0, 1 } },		// +Z
+		{ { -1, 0, 0 }, { 0, -1, 0 }, { 0, 0, -1 } }	// -Z
+	};
+
+	XMFLOAT3 Normalize(XMFLOAT3 v)
+	{
+		float length = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+		return XMFLOAT3(v.x / length, v.y / length, v.z / length);
+	}
+
+	XMFLOAT3 Cross(XMFLOAT3 a, XMFLOAT3 b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	// Unit direction through the center of a texel
+	XMFLOAT3 TexelDirection(unsigned int face, unsigned int x, unsigned int y, unsigned int size)
+	{
+		float s = (x + 0.5f) * 2.0f / size - 1.0f;
+		float t = (y + 0.5f) * 2.0f / size - 1.0f;
+		const float (*axes)[3] = FaceAxes[face];
+		return Normalize(XMFLOAT3(
+			axes[0][0] * s + axes[0][1] * t + axes[0][2],
+			axes[1][0] * s + axes[1][1] * t + axes[1][2],
+			axes[2][0] * s + axes[2][1] * t + axes[2][2]));
+	}
+
+	// The face a direction points into and where on it (the
+	// inverse of FaceAxes)
+	void FindFace(float x, float y, float z, unsigned int& face, float& s, float& t)
+	{
+		float ax = fabsf(x);
+		float ay = fabsf(y);
+		float az = fabsf(z);
+		if (ax >= ay && ax >= az)
+		{
+			face = x >= 0 ? 0 : 1;
+			s = (x >= 0 ? -z : z) / ax;
+			t = -y / ax;
+		}
+		else if (ay >= az)
+		{
+			face = y >= 0 ? 2 : 3;
+			s = x / ay;
+			t = (y >= 0 ? z : -z) / ay;
+		}
+		else
+		{
+			face = z >= 0 ? 4 : 5;
+			s = (z >= 0 ? x : -x) / az;
+			t = -y / az;
+		}
+	}
+
+	// Bilinear within one face (edges clamp rather than
+	// blending into the next face)
+	Float4 SampleFace(const CubeLevel& level, unsigned int face, float s, float t)
+	{
+		float last = level.Size - 1.0f;
+		float fx = std::clamp((s * 0.5f + 0.5f) * level.Size - 0.5f, 0.0f, last);
+		float fy = std::clamp((t * 0.5f + 0.5f) * level.Size - 0.5f, 0.0f, last);
+		unsigned int x0 = (unsigned int)fx;
+		unsigned int y0 = (unsigned int)fy;
+		unsigned int x1 = std::min(x0 + 1, level.Size - 1);
+		unsigned int y1 = std::min(y0 + 1, level.Size - 1);
+
+		const float* texels = level.Faces[face].data();
+		Float4 topLeft = Load(texels + ((size_t)y0 * level.Size + x0) * 4);
+		Float4 topRight = Load(texels + ((size_t)y0 * level.Size + x1) * 4);
+		Float4 bottomLeft = Load(texels + ((size_t)y1 * level.Size + x0) * 4);
+		Float4 bottomRight = Load(texels + ((size_t)y1 * level.Size + x1) * 4);
+
+		Float4 across = Splat(fx - x0);
+		Float4 top = topLeft + (topRight - topLeft) * across;
+		Float4 bottom = bottomLeft + (bottomRight - bottomLeft) * across;
+		return top + (bottom - top) * Splat(fy - y0);
+	}
+
+	// Trilinear: between the two mips around lod
+	Float4 SampleCube(const std::vector<CubeLevel>& levels, float x, float y, float z, float lod)
+	{
+		unsigned int face;
+		float s, t;
+		FindFace(x, y, z, face, s, t);
+
+		lod = std::clamp(lod, 0.0f, levels.size() - 1.0f);
+		unsigned int level = (unsigned int)lod;
+		float blend = lod - level;
+
+		Float4 color = SampleFace(levels[level], face, s, t);
+		if (blend > 0.0f && level + 1 < levels.size())
+			color = color + (SampleFace(levels[level + 1], face, s, t) - color) * Splat(blend);
+		return color;
+	}
+
+	// --------------------------------------------------------
+	// Decodes the faces into light and box filters them down to
+	// 1x1, every face in parallel
+	// - Nothing reads finer than the top specular mip, so larger
+	//    faces start out averaged down to that size
+	// --------------------------------------------------------
+	bool BuildSourceLevels(const std::vector<Image>& faces, std::vector<CubeLevel>& levels)
+	{
+		if (faces.size() != 6 || faces[0].Width == 0)
+			return false;
+		for (const Image& face : faces)
+		{
+			if (face.Width != faces[0].Width || face.Height != faces[0].Width || face.Format != faces[0].Format ||
+				face.Pixels.size() != face.GetSize())
+				return false;
+		}
+
+		float toLinear[256];
+		for (int i = 0; i < 256; i++)
+			toLinear[i] = powf(i / 255.0f, Gamma);
+
+		unsigned int faceSize = faces[0].Width;
+		levels.assign(1, CubeLevel());
+		levels[0].Size = std::min(faceSize, IblPrefilter::SpecularSize);
+		unsigned int size = levels[0].Size;
+
+		std::vector<char> decoded(6, 0);
+		ThreadPool::Get().ParallelFor(6, [&](size_t f)
+		{
+			Image rgba;
+			if (faces[f].IsBlockCompressed())
+			{
+				if (!BcEncoder::Decode(faces[f], rgba))
+					return;
+				rgba = Images::ToRgba(rgba);
+			}
+			else
+			{
+				rgba = Images::ToRgba(faces[f]);
+			}
+
+			// Each texel averages the face pixels it covers
+			std::vector<float>& texels = levels[0].Faces[f];
+			texels.resize((size_t)size * size * 4);
+			for (unsigned int y = 0; y < size; y++)
+			{
+				unsigned int top = y * faceSize / size;
+				unsigned int bottom = (y + 1) * faceSize / size;
+				for (unsigned int x = 0; x < size; x++)
+				{
+					unsigned int left = x * faceSize / size;
+					unsigned int right = (x + 1) * faceSize / size;
+
+					Float4 sum = Splat(0.0f);
+					for (unsigned int py = top; py < bottom; py++)
+					{
+						const uint8_t* pixel = &rgba.Pixels[((size_t)py * faceSize + left) * 4];
+						for (unsigned int px = left; px < right; px++, pixel += 4)
+						{
+							float light[4] = { toLinear[pixel[0]], toLinear[pixel[1]], toLinear[pixel[2]], pixel[3] / 255.0f };
+							sum = sum + Load(light);
+						}
+					}
+					Store(&texels[((size_t)y * size + x) * 4], sum * Splat(1.0f / ((bottom - top) * (right - left))));
+				}
+			}
+			decoded[f] = 1;
+		});
+		if (std::count(decoded.begin(), decoded.end(), 1) != 6)
+			return false;
+
+		while (levels.back().Size > 1)
+		{
+			levels.emplace_back();
+			const CubeLevel& above = levels[levels.size() - 2];
+			CubeLevel& level = levels.back();
+			level.Size = above.Size / 2;
+
+			ThreadPool::Get().ParallelFor(6, [&](size_t f)
+			{
+				level.Faces[f].resize((size_t)level.Size * level.Size * 4);
+				for (unsigned int y = 0; y < level.Size; y++)
+				{
+					for (unsigned int x = 0; x < level.Size; x++)
+					{
+						const float* row0 = &above.Faces[f][((size_t)y * 2 * above.Size + x * 2) * 4];
+						const float* row1 = row0 + (size_t)above.Size * 4;
+						Float4 sum = Load(row0) + Load(row0 + 4) + Load(row1) + Load(row1 + 4);
+						Store(&level.Faces[f][((size_t)y * level.Size + x) * 4], sum * Splat(0.25f));
+					}
+				}
+			});
+		}
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// Projects a small mip of the cube onto the SH basis, each
+	// texel weighted by the solid angle it covers
+	// - Rows are summed in parallel, then added up in a fixed
+	//    order, so every run gives the same coefficients
+	// --------------------------------------------------------
+	SphericalHarmonics9 ProjectIrradiance(const std::vector<CubeLevel>& levels)
+	{
+		const CubeLevel* level = &levels.back();
+		for (const CubeLevel& candidate : levels)
+		{
+			if (candidate.Size <= IrradianceSize)
+			{
+				level = &candidate;
+				break;
+			}
+		}
+
+		unsigned int size = level->Size;
+		std::vector<float> rowSums((size_t)size * 6 * SphericalHarmonics::CoefficientCount * 4);
+		ThreadPool::Get().ParallelFor((size_t)size * 6, [&](size_t row)
+		{
+			unsigned int face = (unsigned int)(row / size);
+			unsigned int y = (unsigned int)(row % size);
+			float texelArea = (2.0f / size) * (2.0f / size);
+
+			Float4 sums[SphericalHarmonics::CoefficientCount];
+			for (Float4& sum : sums)
+				sum = Splat(0.0f);
+
+			for (unsigned int x = 0; x < size; x++)
+			{
+				// dw = dA / (1 + s^2 + t^2)^(3/2) on a face at distance 1
+				float s = (x + 0.5f) * 2.0f / size - 1.0f;
+				float t = (y + 0.5f) * 2.0f / size - 1.0f;
+				float distanceSquared = 1.0f + s * s + t * t;
+				float solidAngle = texelArea / (distanceSquared * sqrtf(distanceSquared));
+
+				XMFLOAT3 direction = TexelDirection(face, x, y, size);
+				float basis[SphericalHarmonics::CoefficientCount];
+				SphericalHarmonics::EvaluateBasis(direction.x, direction.y, direction.z, basis);
+
+				Float4 color = Load(&level->Faces[face][((size_t)y * size + x) * 4]);
+				for (unsigned int i = 0; i < SphericalHarmonics::CoefficientCount; i++)
+					sums[i] = sums[i] + color * Splat(basis[i] * solidAngle);
+			}
+
+			for (unsigned int i = 0; i < SphericalHarmonics::CoefficientCount; i++)
+				Store(&rowSums[(row * SphericalHarmonics::CoefficientCount + i) * 4], sums[i]);
+		});
+
+		SphericalHarmonics9 radiance;
+		for (size_t row = 0; row < (size_t)size * 6; row++)
+		{
+			for (unsigned int i = 0; i < SphericalHarmonics::CoefficientCount; i++)
+			{
+				const float* sum = &rowSums[(row * SphericalHarmonics::CoefficientCount + i) * 4];
+				radiance.Coefficients[i].x += sum[0];
+				radiance.Coefficients[i].y += sum[1];
+				radiance.Coefficients[i].z += sum[2];
+			}
+		}
+		return SphericalHarmonics::ToIrradiance(radiance);
+	}
+
+	// Light directions around +Z (the normal, which is also the
+	// view and reflection) to average for one roughness
+	struct SampleSet
+	{
+		std::vector<XMFLOAT3> Directions;
+		std::vector<float> Weights;		// N dot L
+		std::vector<float> Lods;		// Source mip to read
+		float TotalWeight = 0.0f;
+	};
+
+	float RadicalInverse(uint32_t bits)
+	{
+		bits = (bits << 16) | (bits >> 16);
+		bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+		bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+		bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+		bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+		return bits * 2.3283064365386963e-10f;
+	}
+
+	// --------------------------------------------------------
+	// GGX importance samples (Hammersley points) for one
+	// roughness, the same for every texel
+	// - A sample's mip covers about the solid angle it stands
+	//    for: 1 / (count * pdf), where pdf = D / 4 when N = V
+	// - minLod keeps samples from reading finer than the output
+	//    texel itself
+	// --------------------------------------------------------
+	SampleSet MakeSamples(float roughness, unsigned int sourceSize, float minLod)
+	{
+		SampleSet samples;
+		if (roughness <= 0.0f)
+		{
+			samples.Directions.push_back(XMFLOAT3(0, 0, 1));
+			samples.Weights.push_back(1.0f);
+			samples.Lods.push_back(minLod);
+			samples.TotalWeight = 1.0f;
+			return samples;
+		}
+
+		float alphaSquared = roughness * roughness;
+		float texelSolidAngle = 4.0f * Pi / (6.0f * sourceSize * sourceSize);
+		for (unsigned int i = 0; i < IblPrefilter::SampleCount; i++)
+		{
+			float phi = 2.0f * Pi * i / IblPrefilter::SampleCount;
+			float u = RadicalInverse(i);
+			float cosTheta = sqrtf((1.0f - u) / (1.0f + (alphaSquared - 1.0f) * u));
+			float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+
+			// L = reflect(-V, H) with V = N = +Z
+			XMFLOAT3 light(2.0f * cosTheta * sinTheta * cosf(phi), 2.0f * cosTheta * sinTheta * sinf(phi), 2.0f * cosTheta * cosTheta - 1.0f);
+			if (light.z <= 0.0f)
+				continue;
+
+			float denominator = cosTheta * cosTheta * (alphaSquared - 1.0f) + 1.0f;
+			float distribution = alphaSquared / (Pi * denominator * denominator);
+			float sampleSolidAngle = 1.0f / (IblPrefilter::SampleCount * distribution * 0.25f);
+
+			samples.Directions.push_back(light);
+			samples.Weights.push_back(light.z);
+			samples.Lods.push_back(std::max(0.5f * log2f(sampleSolidAngle / texelSolidAngle) + 1.0f, minLod));
+			samples.TotalWeight += light.z;
+		}
+		return samples;
+	}
+
+	// Gamma encoded RGBA8, like the source textures
+	void EncodeTexel(Float4 light, uint8_t* out)
+	{
+		float channels[4];
+		Store(channels, light);
+		for (int c = 0; c < 3; c++)
+			out[c] = (uint8_t)(powf(std::clamp(channels[c], 0.0f, 1.0f), 1.0f / Gamma) * 255.0f + 0.5f);
+		out[3] = 255;
+	}
+
+	// --------------------------------------------------------
+	// Every specular mip, each row of each face of each mip a
+	// job on the pool
+	// --------------------------------------------------------
+	void PrefilterSpecular(const std::vector<CubeLevel>& levels, PrefilteredEnvironment& out)
+	{
+		unsigned int sourceSize = levels[0].Size;
+		out.SpecularSize = std::min(IblPrefilter::SpecularSize, sourceSize);
+		out.SpecularMipCount = 1;
+		while (out.SpecularMipCount < IblPrefilter::SpecularMipCount && (out.SpecularSize >> out.SpecularMipCount) > 0)
+			out.SpecularMipCount++;
+
+		struct MipJob
+		{
+			SampleSet Samples;
+			unsigned int Size;
+			size_t FirstRow;
+		};
+		std::vector<MipJob> mips(out.SpecularMipCount);
+		size_t rowCount = 0;
+		for (unsigned int m = 0; m < out.SpecularMipCount; m++)
+		{
+			mips[m].Size = out.SpecularSize >> m;
+			mips[m].FirstRow = rowCount;
+			rowCount += (size_t)mips[m].Size * 6;
+
+			float roughness = out.SpecularMipCount > 1 ? (float)m / (out.SpecularMipCount - 1) : 0.0f;
+			mips[m].Samples = MakeSamples(roughness, sourceSize, log2f((float)sourceSize / mips[m].Size));
+		}
+
+		out.Specular.assign(6 * out.SpecularMipCount, Image());
+		for (unsigned int face = 0; face < 6; face++)
+		{
+			for (unsigned int m = 0; m < out.SpecularMipCount; m++)
+			{
+				Image& image = out.Specular[face * out.SpecularMipCount + m];
+				image.Width = image.Height = mips[m].Size;
+				image.Format = ImageFormat::RGBA8;
+				image.Pixels.resize(image.GetSize());
+			}
+		}
+
+		ThreadPool::Get().ParallelFor(rowCount, [&](size_t row)
+		{
+			unsigned int m = 0;
+			while (m + 1 < out.SpecularMipCount && row >= mips[m + 1].FirstRow)
+				m++;
+			const MipJob& mip = mips[m];
+			unsigned int face = (unsigned int)((row - mip.FirstRow) / mip.Size);
+			unsigned int y = (unsigned int)((row - mip.FirstRow) % mip.Size);
+			Image& image = out.Specular[face * out.SpecularMipCount + m];
+
+			for (unsigned int x = 0; x < mip.Size; x++)
+			{
+				// Tangent frame around the texel's direction
+				XMFLOAT3 normal = TexelDirection(face, x, y, mip.Size);
+				XMFLOAT3 up = fabsf(normal.z) < 0.999f ? XMFLOAT3(0, 0, 1) : XMFLOAT3(1, 0, 0);
+				XMFLOAT3 tangent = Normalize(Cross(up, normal));
+				XMFLOAT3 bitangent = Cross(normal, tangent);
+
+				Float4 sum = Splat(0.0f);
+				for (size_t i = 0; i < mip.Samples.Directions.size(); i++)
+				{
+					const XMFLOAT3& light = mip.Samples.Directions[i];
+					float lx = tangent.x * light.x + bitangent.x * light.y + normal.x * light.z;
+					float ly = tangent.y * light.x + bitangent.y * light.y + normal.y * light.z;
+					float lz = tangent.z * light.x + bitangent.z * light.y + normal.z * light.z;
+					sum = sum + SampleCube(levels, lx, ly, lz, mip.Samples.Lods[i]) * Splat(mip.Samples.Weights[i]);
+				}
+
+				EncodeTexel(sum * Splat(1.0f / mip.Samples.TotalWeight), &image.Pixels[((size_t)y * mip.Size + x) * 4]);
+			}
+		});
+	}
+
+	struct CacheHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t SpecularSize;
+		uint32_t SpecularMipCount;
+		uint64_t FileSize;
+		float Irradiance[SphericalHarmonics::CoefficientCount][3];
+	};
+
+	// Bytes of every specular face and mip after the header
+	size_t GetSpecularSize(uint32_t size, uint32_t mipCount)
+	{
+		size_t bytes = 0;
+		for (uint32_t m = 0; m < mipCount; m++)
+			bytes += (size_t)(size >> m) * (size >> m) * 4;
+		return bytes * 6;
+	}
+
+	bool DecodeFace(const ByteSpan& file, Image& out)
+	{
+		if (DdsFile::IsDds(file.Data, file.Size))
+		{
+			std::vector<Image> mips;
+			if (!DdsFile::Parse(file.Data, file.Size, mips))
+				return false;
+			out = std::move(mips[0]);
+			return true;
+		}
+		return PngDecoder::Decode(file.Data, file.Size, out);
+	}
+}
+
+bool IblPrefilter::Prefilter(const std::vector<Image>& faces, PrefilteredEnvironment& out)
+{
+	std::vector<CubeLevel> levels;
+	if (!BuildSourceLevels(faces, levels))
+		return false;
+
+	out.Irradiance = ProjectIrradiance(levels);
+	PrefilterSpecular(levels, out);
+	return true;
+}
+
+bool IblPrefilter::PrefilterFiles(const std::vector<std::wstring>& faceFiles, PrefilteredEnvironment& out)
+{
+	if (faceFiles.size() != 6)
+		return false;
+
+	std::vector<Image> faces(6);
+	for (unsigned int f = 0; f < 6; f++)
+	{
+		MappedFile looseFile;
+		ByteSpan file;
+		if (!Vfs::Read(faceFiles[f], looseFile, file) || !DecodeFace(file, faces[f]))
+			return false;
+	}
+	return Prefilter(faces, out);
+}
+
+bool IblPrefilter::Load(const std::wstring& path, PrefilteredEnvironment& out)
+{
+	MappedFile looseFile;
+	ByteSpan file;
+	CacheHeader header;
+	if (!Vfs::Read(path, looseFile, file) || file.Size < sizeof(header))
+		return false;
+	memcpy(&header, file.Data, sizeof(header));
+
+	if (header.Magic != Magic || header.Version != Version || header.FileSize != file.Size ||
+		header.SpecularSize == 0 || header.SpecularMipCount == 0 || (header.SpecularSize >> (header.SpecularMipCount - 1)) == 0 ||
+		sizeof(header) + GetSpecularSize(header.SpecularSize, header.SpecularMipCount) != file.Size)
+		return false;
+
+	for (unsigned int i = 0; i < SphericalHarmonics::CoefficientCount; i++)
+		out.Irradiance.Coefficients[i] = XMFLOAT3(header.Irradiance[i][0], header.Irradiance[i][1], header.Irradiance[i][2]);
+
+	out.SpecularSize = header.SpecularSize;
+	out.SpecularMipCount = header.SpecularMipCount;
+	out.Specular.assign(6 * out.SpecularMipCount, Image());
+
+	const uint8_t* pixels = (const uint8_t*)file.Data + sizeof(header);
+	for (Image& image : out.Specular)
+	{
+		unsigned int m = (unsigned int)(&image - out.Specular.data()) % out.SpecularMipCount;
+		image.Width = image.Height = out.SpecularSize >> m;
+		image.Format = ImageFormat::RGBA8;
+		image.Pixels.assign(pixels, pixels + image.GetSize());
+		pixels += image.GetSize();
+	}
+	return true;
+}
+
+bool IblPrefilter::Save(const std::wstring& path, const PrefilteredEnvironment& environment)
+{
+	if (environment.Specular.size() != 6 * environment.SpecularMipCount)
+		return false;
+
+	CacheHeader header = {};
+	header.Magic = Magic;
+	header.Version = Version;
+	header.SpecularSize = environment.SpecularSize;
+	header.SpecularMipCount = environment.SpecularMipCount;
+	header.FileSize = sizeof(header) + GetSpecularSize(environment.SpecularSize, environment.SpecularMipCount);
+	for (unsigned int i = 0; i < SphericalHarmonics::CoefficientCount; i++)
+	{
+		header.Irradiance[i][0] = environment.Irradiance.Coefficients[i].x;
+		header.Irradiance[i][1] = environment.Irradiance.Coefficients[i].y;
+		header.Irradiance[i][2] = environment.Irradiance.Coefficients[i].z;
+	}
+
+	std::filesystem::path tempPath(path);
+	tempPath += L".tmp";
+
+	{
+		std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		file.write((const char*)&header, sizeof(header));
+		for (const Image& image : environment.Specular)
+			file.write((const char*)image.Pixels.data(), image.Pixels.size());
+		if (!file)
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
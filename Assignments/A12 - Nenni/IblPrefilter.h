@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Image.h"
+#include "SphericalHarmonics.h"
+
+// --------------------------------------------------------
+// An environment (the sky's cube map) ready for image based
+// lighting: one lookup for diffuse light, one for specular
+// --------------------------------------------------------
+struct PrefilteredEnvironment
+{
+	// Diffuse light by normal (see SphericalHarmonics::ToIrradiance())
+	SphericalHarmonics9 Irradiance;
+
+	// Reflected light by reflection vector, blurred by the GGX
+	// lobe of roughness mip / (SpecularMipCount - 1)
+	// - RGBA8 faces, gamma encoded like every other texture
+	// - Face by face (+X, -X, +Y, -Y, +Z, -Z), each followed by
+	//    its smaller mips: the order D3D11 takes subresources in
+	unsigned int SpecularSize = 0;
+	unsigned int SpecularMipCount = 0;
+	std::vector<Image> Specular;
+};
+
+// --------------------------------------------------------
+// Precomputes image based lighting from the 6 faces of a
+// cube map, on the thread pool, with SSE where it helps
+//
+// - Irradiance is projected from a small mip of the faces,
+//    weighted by each texel's solid angle
+// - Specular mips are importance sampled along the GGX lobe
+//    (with N = V = R, as split sum approximations assume);
+//    each sample reads a blurrier source mip the less likely
+//    it is, so a few samples per texel don't alias
+// - Roughness is the GGX alpha itself, as in Lights.hlsli
+// - AssetCooker runs it on the sky's faces and writes the
+//    results to a file (sky.ibl), so the game only reads them
+// --------------------------------------------------------
+namespace IblPrefilter
+{
+	const uint32_t Magic = 0x204C4249; // "IBL "
+
+	// Bump whenever the saved results change
+	const uint32_t Version = 2;
+
+	const unsigned int SpecularSize = 128;
+	const unsigned int SpecularMipCount = 6;
+	const unsigned int SampleCount = 128;
+
+	// faces are +X, -X, +Y, -Y, +Z, -Z: square, all the same
+	// size, R8, RGBA8 or block compressed (decoded first, see
+	// BcEncoder::Decode()); false otherwise
+	bool Prefilter(const std::vector<Image>& faces, PrefilteredEnvironment& out);
+
+	// The same, from face files (.png or .dds, read through Vfs)
+	bool PrefilterFiles(const std::vector<std::wstring>& faceFiles, PrefilteredEnvironment& out);
+
+	// Reads a file written by Save() (through Vfs, so from the
+	// pack when it's there); false if it's from another version
+	bool Load(const std::wstring& path, PrefilteredEnvironment& out);
+
+	// Written to a temp file that then replaces path
+	bool Save(const std::wstring& path, const PrefilteredEnvironment& environment);
+}
@@ -0,0 +1,184 @@
+#include "Image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace
+{
+	const float Gamma = 2.2f;
+
+	// Entries of the table from light back to gamma encoded
+	// values; enough that every byte value has its own entries
+	const int EncodeTableSize = 4096;
+
+	// --------------------------------------------------------
+	// Byte values as light (0 to 1) and back, for gamma correct
+	// averaging
+	// --------------------------------------------------------
+	struct GammaTables
+	{
+		float ToLinear[256];
+		uint8_t ToGamma[EncodeTableSize + 1];
+
+		GammaTables()
+		{
+			for (int i = 0; i < 256; i++)
+				ToLinear[i] = powf(i / 255.0f, Gamma);
+			for (int i = 0; i <= EncodeTableSize; i++)
+				ToGamma[i] = (uint8_t)(powf((float)i / EncodeTableSize, 1.0f / Gamma) * 255.0f + 0.5f);
+		}
+	};
+
+	const GammaTables& GetGammaTables()
+	{
+		static const GammaTables tables;
+		return tables;
+	}
+
+	uint8_t EncodeGamma(const GammaTables& tables, float light)
+	{
+		return tables.ToGamma[(int)(std::clamp(light, 0.0f, 1.0f) * EncodeTableSize + 0.5f)];
+	}
+
+	// --------------------------------------------------------
+	// Averages each 2x2 block of source into one pixel
+	// - An odd last row or column is averaged with itself, so
+	//    every source pixel still counts
+	// --------------------------------------------------------
+	void Downsample(const Image& source, Image& out, MipFilter filter)
+	{
+		out.Width = std::max(source.Width / 2, 1u);
+		out.Height = std::max(source.Height / 2, 1u);
+		out.Format = source.Format;
+		out.Pixels.resize(out.GetSize());
+
+		const GammaTables& tables = GetGammaTables();
+		unsigned int channels = source.GetElementSize();
+		size_t sourcePitch = source.GetRowPitch();
+		for (unsigned int y = 0; y < out.Height; y++)
+		{
+			const uint8_t* row0 = &source.Pixels[std::min(y * 2, source.Height - 1) * sourcePitch];
+			const uint8_t* row1 = &source.Pixels[std::min(y * 2 + 1, source.Height - 1) * sourcePitch];
+			uint8_t* target = &out.Pixels[y * out.GetRowPitch()];
+
+			for (unsigned int x = 0; x < out.Width; x++)
+			{
+				const uint8_t* corners[4] =
+				{
+					&row0[(size_t)std::min(x * 2, source.Width - 1) * channels],
+					&row0[(size_t)std::min(x * 2 + 1, source.Width - 1) * channels],
+					&row1[(size_t)std::min(x * 2, source.Width - 1) * channels],
+					&row1[(size_t)std::min(x * 2 + 1, source.Width - 1) * channels],
+				};
+				uint8_t* pixel = &target[(size_t)x * channels];
+
+				if (filter == MipFilter::Normals)
+				{
+					float normal[3] = {};
+					for (const uint8_t* corner : corners)
+					{
+						for (int c = 0; c < 3; c++)
+							normal[c] += corner[c] / 127.5f - 1.0f;
+					}
+
+					// Opposing normals can cancel out; straight up is
+					// as good a guess as any then
+					float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+					if (length < 1e-6f)
+					{
+						normal[0] = normal[1] = 0.0f;
+						normal[2] = length = 1.0f;
+					}
+					for (int c = 0; c < 3; c++)
+						pixel[c] = (uint8_t)std::clamp((normal[c] / length + 1.0f) * 127.5f + 0.5f, 0.0f, 255.0f);
+					pixel[3] = (uint8_t)((corners[0][3] + corners[1][3] + corners[2][3] + corners[3][3] + 2) / 4);
+					continue;
+				}
+
+				for (unsigned int c = 0; c < channels; c++)
+				{
+					if (filter == MipFilter::Gamma && c < 3)
+					{
+						float light = 0.0f;
+						for (const uint8_t* corner : corners)
+							light += tables.ToLinear[corner[c]];
+						pixel[c] = EncodeGamma(tables, light * 0.25f);
+					}
+					else
+					{
+						unsigned int sum = corners[0][c] + corners[1][c] + corners[2][c] + corners[3][c];
+						pixel[c] = (uint8_t)((sum + 2) / 4);
+					}
+				}
+			}
+		}
+	}
+
+	// Channel c of pixel i; gray counts for R, G and B
+	uint8_t Sample(const Image& image, size_t i, unsigned int c)
+	{
+		if (image.Format == ImageFormat::RGBA8)
+			return image.Pixels[i * 4 + c];
+		return c < 3 ? image.Pixels[i] : 255;
+	}
+}
+
+void Images::GenerateMips(Image top, std::vector<Image>& mips, MipFilter filter)
+{
+	// Gray images have no direction to renormalize
+	if (top.Format == ImageFormat::R8 && filter == MipFilter::Normals)
+		filter = MipFilter::Linear;
+
+	mips.clear();
+	mips.push_back(std::move(top));
+	while (mips.back().Width > 1 || mips.back().Height > 1)
+	{
+		Image next;
+		Downsample(mips.back(), next, filter);
+		mips.push_back(std::move(next));
+	}
+}
+
+Image Images::ToRgba(const Image& image)
+{
+	if (image.Format == ImageFormat::RGBA8)
+		return image;
+
+	Image rgba;
+	rgba.Width = image.Width;
+	rgba.Height = image.Height;
+	rgba.Pixels.resize(rgba.GetSize());
+
+	size_t pixelCount = (size_t)image.Width * image.Height;
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		for (unsigned int c = 0; c < 4; c++)
+			rgba.Pixels[i * 4 + c] = Sample(image, i, c);
+	}
+	return rgba;
+}
+
+double Images::Psnr(const Image& reference, const Image& test, unsigned int channelCount)
+{
+	if (reference.Width != test.Width || reference.Height != test.Height)
+		return 0.0;
+
+	uint64_t squaredError = 0;
+	size_t pixelCount = (size_t)reference.Width * reference.Height;
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		for (unsigned int c = 0; c < channelCount; c++)
+		{
+			int difference = Sample(reference, i, c) - Sample(test, i, c);
+			squaredError += difference * difference;
+		}
+	}
+
+	if (squaredError == 0)
+		return std::numeric_limits<double>::infinity();
+
+	double meanSquaredError = (double)squaredError / ((double)pixelCount * channelCount);
+	return 10.0 * log10(255.0 * 255.0 / meanSquaredError);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// What an Image's pixels hold (each one a DXGI format, see
+// DdsFile::GetDxgiFormat())
+enum class ImageFormat
+{
+	R8,		// 1 byte per pixel (DXGI_FORMAT_R8_UNORM)
+	RGBA8,	// 4 bytes per pixel (DXGI_FORMAT_R8G8B8A8_UNORM)
+	RG16,	// 4 bytes per pixel (DXGI_FORMAT_R16G16_UNORM), for lookup tables
+	BC1,	// 8 byte blocks of 4x4 pixels: RGB
+	BC4,	// 8 byte blocks: one channel (R)
+	BC5,	// 16 byte blocks: two channels (RG)
+	BC7		// 16 byte blocks: RGBA
+};
+
+// How a mip level is filtered from the one above it
+enum class MipFilter
+{
+	Linear,		// Plain average of the stored values
+	Gamma,		// Colors averaged as light (gamma 2.2, like the shaders decode them); alpha as stored
+	Normals		// Tangent space normals (RGB = XYZ * 0.5 + 0.5), averaged and renormalized
+};
+
+// --------------------------------------------------------
+// Image in CPU memory, rows (of pixels, or of 4x4 blocks for
+// block compressed formats) tightly packed
+//
+// - Decoded images (see PngDecoder) are R8 or RGBA8
+// --------------------------------------------------------
+struct Image
+{
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	ImageFormat Format = ImageFormat::RGBA8;
+	std::vector<uint8_t> Pixels;
+
+	bool IsBlockCompressed() const { return Format != ImageFormat::R8 && Format != ImageFormat::RGBA8 && Format != ImageFormat::RG16; }
+
+	// Bytes per pixel (or per 4x4 block)
+	unsigned int GetElementSize() const
+	{
+		switch (Format)
+		{
+		case ImageFormat::R8: return 1;
+		case ImageFormat::BC1: case ImageFormat::BC4: return 8;
+		case ImageFormat::BC5: case ImageFormat::BC7: return 16;
+		default: return 4;
+		}
+	}
+
+	// Pixels across a row (or blocks, rounded up)
+	unsigned int GetRowElements() const { return IsBlockCompressed() ? (Width + 3) / 4 : Width; }
+	unsigned int GetRowCount() const { return IsBlockCompressed() ? (Height + 3) / 4 : Height; }
+	size_t GetRowPitch() const { return (size_t)GetRowElements() * GetElementSize(); }
+	size_t GetSize() const { return GetRowPitch() * GetRowCount(); }
+};
+
+// --------------------------------------------------------
+// CPU work on decoded images, so it can happen on worker
+// threads instead of the immediate context
+// --------------------------------------------------------
+namespace Images
+{
+	// top and every mip level below it, down to 1x1, each a
+	// 2x2 box filter of the one above (Linear is what
+	// GenerateMips() does for UNORM formats)
+	// - top must be R8 or RGBA8 (and RGBA8 for Normals)
+	void GenerateMips(Image top, std::vector<Image>& mips, MipFilter filter = MipFilter::Linear);
+
+	// The same pixels as RGBA8 (gray is copied to RGB, with
+	// opaque alpha); image must be R8 or RGBA8
+	Image ToRgba(const Image& image);
+
+	// Peak signal to noise ratio of test against reference, in
+	// dB, over their first channelCount channels (1 to 4)
+	// - Both must be R8 or RGBA8 and the same size; identical
+	//    images are infinitely good
+	double Psnr(const Image& reference, const Image& test, unsigned int channelCount);
+}
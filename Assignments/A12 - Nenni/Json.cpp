@@ -0,0 +1,391 @@
+#include "Json.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+	// Deeper documents are rejected instead of overflowing the stack
+	const int MaxDepth = 256;
+
+	const JsonValue NullValue;
+	const std::string EmptyString;
+
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
+
+	// Appends a code point to a UTF-8 string
+	void AppendUtf8(std::string& out, unsigned int codePoint)
+	{
+		if (codePoint < 0x80)
+			out += (char)codePoint;
+		else if (codePoint < 0x800)
+		{
+			out += (char)(0xC0 | (codePoint >> 6));
+			out += (char)(0x80 | (codePoint & 0x3F));
+		}
+		else if (codePoint < 0x10000)
+		{
+			out += (char)(0xE0 | (codePoint >> 12));
+			out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+			out += (char)(0x80 | (codePoint & 0x3F));
+		}
+		else
+		{
+			out += (char)(0xF0 | (codePoint >> 18));
+			out += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+			out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+			out += (char)(0x80 | (codePoint & 0x3F));
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Recursive descent parser over a (not null terminated)
+// block of text
+// --------------------------------------------------------
+class JsonParser
+{
+public:
+	JsonParser(const char* data, size_t size)
+		: p(data), end(data + size)
+	{
+	}
+
+	bool ParseDocument(JsonValue& out)
+	{
+		if (!ParseValue(out, 0))
+			return false;
+
+		SkipSpaces();
+		return p == end;
+	}
+
+private:
+	const char* p;
+	const char* end;
+
+	void SkipSpaces()
+	{
+		while (p < end && IsSpace(*p))
+			p++;
+	}
+
+	bool Match(const char* word)
+	{
+		size_t length = strlen(word);
+		if ((size_t)(end - p) < length || memcmp(p, word, length) != 0)
+			return false;
+
+		p += length;
+		return true;
+	}
+
+	bool ParseValue(JsonValue& out, int depth)
+	{
+		if (depth > MaxDepth)
+			return false;
+
+		SkipSpaces();
+		if (p >= end)
+			return false;
+
+		switch (*p)
+		{
+		case '{': return ParseObject(out, depth);
+		case '[': return ParseArray(out, depth);
+		case '"':
+			out.type = JsonValue::Type::String;
+			return ParseString(out.text);
+		case 't':
+			out.type = JsonValue::Type::Bool;
+			out.boolValue = true;
+			return Match("true");
+		case 'f':
+			out.type = JsonValue::Type::Bool;
+			out.boolValue = false;
+			return Match("false");
+		case 'n':
+			out.type = JsonValue::Type::Null;
+			return Match("null");
+		default:
+			return ParseNumber(out);
+		}
+	}
+
+	bool ParseObject(JsonValue& out, int depth)
+	{
+		out.type = JsonValue::Type::Object;
+		p++;
+
+		SkipSpaces();
+		if (p < end && *p == '}')
+		{
+			p++;
+			return true;
+		}
+
+		while (true)
+		{
+			SkipSpaces();
+			std::string key;
+			if (p >= end || *p != '"' || !ParseString(key))
+				return false;
+
+			SkipSpaces();
+			if (p >= end || *p != ':')
+				return false;
+			p++;
+
+			out.members.emplace_back(std::move(key), JsonValue());
+			if (!ParseValue(out.members.back().second, depth + 1))
+				return false;
+
+			SkipSpaces();
+			if (p < end && *p == ',')
+			{
+				p++;
+				continue;
+			}
+			if (p < end && *p == '}')
+			{
+				p++;
+				return true;
+			}
+			return false;
+		}
+	}
+
+	bool ParseArray(JsonValue& out, int depth)
+	{
+		out.type = JsonValue::Type::Array;
+		p++;
+
+		SkipSpaces();
+		if (p < end && *p == ']')
+		{
+			p++;
+			return true;
+		}
+
+		while (true)
+		{
+			out.elements.emplace_back();
+			if (!ParseValue(out.elements.back(), depth + 1))
+				return false;
+
+			SkipSpaces();
+			if (p < end && *p == ',')
+			{
+				p++;
+				continue;
+			}
+			if (p < end && *p == ']')
+			{
+				p++;
+				return true;
+			}
+			return false;
+		}
+	}
+
+	bool ParseHex4(unsigned int& out)
+	{
+		if (end - p < 4)
+			return false;
+
+		out = 0;
+		for (int i = 0; i < 4; i++, p++)
+		{
+			char c = *p;
+			unsigned int digit;
+			if (c >= '0' && c <= '9') digit = c - '0';
+			else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+			else return false;
+			out = out * 16 + digit;
+		}
+		return true;
+	}
+
+	bool ParseString(std::string& out)
+	{
+		p++;
+		while (p < end)
+		{
+			// Copy runs without escapes in one go
+			const char* start = p;
+			while (p < end && *p != '"' && *p != '\\')
+				p++;
+			out.append(start, p);
+
+			if (p >= end)
+				return false;
+			if (*p == '"')
+			{
+				p++;
+				return true;
+			}
+
+			// Escape sequence
+			p++;
+			if (p >= end)
+				return false;
+
+			char c = *p++;
+			switch (c)
+			{
+			case '"': out += '"'; break;
+			case '\\': out += '\\'; break;
+			case '/': out += '/'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u':
+			{
+				unsigned int codePoint;
+				if (!ParseHex4(codePoint))
+					return false;
+
+				// Surrogate pair
+				if (codePoint >= 0xD800 && codePoint < 0xDC00 && Match("\\u"))
+				{
+					unsigned int low;
+					if (!ParseHex4(low) || low < 0xDC00 || low >= 0xE000)
+						return false;
+					codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+				}
+				AppendUtf8(out, codePoint);
+				break;
+			}
+			default:
+				return false;
+			}
+		}
+		return false;
+	}
+
+	bool ParseNumber(JsonValue& out)
+	{
+		// strtod needs a terminated string, and numbers are short
+		const char* start = p;
+		while (p < end && ((*p && strchr("+-.eE", *p)) || (*p >= '0' && *p <= '9')))
+			p++;
+
+		size_t length = p - start;
+		char buffer[64];
+		if (length == 0 || length >= sizeof(buffer))
+			return false;
+
+		memcpy(buffer, start, length);
+		buffer[length] = 0;
+
+		char* parsedEnd;
+		out.type = JsonValue::Type::Number;
+		out.number = strtod(buffer, &parsedEnd);
+		return parsedEnd == buffer + length;
+	}
+};
+
+JsonValue::Type JsonValue::GetType() const
+{
+	return type;
+}
+
+bool JsonValue::IsNull() const
+{
+	return type == Type::Null;
+}
+
+bool JsonValue::IsNumber() const
+{
+	return type == Type::Number;
+}
+
+bool JsonValue::IsString() const
+{
+	return type == Type::String;
+}
+
+bool JsonValue::IsArray() const
+{
+	return type == Type::Array;
+}
+
+bool JsonValue::IsObject() const
+{
+	return type == Type::Object;
+}
+
+bool JsonValue::Bool(bool fallback) const
+{
+	return type == Type::Bool ? boolValue : fallback;
+}
+
+double JsonValue::Number(double fallback) const
+{
+	return type == Type::Number ? number : fallback;
+}
+
+const std::string& JsonValue::String() const
+{
+	return type == Type::String ? text : EmptyString;
+}
+
+size_t JsonValue::Size() const
+{
+	if (type == Type::Array)
+		return elements.size();
+	if (type == Type::Object)
+		return members.size();
+	return 0;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+	if (type == Type::Array && index < elements.size())
+		return elements[index];
+	if (type == Type::Object && index < members.size())
+		return members[index].second;
+	return NullValue;
+}
+
+const JsonValue& JsonValue::operator[](const char* key) const
+{
+	if (type == Type::Object)
+	{
+		for (const auto& member : members)
+		{
+			if (member.first == key)
+				return member.second;
+		}
+	}
+	return NullValue;
+}
+
+bool JsonValue::Has(const char* key) const
+{
+	return &(*this)[key] != &NullValue;
+}
+
+const std::vector<std::pair<std::string, JsonValue>>& JsonValue::Members() const
+{
+	return members;
+}
+
+bool Json::Parse(const char* data, size_t size, JsonValue& out)
+{
+	out = JsonValue();
+
+	JsonParser parser(data, size);
+	if (!parser.ParseDocument(out))
+	{
+		out = JsonValue();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// --------------------------------------------------------
+// A parsed JSON value (null, bool, number, string, array
+// or object)
+//
+// - Objects keep their members in file order; lookups are
+//    linear, which is fine for the small documents this is
+//    used for (glTF headers)
+// - Missing members and out of range elements come back as
+//    a shared null value, so lookups can be chained:
+//    root["meshes"][0]["name"].String()
+// --------------------------------------------------------
+class JsonValue
+{
+public:
+	enum class Type
+	{
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object
+	};
+
+	Type GetType() const;
+	bool IsNull() const;
+	bool IsNumber() const;
+	bool IsString() const;
+	bool IsArray() const;
+	bool IsObject() const;
+
+	// Values of the wrong type return the fallback
+	bool Bool(bool fallback = false) const;
+	double Number(double fallback = 0) const;
+	const std::string& String() const;
+
+	// Elements of an array, or members of an object
+	size_t Size() const;
+	const JsonValue& operator[](size_t index) const;
+	const JsonValue& operator[](const char* key) const;
+	bool Has(const char* key) const;
+
+	// Member names and values of an object, in file order
+	const std::vector<std::pair<std::string, JsonValue>>& Members() const;
+
+private:
+	friend class JsonParser;
+
+	Type type = Type::Null;
+	bool boolValue = false;
+	double number = 0;
+	std::string text;
+	std::vector<JsonValue> elements;
+	std::vector<std::pair<std::string, JsonValue>> members;
+};
+
+namespace Json
+{
+	// Parses a whole document; false (and a null out) if it isn't valid JSON
+	bool Parse(const char* data, size_t size, JsonValue& out);
+}
@@ -0,0 +1,761 @@
+#include "LightProbes.h"
+#include "BcEncoder.h"
+#include "DdsFile.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "ThreadPool.h"
+#include "VertexPacking.h"
+#include "Vfs.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+	const float Pi = 3.14159265359f;
+	const float Gamma = 2.2f;
+
+	// How far rays leaving a surface start off it, so they don't
+	// hit the triangle they left
+	const float RayOffset = 0.001f;
+
+	// Probes whose rays hit more back faces than this are inside
+	// something
+	const float InsideFraction = 0.25f;
+
+	// Triangles per BVH leaf, at most
+	const unsigned int LeafSize = 4;
+
+	XMFLOAT3 Add(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.x + b.x, a.y + b.y, a.z + b.z); }
+	XMFLOAT3 Subtract(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	XMFLOAT3 Multiply(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.x * b.x, a.y * b.y, a.z * b.z); }
+	XMFLOAT3 Scale(XMFLOAT3 a, float s) { return XMFLOAT3(a.x * s, a.y * s, a.z * s); }
+	float Dot(XMFLOAT3 a, XMFLOAT3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+	XMFLOAT3 Cross(XMFLOAT3 a, XMFLOAT3 b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	XMFLOAT3 Normalize(XMFLOAT3 v)
+	{
+		float length = sqrtf(Dot(v, v));
+		return length > 0.0f ? Scale(v, 1.0f / length) : v;
+	}
+
+	// Row vectors, as Transformation builds its matrices
+	XMFLOAT3 TransformPoint(const XMFLOAT4X4& m, XMFLOAT3 p)
+	{
+		return XMFLOAT3(
+			p.x * m._11 + p.y * m._21 + p.z * m._31 + m._41,
+			p.x * m._12 + p.y * m._22 + p.z * m._32 + m._42,
+			p.x * m._13 + p.y * m._23 + p.z * m._33 + m._43);
+	}
+
+	// Mirroring transforms flip which side of a triangle is front
+	bool IsMirrored(const XMFLOAT4X4& m)
+	{
+		XMFLOAT3 x(m._11, m._12, m._13);
+		XMFLOAT3 y(m._21, m._22, m._23);
+		XMFLOAT3 z(m._31, m._32, m._33);
+		return Dot(Cross(x, y), z) < 0.0f;
+	}
+
+	// A static triangle in world space, ready for ray tests
+	struct Triangle
+	{
+		XMFLOAT3 A;
+		XMFLOAT3 EdgeB;		// B - A
+		XMFLOAT3 EdgeC;		// C - A
+		XMFLOAT3 Normal;	// Unit, out of the front face
+		XMFLOAT3 Albedo;
+	};
+
+	// Leaves hold Count triangles from First; inner nodes (Count
+	// 0) have their two children at First and First + 1
+	struct BvhNode
+	{
+		XMFLOAT3 Min;
+		XMFLOAT3 Max;
+		uint32_t First;
+		uint32_t Count;
+	};
+
+	struct RayHit
+	{
+		float Distance;
+		const Triangle* Surface;
+	};
+
+	// --------------------------------------------------------
+	// Bounding volume hierarchy over every static triangle
+	// - Built top down, each node split at the median centroid
+	//    along its widest axis
+	// - Read only once built, so any number of threads can trace
+	//    against it at once
+	// --------------------------------------------------------
+	class Bvh
+	{
+	public:
+		void Build(std::vector<Triangle> triangles)
+		{
+			this->triangles = std::move(triangles);
+			nodes.clear();
+			if (this->triangles.empty())
+				return;
+
+			nodes.reserve(this->triangles.size() * 2);
+			nodes.push_back(BvhNode());
+			Split(0, 0, (uint32_t)this->triangles.size());
+		}
+
+		// Closest triangle along the ray, either side, within maxDistance
+		bool Intersect(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, RayHit& hit) const
+		{
+			hit.Distance = maxDistance;
+			hit.Surface = nullptr;
+			Traverse(origin, direction, hit, false);
+			return hit.Surface != nullptr;
+		}
+
+		// Whether anything at all is within maxDistance
+		bool IsOccluded(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance) const
+		{
+			RayHit hit = { maxDistance, nullptr };
+			Traverse(origin, direction, hit, true);
+			return hit.Surface != nullptr;
+		}
+
+	private:
+		std::vector<Triangle> triangles;
+		std::vector<BvhNode> nodes;
+
+		static XMFLOAT3 Centroid(const Triangle& t)
+		{
+			return Add(t.A, Scale(Add(t.EdgeB, t.EdgeC), 1.0f / 3.0f));
+		}
+
+		void Split(uint32_t nodeIndex, uint32_t first, uint32_t count)
+		{
+			XMFLOAT3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+			XMFLOAT3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			XMFLOAT3 centroidMin = boundsMin;
+			XMFLOAT3 centroidMax = boundsMax;
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				const Triangle& t = triangles[i];
+				XMFLOAT3 corners[3] = { t.A, Add(t.A, t.EdgeB), Add(t.A, t.EdgeC) };
+				for (const XMFLOAT3& c : corners)
+				{
+					boundsMin = XMFLOAT3(std::min(boundsMin.x, c.x), std::min(boundsMin.y, c.y), std::min(boundsMin.z, c.z));
+					boundsMax = XMFLOAT3(std::max(boundsMax.x, c.x), std::max(boundsMax.y, c.y), std::max(boundsMax.z, c.z));
+				}
+				XMFLOAT3 c = Centroid(t);
+				centroidMin = XMFLOAT3(std::min(centroidMin.x, c.x), std::min(centroidMin.y, c.y), std::min(centroidMin.z, c.z));
+				centroidMax = XMFLOAT3(std::max(centroidMax.x, c.x), std::max(centroidMax.y, c.y), std::max(centroidMax.z, c.z));
+			}
+
+			nodes[nodeIndex].Min = boundsMin;
+			nodes[nodeIndex].Max = boundsMax;
+			if (count <= LeafSize)
+			{
+				nodes[nodeIndex].First = first;
+				nodes[nodeIndex].Count = count;
+				return;
+			}
+
+			XMFLOAT3 extent = Subtract(centroidMax, centroidMin);
+			int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+			uint32_t half = count / 2;
+			std::nth_element(triangles.begin() + first, triangles.begin() + first + half, triangles.begin() + first + count,
+				[axis](const Triangle& a, const Triangle& b)
+				{
+					XMFLOAT3 ca = Centroid(a);
+					XMFLOAT3 cb = Centroid(b);
+					return (&ca.x)[axis] < (&cb.x)[axis];
+				});
+
+			uint32_t children = (uint32_t)nodes.size();
+			nodes[nodeIndex].First = children;
+			nodes[nodeIndex].Count = 0;
+			nodes.push_back(BvhNode());
+			nodes.push_back(BvhNode());
+			Split(children, first, half);
+			Split(children + 1, first + half, count - half);
+		}
+
+		// Slab test: whether the ray enters the box before maxDistance
+		static bool HitsBox(const BvhNode& node, XMFLOAT3 origin, XMFLOAT3 inverseDirection, float maxDistance)
+		{
+			float t0x = (node.Min.x - origin.x) * inverseDirection.x;
+			float t1x = (node.Max.x - origin.x) * inverseDirection.x;
+			float t0y = (node.Min.y - origin.y) * inverseDirection.y;
+			float t1y = (node.Max.y - origin.y) * inverseDirection.y;
+			float t0z = (node.Min.z - origin.z) * inverseDirection.z;
+			float t1z = (node.Max.z - origin.z) * inverseDirection.z;
+			float enter = std::max(std::max(std::min(t0x, t1x), std::min(t0y, t1y)), std::max(std::min(t0z, t1z), 0.0f));
+			float exit = std::min(std::min(std::max(t0x, t1x), std::max(t0y, t1y)), std::min(std::max(t0z, t1z), maxDistance));
+			return enter <= exit;
+		}
+
+		// Moller-Trumbore; both sides count
+		static bool HitsTriangle(const Triangle& t, XMFLOAT3 origin, XMFLOAT3 direction, float& distance)
+		{
+			XMFLOAT3 p = Cross(direction, t.EdgeC);
+			float determinant = Dot(t.EdgeB, p);
+			if (fabsf(determinant) < 1e-12f)
+				return false;
+
+			float inverse = 1.0f / determinant;
+			XMFLOAT3 s = Subtract(origin, t.A);
+			float u = Dot(s, p) * inverse;
+			if (u < 0.0f || u > 1.0f)
+				return false;
+
+			XMFLOAT3 q = Cross(s, t.EdgeB);
+			float v = Dot(direction, q) * inverse;
+			if (v < 0.0f || u + v > 1.0f)
+				return false;
+
+			distance = Dot(t.EdgeC, q) * inverse;
+			return distance > 0.0f;
+		}
+
+		void Traverse(XMFLOAT3 origin, XMFLOAT3 direction, RayHit& hit, bool anyHit) const
+		{
+			if (nodes.empty())
+				return;
+
+			// Infinity for axes the ray runs along, which the slab
+			// test handles
+			XMFLOAT3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+			uint32_t stack[64];
+			unsigned int stackSize = 0;
+			stack[stackSize++] = 0;
+			while (stackSize > 0)
+			{
+				const BvhNode& node = nodes[stack[--stackSize]];
+				if (!HitsBox(node, origin, inverseDirection, hit.Distance))
+					continue;
+
+				if (node.Count == 0)
+				{
+					stack[stackSize++] = node.First;
+					stack[stackSize++] = node.First + 1;
+					continue;
+				}
+
+				for (uint32_t i = node.First; i < node.First + node.Count; i++)
+				{
+					float distance;
+					if (!HitsTriangle(triangles[i], origin, direction, distance))
+						continue;
+
+					// Double sided surfaces are two triangles in the same
+					// place; the one facing the ray wins the tie
+					bool tie = hit.Surface && distance <= hit.Distance * 1.0001f &&
+						Dot(triangles[i].Normal, direction) < 0.0f && Dot(hit.Surface->Normal, direction) >= 0.0f;
+					if (distance < hit.Distance || tie)
+					{
+						hit.Distance = distance;
+						hit.Surface = &triangles[i];
+						if (anyHit)
+							return;
+					}
+				}
+			}
+		}
+	};
+
+	// An instance's mesh, mapped for as long as the bake needs it
+	struct LoadedInstance
+	{
+		MappedFile File;
+		MeshCacheData Mesh;
+		bool Loaded = false;
+		XMFLOAT3 Albedo = XMFLOAT3(1, 1, 1);	// Times the map's average
+	};
+
+	// --------------------------------------------------------
+	// Average linear color of a cooked texture: its smallest
+	// mip (already gamma-correct averages, see TextureCooker),
+	// decoded and raised to 2.2 like the pixel shader does
+	// --------------------------------------------------------
+	bool AverageColor(const std::wstring& path, XMFLOAT3& out)
+	{
+		MappedFile looseFile;
+		ByteSpan file;
+		std::vector<Image> mips;
+		if (!Vfs::Read(path, looseFile, file) || !DdsFile::Parse(file.Data, file.Size, mips))
+			return false;
+
+		Image rgba;
+		if (mips.back().IsBlockCompressed())
+		{
+			if (!BcEncoder::Decode(mips.back(), rgba))
+				return false;
+			rgba = Images::ToRgba(rgba);
+		}
+		else
+		{
+			rgba = Images::ToRgba(mips.back());
+		}
+
+		size_t pixelCount = (size_t)rgba.Width * rgba.Height;
+		if (pixelCount == 0)
+			return false;
+
+		XMFLOAT3 sum(0, 0, 0);
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			const uint8_t* pixel = &rgba.Pixels[i * 4];
+			sum = Add(sum, XMFLOAT3(powf(pixel[0] / 255.0f, Gamma), powf(pixel[1] / 255.0f, Gamma), powf(pixel[2] / 255.0f, Gamma)));
+		}
+		out = Scale(sum, 1.0f / pixelCount);
+		return true;
+	}
+
+	// Maps every instance's mesh and works out its albedo; false
+	// if none could be loaded
+	bool LoadInstances(const LightProbeScene& scene, std::vector<LoadedInstance>& out)
+	{
+		bool anyLoaded = false;
+		for (size_t i = 0; i < scene.Instances.size(); i++)
+		{
+			const ProbeInstance& instance = scene.Instances[i];
+			LoadedInstance& loaded = out[i];
+			loaded.Loaded = MeshCache::LoadCooked(instance.MeshPath, loaded.File, loaded.Mesh) && loaded.Mesh.LodCount > 0;
+			if (!loaded.Loaded)
+			{
+				printf("Light probes: could not load %ls\n", instance.MeshPath.c_str());
+				continue;
+			}
+			anyLoaded = true;
+
+			XMFLOAT3 average(1, 1, 1);
+			if (!instance.AlbedoMap.empty() && !AverageColor(instance.AlbedoMap, average))
+				printf("Light probes: could not read %ls\n", instance.AlbedoMap.c_str());
+			loaded.Albedo = Multiply(instance.Albedo, average);
+		}
+		return anyLoaded;
+	}
+
+	// The static instances' LOD 0 triangles in world space
+	std::vector<Triangle> GatherTriangles(const LightProbeScene& scene, const std::vector<LoadedInstance>& instances)
+	{
+		std::vector<Triangle> triangles;
+		for (size_t i = 0; i < instances.size(); i++)
+		{
+			const LoadedInstance& instance = instances[i];
+			if (!instance.Loaded || !scene.Instances[i].Static)
+				continue;
+
+			const MeshCacheData& mesh = instance.Mesh;
+			const XMFLOAT4X4& world = scene.Instances[i].World;
+			VertexQuantization quantization = VertexPacking::QuantizationFromBounds(mesh.BoundsMin, mesh.BoundsMax);
+			std::vector<XMFLOAT3> positions(mesh.VertexCount);
+			for (unsigned int v = 0; v < mesh.VertexCount; v++)
+				positions[v] = TransformPoint(world, VertexPacking::Unpack(mesh.Vertices[v], quantization).Position);
+
+			// Cooked meshes are clockwise in front, like D3D's default
+			// (see Mesh::IsFrontCounterClockwise), which makes
+			// B - A cross C - A point out of the front in a left
+			// handed space
+			bool mirrored = IsMirrored(world);
+			const MeshLod& lod = mesh.Lods[0];
+			for (unsigned int t = lod.IndexStart; t + 2 < lod.IndexStart + lod.IndexCount; t += 3)
+			{
+				unsigned int index[3];
+				for (unsigned int c = 0; c < 3; c++)
+				{
+					index[c] = mesh.IndexStride == 2 ? ((const uint16_t*)mesh.Indices)[t + c] : ((const uint32_t*)mesh.Indices)[t + c];
+					if (index[c] >= mesh.VertexCount)
+						index[c] = 0;
+				}
+
+				Triangle triangle;
+				triangle.A = positions[index[0]];
+				triangle.EdgeB = Subtract(positions[index[1]], triangle.A);
+				triangle.EdgeC = Subtract(positions[index[2]], triangle.A);
+				XMFLOAT3 normal = Cross(triangle.EdgeB, triangle.EdgeC);
+				if (Dot(normal, normal) <= 0.0f)
+					continue;
+				triangle.Normal = Normalize(mirrored ? Scale(normal, -1.0f) : normal);
+				triangle.Albedo = instance.Albedo;
+				triangles.push_back(triangle);
+			}
+		}
+		return triangles;
+	}
+
+	// --------------------------------------------------------
+	// Light from one of the scene's lights arriving at a point,
+	// as Lights.hlsli's diffuse term has it (n dot l times
+	// attenuation, spot falloff, intensity and color), or black
+	// when something blocks it
+	// - direction gets the unit direction toward the light
+	// --------------------------------------------------------
+	XMFLOAT3 LightArriving(const Bvh& bvh, const Light& light, XMFLOAT3 position, XMFLOAT3 normal, XMFLOAT3& direction)
+	{
+		float distance = FLT_MAX;
+		float falloff = 1.0f;
+		if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+		{
+			direction = Normalize(Scale(light.Direction, -1.0f));
+		}
+		else if (light.Type == LIGHT_TYPE_POINT || light.Type == LIGHT_TYPE_SPOT)
+		{
+			XMFLOAT3 toLight = Subtract(light.Position, position);
+			distance = sqrtf(Dot(toLight, toLight));
+			direction = Normalize(toLight);
+
+			float attenuation = std::clamp(1.0f - distance * distance / (light.Range * light.Range), 0.0f, 1.0f);
+			falloff = attenuation * attenuation;
+			if (light.Type == LIGHT_TYPE_SPOT)
+			{
+				float angle = -Dot(direction, Normalize(light.Direction));
+				float outer = cosf(light.SpotOuterAngle);
+				float inner = cosf(light.SpotInnerAngle);
+				falloff *= std::clamp((angle - outer) / (inner - outer), 0.0f, 1.0f);
+			}
+		}
+		else
+		{
+			return XMFLOAT3(0, 0, 0);
+		}
+
+		float lambert = std::clamp(Dot(normal, direction), 0.0f, 1.0f);
+		if (lambert * falloff <= 0.0f || bvh.IsOccluded(position, direction, distance))
+			return XMFLOAT3(0, 0, 0);
+		return Scale(light.Color, lambert * falloff * light.Intensity);
+	}
+
+	// Same directions for every probe, evenly spread over the sphere
+	std::vector<XMFLOAT3> SphericalFibonacci(unsigned int count)
+	{
+		const float goldenAngle = Pi * (3.0f - sqrtf(5.0f));
+		std::vector<XMFLOAT3> directions(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			float z = 1.0f - (2.0f * i + 1.0f) / count;
+			float radius = sqrtf(std::max(0.0f, 1.0f - z * z));
+			float phi = goldenAngle * i;
+			directions[i] = XMFLOAT3(radius * cosf(phi), radius * sinf(phi), z);
+		}
+		return directions;
+	}
+
+	// --------------------------------------------------------
+	// Gives probes inside geometry the average of their valid
+	// neighbors (all 26), spreading inward a ring at a time
+	// --------------------------------------------------------
+	void DilateInvalid(LightProbeGrid& grid, std::vector<char>& valid)
+	{
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			std::vector<char> nextValid = valid;
+			for (unsigned int z = 0; z < grid.CountZ; z++)
+			{
+				for (unsigned int y = 0; y < grid.CountY; y++)
+				{
+					for (unsigned int x = 0; x < grid.CountX; x++)
+					{
+						size_t index = ((size_t)z * grid.CountY + y) * grid.CountX + x;
+						if (valid[index])
+							continue;
+
+						SphericalHarmonics9 sum;
+						unsigned int count = 0;
+						for (int dz = -1; dz <= 1; dz++)
+						{
+							for (int dy = -1; dy <= 1; dy++)
+							{
+								for (int dx = -1; dx <= 1; dx++)
+								{
+									int nx = (int)x + dx, ny = (int)y + dy, nz = (int)z + dz;
+									if (nx < 0 || ny < 0 || nz < 0 || nx >= (int)grid.CountX || ny >= (int)grid.CountY || nz >= (int)grid.CountZ)
+										continue;
+
+									size_t neighbor = ((size_t)nz * grid.CountY + ny) * grid.CountX + nx;
+									if (!valid[neighbor])
+										continue;
+									for (unsigned int i = 0; i < SphericalHarmonics::CoefficientCount; i++)
+										sum.Coefficients[i] = Add(sum.Coefficients[i], grid.Probes[neighbor].Coefficients[i]);
+									count++;
+								}
+							}
+						}
+
+						if (count == 0)
+							continue;
+						for (unsigned int i = 0; i < SphericalHarmonics::CoefficientCount; i++)
+							grid.Probes[index].Coefficients[i] = Scale(sum.Coefficients[i], 1.0f / count);
+						nextValid[index] = 1;
+						changed = true;
+					}
+				}
+			}
+			valid.swap(nextValid);
+		}
+	}
+
+	// --------------------------------------------------------
+	// The bake itself, once the meshes are loaded
+	// - Probes are independent, so each is a job on the pool
+	// --------------------------------------------------------
+	void BakeLoaded(const LightProbeScene& scene, const std::vector<LoadedInstance>& instances, LightProbeGrid& out)
+	{
+		// Bounds of everything, static or not
+		XMFLOAT3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (size_t i = 0; i < instances.size(); i++)
+		{
+			if (!instances[i].Loaded)
+				continue;
+
+			const MeshCacheData& mesh = instances[i].Mesh;
+			for (unsigned int corner = 0; corner < 8; corner++)
+			{
+				XMFLOAT3 local(
+					corner & 1 ? mesh.BoundsMax.x : mesh.BoundsMin.x,
+					corner & 2 ? mesh.BoundsMax.y : mesh.BoundsMin.y,
+					corner & 4 ? mesh.BoundsMax.z : mesh.BoundsMin.z);
+				XMFLOAT3 p = TransformPoint(scene.Instances[i].World, local);
+				boundsMin = XMFLOAT3(std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z));
+				boundsMax = XMFLOAT3(std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z));
+			}
+		}
+
+		// Probes half a spacing past the bounds, then spread
+		// evenly over them
+		float spacing = std::max(scene.Spacing, 0.01f);
+		boundsMin = Subtract(boundsMin, XMFLOAT3(spacing * 0.5f, spacing * 0.5f, spacing * 0.5f));
+		boundsMax = Add(boundsMax, XMFLOAT3(spacing * 0.5f, spacing * 0.5f, spacing * 0.5f));
+		XMFLOAT3 extent = Subtract(boundsMax, boundsMin);
+		unsigned int* counts[3] = { &out.CountX, &out.CountY, &out.CountZ };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float length = (&extent.x)[axis];
+			*counts[axis] = std::min((unsigned int)ceilf(length / spacing) + 1, LightProbes::MaxProbesPerAxis);
+			(&out.Spacing.x)[axis] = length / (*counts[axis] - 1);
+		}
+		out.Origin = boundsMin;
+
+		Bvh bvh;
+		bvh.Build(GatherTriangles(scene, instances));
+
+		std::vector<XMFLOAT3> rays = SphericalFibonacci(LightProbes::RayCount);
+		SphericalHarmonics9 skyRadiance = SphericalHarmonics::ToRadiance(scene.SkyIrradiance);
+		unsigned int shadedLightCount = std::min((unsigned int)scene.Lights.size(), scene.ShadedLightCount);
+
+		size_t probeCount = (size_t)out.CountX * out.CountY * out.CountZ;
+		out.Probes.assign(probeCount, SphericalHarmonics9());
+		std::vector<char> valid(probeCount, 1);
+		ThreadPool::Get().ParallelFor(probeCount, [&](size_t index)
+		{
+			unsigned int x = (unsigned int)(index % out.CountX);
+			unsigned int y = (unsigned int)(index / out.CountX % out.CountY);
+			unsigned int z = (unsigned int)(index / ((size_t)out.CountX * out.CountY));
+			XMFLOAT3 probe = Add(out.Origin, Multiply(XMFLOAT3((float)x, (float)y, (float)z), out.Spacing));
+
+			SphericalHarmonics9 radiance;
+			unsigned int backFaces = 0;
+			for (const XMFLOAT3& ray : rays)
+			{
+				XMFLOAT3 color;
+				RayHit hit;
+				if (!bvh.Intersect(probe, ray, FLT_MAX, hit))
+				{
+					// The sky, past everything
+					XMFLOAT3 sky = SphericalHarmonics::Evaluate(skyRadiance, ray);
+					color = XMFLOAT3(std::max(sky.x, 0.0f), std::max(sky.y, 0.0f), std::max(sky.z, 0.0f));
+				}
+				else if (Dot(hit.Surface->Normal, ray) > 0.0f)
+				{
+					// The inside of something: no light
+					backFaces++;
+					continue;
+				}
+				else
+				{
+					// The surface's diffuse reflection of everything
+					// that lights it
+					const Triangle& triangle = *hit.Surface;
+					XMFLOAT3 surface = Add(Add(probe, Scale(ray, hit.Distance)), Scale(triangle.Normal, RayOffset));
+					XMFLOAT3 arriving = SphericalHarmonics::Evaluate(scene.SkyIrradiance, triangle.Normal);
+					arriving = XMFLOAT3(std::max(arriving.x, 0.0f), std::max(arriving.y, 0.0f), std::max(arriving.z, 0.0f));
+					for (const Light& light : scene.Lights)
+					{
+						XMFLOAT3 direction;
+						arriving = Add(arriving, LightArriving(bvh, light, surface, triangle.Normal, direction));
+					}
+					color = Multiply(triangle.Albedo, arriving);
+				}
+				SphericalHarmonics::AddSample(radiance, ray, color, 4.0f * Pi / LightProbes::RayCount);
+			}
+
+			// Lights the pixel shader leaves out arrive directly too
+			// - As radiance, pi times what they give a surface facing
+			//    them, which ToIrradiance() divides back out
+			for (unsigned int i = shadedLightCount; i < scene.Lights.size(); i++)
+			{
+				XMFLOAT3 direction;
+				const Light& light = scene.Lights[i];
+				XMFLOAT3 toward = light.Type == LIGHT_TYPE_DIRECTIONAL ? Normalize(Scale(light.Direction, -1.0f)) : Normalize(Subtract(light.Position, probe));
+				XMFLOAT3 color = LightArriving(bvh, light, probe, toward, direction);
+				SphericalHarmonics::AddSample(radiance, direction, color, Pi);
+			}
+
+			out.Probes[index] = SphericalHarmonics::ToIrradiance(radiance);
+			valid[index] = backFaces <= InsideFraction * LightProbes::RayCount;
+		});
+
+		DilateInvalid(out, valid);
+	}
+
+	struct FileHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t FileSize;
+		float Origin[3];
+		float Spacing[3];
+		uint32_t Counts[3];
+		uint32_t Padding;
+	};
+
+	const size_t ProbeSize = SphericalHarmonics::CoefficientCount * sizeof(XMFLOAT3);
+}
+
+bool LightProbes::Bake(const LightProbeScene& scene, LightProbeGrid& out)
+{
+	std::vector<LoadedInstance> instances(scene.Instances.size());
+	if (!LoadInstances(scene, instances))
+		return false;
+
+	BakeLoaded(scene, instances, out);
+	return true;
+}
+
+bool LightProbes::Load(const std::wstring& path, LightProbeGrid& out)
+{
+	MappedFile looseFile;
+	ByteSpan file;
+	FileHeader header;
+	if (!Vfs::Read(path, looseFile, file) || file.Size < sizeof(header))
+		return false;
+	memcpy(&header, file.Data, sizeof(header));
+
+	if (header.Magic != Magic || header.Version != Version || header.FileSize != file.Size)
+		return false;
+	for (uint32_t count : header.Counts)
+	{
+		if (count == 0 || count > MaxProbesPerAxis)
+			return false;
+	}
+	size_t probeCount = (size_t)header.Counts[0] * header.Counts[1] * header.Counts[2];
+	if (sizeof(header) + probeCount * ProbeSize != file.Size)
+		return false;
+
+	out.Origin = XMFLOAT3(header.Origin[0], header.Origin[1], header.Origin[2]);
+	out.Spacing = XMFLOAT3(header.Spacing[0], header.Spacing[1], header.Spacing[2]);
+	out.CountX = header.Counts[0];
+	out.CountY = header.Counts[1];
+	out.CountZ = header.Counts[2];
+	out.Probes.resize(probeCount);
+	memcpy(out.Probes.data(), (const uint8_t*)file.Data + sizeof(header), probeCount * ProbeSize);
+	return true;
+}
+
+bool LightProbes::Save(const std::wstring& path, const LightProbeGrid& grid)
+{
+	if (grid.Probes.size() != (size_t)grid.CountX * grid.CountY * grid.CountZ || grid.Probes.empty())
+		return false;
+
+	FileHeader header = {};
+	header.Magic = Magic;
+	header.Version = Version;
+	header.FileSize = sizeof(header) + grid.Probes.size() * ProbeSize;
+	header.Origin[0] = grid.Origin.x;
+	header.Origin[1] = grid.Origin.y;
+	header.Origin[2] = grid.Origin.z;
+	header.Spacing[0] = grid.Spacing.x;
+	header.Spacing[1] = grid.Spacing.y;
+	header.Spacing[2] = grid.Spacing.z;
+	header.Counts[0] = grid.CountX;
+	header.Counts[1] = grid.CountY;
+	header.Counts[2] = grid.CountZ;
+
+	std::filesystem::path tempPath(path);
+	tempPath += L".tmp";
+
+	{
+		std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)grid.Probes.data(), grid.Probes.size() * ProbeSize);
+		if (!file)
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
+
+float LightProbes::Sample(const LightProbeGrid& grid, const XMFLOAT3& position, SphericalHarmonics9& out)
+{
+	out = SphericalHarmonics9();
+	if (grid.Probes.empty())
+		return 0.0f;
+
+	// Position in probes, and how far outside the grid it is
+	const unsigned int counts[3] = { grid.CountX, grid.CountY, grid.CountZ };
+	unsigned int cell[3];
+	float blend[3];
+	float outside = 0.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float last = counts[axis] - 1.0f;
+		float spacing = (&grid.Spacing.x)[axis];
+		float p = spacing > 0.0f ? ((&position.x)[axis] - (&grid.Origin.x)[axis]) / spacing : 0.0f;
+		outside = std::max(outside, std::max(-p, p - last));
+
+		p = std::clamp(p, 0.0f, last);
+		cell[axis] = std::min((unsigned int)p, counts[axis] > 1 ? counts[axis] - 2 : 0);
+		blend[axis] = counts[axis] > 1 ? p - cell[axis] : 0.0f;
+	}
+
+	for (unsigned int corner = 0; corner < 8; corner++)
+	{
+		unsigned int x = cell[0] + (corner & 1 ? 1 : 0);
+		unsigned int y = cell[1] + (corner & 2 ? 1 : 0);
+		unsigned int z = cell[2] + (corner & 4 ? 1 : 0);
+		float weight =
+			(corner & 1 ? blend[0] : 1.0f - blend[0]) *
+			(corner & 2 ? blend[1] : 1.0f - blend[1]) *
+			(corner & 4 ? blend[2] : 1.0f - blend[2]);
+		if (weight <= 0.0f)
+			continue;
+
+		const SphericalHarmonics9& probe = grid.Probes[((size_t)z * grid.CountY + y) * grid.CountX + x];
+		for (unsigned int i = 0; i < SphericalHarmonics::CoefficientCount; i++)
+			out.Coefficients[i] = Add(out.Coefficients[i], Scale(probe.Coefficients[i], weight));
+	}
+	return std::clamp(1.0f - outside, 0.0f, 1.0f);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+#include "Lights.h"
+#include "SphericalHarmonics.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// One entity of the scene the probes are baked for
+// --------------------------------------------------------
+struct ProbeInstance
+{
+	std::wstring MeshPath;				// Cooked .mesh (see MeshCache::LoadCooked())
+	XMFLOAT4X4 World;
+	XMFLOAT3 Albedo = XMFLOAT3(1, 1, 1);	// Linear; times AlbedoMap's average color
+	std::wstring AlbedoMap;				// Optional cooked .dds
+
+	// Static entities block and bounce light; the rest (which
+	// move) only count toward the bounds, as they are what the
+	// probes light
+	bool Static = false;
+};
+
+// --------------------------------------------------------
+// Everything a bake depends on
+// --------------------------------------------------------
+struct LightProbeScene
+{
+	std::vector<ProbeInstance> Instances;
+
+	// The first ShadedLightCount lights are evaluated per pixel,
+	// so only their bounce goes into the probes; the rest light
+	// the probes directly too
+	std::vector<Light> Lights;
+	unsigned int ShadedLightCount = 0;
+
+	// The sky's light (see IblPrefilter), for rays that escape
+	SphericalHarmonics9 SkyIrradiance;
+
+	// Distance between probes, before it's stretched to fit the
+	// bounds evenly
+	float Spacing = 1.0f;
+};
+
+// --------------------------------------------------------
+// A box of SH irradiance probes (see SphericalHarmonics)
+//
+// - Probe (x, y, z) sits at Origin + (x, y, z) * Spacing
+// - Probes are stored x fastest, then y, then z, so the 8
+//    around a point are two runs of 2 in each of 2 slices
+// --------------------------------------------------------
+struct LightProbeGrid
+{
+	XMFLOAT3 Origin = XMFLOAT3(0, 0, 0);
+	XMFLOAT3 Spacing = XMFLOAT3(1, 1, 1);
+	unsigned int CountX = 0;
+	unsigned int CountY = 0;
+	unsigned int CountZ = 0;
+	std::vector<SphericalHarmonics9> Probes;
+};
+
+// --------------------------------------------------------
+// Bakes indirect light into a grid of probes over a scene, so
+// entities can get it from a few probes instead of per pixel
+//
+// - The grid covers every instance's bounds, half a spacing
+//    beyond them
+// - Each probe casts RayCount rays (the same spherical
+//    Fibonacci directions for all) against a BVH of the
+//    static instances' triangles (LOD 0), on the thread pool:
+//    - Rays that escape see the sky
+//    - Rays that hit pick up that surface's light: every
+//       light (with a shadow ray) and the sky, reflected by
+//       its albedo (one diffuse bounce)
+//    - Lights past ShadedLightCount add their direct light,
+//       when the probe can see them
+// - Probes that see mostly back faces are inside geometry;
+//    they take their valid neighbors' average, so blends near
+//    walls don't go dark
+// - Light follows Lights.hlsli: diffuse is n dot l times the
+//    light's intensity and color, with no 1 / pi
+// - Slow, so AssetCooker bakes each .scene into a .probes file
+//    (keyed on the scene, its meshes and albedo maps and the
+//    sky), and the game only loads that
+// --------------------------------------------------------
+namespace LightProbes
+{
+	const uint32_t Magic = 0x424F5250; // "PROB"
+
+	// Bump whenever the baked results change
+	const uint32_t Version = 2;
+
+	const unsigned int RayCount = 256;
+	const unsigned int MaxProbesPerAxis = 64;
+
+	// False if no instance's mesh could be loaded
+	bool Bake(const LightProbeScene& scene, LightProbeGrid& out);
+
+	// Reads a .probes file through Vfs
+	bool Load(const std::wstring& path, LightProbeGrid& out);
+
+	// Written to a temp file that then replaces path
+	bool Save(const std::wstring& path, const LightProbeGrid& grid);
+
+	// Trilinear blend of the 8 probes around position, clamped
+	// to the grid; returns how much the grid applies there: 1
+	// inside, fading to 0 a spacing outside (0 for no grid)
+	float Sample(const LightProbeGrid& grid, const XMFLOAT3& position, SphericalHarmonics9& out);
+}
@@ -6,6 +6,10 @@
 #define LIGHT_TYPE_POINT 1
 #define LIGHT_TYPE_SPOT 2
 
+// Lights the pixel shader evaluates (the first one casts the
+// shadow); any more are baked into the light probes
+#define SHADED_LIGHT_COUNT 1
+
 using namespace DirectX;
 
 struct Light 
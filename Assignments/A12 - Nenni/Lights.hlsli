@@ -5,6 +5,10 @@
 #define LIGHT_TYPE_POINT 1
 #define LIGHT_TYPE_SPOT 2
 
+// Lights the pixel shader evaluates (the first one casts the
+// shadow); any more are baked into the light probes
+#define SHADED_LIGHT_COUNT 1
+
 #define MAX_SPECULAR_EXPONENT 256.0f
 
 static const float PI = 3.14159265359f;
@@ -183,9 +187,38 @@ float3 SpotLight(Light light, float3 normal, float3 worldPos, float3 camPos, flo
     return (balanceDiff * surfaceColor + specular) * attenuation * spotTerm * light.Intensity * light.Color;
 }
 
+// Diffuse light arriving at normal n, from 9 SH coefficients
+// of irradiance (same basis order as SphericalHarmonics.cpp)
+float3 ShIrradiance(float4 sh[9], float3 n)
+{
+    return sh[0].rgb * 0.282095f +
+        sh[1].rgb * (0.488603f * n.y) +
+        sh[2].rgb * (0.488603f * n.z) +
+        sh[3].rgb * (0.488603f * n.x) +
+        sh[4].rgb * (1.092548f * n.x * n.y) +
+        sh[5].rgb * (1.092548f * n.y * n.z) +
+        sh[6].rgb * (0.315392f * (3.0f * n.z * n.z - 1.0f)) +
+        sh[7].rgb * (1.092548f * n.x * n.z) +
+        sh[8].rgb * (0.546274f * (n.x * n.x - n.y * n.y));
+}
+
+// Split sum environment BRDF: the scale and bias f0 gets once
+// the GGX lobe is integrated over every light direction
+// - Looked up in a table the cooker integrates with the same
+//    GGX as above (see Brdf.h): n dot v across, roughness down
+float3 EnvironmentBRDF(Texture2D lut, SamplerState samp, float3 f0, float roughness, float NdotV)
+{
+    float2 scaleBias = lut.SampleLevel(samp, float2(NdotV, roughness), 0).rg;
+    return f0 * scaleBias.x + scaleBias.y;
+}
+
 float3 NormalMapping(Texture2D nMap, SamplerState samp, float2 uv, float3 normal, float3 tangent)
 {
-    float3 normalFromMap = nMap.Sample(samp, uv).rgb * 2.0f - 1.0f;
+    // Only X and Y are used (cooked normal maps are BC5, which
+    // has no blue), so Z is rebuilt; it always faces outward
+    float3 normalFromMap;
+    normalFromMap.xy = nMap.Sample(samp, uv).rg * 2.0f - 1.0f;
+    normalFromMap.z = sqrt(saturate(1.0f - dot(normalFromMap.xy, normalFromMap.xy)));
     
     float3 n = normal;
     float3 t = normalize(tangent - n * dot(tangent, n));
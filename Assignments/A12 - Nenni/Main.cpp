@@ -6,6 +6,7 @@
 #include "Graphics.h"
 #include "Game.h"
 #include "Input.h"
+#include "Benchmarks.h"
 
 // Annonymous namespace to hold variables
 // only accessible in this file
@@ -48,6 +49,32 @@ int WINAPI WinMain(
 	printf("Console window created successfully.  Feel free to printf() here.\n");
 #endif
 
+	// Run the CPU benchmarks instead of the game?
+	// - "-scenes=1000,50000" picks the scene sizes to time
+	if (strstr(lpCmdLine, "-benchmark"))
+	{
+#if !defined(DEBUG) && !defined(_DEBUG)
+		Window::CreateConsoleWindow(500, 120, 32, 120);
+#endif
+		std::vector<unsigned int> sceneSizes;
+		if (const char* sizes = strstr(lpCmdLine, "-scenes="))
+		{
+			for (const char* p = sizes + strlen("-scenes="); *p >= '0' && *p <= '9';)
+			{
+				char* end = nullptr;
+				sceneSizes.push_back((unsigned int)strtoul(p, &end, 10));
+				p = *end == ',' ? end + 1 : end;
+			}
+		}
+		if (sceneSizes.empty())
+			Benchmarks::RunAll();
+		else
+			Benchmarks::RunAll(sceneSizes);
+		printf("Press Enter to exit.\n");
+		getchar();
+		return 0;
+	}
+
 	// Set up app initialization details
 	unsigned int windowWidth = 1280;
 	unsigned int windowHeight = 720;
@@ -0,0 +1,173 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : data(nullptr), size(0), open(false)
+#ifdef _WIN32
+	, fileHandle(nullptr), mappingHandle(nullptr)
+#endif
+{
+}
+
+MappedFile::MappedFile(const std::wstring& path) : MappedFile()
+{
+	Open(path);
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : MappedFile()
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+
+		data = other.data;
+		size = other.size;
+		open = other.open;
+#ifdef _WIN32
+		fileHandle = other.fileHandle;
+		mappingHandle = other.mappingHandle;
+		other.fileHandle = nullptr;
+		other.mappingHandle = nullptr;
+#endif
+		other.data = nullptr;
+		other.size = 0;
+		other.open = false;
+	}
+	return *this;
+}
+
+// --------------------------------------------------------
+// Maps the whole file into memory (read only)
+// - Returns false if the file can't be opened or mapped
+// - An empty file opens successfully with a null data pointer
+// --------------------------------------------------------
+bool MappedFile::Open(const std::wstring& path)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	size = (size_t)fileSize.QuadPart;
+	open = true;
+
+	// Windows refuses to map zero-length files
+	if (size == 0)
+		return true;
+
+	mappingHandle = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mappingHandle)
+	{
+		Close();
+		return false;
+	}
+
+	data = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		Close();
+		return false;
+	}
+#else
+	int fd = ::open(std::filesystem::path(path).string().c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info = {};
+	if (fstat(fd, &info) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	size = (size_t)info.st_size;
+	open = true;
+
+	if (size > 0)
+	{
+		void* mapped = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped == MAP_FAILED)
+		{
+			::close(fd);
+			size = 0;
+			open = false;
+			return false;
+		}
+
+		// We read front to back, so let the kernel read ahead aggressively
+		madvise(mapped, size, MADV_SEQUENTIAL);
+		data = (const char*)mapped;
+	}
+
+	// The mapping keeps its own reference to the file
+	::close(fd);
+#endif
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (data)
+		UnmapViewOfFile(data);
+	if (mappingHandle)
+		CloseHandle((HANDLE)mappingHandle);
+	if (fileHandle)
+		CloseHandle((HANDLE)fileHandle);
+
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	if (data)
+		munmap((void*)data, size);
+#endif
+
+	data = nullptr;
+	size = 0;
+	open = false;
+}
+
+bool MappedFile::IsOpen() const
+{
+	return open;
+}
+
+const char* MappedFile::GetData() const
+{
+	return data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return size;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+// --------------------------------------------------------
+// Read-only memory mapping of an entire file
+//
+// - Uses CreateFileMapping on Windows and mmap elsewhere
+// - The file stays mapped until Close() or destruction,
+//    so pointers from GetData() are only valid until then
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile();
+	explicit MappedFile(const std::wstring& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	bool Open(const std::wstring& path);
+	void Close();
+
+	// Getter Methods
+	bool IsOpen() const;
+	const char* GetData() const;
+	size_t GetSize() const;
+
+private:
+	const char* data;
+	size_t size;
+	bool open;
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#endif
+};
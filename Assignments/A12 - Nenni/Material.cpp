@@ -38,6 +38,11 @@ void Material::SetUVOffset(XMFLOAT2 offset)
 	uvOffset = offset;
 }
 
+void Material::SetRoughness(float inRoughness)
+{
+	roughness = inRoughness;
+}
+
 XMFLOAT4& Material::GetTint()
 {
 	return tint;
@@ -65,6 +70,11 @@ XMFLOAT2 Material::GetUVOffset()
 
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Material::GetTexture(unsigned int index)
 {
+	auto asset = textureAssets.find(index);
+	if (asset != textureAssets.end()) {
+		return asset->second->Get();
+	}
+
 	auto it = textureSRVs.find(index);
 
 	if (it == textureSRVs.end()) {
@@ -81,7 +91,16 @@ float Material::GetRoughness()
 
 void Material::AddTextureSRV(unsigned int index, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
-	textureSRVs.insert({ index, srv });
+	// Replaces any texture already in this slot
+	textureSRVs.insert_or_assign(index, srv);
+	textureAssets.erase(index);
+}
+
+void Material::AddTexture(unsigned int index, std::shared_ptr<TextureAsset> texture)
+{
+	// Replaces any texture already in this slot
+	textureAssets.insert_or_assign(index, texture);
+	textureSRVs.erase(index);
 }
 
 void Material::AddSampler(unsigned int index, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler)
@@ -92,5 +111,6 @@ void Material::AddSampler(unsigned int index, Microsoft::WRL::ComPtr<ID3D11Sampl
 void Material::BindTextureAndSampler()
 {
 	for (auto& t : textureSRVs) { Graphics::Context->PSSetShaderResources(t.first, 1, t.second.GetAddressOf()); }
+	for (auto& t : textureAssets) { Graphics::Context->PSSetShaderResources(t.first, 1, t.second->Use().GetAddressOf()); }
 	for (auto& s : samplers) { Graphics::Context->PSSetSamplers(s.first, 1, s.second.GetAddressOf()); }
 }
@@ -2,7 +2,9 @@
 #include <DirectXMath.h>
 #include <d3d11.h>
 #include <wrl/client.h>
+#include <memory>
 #include <unordered_map>
+#include "Asset.h"
 
 using namespace DirectX;
 
@@ -16,6 +18,7 @@ public:
 	void SetPixelShader(Microsoft::WRL::ComPtr<ID3D11PixelShader> inPixelShader);
 	void SetUVScale(XMFLOAT2 scale);
 	void SetUVOffset(XMFLOAT2 offset);
+	void SetRoughness(float inRoughness);
 
 	XMFLOAT4& GetTint();
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> GetVertexShader();
@@ -26,6 +29,10 @@ public:
 	float GetRoughness();
 
 	void AddTextureSRV(unsigned int index, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+
+	// A texture that may still be loading (see AssetManager),
+	// bound as whatever it is at the time
+	void AddTexture(unsigned int index, std::shared_ptr<TextureAsset> texture);
 	void AddSampler(unsigned int index, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler);
 	void BindTextureAndSampler();
 
@@ -40,6 +47,7 @@ private:
 	float roughness;
 
 	std::unordered_map<unsigned int, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs;
+	std::unordered_map<unsigned int, std::shared_ptr<TextureAsset>> textureAssets;
 	std::unordered_map<unsigned int, Microsoft::WRL::ComPtr<ID3D11SamplerState>> samplers;
 };
 
@@ -1,237 +1,207 @@
 #include "Mesh.h"
 #include "Entity.h"
+#include "MeshCodec.h"
+#include "MeshCooker.h"
+#include "TangentGenerator.h"
 
-Mesh::Mesh(unsigned int* indices, Vertex* vertices, int iCount, int vCount) 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace
 {
-	// Set variables
-	indexCount = iCount;
-	vertexCount = vCount;
+	void CopyName(char* destination, const string& name)
+	{
+		size_t length = min<size_t>(name.size(), MeshSubmesh::MaxNameLength);
+		memcpy(destination, name.data(), length);
+		destination[length] = 0;
+	}
+}
 
-	CreateBuffers(vertices, indices);
+Mesh::Mesh(unsigned int* indices, Vertex* vertices, int iCount, int vCount) 
+{
+	CreateFromArrays(indices, vertices, iCount, vCount);
 }
 
 Mesh::Mesh(const wstring& objFile)
 {
-	// Author: Chris Cascioli
-// Purpose: Basic .OBJ 3D model loading, supporting positions, uvs and normals
-// 
-// - You are allowed to directly copy/paste this into your code base
-//   for assignments, given that you clearly cite that this is not
-//   code of your own design.
-
-// *************************************
-//      IMPLEMENTATION NOTES (1/2)
-//
-//  - You'll need to #include both
-//      <fstream> and <stdexcept>
-//
-//  - You will need to integrate
-//      this code into a function or
-//      constructor of your own making
-//
-//  - There is MORE TO DO after pasting 
-//      this code in - see the bottom for
-//      what to do *after* including 
-//      this code in your mesh class
-//
-// *************************************
+	const wchar_t* fileName = objFile.c_str() + objFile.find_last_of(L"/\\") + 1;
+	frontCounterClockwise = false;
 
-// File input object
-	wstring file = objFile;
-	std::ifstream obj(objFile);
+	filesystem::path extension = filesystem::path(objFile).extension();
+	if (extension == L".glb")
+	{
+		LoadGlb(objFile);
+		return;
+	}
 
-	// Check for successful open
-	if (!obj.is_open())
-		throw std::invalid_argument("Error opening file: Invalid file path or file is inaccessible");
+	// Compressed vertices and indices (see MeshCodec) are decoded
+	// straight into the arrays the mesh is built from
+	if (extension == L".meshz")
+	{
+		vector<Vertex> vertices;
+		vector<unsigned int> indices;
+		if (!MeshCodec::Load(objFile, vertices, indices) || vertices.empty() || indices.empty())
+			throw std::invalid_argument("Error opening file: Invalid file path or file is not a valid .meshz");
+
+		printf("%ls: decoded %zu vertices, %zu indices\n", fileName, vertices.size(), indices.size());
+		CreateFromArrays(&indices[0], &vertices[0], (int)indices.size(), (int)vertices.size());
+		return;
+	}
 
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;	// Positions from the file
-	std::vector<XMFLOAT3> normals;		// Normals from the file
-	std::vector<XMFLOAT2> uvs;			// UVs from the file
-	std::vector<Vertex> verts;			// Verts we're assembling
-	std::vector<UINT> indices;			// Indices of these verts
-	vertexCount = 0;					// Count of vertices
-	indexCount = 0;						// Count of indices
-	char chars[100];					// String for line reading
-
-	// Still have data left?
-	while (obj.good())
+	// Meshes written by the asset cooker (see AssetCooker) have
+	// no source next to them, so they are used as they are
+	if (extension == L".mesh")
 	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
+		MappedFile cookedFile;
+		MeshCacheData cooked;
+		if (!MeshCache::LoadCooked(objFile, cookedFile, cooked))
+			throw std::invalid_argument("Error opening file: Invalid file path or file is not a valid .mesh");
+
+		CreateFromCacheData(cooked);
+		printf("%ls: loaded %d vertices, %d indices, %zu LODs, %zu meshlets, %zu submeshes (cooked)\n", fileName, vertexCount, indexCount, lods.size(), meshlets.size(), submeshes.size());
+		LoadMaterialLibrary(objFile);
+		return;
+	}
 
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
-		}
-		else if (chars[0] == 'f')
+	// Use the binary .mesh cache next to the asset when it is up to date
+	// - The arrays are used straight from the memory mapped file,
+	//    so there's no parsing and no tangent calculation at all
+	{
+		MappedFile cacheFile;
+		MeshCacheData cached;
+		if (MeshCache::Load(objFile, cacheFile, cached))
 		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			unsigned int i[12];
-			int numbersRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// If we only got the first number, chances are the OBJ
-			// file has no UV coordinates.  This isn't great, but we
-			// still want to load the model without crashing, so we
-			// need to re-read a different pattern (in which we assume
-			// there are no UVs denoted for any of the vertices)
-			if (numbersRead == 1)
-			{
-				// Re-read with a different pattern
-				numbersRead = sscanf_s(
-					chars,
-					"f %d//%d %d//%d %d//%d %d//%d",
-					&i[0], &i[2],
-					&i[3], &i[5],
-					&i[6], &i[8],
-					&i[9], &i[11]);
-
-				// The following indices are where the UVs should 
-				// have been, so give them a valid value
-				i[1] = 1;
-				i[4] = 1;
-				i[7] = 1;
-				i[10] = 1;
-
-				// If we have no UVs, create a single UV coordinate
-				// that will be used for all vertices
-				if (uvs.size() == 0)
-					uvs.push_back(XMFLOAT2(0, 0));
-			}
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal's Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-			vertexCount += 3;
-
-			// Add three more indices
-			indices.push_back(indexCount); indexCount += 1;
-			indices.push_back(indexCount); indexCount += 1;
-			indices.push_back(indexCount); indexCount += 1;
-
-			// Was there a 4th face?
-			// - 12 numbers read means 4 faces WITH uv's
-			// - 8 numbers read means 4 faces WITHOUT uv's
-			if (numbersRead == 12 || numbersRead == 8)
-			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal's Z
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-				vertexCount += 3;
-
-				// Add three more indices
-				indices.push_back(indexCount); indexCount += 1;
-				indices.push_back(indexCount); indexCount += 1;
-				indices.push_back(indexCount); indexCount += 1;
-			}
+			CreateFromCacheData(cached);
+			printf("%ls: loaded %d vertices, %d indices, %zu LODs, %zu meshlets, %zu submeshes from cache\n", fileName, vertexCount, indexCount, lods.size(), meshlets.size(), submeshes.size());
+			LoadMaterialLibrary(objFile);
+			return;
 		}
 	}
 
-	// Close the file and create the actual buffers
-	obj.close();
+	// Weld, optimize and split the .obj (see MeshCooker)
+	CookedMesh cooked;
+	if (!MeshCooker::CookObj(objFile, cooked))
+		throw std::invalid_argument("Error opening file: Invalid file path or file is inaccessible");
+	MeshCacheData packed = MeshCooker::Pack(cooked);
+
+	// Write the finished arrays out so the next run can skip all of the above
+	if (!MeshCache::Save(objFile, packed))
+		printf("%ls: could not write mesh cache\n", fileName);
+
+	CreateFromCacheData(packed);
+	LoadMaterialLibrary(objFile);
+}
+
+// --------------------------------------------------------
+// Builds the mesh from finished vertices (with tangents) and
+// indices, as one LOD and one submesh
+// - Meshes built in code (or decoded from .meshz files) get
+//    only LOD 0 and a single, unnamed submesh
+// --------------------------------------------------------
+void Mesh::CreateFromArrays(unsigned int* indices, Vertex* vertices, int iCount, int vCount)
+{
+	frontCounterClockwise = false;
+
+	CookedMesh cooked;
+	MeshCooker::CookArrays(vertices, vCount, indices, iCount, cooked);
+	CreateFromCacheData(MeshCooker::Pack(cooked));
+}
+
+// --------------------------------------------------------
+// Copies the LODs, meshlets and submeshes out of cached (or
+// just cooked) data and creates the GPU buffers from it
+// --------------------------------------------------------
+void Mesh::CreateFromCacheData(const MeshCacheData& data)
+{
+	lods.assign(data.Lods, data.Lods + data.LodCount);
+	meshlets.assign(data.Meshlets, data.Meshlets + data.MeshletCount);
+	submeshes.assign(data.Submeshes, data.Submeshes + data.SubmeshCount);
+	submeshRanges.assign(data.SubmeshRanges, data.SubmeshRanges + data.SubmeshCount * data.LodCount);
+	materialLibrary = data.MaterialLibrary;
+	vertexCount = (int)data.VertexCount;
+	indexCount = (int)lods[0].IndexCount;
+	boundsMin = data.BoundsMin;
+	boundsMax = data.BoundsMax;
+
+	CreateBuffers(data);
+}
+
+// --------------------------------------------------------
+// Loads a binary glTF file (see GltfLoader)
+//
+// - The vertices arrive packed and the index data is often the
+//    file's own, so this skips the cache, vertex optimization,
+//    LODs and meshlets: one LOD, drawn whole per submesh
+// - Each primitive is a submesh, and the file's materials
+//    take the place of a .mtl library
+// --------------------------------------------------------
+void Mesh::LoadGlb(const wstring& glbFile)
+{
+	const wchar_t* fileName = glbFile.c_str() + glbFile.find_last_of(L"/\\") + 1;
+
+	MappedFile file;
+	GltfMeshData glb;
+	if (!GltfLoader::Load(glbFile, file, glb))
+		throw std::invalid_argument("Error opening file: Invalid file path or file is not a supported .glb");
+
+	vertexCount = (int)glb.Vertices.size();
+	indexCount = (int)glb.IndexCount;
+	boundsMin = glb.BoundsMin;
+	boundsMax = glb.BoundsMax;
+	frontCounterClockwise = true;
+	mtlMaterials = glb.Materials;
+	lods.push_back({ 0, glb.IndexCount, 0.0f });
+
+	submeshes.resize(glb.Primitives.size());
+	for (size_t s = 0; s < glb.Primitives.size(); s++)
+	{
+		CopyName(submeshes[s].Name, glb.Primitives[s].Name);
+		CopyName(submeshes[s].Material, glb.Primitives[s].Material);
+		submeshRanges.push_back({ glb.Primitives[s].IndexStart, glb.Primitives[s].IndexCount });
+	}
+
+	printf("%ls: %d vertices, %d indices, %zu primitives (%u attribute streams read in place, %u converted, indices %s)\n",
+		fileName, vertexCount, indexCount, submeshes.size(),
+		glb.DirectStreams, glb.ConvertedStreams,
+		glb.IndicesInPlace ? "from the file" : "converted");
+
+	MeshCacheData data;
+	data.Vertices = &glb.Vertices[0];
+	data.VertexCount = (unsigned int)vertexCount;
+	data.Indices = glb.Indices;
+	data.IndexCount = glb.IndexCount;
+	data.IndexStride = glb.IndexStride;
+	data.BoundsMin = boundsMin;
+	data.BoundsMax = boundsMax;
+	CreateBuffers(data);
+}
 
-	CalculateTangents(&verts[0], vertexCount, &indices[0], indexCount);
+// --------------------------------------------------------
+// Reads the .mtl file named by the .obj (next to it), so
+// submeshes can look up their materials
+// - A name that can't be converted to a path (not valid
+//    UTF-8) is skipped like a missing file
+// --------------------------------------------------------
+void Mesh::LoadMaterialLibrary(const wstring& objFile)
+{
+	if (materialLibrary.empty())
+		return;
 
-	CreateBuffers(&verts[0], &indices[0]);
+	filesystem::path path;
+	try
+	{
+		path = filesystem::path(objFile).parent_path() / filesystem::path(materialLibrary);
+	}
+	catch (const exception&)
+	{
+		printf("%ls: material library name isn't a valid path\n", objFile.c_str());
+		return;
+	}
+
+	if (!MtlParser::Load(path.wstring(), mtlMaterials))
+		printf("%ls: could not read material library\n", path.c_str());
 }
 
 Mesh::~Mesh() 
@@ -241,6 +211,16 @@ Mesh::~Mesh()
 
 void Mesh::Draw()
 {
+	Draw(0);
+}
+
+// --------------------------------------------------------
+// Draws one level of detail (clamped to the coarsest one)
+// --------------------------------------------------------
+void Mesh::Draw(unsigned int lod)
+{
+	const MeshLod& range = lods[lod < lods.size() ? lod : lods.size() - 1];
+
 	// DRAW geometry
 	// - These steps are generally repeated for EACH object you draw
 	// - Other Direct3D calls will also be necessary to do more complex things
@@ -250,10 +230,10 @@ void Mesh::Draw()
 		//  - For this demo, this step *could* simply be done once during Init()
 		//  - However, this needs to be done between EACH DrawIndexed() call
 		//     when drawing different geometry, so it's here as an example
-		UINT stride = sizeof(Vertex);
+		UINT stride = sizeof(PackedVertex);
 		UINT offset = 0;
 		Graphics::Context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-		Graphics::Context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+		Graphics::Context->IASetIndexBuffer(indexBuffer.Get(), indexFormat, 0);
 
 		// Tell Direct3D to draw
 		//  - Begins the rendering pipeline on the GPU
@@ -262,14 +242,49 @@ void Mesh::Draw()
 		//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
 		//     vertices in the currently set VERTEX BUFFER
 		Graphics::Context->DrawIndexed(
-			indexCount,     // The number of indices to use (we could draw a subset if we wanted)
-			0,     // Offset to the first index we want to use
+			range.IndexCount,     // The number of indices to use (just this LOD's range)
+			range.IndexStart,     // Offset to the first index we want to use
 			0);    // Offset to add to each index when looking up vertices
 	}
 }
 
-void Mesh::CreateBuffers(Vertex* vertices, unsigned int* indices)
+// --------------------------------------------------------
+// Draws just the given ranges of the index buffer, like the
+// visible meshlets of an LOD (see Entity::CullMeshlets)
+// --------------------------------------------------------
+void Mesh::Draw(const vector<IndexRange>& ranges)
 {
+	if (ranges.empty())
+		return;
+
+	BindBuffers();
+	DrawRanges(ranges);
+}
+
+// --------------------------------------------------------
+// Sets this mesh's vertex and index buffers, so several
+// DrawRanges() calls (one per submesh) can share one bind
+// --------------------------------------------------------
+void Mesh::BindBuffers()
+{
+	UINT stride = sizeof(PackedVertex);
+	UINT offset = 0;
+	Graphics::Context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
+	Graphics::Context->IASetIndexBuffer(indexBuffer.Get(), indexFormat, 0);
+}
+
+// Draws ranges of the index buffer set by BindBuffers()
+void Mesh::DrawRanges(const vector<IndexRange>& ranges)
+{
+	for (const IndexRange& range : ranges)
+		Graphics::Context->DrawIndexed(range.Count, range.Start, 0);
+}
+
+void Mesh::CreateBuffers(const MeshCacheData& data)
+{
+	quantization = VertexPacking::QuantizationFromBounds(data.BoundsMin, data.BoundsMax);
+	indexFormat = data.IndexStride == sizeof(uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
 	// Create a VERTEX BUFFER
 	// - This holds the vertex data of triangles for a single object
 	// - This buffer is created on the GPU, which is where the data needs to
@@ -280,7 +295,7 @@ void Mesh::CreateBuffers(Vertex* vertices, unsigned int* indices)
 		//  - After the buffer is created, this description variable is unnecessary
 		D3D11_BUFFER_DESC vbd = {};
 		vbd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		vbd.ByteWidth = sizeof(Vertex) * vertexCount;       // number of vertices in the buffer
+		vbd.ByteWidth = sizeof(PackedVertex) * vertexCount; // number of vertices in the buffer
 		vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells Direct3D this is a vertex buffer
 		vbd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
 		vbd.MiscFlags = 0;
@@ -290,7 +305,7 @@ void Mesh::CreateBuffers(Vertex* vertices, unsigned int* indices)
 		// - This is how we initially fill the buffer with data
 		// - Essentially, we're specifying a pointer to the data to copy
 		D3D11_SUBRESOURCE_DATA initialVertexData = {};
-		initialVertexData.pSysMem = vertices; // pSysMem = Pointer to System Memory
+		initialVertexData.pSysMem = data.Vertices; // pSysMem = Pointer to System Memory
 
 		// Actually create the buffer on the GPU with the initial data
 		// - Once we do this, we'll NEVER CHANGE DATA IN THE BUFFER AGAIN
@@ -304,11 +319,11 @@ void Mesh::CreateBuffers(Vertex* vertices, unsigned int* indices)
 	//    be if we want the GPU to act on it (as in: draw it to the screen)
 	{
 		// Describe the buffer, as we did above, with two major differences
-		//  - Byte Width (3 unsigned integers vs. 3 whole vertices)
+		//  - Byte Width (2 or 4 bytes per index vs. whole vertices)
 		//  - Bind Flag (used as an index buffer instead of a vertex buffer) 
 		D3D11_BUFFER_DESC ibd = {};
 		ibd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		ibd.ByteWidth = sizeof(unsigned int) * indexCount;	// number of indices in the buffer
+		ibd.ByteWidth = data.IndexStride * data.IndexCount;	// number of indices in the buffer (every LOD)
 		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;	// Tells Direct3D this is an index buffer
 		ibd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
 		ibd.MiscFlags = 0;
@@ -316,7 +331,7 @@ void Mesh::CreateBuffers(Vertex* vertices, unsigned int* indices)
 
 		// Specify the initial data for this buffer, similar to above
 		D3D11_SUBRESOURCE_DATA initialIndexData = {};
-		initialIndexData.pSysMem = indices; // pSysMem = Pointer to System Memory
+		initialIndexData.pSysMem = data.Indices; // pSysMem = Pointer to System Memory
 
 		// Actually create the buffer with the initial data
 		// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
@@ -343,103 +358,126 @@ int Mesh::GetVertexCount()
 	return vertexCount;
 }
 
+// Bytes of the vertex and index buffers, from their descs
+size_t Mesh::GetMemorySize()
+{
+	D3D11_BUFFER_DESC vertexDesc = {};
+	D3D11_BUFFER_DESC indexDesc = {};
+	if (vertexBuffer)
+		vertexBuffer->GetDesc(&vertexDesc);
+	if (indexBuffer)
+		indexBuffer->GetDesc(&indexDesc);
+	return (size_t)vertexDesc.ByteWidth + indexDesc.ByteWidth;
+}
+
+unsigned int Mesh::GetLodCount()
+{
+	return (unsigned int)lods.size();
+}
+
+MeshLod Mesh::GetLod(unsigned int lod)
+{
+	return lods[lod < lods.size() ? lod : lods.size() - 1];
+}
+
+unsigned int Mesh::GetMeshletCount()
+{
+	return (unsigned int)meshlets.size();
+}
+
 // --------------------------------------------------------
-// Author: Chris Cascioli
-// Purpose: Calculates the tangents of the vertices in a mesh
-// 
-// - You are allowed to directly copy/paste this into your code base
-//   for assignments, given that you clearly cite that this is not
-//   code of your own design.
-//
-// - Code originally adapted from: http://www.terathon.com/code/tangent.html
-//   - Updated version now found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
-//   - See listing 7.4 in section 7.5 (page 9 of the PDF)
-//
-// - Note: For this code to work, your Vertex format must
-//         contain an XMFLOAT3 called Tangent
-//
-// - Be sure to call this BEFORE creating your D3D vertex/index buffers
+// The meshlets that make up one LOD
+// - Meshlets are sorted by where they start in the index
+//    buffer, and each LOD is one contiguous run of them
 // --------------------------------------------------------
-void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+const Meshlet* Mesh::GetLodMeshlets(unsigned int lod, unsigned int& meshletCount)
 {
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
-	{
-		verts[i].Tangent = XMFLOAT3(0, 0, 0);
-	}
+	MeshLod range = GetLod(lod);
+	return FindMeshlets({ range.IndexStart, range.IndexCount }, meshletCount);
+}
 
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numIndices;)
-	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->UV.x - v1->UV.x;
-		float t1 = v2->UV.y - v1->UV.y;
-
-		float s2 = v3->UV.x - v1->UV.x;
-		float t2 = v3->UV.y - v1->UV.y;
-
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-
-		// Adjust tangents of each vert of the triangle
-		v1->Tangent.x += tx;
-		v1->Tangent.y += ty;
-		v1->Tangent.z += tz;
-
-		v2->Tangent.x += tx;
-		v2->Tangent.y += ty;
-		v2->Tangent.z += tz;
-
-		v3->Tangent.x += tx;
-		v3->Tangent.y += ty;
-		v3->Tangent.z += tz;
-	}
+unsigned int Mesh::GetSubmeshCount()
+{
+	return (unsigned int)submeshes.size();
+}
 
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
-	{
-		// Grab the two vectors
-		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
-		XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
+const MeshSubmesh& Mesh::GetSubmesh(unsigned int submesh)
+{
+	return submeshes[submesh];
+}
 
-		// Use Gram-Schmidt orthonormalize to ensure
-		// the normal and tangent are exactly 90 degrees apart
-		tangent = XMVector3Normalize(
-			tangent - normal * XMVector3Dot(normal, tangent));
+// One submesh of one LOD (clamped to the coarsest one)
+IndexRange Mesh::GetSubmeshRange(unsigned int lod, unsigned int submesh)
+{
+	lod = min(lod, (unsigned int)lods.size() - 1);
+	return submeshRanges[lod * submeshes.size() + submesh];
+}
 
-		// Store the tangent
-		XMStoreFloat3(&verts[i].Tangent, tangent);
-	}
+// Submeshes of a LOD are split into meshlets separately, so
+// these are a contiguous run too
+const Meshlet* Mesh::GetSubmeshMeshlets(unsigned int lod, unsigned int submesh, unsigned int& meshletCount)
+{
+	return FindMeshlets(GetSubmeshRange(lod, submesh), meshletCount);
+}
+
+// The submesh's material from the .mtl file, or nullptr
+const MtlMaterial* Mesh::GetSubmeshMtl(unsigned int submesh)
+{
+	return MtlParser::Find(mtlMaterials, submeshes[submesh].Material);
+}
+
+const Meshlet* Mesh::FindMeshlets(const IndexRange& range, unsigned int& meshletCount)
+{
+	auto byStart = [](const Meshlet& meshlet, unsigned int start) { return meshlet.IndexStart < start; };
+	auto first = lower_bound(meshlets.begin(), meshlets.end(), range.Start, byStart);
+	auto last = lower_bound(first, meshlets.end(), range.Start + range.Count, byStart);
+
+	meshletCount = (unsigned int)(last - first);
+	return meshletCount > 0 ? &*first : nullptr;
+}
+
+XMFLOAT3 Mesh::GetBoundsMin()
+{
+	return boundsMin;
+}
+
+XMFLOAT3 Mesh::GetBoundsMax()
+{
+	return boundsMax;
+}
+
+VertexQuantization Mesh::GetQuantization()
+{
+	return quantization;
+}
+
+// Whether front faces wind counter-clockwise, which needs a
+// rasterizer state with FrontCounterClockwise set
+bool Mesh::IsFrontCounterClockwise()
+{
+	return frontCounterClockwise;
+}
+
+// --------------------------------------------------------
+// Calculates the tangents of the vertices in a mesh
+//
+// - See TangentGenerator (the original per-triangle version,
+//   with its credits, is TangentGenerator::GenerateScalar)
+//
+// - Be sure to call this BEFORE creating your D3D vertex/index buffers
+// --------------------------------------------------------
+void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+{
+	TangentGenerator::Generate(verts, numVerts, indices, numIndices);
 }
 
 void Mesh::SetBuffersAndDraw()
 {
 	// Set buffers in the input assembler
-	UINT stride = sizeof(Vertex);
+	UINT stride = sizeof(PackedVertex);
 	UINT offset = 0;
 	Graphics::Context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-	Graphics::Context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	Graphics::Context->IASetIndexBuffer(indexBuffer.Get(), indexFormat, 0);
 
 	// Draw this mesh
 	Graphics::Context->DrawIndexed(this->indexCount, 0, 0);
@@ -6,7 +6,13 @@
 #include <stdexcept>
 #include <vector>
 #include "Graphics.h" 
+#include "GltfLoader.h"
+#include "MeshCache.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "MtlParser.h"
 #include "Vertex.h"
+#include "VertexPacking.h"
 
 using namespace std;
 
@@ -24,12 +30,30 @@ public:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
 	int GetIndexCount();
 	int GetVertexCount();
+	size_t GetMemorySize();
+	unsigned int GetLodCount();
+	MeshLod GetLod(unsigned int lod);
+	unsigned int GetMeshletCount();
+	const Meshlet* GetLodMeshlets(unsigned int lod, unsigned int& meshletCount);
+	unsigned int GetSubmeshCount();
+	const MeshSubmesh& GetSubmesh(unsigned int submesh);
+	IndexRange GetSubmeshRange(unsigned int lod, unsigned int submesh);
+	const Meshlet* GetSubmeshMeshlets(unsigned int lod, unsigned int submesh, unsigned int& meshletCount);
+	const MtlMaterial* GetSubmeshMtl(unsigned int submesh);
+	XMFLOAT3 GetBoundsMin();
+	XMFLOAT3 GetBoundsMax();
+	VertexQuantization GetQuantization();
+	bool IsFrontCounterClockwise();
 
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
 
 	void SetBuffersAndDraw();
 
 	void Draw();
+	void Draw(unsigned int lod);
+	void Draw(const vector<IndexRange>& ranges);
+	void BindBuffers();
+	void DrawRanges(const vector<IndexRange>& ranges);
 
 
 private:
@@ -38,10 +62,43 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
 
-	int indexCount;
+	int indexCount;		// Of the full resolution mesh (LOD 0)
 	int vertexCount;
 
-	void CreateBuffers(Vertex* vertices, unsigned int* indices);
+	// Ranges of the index buffer, from full resolution down
+	vector<MeshLod> lods;
+
+	// Every LOD split into clusters, in index buffer order
+	vector<Meshlet> meshlets;
+
+	// Parts of the mesh with their own material, and where each
+	// one is in every LOD (see MeshCacheData)
+	vector<MeshSubmesh> submeshes;
+	vector<IndexRange> submeshRanges;
+
+	// The .mtl file named by the .obj, and what was read from it
+	// (or a .glb's own materials)
+	string materialLibrary;
+	vector<MtlMaterial> mtlMaterials;
+
+	// Axis-aligned bounds of the vertex positions
+	XMFLOAT3 boundsMin;
+	XMFLOAT3 boundsMax;
+
+	// Vertex buffers hold PackedVertex, so shaders need this to
+	// turn positions back into local space
+	VertexQuantization quantization;
+	DXGI_FORMAT indexFormat;
+
+	// .glb meshes keep the file's winding (see GltfLoader)
+	bool frontCounterClockwise;
+
+	void CreateFromArrays(unsigned int* indices, Vertex* vertices, int iCount, int vCount);
+	void CreateFromCacheData(const MeshCacheData& data);
+	void CreateBuffers(const MeshCacheData& data);
+	void LoadMaterialLibrary(const wstring& objFile);
+	void LoadGlb(const wstring& glbFile);
+	const Meshlet* FindMeshlets(const IndexRange& range, unsigned int& meshletCount);
 
 };
 
@@ -0,0 +1,488 @@
+#include "MeshCache.h"
+#include "Vfs.h"
+
+#include <cfloat>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+static_assert(sizeof(MeshCache::Header) % 16 == 0, "Mesh cache header must keep the arrays after it aligned");
+
+namespace
+{
+	// Everything after the header starts on this boundary
+	const uint64_t SectionAlignment = 16;
+
+	inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	inline uint64_t RotateLeft(uint64_t x, int bits)
+	{
+		return (x << bits) | (x >> (64 - bits));
+	}
+
+	inline uint64_t ReadU64(const unsigned char* p)
+	{
+		uint64_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	// Size, modification time and content hash of a source asset
+	struct SourceStamp
+	{
+		uint64_t Size = 0;
+		uint64_t Time = 0;
+		uint64_t Hash = 0;
+	};
+
+	// Size and time come from the file system or the pack's
+	// table of contents, which is cheap
+	bool GetSourceSizeAndTime(const std::wstring& sourcePath, SourceStamp& stamp)
+	{
+		return Vfs::Stat(sourcePath, stamp.Size, stamp.Time);
+	}
+
+	// The hash needs the whole file, so it is only computed when
+	// writing a cache or when the time alone can't decide
+	bool GetSourceHash(const std::wstring& sourcePath, SourceStamp& stamp)
+	{
+		MappedFile source;
+		ByteSpan data;
+		if (!Vfs::Read(sourcePath, source, data))
+			return false;
+
+		stamp.Hash = MeshCache::HashBytes(data.Data, data.Size);
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// Checks that a mapped cache is complete and readable by
+	// this build before any of its offsets are trusted
+	// --------------------------------------------------------
+	bool IsHeaderValid(const MeshCache::Header& header, size_t fileSize)
+	{
+		if (header.Magic != MeshCache::Magic ||
+			header.Version != MeshCache::Version ||
+			header.VertexStride != sizeof(PackedVertex) ||
+			(header.IndexStride != 2 && header.IndexStride != 4) ||
+			header.FileSize != fileSize)
+			return false;
+
+		if (header.VertexCount == 0 || header.IndexCount == 0 || header.IndexCount % 3 != 0)
+			return false;
+
+		if (header.IndexStride == 2 && header.VertexCount >= VertexPacking::MaxShortIndexVertices)
+			return false;
+
+		if (header.LodCount == 0 || header.LodCount > MeshSimplifier::MaxLods)
+			return false;
+
+		uint64_t vertexBytes = (uint64_t)header.VertexCount * sizeof(PackedVertex);
+		uint64_t indexBytes = (uint64_t)header.IndexCount * header.IndexStride;
+		uint64_t lodBytes = (uint64_t)header.LodCount * sizeof(MeshLod);
+		uint64_t meshletBytes = (uint64_t)header.MeshletCount * sizeof(Meshlet);
+		uint64_t submeshBytes = (uint64_t)header.SubmeshCount * sizeof(MeshSubmesh);
+		uint64_t rangeBytes = (uint64_t)header.SubmeshCount * header.LodCount * sizeof(IndexRange);
+
+		if (header.SubmeshCount == 0 || memchr(header.MaterialLibrary, 0, sizeof(header.MaterialLibrary)) == nullptr)
+			return false;
+
+		return
+			header.VertexOffset % SectionAlignment == 0 &&
+			header.IndexOffset % SectionAlignment == 0 &&
+			header.LodOffset % SectionAlignment == 0 &&
+			header.MeshletOffset % SectionAlignment == 0 &&
+			header.SubmeshOffset % SectionAlignment == 0 &&
+			header.SubmeshRangeOffset % SectionAlignment == 0 &&
+			header.VertexOffset >= sizeof(MeshCache::Header) &&
+			header.VertexOffset + vertexBytes <= header.IndexOffset &&
+			header.IndexOffset + indexBytes <= header.LodOffset &&
+			header.LodOffset + lodBytes <= header.MeshletOffset &&
+			header.MeshletOffset + meshletBytes <= header.SubmeshOffset &&
+			header.SubmeshOffset + submeshBytes <= header.SubmeshRangeOffset &&
+			header.SubmeshRangeOffset + rangeBytes <= fileSize;
+	}
+
+	// Every LOD must be whole triangles inside the index array
+	bool AreLodsValid(const MeshLod* lods, unsigned int lodCount, unsigned int indexCount)
+	{
+		for (unsigned int i = 0; i < lodCount; i++)
+		{
+			const MeshLod& lod = lods[i];
+			if (lod.IndexCount == 0 || lod.IndexStart % 3 != 0 || lod.IndexCount % 3 != 0 ||
+				(uint64_t)lod.IndexStart + lod.IndexCount > indexCount)
+				return false;
+		}
+		return true;
+	}
+
+	bool AreMeshletsValid(const Meshlet* meshlets, unsigned int meshletCount, unsigned int indexCount)
+	{
+		for (unsigned int i = 0; i < meshletCount; i++)
+		{
+			const Meshlet& meshlet = meshlets[i];
+			if (meshlet.IndexStart % 3 != 0 || meshlet.IndexCount % 3 != 0 ||
+				(uint64_t)meshlet.IndexStart + meshlet.IndexCount > indexCount)
+				return false;
+		}
+		return true;
+	}
+
+	// Every submesh range must be whole triangles inside its LOD,
+	// and every name must end inside its field
+	bool AreSubmeshesValid(const MeshSubmesh* submeshes, const IndexRange* ranges, unsigned int submeshCount, const MeshLod* lods, unsigned int lodCount)
+	{
+		for (unsigned int s = 0; s < submeshCount; s++)
+		{
+			if (!memchr(submeshes[s].Name, 0, sizeof(submeshes[s].Name)) ||
+				!memchr(submeshes[s].Material, 0, sizeof(submeshes[s].Material)))
+				return false;
+		}
+
+		for (unsigned int l = 0; l < lodCount; l++)
+		{
+			for (unsigned int s = 0; s < submeshCount; s++)
+			{
+				const IndexRange& range = ranges[l * submeshCount + s];
+				if (range.Start % 3 != 0 || range.Count % 3 != 0 ||
+					range.Start < lods[l].IndexStart ||
+					(uint64_t)range.Start + range.Count > (uint64_t)lods[l].IndexStart + lods[l].IndexCount)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// Checks the arrays of a mapped cache whose header is valid,
+	// and points out at them
+	// --------------------------------------------------------
+	bool ReadArrays(const char* data, const MeshCache::Header& header, MeshCacheData& out)
+	{
+		const MeshLod* lods = (const MeshLod*)(data + header.LodOffset);
+		const Meshlet* meshlets = (const Meshlet*)(data + header.MeshletOffset);
+		const MeshSubmesh* submeshes = (const MeshSubmesh*)(data + header.SubmeshOffset);
+		const IndexRange* submeshRanges = (const IndexRange*)(data + header.SubmeshRangeOffset);
+		if (!AreLodsValid(lods, header.LodCount, header.IndexCount) ||
+			!AreMeshletsValid(meshlets, header.MeshletCount, header.IndexCount) ||
+			!AreSubmeshesValid(submeshes, submeshRanges, header.SubmeshCount, lods, header.LodCount))
+			return false;
+
+		out.Vertices = (const PackedVertex*)(data + header.VertexOffset);
+		out.Indices = data + header.IndexOffset;
+		out.VertexCount = header.VertexCount;
+		out.IndexCount = header.IndexCount;
+		out.IndexStride = header.IndexStride;
+		out.Lods = lods;
+		out.LodCount = header.LodCount;
+		out.Meshlets = meshlets;
+		out.MeshletCount = header.MeshletCount;
+		out.Submeshes = submeshes;
+		out.SubmeshRanges = submeshRanges;
+		out.SubmeshCount = header.SubmeshCount;
+		out.MaterialLibrary = data + offsetof(MeshCache::Header, MaterialLibrary);
+		out.BoundsMin = header.BoundsMin;
+		out.BoundsMax = header.BoundsMax;
+		return true;
+	}
+
+	// Overwrites just the header of an existing cache file
+	bool RewriteHeader(const std::wstring& cachePath, const MeshCache::Header& header)
+	{
+		std::fstream file(std::filesystem::path(cachePath), std::ios::in | std::ios::out | std::ios::binary);
+		if (!file)
+			return false;
+
+		file.write((const char*)&header, sizeof(header));
+		return (bool)file;
+	}
+}
+
+std::wstring MeshCache::GetCachePath(const std::wstring& sourcePath)
+{
+	return std::filesystem::path(sourcePath).replace_extension(L".mesh").wstring();
+}
+
+// --------------------------------------------------------
+// Maps an up to date cache for the given source asset
+//
+// - Stale if the format, source size or source contents differ
+// - If only the modification time changed (fresh checkout,
+//    copied folder) the contents are hashed; when they still
+//    match, the stored time is refreshed instead of rebuilding
+// --------------------------------------------------------
+bool MeshCache::Load(const std::wstring& sourcePath, MappedFile& cacheFile, MeshCacheData& out)
+{
+	out = MeshCacheData();
+
+	SourceStamp stamp;
+	if (!GetSourceSizeAndTime(sourcePath, stamp))
+		return false;
+
+	std::wstring cachePath = GetCachePath(sourcePath);
+	if (!cacheFile.Open(cachePath) || cacheFile.GetSize() < sizeof(Header))
+	{
+		cacheFile.Close();
+		return false;
+	}
+
+	Header header;
+	memcpy(&header, cacheFile.GetData(), sizeof(header));
+
+	if (!IsHeaderValid(header, cacheFile.GetSize()) || header.SourceSize != stamp.Size)
+	{
+		cacheFile.Close();
+		return false;
+	}
+
+	if (header.SourceTime != stamp.Time)
+	{
+		if (!GetSourceHash(sourcePath, stamp) || header.SourceHash != stamp.Hash)
+		{
+			cacheFile.Close();
+			return false;
+		}
+
+		// Same contents, so just record the new time for next run
+		// - The file has to be unmapped before it can be written
+		header.SourceTime = stamp.Time;
+		cacheFile.Close();
+		RewriteHeader(cachePath, header);
+
+		if (!cacheFile.Open(cachePath) || cacheFile.GetSize() != header.FileSize)
+		{
+			cacheFile.Close();
+			return false;
+		}
+	}
+
+	if (!ReadArrays(cacheFile.GetData(), header, out))
+	{
+		cacheFile.Close();
+		return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Maps a cooked .mesh, validated the same way as a cache
+//
+// - The source stamp in its header is only for the cooker,
+//    so it isn't checked here
+// --------------------------------------------------------
+bool MeshCache::LoadCooked(const std::wstring& cookedPath, MappedFile& cookedFile, MeshCacheData& out)
+{
+	out = MeshCacheData();
+
+	ByteSpan file;
+	if (!Vfs::Read(cookedPath, cookedFile, file) || file.Size < sizeof(Header))
+	{
+		cookedFile.Close();
+		return false;
+	}
+
+	Header header;
+	memcpy(&header, file.Data, sizeof(header));
+	if (!IsHeaderValid(header, file.Size) || !ReadArrays(file.Data, header, out))
+	{
+		cookedFile.Close();
+		return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Writes the cache for a source asset
+//
+// - Written to a temporary file first and then renamed, so
+//    an interrupted write never leaves a half-finished cache
+// --------------------------------------------------------
+bool MeshCache::Save(const std::wstring& sourcePath, const MeshCacheData& data)
+{
+	return Save(sourcePath, GetCachePath(sourcePath), data);
+}
+
+bool MeshCache::Save(const std::wstring& sourcePath, const std::wstring& cachePath, const MeshCacheData& data)
+{
+	if (!data.Vertices || !data.Indices || data.VertexCount == 0 || data.IndexCount == 0)
+		return false;
+	if (data.IndexStride != 2 && data.IndexStride != 4)
+		return false;
+	if (!data.Lods || data.LodCount == 0 || data.LodCount > MeshSimplifier::MaxLods ||
+		!AreLodsValid(data.Lods, data.LodCount, data.IndexCount))
+		return false;
+	if ((!data.Meshlets && data.MeshletCount > 0) ||
+		!AreMeshletsValid(data.Meshlets, data.MeshletCount, data.IndexCount))
+		return false;
+	if (!data.Submeshes || !data.SubmeshRanges || data.SubmeshCount == 0 ||
+		!AreSubmeshesValid(data.Submeshes, data.SubmeshRanges, data.SubmeshCount, data.Lods, data.LodCount))
+		return false;
+
+	SourceStamp stamp;
+	if (!GetSourceSizeAndTime(sourcePath, stamp) || !GetSourceHash(sourcePath, stamp))
+		return false;
+
+	uint64_t vertexBytes = (uint64_t)data.VertexCount * sizeof(PackedVertex);
+	uint64_t indexBytes = (uint64_t)data.IndexCount * data.IndexStride;
+	uint64_t lodBytes = (uint64_t)data.LodCount * sizeof(MeshLod);
+	uint64_t meshletBytes = (uint64_t)data.MeshletCount * sizeof(Meshlet);
+	uint64_t submeshBytes = (uint64_t)data.SubmeshCount * sizeof(MeshSubmesh);
+	uint64_t rangeBytes = (uint64_t)data.SubmeshCount * data.LodCount * sizeof(IndexRange);
+
+	Header header = {};
+	header.Magic = Magic;
+	header.Version = Version;
+	header.VertexStride = sizeof(PackedVertex);
+	header.IndexStride = data.IndexStride;
+	header.SourceSize = stamp.Size;
+	header.SourceTime = stamp.Time;
+	header.SourceHash = stamp.Hash;
+	header.BoundsMin = data.BoundsMin;
+	header.BoundsMax = data.BoundsMax;
+	header.VertexCount = data.VertexCount;
+	header.IndexCount = data.IndexCount;
+	header.VertexOffset = AlignUp(sizeof(Header), SectionAlignment);
+	header.IndexOffset = AlignUp(header.VertexOffset + vertexBytes, SectionAlignment);
+	header.LodCount = data.LodCount;
+	header.LodOffset = AlignUp(header.IndexOffset + indexBytes, SectionAlignment);
+	header.MeshletCount = data.MeshletCount;
+	header.MeshletOffset = AlignUp(header.LodOffset + lodBytes, SectionAlignment);
+	header.SubmeshCount = data.SubmeshCount;
+	header.SubmeshOffset = AlignUp(header.MeshletOffset + meshletBytes, SectionAlignment);
+	header.SubmeshRangeOffset = AlignUp(header.SubmeshOffset + submeshBytes, SectionAlignment);
+	header.FileSize = header.SubmeshRangeOffset + rangeBytes;
+	strncpy(header.MaterialLibrary, data.MaterialLibrary ? data.MaterialLibrary : "", sizeof(header.MaterialLibrary) - 1);
+
+	std::filesystem::path tempPath(cachePath);
+	tempPath += L".tmp";
+
+	{
+		std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		const char padding[SectionAlignment] = {};
+		file.write((const char*)&header, sizeof(header));
+		file.write(padding, header.VertexOffset - sizeof(header));
+		file.write((const char*)data.Vertices, vertexBytes);
+		file.write(padding, header.IndexOffset - (header.VertexOffset + vertexBytes));
+		file.write((const char*)data.Indices, indexBytes);
+		file.write(padding, header.LodOffset - (header.IndexOffset + indexBytes));
+		file.write((const char*)data.Lods, lodBytes);
+		file.write(padding, header.MeshletOffset - (header.LodOffset + lodBytes));
+		if (meshletBytes > 0)
+			file.write((const char*)data.Meshlets, meshletBytes);
+		file.write(padding, header.SubmeshOffset - (header.MeshletOffset + meshletBytes));
+		file.write((const char*)data.Submeshes, submeshBytes);
+		file.write(padding, header.SubmeshRangeOffset - (header.SubmeshOffset + submeshBytes));
+		file.write((const char*)data.SubmeshRanges, rangeBytes);
+
+		if (!file)
+		{
+			file.close();
+			std::error_code ignored;
+			std::filesystem::remove(tempPath, ignored);
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, cachePath, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// 64-bit content hash (xxHash64 style)
+// - Four independent lanes of 8 bytes, so it runs at memory
+//    speed instead of one multiply chain per byte
+// --------------------------------------------------------
+uint64_t MeshCache::HashBytes(const void* data, size_t size)
+{
+	const uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+	const uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+	const uint64_t Prime3 = 0x165667B19E3779F9ull;
+	const uint64_t Prime4 = 0x85EBCA77C2B2AE63ull;
+	const uint64_t Prime5 = 0x27D4EB2F165667C5ull;
+
+	const unsigned char* p = (const unsigned char*)data;
+	const unsigned char* end = p + size;
+	uint64_t h;
+
+	auto round = [&](uint64_t acc, uint64_t input)
+	{
+		acc += input * Prime2;
+		acc = RotateLeft(acc, 31);
+		return acc * Prime1;
+	};
+
+	if (size >= 32)
+	{
+		uint64_t v1 = Prime1 + Prime2;
+		uint64_t v2 = Prime2;
+		uint64_t v3 = 0;
+		uint64_t v4 = 0 - Prime1;
+
+		for (; p + 32 <= end; p += 32)
+		{
+			v1 = round(v1, ReadU64(p));
+			v2 = round(v2, ReadU64(p + 8));
+			v3 = round(v3, ReadU64(p + 16));
+			v4 = round(v4, ReadU64(p + 24));
+		}
+
+		h = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+		for (uint64_t v : { v1, v2, v3, v4 })
+			h = (h ^ round(0, v)) * Prime1 + Prime4;
+	}
+	else
+	{
+		h = Prime5;
+	}
+
+	h += (uint64_t)size;
+
+	for (; p + 8 <= end; p += 8)
+		h = RotateLeft(h ^ round(0, ReadU64(p)), 27) * Prime1 + Prime4;
+
+	for (; p < end; p++)
+		h = RotateLeft(h ^ (*p * Prime5), 11) * Prime1;
+
+	h ^= h >> 33;
+	h *= Prime2;
+	h ^= h >> 29;
+	h *= Prime3;
+	h ^= h >> 32;
+	return h;
+}
+
+void MeshCache::CalculateBounds(const Vertex* vertices, unsigned int vertexCount, XMFLOAT3& boundsMin, XMFLOAT3& boundsMax)
+{
+	if (vertexCount == 0)
+	{
+		boundsMin = boundsMax = XMFLOAT3(0, 0, 0);
+		return;
+	}
+
+	boundsMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	boundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const XMFLOAT3& p = vertices[i].Position;
+		boundsMin.x = p.x < boundsMin.x ? p.x : boundsMin.x;
+		boundsMin.y = p.y < boundsMin.y ? p.y : boundsMin.y;
+		boundsMin.z = p.z < boundsMin.z ? p.z : boundsMin.z;
+		boundsMax.x = p.x > boundsMax.x ? p.x : boundsMax.x;
+		boundsMax.y = p.y > boundsMax.y ? p.y : boundsMax.y;
+		boundsMax.z = p.z > boundsMax.z ? p.z : boundsMax.z;
+	}
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "MappedFile.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "VertexPacking.h"
+
+// --------------------------------------------------------
+// Names of one part of a mesh (see ObjSubmesh), fixed size
+// so they can be stored in the .mesh cache as is
+// - Longer names are cut off
+// --------------------------------------------------------
+struct MeshSubmesh
+{
+	static const unsigned int MaxNameLength = 63;
+
+	char Name[MaxNameLength + 1];
+	char Material[MaxNameLength + 1];
+};
+
+// --------------------------------------------------------
+// GPU-ready vertex/index data of a mesh, either pointing into
+// a memory mapped .mesh file or at arrays owned by the caller
+//
+// - Vertices are packed (see VertexPacking) and quantized to
+//    the bounds, so the bounds are needed to draw them
+// - Indices are 16-bit when IndexStride is 2, 32-bit when 4
+// - IndexCount covers every LOD; each LOD is a range of it,
+//    split further into meshlets for culling
+// - Each LOD's range holds its submeshes one after another;
+//    SubmeshRanges has LodCount * SubmeshCount entries, with
+//    all submeshes of LOD 0 first (meshlets never cross them)
+// --------------------------------------------------------
+struct MeshCacheData
+{
+	const PackedVertex* Vertices = nullptr;
+	const void* Indices = nullptr;
+	unsigned int VertexCount = 0;
+	unsigned int IndexCount = 0;
+	unsigned int IndexStride = sizeof(unsigned int);
+	const MeshLod* Lods = nullptr;
+	unsigned int LodCount = 0;
+	const Meshlet* Meshlets = nullptr;
+	unsigned int MeshletCount = 0;
+	const MeshSubmesh* Submeshes = nullptr;
+	const IndexRange* SubmeshRanges = nullptr;
+	unsigned int SubmeshCount = 0;
+	const char* MaterialLibrary = "";
+
+	XMFLOAT3 BoundsMin = XMFLOAT3(0, 0, 0);
+	XMFLOAT3 BoundsMax = XMFLOAT3(0, 0, 0);
+};
+
+// --------------------------------------------------------
+// Binary .mesh cache written next to each source asset
+//
+// - Holds the finished packed vertex and index arrays (welded,
+//    optimized, with tangents and LODs) so later runs skip all of it
+// - The header records the source file's size, modification
+//    time and content hash; any mismatch (or a new format
+//    version) marks the cache as stale so it gets rebuilt
+// - Arrays are stored 16-byte aligned, so loading is just a
+//    memory map and the pointers go straight to the GPU
+// --------------------------------------------------------
+namespace MeshCache
+{
+	const uint32_t Magic = 0x4853454D; // "MESH"
+
+	// Bump whenever the stored data changes so old caches rebuild
+	// - 2: triangles and vertices are cache/fetch optimized
+	// - 3: packed vertices and 16-bit indices when they fit
+	// - 4: LOD index ranges after the full resolution indices
+	// - 5: meshlets with culling bounds
+	// - 6: tangents guarded against degenerate UVs
+	// - 7: submeshes, with their names and material library
+	const uint32_t Version = 7;
+
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t VertexStride;	// sizeof(PackedVertex) when written
+		uint32_t IndexStride;	// 2 or 4
+
+		uint64_t SourceSize;
+		uint64_t SourceTime;
+		uint64_t SourceHash;
+		uint64_t FileSize;
+
+		XMFLOAT3 BoundsMin;
+		uint32_t VertexCount;
+		XMFLOAT3 BoundsMax;
+		uint32_t IndexCount;
+
+		uint64_t VertexOffset;
+		uint64_t IndexOffset;
+
+		uint32_t LodCount;
+		uint32_t MeshletCount;
+		uint64_t LodOffset;
+		uint64_t MeshletOffset;
+
+		uint32_t SubmeshCount;
+		uint32_t Reserved;
+		uint64_t SubmeshOffset;
+		uint64_t SubmeshRangeOffset;
+		char MaterialLibrary[MeshSubmesh::MaxNameLength + 1];
+	};
+
+	// Path of the cache file that belongs to a source asset
+	std::wstring GetCachePath(const std::wstring& sourcePath);
+
+	// Maps the cache for a source asset if it is up to date
+	// - On success, out points into cacheFile, which must stay
+	//    open for as long as the data is used
+	bool Load(const std::wstring& sourcePath, MappedFile& cacheFile, MeshCacheData& out);
+
+	// Maps a cooked .mesh (see AssetCooker) through Vfs, without
+	// looking for its source
+	// - out points into the mounted pack, or into cookedFile when
+	//    the .mesh is a loose file
+	bool LoadCooked(const std::wstring& cookedPath, MappedFile& cookedFile, MeshCacheData& out);
+
+	// Writes (or replaces) the cache for a source asset, next to
+	// it or at the given path
+	bool Save(const std::wstring& sourcePath, const MeshCacheData& data);
+	bool Save(const std::wstring& sourcePath, const std::wstring& cachePath, const MeshCacheData& data);
+
+	// 64-bit content hash used for the source stamp (and by the
+	// asset cooker to tell changed inputs apart)
+	uint64_t HashBytes(const void* data, size_t size);
+
+	// Min/max corners of a set of vertex positions
+	void CalculateBounds(const Vertex* vertices, unsigned int vertexCount, XMFLOAT3& boundsMin, XMFLOAT3& boundsMax);
+}
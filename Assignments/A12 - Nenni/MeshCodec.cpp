@@ -0,0 +1,553 @@
+#include "MeshCodec.h"
+#include "Vfs.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESH_CODEC_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Floats in a Vertex, each of which is one stream
+	const unsigned int VertexComponents = sizeof(Vertex) / sizeof(float);
+	static_assert(sizeof(Vertex) == VertexComponents * sizeof(float), "Vertex must be made of floats only");
+
+	// Vertex streams, then the index stream
+	const unsigned int StreamCount = VertexComponents + 1;
+
+	// Values per group (one header byte and up to 4 x 16 bytes)
+	const unsigned int GroupSize = 16;
+
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t VertexCount;
+		uint32_t IndexCount;
+		uint32_t Stored;	// 1 when the arrays follow as they are
+		uint32_t Padding;
+		uint64_t Size;
+	};
+
+	// Follows the header of compressed data: where each stream
+	// starts; each ends where the next one starts, the last one
+	// at Size
+	struct StreamTable
+	{
+		uint64_t Offsets[StreamCount];
+	};
+
+	inline uint64_t GetStoredSize(uint64_t vertexCount, uint64_t indexCount)
+	{
+		return sizeof(Header) + vertexCount * sizeof(Vertex) + indexCount * sizeof(uint32_t);
+	}
+
+	inline uint32_t ZigZag(uint32_t delta)
+	{
+		return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+	}
+
+	inline uint32_t UnZigZag(uint32_t value)
+	{
+		return (value >> 1) ^ (0u - (value & 1));
+	}
+
+	// Bits per byte for each of the 2-bit width codes
+	const unsigned int CodeBits[4] = { 0, 2, 4, 8 };
+
+	// Smallest width code whose bits fit every byte
+	unsigned int WidthCode(const uint8_t* bytes)
+	{
+		uint8_t largest = 0;
+		for (unsigned int i = 0; i < GroupSize; i++)
+			largest = std::max(largest, bytes[i]);
+
+		if (largest == 0) return 0;
+		if (largest < 4) return 1;
+		if (largest < 16) return 2;
+		return 3;
+	}
+
+	// --------------------------------------------------------
+	// Appends one stream of count values (read with a stride,
+	// in units of uint32_t)
+	// - Per group: a header byte with the 4 planes' width codes
+	//    (plane 0, the low bytes, in the low bits), then each
+	//    plane's packed bytes
+	// - The last group is padded with zero differences
+	// --------------------------------------------------------
+	void EncodeStream(const uint32_t* values, size_t stride, unsigned int count, std::vector<uint8_t>& out)
+	{
+		uint32_t previous = 0;
+		for (unsigned int start = 0; start < count; start += GroupSize)
+		{
+			uint8_t planes[4][GroupSize] = {};
+			for (unsigned int i = 0; i < GroupSize && start + i < count; i++)
+			{
+				uint32_t value = values[(start + i) * stride];
+				uint32_t delta = ZigZag(value - previous);
+				previous = value;
+
+				for (unsigned int p = 0; p < 4; p++)
+					planes[p][i] = (uint8_t)(delta >> (p * 8));
+			}
+
+			unsigned int codes[4];
+			uint8_t header = 0;
+			for (unsigned int p = 0; p < 4; p++)
+			{
+				codes[p] = WidthCode(planes[p]);
+				header |= (uint8_t)(codes[p] << (p * 2));
+			}
+			out.push_back(header);
+
+			for (unsigned int p = 0; p < 4; p++)
+			{
+				unsigned int bits = CodeBits[codes[p]];
+				if (bits == 0)
+					continue;
+
+				// Value i goes in byte i * bits / 8, lowest bits first
+				unsigned int perByte = 8 / bits;
+				for (unsigned int i = 0; i < GroupSize; i += perByte)
+				{
+					uint8_t packed = 0;
+					for (unsigned int k = 0; k < perByte; k++)
+						packed |= (uint8_t)(planes[p][i + k] << (k * bits));
+					out.push_back(packed);
+				}
+			}
+		}
+	}
+
+	// Bytes of packed data after a group's header byte
+	inline size_t GroupDataSize(uint8_t header)
+	{
+		size_t size = 0;
+		for (unsigned int p = 0; p < 4; p++)
+			size += CodeBits[(header >> (p * 2)) & 3] * GroupSize / 8;
+		return size;
+	}
+
+	// --------------------------------------------------------
+	// Reads one stream group by group, keeping the running
+	// total between groups
+	// --------------------------------------------------------
+	struct StreamReader
+	{
+		const uint8_t* Next;
+		const uint8_t* End;
+		uint32_t Previous;
+
+#ifdef MESH_CODEC_SSE
+		__m128i Last;
+#endif
+
+		void Start(const uint8_t* begin, const uint8_t* end)
+		{
+			Next = begin;
+			End = end;
+			Previous = 0;
+#ifdef MESH_CODEC_SSE
+			Last = _mm_setzero_si128();
+#endif
+		}
+
+		// Checks the next group is all there, then returns its header
+		bool NextGroup(uint8_t& header)
+		{
+			if (Next >= End)
+				return false;
+
+			header = *Next;
+			if (GroupDataSize(header) > (size_t)(End - Next - 1))
+				return false;
+
+			Next++;
+			return true;
+		}
+	};
+
+	// Plain version of unpacking one plane's 16 bytes
+	void UnpackPlane(const uint8_t*& p, unsigned int code, uint8_t* out)
+	{
+		unsigned int bits = CodeBits[code];
+		if (bits == 0)
+		{
+			memset(out, 0, GroupSize);
+			return;
+		}
+
+		unsigned int perByte = 8 / bits;
+		uint8_t mask = (uint8_t)((1u << bits) - 1);
+		for (unsigned int i = 0; i < GroupSize; i += perByte, p++)
+		{
+			for (unsigned int k = 0; k < perByte; k++)
+				out[i + k] = (uint8_t)((*p >> (k * bits)) & mask);
+		}
+	}
+
+	// Decodes 16 values of a stream in plain C++ (used for the
+	// last group of each stream, and when SSE isn't available)
+	bool DecodeGroupScalar(StreamReader& reader, uint32_t* out)
+	{
+		uint8_t header;
+		if (!reader.NextGroup(header))
+			return false;
+
+		uint8_t planes[4][GroupSize];
+		for (unsigned int p = 0; p < 4; p++)
+			UnpackPlane(reader.Next, (header >> (p * 2)) & 3, planes[p]);
+
+		for (unsigned int i = 0; i < GroupSize; i++)
+		{
+			uint32_t delta = planes[0][i] | (planes[1][i] << 8) | (planes[2][i] << 16) | ((uint32_t)planes[3][i] << 24);
+			reader.Previous += UnZigZag(delta);
+			out[i] = reader.Previous;
+		}
+
+#ifdef MESH_CODEC_SSE
+		reader.Last = _mm_set1_epi32((int)reader.Previous);
+#endif
+		return true;
+	}
+
+#ifdef MESH_CODEC_SSE
+	// --------------------------------------------------------
+	// One plane's 16 bytes from 0, 4, 8 or 16 packed bytes
+	// - 4 bits: low and high nibbles are interleaved back
+	// - 2 bits: the four 2-bit fields of each byte are split out
+	//    and interleaved in two steps
+	// --------------------------------------------------------
+	inline __m128i UnpackPlaneSSE(const uint8_t*& p, unsigned int code)
+	{
+		switch (code)
+		{
+		case 0:
+			return _mm_setzero_si128();
+		case 1:
+		{
+			int32_t packed;
+			memcpy(&packed, p, sizeof(packed));
+			p += 4;
+
+			__m128i x = _mm_cvtsi32_si128(packed);
+			__m128i mask = _mm_set1_epi8(3);
+			__m128i a = _mm_and_si128(x, mask);
+			__m128i b = _mm_and_si128(_mm_srli_epi16(x, 2), mask);
+			__m128i c = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+			__m128i d = _mm_and_si128(_mm_srli_epi16(x, 6), mask);
+			return _mm_unpacklo_epi16(_mm_unpacklo_epi8(a, b), _mm_unpacklo_epi8(c, d));
+		}
+		case 2:
+		{
+			__m128i x = _mm_loadl_epi64((const __m128i*)p);
+			p += 8;
+
+			__m128i mask = _mm_set1_epi8(15);
+			__m128i low = _mm_and_si128(x, mask);
+			__m128i high = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+			return _mm_unpacklo_epi8(low, high);
+		}
+		default:
+		{
+			__m128i x = _mm_loadu_si128((const __m128i*)p);
+			p += 16;
+			return x;
+		}
+		}
+	}
+
+	// Zigzag decodes 4 differences and adds them up after last
+	inline __m128i SumDeltas(__m128i zigzag, __m128i last)
+	{
+		__m128i one = _mm_set1_epi32(1);
+		__m128i delta = _mm_xor_si128(_mm_srli_epi32(zigzag, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(zigzag, one)));
+
+		// Inclusive prefix sum of the 4 lanes
+		delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 4));
+		delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 8));
+		return _mm_add_epi32(delta, _mm_shuffle_epi32(last, _MM_SHUFFLE(3, 3, 3, 3)));
+	}
+
+	// --------------------------------------------------------
+	// Decodes 16 values of a stream into 4 registers
+	// - The byte planes are interleaved back into 32-bit values
+	//    with two rounds of unpacks
+	// --------------------------------------------------------
+	inline bool DecodeGroupSSE(StreamReader& reader, __m128i out[4])
+	{
+		uint8_t header;
+		if (!reader.NextGroup(header))
+			return false;
+
+		__m128i p0 = UnpackPlaneSSE(reader.Next, header & 3);
+		__m128i p1 = UnpackPlaneSSE(reader.Next, (header >> 2) & 3);
+		__m128i p2 = UnpackPlaneSSE(reader.Next, (header >> 4) & 3);
+		__m128i p3 = UnpackPlaneSSE(reader.Next, (header >> 6) & 3);
+
+		__m128i low01 = _mm_unpacklo_epi8(p0, p1);
+		__m128i high01 = _mm_unpackhi_epi8(p0, p1);
+		__m128i low23 = _mm_unpacklo_epi8(p2, p3);
+		__m128i high23 = _mm_unpackhi_epi8(p2, p3);
+
+		out[0] = SumDeltas(_mm_unpacklo_epi16(low01, low23), reader.Last);
+		out[1] = SumDeltas(_mm_unpackhi_epi16(low01, low23), out[0]);
+		out[2] = SumDeltas(_mm_unpacklo_epi16(high01, high23), out[1]);
+		out[3] = SumDeltas(_mm_unpackhi_epi16(high01, high23), out[2]);
+
+		reader.Last = out[3];
+		reader.Previous = (uint32_t)_mm_cvtsi128_si32(_mm_shuffle_epi32(out[3], _MM_SHUFFLE(3, 3, 3, 3)));
+		return true;
+	}
+#endif
+
+	// --------------------------------------------------------
+	// Decodes the vertex streams 16 vertices at a time
+	// - With SSE, each 4 x 4 block of (component, vertex) values
+	//    is transposed and stored as part of 4 vertices; the
+	//    last block of components has one padding lane, whose
+	//    store spills into the next vertex, so those blocks are
+	//    stored first and the last group goes the plain way
+	// --------------------------------------------------------
+	bool DecodeVertices(StreamReader* readers, unsigned int vertexCount, Vertex* vertices)
+	{
+		uint32_t* out = (uint32_t*)vertices;
+		unsigned int start = 0;
+
+#ifdef MESH_CODEC_SSE
+		const unsigned int Blocks = (VertexComponents + 3) / 4;
+		for (; start + GroupSize < vertexCount; start += GroupSize)
+		{
+			__m128i values[Blocks * 4][4];
+			for (unsigned int c = 0; c < VertexComponents; c++)
+			{
+				if (!DecodeGroupSSE(readers[c], values[c]))
+					return false;
+			}
+			for (unsigned int c = VertexComponents; c < Blocks * 4; c++)
+				values[c][0] = values[c][1] = values[c][2] = values[c][3] = _mm_setzero_si128();
+
+			for (unsigned int v = 0; v < 4; v++)
+			{
+				uint32_t* first = out + (size_t)(start + v * 4) * VertexComponents;
+				for (int block = Blocks - 1; block >= 0; block--)
+				{
+					__m128 r0 = _mm_castsi128_ps(values[block * 4 + 0][v]);
+					__m128 r1 = _mm_castsi128_ps(values[block * 4 + 1][v]);
+					__m128 r2 = _mm_castsi128_ps(values[block * 4 + 2][v]);
+					__m128 r3 = _mm_castsi128_ps(values[block * 4 + 3][v]);
+					_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+					_mm_storeu_ps((float*)(first + block * 4), r0);
+					_mm_storeu_ps((float*)(first + VertexComponents + block * 4), r1);
+					_mm_storeu_ps((float*)(first + VertexComponents * 2 + block * 4), r2);
+					_mm_storeu_ps((float*)(first + VertexComponents * 3 + block * 4), r3);
+				}
+			}
+		}
+#endif
+
+		for (; start < vertexCount; start += GroupSize)
+		{
+			uint32_t values[VertexComponents][GroupSize];
+			for (unsigned int c = 0; c < VertexComponents; c++)
+			{
+				if (!DecodeGroupScalar(readers[c], values[c]))
+					return false;
+			}
+
+			unsigned int count = std::min(GroupSize, vertexCount - start);
+			for (unsigned int i = 0; i < count; i++)
+			{
+				for (unsigned int c = 0; c < VertexComponents; c++)
+					out[(size_t)(start + i) * VertexComponents + c] = values[c][i];
+			}
+		}
+		return true;
+	}
+
+	bool DecodeIndices(StreamReader& reader, unsigned int indexCount, unsigned int* indices)
+	{
+		unsigned int start = 0;
+
+#ifdef MESH_CODEC_SSE
+		for (; start + GroupSize <= indexCount; start += GroupSize)
+		{
+			__m128i values[4];
+			if (!DecodeGroupSSE(reader, values))
+				return false;
+
+			for (unsigned int i = 0; i < 4; i++)
+				_mm_storeu_si128((__m128i*)(indices + start + i * 4), values[i]);
+		}
+#endif
+
+		for (; start < indexCount; start += GroupSize)
+		{
+			uint32_t values[GroupSize];
+			if (!DecodeGroupScalar(reader, values))
+				return false;
+
+			unsigned int count = std::min(GroupSize, indexCount - start);
+			memcpy(indices + start, values, sizeof(uint32_t) * count);
+		}
+		return true;
+	}
+
+	// Reads the header, and the stream table of compressed data
+	bool ReadHeader(const void* data, size_t size, Header& header, StreamTable& streams)
+	{
+		if (!data || size < sizeof(Header))
+			return false;
+
+		memcpy(&header, data, sizeof(Header));
+		if (header.Magic != MeshCodec::Magic || header.Version != MeshCodec::Version || header.Size != size || header.Stored > 1)
+			return false;
+
+		if (header.Stored)
+			return size == GetStoredSize(header.VertexCount, header.IndexCount);
+
+		if (size < sizeof(Header) + sizeof(StreamTable))
+			return false;
+		memcpy(&streams, (const uint8_t*)data + sizeof(Header), sizeof(StreamTable));
+
+		// Streams must be in order and inside the data
+		uint64_t previous = sizeof(Header) + sizeof(StreamTable);
+		for (unsigned int s = 0; s < StreamCount; s++)
+		{
+			if (streams.Offsets[s] < previous || streams.Offsets[s] > size)
+				return false;
+			previous = streams.Offsets[s];
+		}
+		return true;
+	}
+
+	// Every index has to be one of the vertices
+	bool AreIndicesValid(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount)
+	{
+		unsigned int largest = 0;
+		for (unsigned int i = 0; i < indexCount; i++)
+			largest = std::max(largest, indices[i]);
+		return indexCount == 0 || largest < vertexCount;
+	}
+}
+
+std::vector<uint8_t> MeshCodec::Encode(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount)
+{
+	Header header = {};
+	header.Magic = Magic;
+	header.Version = Version;
+	header.VertexCount = vertexCount;
+	header.IndexCount = indexCount;
+
+	StreamTable streams = {};
+	std::vector<uint8_t> out(sizeof(Header) + sizeof(StreamTable));
+	for (unsigned int c = 0; c < VertexComponents; c++)
+	{
+		streams.Offsets[c] = out.size();
+		EncodeStream((const uint32_t*)vertices + c, VertexComponents, vertexCount, out);
+	}
+	streams.Offsets[VertexComponents] = out.size();
+	EncodeStream(indices, 1, indexCount, out);
+
+	// Small meshes (and noisy ones) can come out bigger than
+	// they went in, so those are stored as they are
+	uint64_t storedSize = GetStoredSize(vertexCount, indexCount);
+	if (out.size() >= storedSize)
+	{
+		header.Stored = 1;
+		header.Size = storedSize;
+		out.assign(sizeof(Header), 0);
+		out.insert(out.end(), (const uint8_t*)vertices, (const uint8_t*)(vertices + vertexCount));
+		out.insert(out.end(), (const uint8_t*)indices, (const uint8_t*)(indices + indexCount));
+		memcpy(&out[0], &header, sizeof(Header));
+		return out;
+	}
+
+	header.Size = out.size();
+	memcpy(&out[0], &header, sizeof(Header));
+	memcpy(&out[sizeof(Header)], &streams, sizeof(StreamTable));
+	return out;
+}
+
+bool MeshCodec::ReadCounts(const void* data, size_t size, unsigned int& vertexCount, unsigned int& indexCount)
+{
+	Header header;
+	StreamTable streams;
+	if (!ReadHeader(data, size, header, streams))
+		return false;
+
+	vertexCount = header.VertexCount;
+	indexCount = header.IndexCount;
+	return true;
+}
+
+bool MeshCodec::Decode(const void* data, size_t size, Vertex* vertices, unsigned int* indices)
+{
+	Header header;
+	StreamTable streams;
+	if (!ReadHeader(data, size, header, streams))
+		return false;
+
+	const uint8_t* bytes = (const uint8_t*)data;
+	if (header.Stored)
+	{
+		const uint8_t* storedIndices = bytes + sizeof(Header) + (size_t)header.VertexCount * sizeof(Vertex);
+		memcpy(vertices, bytes + sizeof(Header), (size_t)header.VertexCount * sizeof(Vertex));
+		memcpy(indices, storedIndices, (size_t)header.IndexCount * sizeof(uint32_t));
+		return AreIndicesValid(indices, header.IndexCount, header.VertexCount);
+	}
+
+	StreamReader readers[StreamCount];
+	for (unsigned int s = 0; s < StreamCount; s++)
+	{
+		uint64_t end = s + 1 < StreamCount ? streams.Offsets[s + 1] : header.Size;
+		readers[s].Start(bytes + streams.Offsets[s], bytes + end);
+	}
+
+	return
+		DecodeVertices(readers, header.VertexCount, vertices) &&
+		DecodeIndices(readers[VertexComponents], header.IndexCount, indices) &&
+		AreIndicesValid(indices, header.IndexCount, header.VertexCount);
+}
+
+bool MeshCodec::Decode(const void* data, size_t size, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	unsigned int vertexCount, indexCount;
+	if (!ReadCounts(data, size, vertexCount, indexCount))
+		return false;
+
+	// Every group takes at least its header byte, so damaged
+	// counts can't ask for more memory than the data allows
+	if ((uint64_t)vertexCount / GroupSize * VertexComponents + (uint64_t)indexCount / GroupSize > size)
+		return false;
+
+	vertices.resize(vertexCount);
+	indices.resize(indexCount);
+	return Decode(data, size, vertices.data(), indices.data());
+}
+
+bool MeshCodec::Save(const std::wstring& path, const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount)
+{
+	std::vector<uint8_t> encoded = Encode(vertices, vertexCount, indices, indexCount);
+
+	std::ofstream file(std::filesystem::path(path), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	file.write((const char*)&encoded[0], encoded.size());
+	return (bool)file;
+}
+
+bool MeshCodec::Load(const std::wstring& path, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	MappedFile file;
+	ByteSpan data;
+	return Vfs::Read(path, file, data) && Decode(data.Data, data.Size, vertices, indices);
+}
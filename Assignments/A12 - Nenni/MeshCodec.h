@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Lossless compression of full float vertex and index arrays,
+// for storing detailed meshes in less space (.meshz files)
+//
+// - Every Vertex float (bit pattern) and every index is its own
+//    stream of 32-bit values
+// - Each value becomes the difference from the one before it in
+//    its stream, zigzag encoded so small negative differences
+//    are small numbers too
+// - Groups of 16 values are split into 4 byte planes, and each
+//    plane is stored with 0, 2, 4 or 8 bits per byte (whichever
+//    fits its largest byte), so planes of zeros (the high bytes
+//    of small differences) cost nothing
+// - Decoding uses SSE2: bits are unpacked, the byte planes
+//    interleaved back, deltas summed with a prefix sum, and the
+//    streams transposed back into Vertex order 4x4 at a time
+// - Meshes that wouldn't get smaller (small ones, mostly) are
+//    stored as plain arrays after the header instead
+// - Indices are checked against the vertex count after
+//    decoding, so damaged data can't point outside the mesh
+// --------------------------------------------------------
+namespace MeshCodec
+{
+	const uint32_t Magic = 0x5A48534D; // "MSHZ"
+	const uint32_t Version = 2;
+
+	// Compresses vertices and indices into one block of memory
+	std::vector<uint8_t> Encode(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount);
+
+	// Counts stored in compressed data (false if it isn't any)
+	bool ReadCounts(const void* data, size_t size, unsigned int& vertexCount, unsigned int& indexCount);
+
+	// Decompresses into arrays of at least the stored counts
+	// - Returns false for damaged data, including indices past
+	//    the last vertex (and the arrays may then be partly
+	//    written)
+	bool Decode(const void* data, size_t size, Vertex* vertices, unsigned int* indices);
+	bool Decode(const void* data, size_t size, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+	// .meshz files, which hold nothing but the compressed data
+	bool Save(const std::wstring& path, const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount);
+	bool Load(const std::wstring& path, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+}
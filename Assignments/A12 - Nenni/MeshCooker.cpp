@@ -0,0 +1,200 @@
+#include "MeshCooker.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+#include "TangentGenerator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	void CopyName(char* destination, const std::string& name)
+	{
+		size_t length = std::min<size_t>(name.size(), MeshSubmesh::MaxNameLength);
+		memcpy(destination, name.data(), length);
+		destination[length] = 0;
+	}
+
+	// --------------------------------------------------------
+	// Sorts one LOD's triangles by submesh and appends each
+	// submesh's range of it
+	// - Stable, so the vertex cache order within each submesh
+	//    is kept
+	// - Simplification never moves a triangle onto another
+	//    submesh's vertices (they aren't shared, see ObjParser),
+	//    so any corner tells which submesh a triangle is in
+	// --------------------------------------------------------
+	void GroupLodBySubmesh(unsigned int* indices, const MeshLod& lod, const std::vector<unsigned int>& vertexSubmesh, unsigned int submeshCount, std::vector<IndexRange>& ranges)
+	{
+		unsigned int* lodIndices = indices + lod.IndexStart;
+		unsigned int triangleCount = lod.IndexCount / 3;
+
+		std::vector<unsigned int> starts(submeshCount + 1, 0);
+		for (unsigned int t = 0; t < triangleCount; t++)
+			starts[vertexSubmesh[lodIndices[t * 3]] + 1]++;
+		for (unsigned int s = 0; s < submeshCount; s++)
+		{
+			starts[s + 1] += starts[s];
+			ranges.push_back({ lod.IndexStart + starts[s] * 3, (starts[s + 1] - starts[s]) * 3 });
+		}
+
+		std::vector<unsigned int> grouped(lod.IndexCount);
+		for (unsigned int t = 0; t < triangleCount; t++)
+		{
+			unsigned int destination = starts[vertexSubmesh[lodIndices[t * 3]]]++;
+			memcpy(&grouped[destination * 3], &lodIndices[t * 3], sizeof(unsigned int) * 3);
+		}
+		memcpy(lodIndices, &grouped[0], sizeof(unsigned int) * lod.IndexCount);
+	}
+}
+
+bool MeshCooker::CookObj(const std::wstring& objFile, CookedMesh& out)
+{
+	const wchar_t* fileName = objFile.c_str() + objFile.find_last_of(L"/\\") + 1;
+	out = CookedMesh();
+
+	// Parse the file into welded vertices and indices
+	// - See ObjParser for details (memory mapped, no sscanf)
+	ObjMeshData obj;
+	if (!ObjParser::Load(objFile, obj))
+		return false;
+
+	int vertexCount = (int)obj.Vertices.size();
+	int indexCount = (int)obj.Indices.size();
+	out.MaterialLibrary = obj.MaterialLibrary;
+
+	out.Submeshes.resize(obj.Submeshes.size());
+	for (size_t s = 0; s < obj.Submeshes.size(); s++)
+	{
+		CopyName(out.Submeshes[s].Name, obj.Submeshes[s].Name);
+		CopyName(out.Submeshes[s].Material, obj.Submeshes[s].Material);
+	}
+
+	// Reorder triangles for the post-transform vertex cache (one
+	// submesh at a time, so they stay grouped), then vertices by
+	// first use so the vertex buffer is read in order
+	// - Stats come from a simulated FIFO cache (see MeshOptimizer)
+	VertexCacheStats cacheBefore = MeshOptimizer::AnalyzeVertexCache(&obj.Indices[0], indexCount, vertexCount);
+	for (const ObjSubmesh& submesh : obj.Submeshes)
+		MeshOptimizer::OptimizeVertexCache(&obj.Indices[submesh.IndexStart], submesh.IndexCount, vertexCount);
+	vertexCount = (int)MeshOptimizer::OptimizeVertexFetch(&obj.Vertices[0], vertexCount, &obj.Indices[0], indexCount);
+	obj.Vertices.resize(vertexCount);
+	VertexCacheStats cacheAfter = MeshOptimizer::AnalyzeVertexCache(&obj.Indices[0], indexCount, vertexCount);
+
+	// Tangents are accumulated across every triangle sharing a vertex
+	TangentGenerator::Generate(&obj.Vertices[0], vertexCount, &obj.Indices[0], indexCount);
+
+	// Report how much welding saved compared to one vertex per face corner
+	// - Vertex buffer memory drops by the number of merged vertices
+	// - The vertex shader previously ran once per index; with shared
+	//    vertices the post-transform cache can reuse the merged ones
+	size_t faceCorners = obj.FaceCorners;
+	size_t bytesBefore = sizeof(Vertex) * faceCorners;
+	size_t bytesAfter = sizeof(Vertex) * vertexCount;
+	printf("%ls: %zu -> %d vertices (%d indices), vertex buffer %zu -> %zu bytes (%.1f%% saved), up to %zu fewer vertex shader invocations\n",
+		fileName,
+		faceCorners, vertexCount, indexCount,
+		bytesBefore, bytesAfter,
+		faceCorners > 0 ? 100.0 * (1.0 - (double)vertexCount / faceCorners) : 0.0,
+		faceCorners - vertexCount);
+	printf("%ls: vertex cache ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%u -> %u vertex shader runs)\n",
+		fileName,
+		cacheBefore.ACMR, cacheAfter.ACMR,
+		cacheBefore.ATVR, cacheAfter.ATVR,
+		cacheBefore.Transforms, cacheAfter.Transforms);
+
+	// Simplified LODs are appended after the full resolution indices
+	// so every LOD shares this mesh's vertex and index buffers
+	out.Lods = MeshSimplifier::GenerateLods(&obj.Vertices[0], vertexCount, obj.Indices);
+	printf("%ls: %zu LODs:", fileName, out.Lods.size());
+	for (const MeshLod& lod : out.Lods)
+		printf(" %u tris (error %.4f)", lod.IndexCount / 3, lod.Error);
+	printf("\n");
+
+	// Group every LOD by submesh, so each submesh of each LOD is
+	// one range of the index buffer
+	std::vector<unsigned int> vertexSubmesh(vertexCount, 0);
+	for (size_t s = 0; s < obj.Submeshes.size(); s++)
+	{
+		const ObjSubmesh& submesh = obj.Submeshes[s];
+		for (unsigned int i = submesh.IndexStart; i < submesh.IndexStart + submesh.IndexCount; i++)
+			vertexSubmesh[obj.Indices[i]] = (unsigned int)s;
+	}
+	for (const MeshLod& lod : out.Lods)
+		GroupLodBySubmesh(&obj.Indices[0], lod, vertexSubmesh, (unsigned int)out.Submeshes.size(), out.SubmeshRanges);
+
+	// Split every submesh of every LOD into meshlets for culling
+	// (see Meshlets), so no meshlet mixes materials
+	for (const IndexRange& range : out.SubmeshRanges)
+		Meshlets::Build(&obj.Vertices[0], vertexCount, &obj.Indices[0], range.Start, range.Count, out.Meshlets);
+	printf("%ls: %zu meshlets, %zu submeshes\n", fileName, out.Meshlets.size(), out.Submeshes.size());
+
+	MeshCache::CalculateBounds(&obj.Vertices[0], vertexCount, out.BoundsMin, out.BoundsMax);
+
+	out.Vertices = std::move(obj.Vertices);
+	out.Indices = std::move(obj.Indices);
+	return true;
+}
+
+void MeshCooker::CookArrays(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, CookedMesh& out)
+{
+	out = CookedMesh();
+	out.Vertices.assign(vertices, vertices + vertexCount);
+	out.Indices.assign(indices, indices + indexCount);
+
+	out.Lods.push_back({ 0, indexCount, 0.0f });
+	out.Submeshes.push_back({});
+	out.SubmeshRanges.push_back({ 0, indexCount });
+
+	// Meshlets reorder triangles, which is why the indices are a copy
+	Meshlets::Build(&out.Vertices[0], vertexCount, &out.Indices[0], 0, indexCount, out.Meshlets);
+
+	MeshCache::CalculateBounds(vertices, vertexCount, out.BoundsMin, out.BoundsMax);
+}
+
+// --------------------------------------------------------
+// Converts full float vertices into the compact GPU format
+//
+// - Positions are quantized to the mesh's bounds
+// - Indices are narrowed to 16 bits when every vertex fits
+// - Benchmarks::PackingRoundTrip() checks the round trip
+//    against the documented error bounds
+// --------------------------------------------------------
+MeshCacheData MeshCooker::Pack(CookedMesh& mesh)
+{
+	unsigned int vertexCount = (unsigned int)mesh.Vertices.size();
+	unsigned int indexCount = (unsigned int)mesh.Indices.size();
+
+	VertexQuantization packing = VertexPacking::QuantizationFromBounds(mesh.BoundsMin, mesh.BoundsMax);
+	mesh.PackedVertices.resize(vertexCount);
+	VertexPacking::PackVertices(&mesh.Vertices[0], vertexCount, packing, &mesh.PackedVertices[0]);
+
+	MeshCacheData data;
+	data.Vertices = &mesh.PackedVertices[0];
+	data.VertexCount = vertexCount;
+	data.IndexCount = indexCount;
+	data.Lods = &mesh.Lods[0];
+	data.LodCount = (unsigned int)mesh.Lods.size();
+	data.Meshlets = mesh.Meshlets.empty() ? nullptr : &mesh.Meshlets[0];
+	data.MeshletCount = (unsigned int)mesh.Meshlets.size();
+	data.Submeshes = &mesh.Submeshes[0];
+	data.SubmeshRanges = &mesh.SubmeshRanges[0];
+	data.SubmeshCount = (unsigned int)mesh.Submeshes.size();
+	data.MaterialLibrary = mesh.MaterialLibrary.c_str();
+	data.BoundsMin = mesh.BoundsMin;
+	data.BoundsMax = mesh.BoundsMax;
+
+	if (vertexCount < VertexPacking::MaxShortIndexVertices)
+	{
+		mesh.ShortIndices = VertexPacking::NarrowIndices(&mesh.Indices[0], indexCount);
+		data.Indices = &mesh.ShortIndices[0];
+		data.IndexStride = sizeof(uint16_t);
+	}
+	else
+	{
+		data.Indices = &mesh.Indices[0];
+		data.IndexStride = sizeof(unsigned int);
+	}
+	return data;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "MeshCache.h"
+
+// --------------------------------------------------------
+// Everything a .mesh cache holds, built from source data:
+// welded and optimized vertices with tangents, every LOD's
+// indices, meshlets and submeshes
+// - Vertices and Indices are full precision; Pack() fills in
+//    the GPU-ready copies
+// --------------------------------------------------------
+struct CookedMesh
+{
+	std::vector<Vertex> Vertices;
+	std::vector<unsigned int> Indices;	// Every LOD, one after another
+	std::vector<MeshLod> Lods;
+	std::vector<Meshlet> Meshlets;
+	std::vector<MeshSubmesh> Submeshes;
+	std::vector<IndexRange> SubmeshRanges;
+	std::string MaterialLibrary;
+
+	XMFLOAT3 BoundsMin = XMFLOAT3(0, 0, 0);
+	XMFLOAT3 BoundsMax = XMFLOAT3(0, 0, 0);
+
+	std::vector<PackedVertex> PackedVertices;
+	std::vector<uint16_t> ShortIndices;
+};
+
+// --------------------------------------------------------
+// Turns source meshes into cooked ones, without touching the
+// GPU, so the same code runs in Mesh (when a cache is stale)
+// and offline in AssetCooker
+// --------------------------------------------------------
+namespace MeshCooker
+{
+	// Parses an .obj, then optimizes it, generates tangents, LODs
+	// and meshlets, printing stats along the way
+	bool CookObj(const std::wstring& objFile, CookedMesh& out);
+
+	// Finished vertices (with tangents) and indices, as one LOD
+	// and one unnamed submesh
+	void CookArrays(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, CookedMesh& out);
+
+	// Packs the vertices (and narrows the indices when they fit)
+	// - The result points into mesh, which must outlive it
+	MeshCacheData Pack(CookedMesh& mesh);
+}
@@ -0,0 +1,273 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	// Tuning values from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+	const int ScoringCacheSize = 32;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriangleScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+
+	// Valence boosts are looked up in a table up to this many triangles
+	const unsigned int MaxScoredValence = 32;
+
+	const unsigned int NoTriangle = ~0u;
+
+	// --------------------------------------------------------
+	// Precomputed parts of the per-vertex score
+	// - Cache: vertices used by the last triangle get a fixed
+	//    score, the rest fall off with their cache position
+	// - Valence: vertices with few triangles left are boosted,
+	//    so lone triangles get finished instead of left behind
+	// --------------------------------------------------------
+	struct ScoreTables
+	{
+		float Cache[ScoringCacheSize];
+		float Valence[MaxScoredValence + 1];
+
+		ScoreTables()
+		{
+			for (int i = 0; i < ScoringCacheSize; i++)
+			{
+				if (i < 3)
+					Cache[i] = LastTriangleScore;
+				else
+					Cache[i] = powf(1.0f - (float)(i - 3) / (ScoringCacheSize - 3), CacheDecayPower);
+			}
+
+			Valence[0] = 0;
+			for (unsigned int i = 1; i <= MaxScoredValence; i++)
+				Valence[i] = ValenceBoostScale * powf((float)i, -ValenceBoostPower);
+		}
+	};
+
+	inline float VertexScore(const ScoreTables& tables, int cachePosition, unsigned int liveTriangles)
+	{
+		// No triangles left, so this vertex no longer matters
+		if (liveTriangles == 0)
+			return -1.0f;
+
+		float score = cachePosition >= 0 ? tables.Cache[cachePosition] : 0.0f;
+		score += liveTriangles <= MaxScoredValence
+			? tables.Valence[liveTriangles]
+			: ValenceBoostScale * powf((float)liveTriangles, -ValenceBoostPower);
+		return score;
+	}
+}
+
+// --------------------------------------------------------
+// Reorders triangles for the post-transform vertex cache
+//
+// - Greedily emits the best scoring triangle, where a triangle
+//    scores the sum of its vertices (see VertexScore)
+// - Only triangles touching vertices in the simulated LRU
+//    cache change score after each step, so each step is
+//    constant work and the whole pass is linear
+// - Falls back to the next unused triangle in input order
+//    when nothing in the cache has triangles left
+// --------------------------------------------------------
+void MeshOptimizer::OptimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount)
+{
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount < 2 || vertexCount == 0)
+		return;
+
+	static const ScoreTables tables;
+
+	// Triangles using each vertex, stored as one flat array
+	// - liveTriangles[v] triangles of v's range are not emitted yet
+	//    (emitted ones are swapped to the end of the range)
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (unsigned int i = 0; i < indexCount; i++)
+		liveTriangles[indices[i]]++;
+
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+	std::vector<unsigned int> adjacency(indexCount);
+	{
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (unsigned int i = 0; i < indexCount; i++)
+			adjacency[fill[indices[i]]++] = i / 3;
+	}
+
+	// Starting scores (nothing is cached yet)
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		vertexScores[v] = VertexScore(tables, -1, liveTriangles[v]);
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	unsigned int bestTriangle = 0;
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		const unsigned int* tri = &indices[t * 3];
+		triangleScores[t] = vertexScores[tri[0]] + vertexScores[tri[1]] + vertexScores[tri[2]];
+		if (triangleScores[t] > triangleScores[bestTriangle])
+			bestTriangle = t;
+	}
+
+	// Two LRU caches, swapped every step; one extra triangle's
+	// worth of room for vertices about to fall out
+	unsigned int cacheA[ScoringCacheSize + 3];
+	unsigned int cacheB[ScoringCacheSize + 3];
+	unsigned int* cache = cacheA;
+	unsigned int* nextCache = cacheB;
+	unsigned int cacheCount = 0;
+
+	std::vector<unsigned int> output(indexCount);
+	unsigned int inputCursor = 0;
+
+	for (unsigned int emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		// Dead end: continue with the next unused triangle in input order
+		if (bestTriangle == NoTriangle)
+		{
+			while (emitted[inputCursor])
+				inputCursor++;
+			bestTriangle = inputCursor;
+		}
+
+		unsigned int a = indices[bestTriangle * 3 + 0];
+		unsigned int b = indices[bestTriangle * 3 + 1];
+		unsigned int c = indices[bestTriangle * 3 + 2];
+
+		output[emittedCount * 3 + 0] = a;
+		output[emittedCount * 3 + 1] = b;
+		output[emittedCount * 3 + 2] = c;
+		emitted[bestTriangle] = true;
+
+		// Move this triangle out of each vertex's live range
+		for (unsigned int v : { a, b, c })
+		{
+			unsigned int* begin = &adjacency[adjacencyOffsets[v]];
+			unsigned int live = liveTriangles[v];
+			for (unsigned int i = 0; i < live; i++)
+			{
+				if (begin[i] == bestTriangle)
+				{
+					std::swap(begin[i], begin[live - 1]);
+					break;
+				}
+			}
+			liveTriangles[v]--;
+		}
+
+		// The new triangle goes to the front of the cache,
+		// followed by everything else that was already in it
+		unsigned int nextCount = 0;
+		nextCache[nextCount++] = a;
+		nextCache[nextCount++] = b;
+		nextCache[nextCount++] = c;
+		for (unsigned int i = 0; i < cacheCount; i++)
+		{
+			unsigned int v = cache[i];
+			if (v != a && v != b && v != c)
+				nextCache[nextCount++] = v;
+		}
+
+		// Rescore every vertex that was or is in the cache, and
+		// push the change onto its remaining triangles
+		bestTriangle = NoTriangle;
+		float bestScore = -1e30f;
+		for (unsigned int i = 0; i < nextCount; i++)
+		{
+			unsigned int v = nextCache[i];
+			int position = i < (unsigned int)ScoringCacheSize ? (int)i : -1;
+			cachePositions[v] = position;
+
+			float score = VertexScore(tables, position, liveTriangles[v]);
+			float delta = score - vertexScores[v];
+			vertexScores[v] = score;
+
+			const unsigned int* adjacent = &adjacency[adjacencyOffsets[v]];
+			for (unsigned int j = 0; j < liveTriangles[v]; j++)
+			{
+				unsigned int t = adjacent[j];
+				triangleScores[t] += delta;
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					bestTriangle = t;
+				}
+			}
+		}
+
+		std::swap(cache, nextCache);
+		cacheCount = std::min(nextCount, (unsigned int)ScoringCacheSize);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+// --------------------------------------------------------
+// Renumbers vertices in the order the index buffer first
+// uses them and rewrites the vertex array to match
+// --------------------------------------------------------
+unsigned int MeshOptimizer::OptimizeVertexFetch(Vertex* vertices, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount)
+{
+	const unsigned int Unused = ~0u;
+	std::vector<unsigned int> remap(vertexCount, Unused);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertexCount);
+
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		unsigned int& newIndex = remap[indices[i]];
+		if (newIndex == Unused)
+		{
+			newIndex = (unsigned int)reordered.size();
+			reordered.push_back(vertices[indices[i]]);
+		}
+		indices[i] = newIndex;
+	}
+
+	std::copy(reordered.begin(), reordered.end(), vertices);
+	return (unsigned int)reordered.size();
+}
+
+// --------------------------------------------------------
+// Counts vertex shader runs with a FIFO cache of cacheSize
+// entries, which is how most GPUs reuse transformed vertices
+// --------------------------------------------------------
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats;
+	if (indexCount < 3 || vertexCount == 0)
+		return stats;
+
+	// A vertex is cached if it was loaded fewer than cacheSize misses ago
+	std::vector<unsigned int> loadedAt(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	unsigned int misses = 0;
+	unsigned int usedCount = 0;
+
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		unsigned int v = indices[i];
+		if (!used[v])
+		{
+			used[v] = true;
+			usedCount++;
+		}
+		else if (misses - loadedAt[v] < cacheSize)
+		{
+			continue;
+		}
+
+		misses++;
+		loadedAt[v] = misses;
+	}
+
+	stats.Transforms = misses;
+	stats.ACMR = (float)misses / (indexCount / 3);
+	stats.ATVR = (float)misses / usedCount;
+	return stats;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Results of running an index buffer through a simulated
+// post-transform vertex cache
+//
+// - ACMR: vertex shader runs per triangle (0.5 is ideal for
+//    large grid-like meshes, 3.0 is no reuse at all)
+// - ATVR: vertex shader runs per unique vertex (1.0 is ideal)
+// --------------------------------------------------------
+struct VertexCacheStats
+{
+	unsigned int Transforms = 0;
+	float ACMR = 0;
+	float ATVR = 0;
+};
+
+// --------------------------------------------------------
+// Reordering passes that make meshes cheaper to draw
+//
+// - OptimizeVertexCache reorders triangles (Forsyth's linear
+//    speed algorithm) so recently transformed vertices get
+//    reused by the next triangles
+// - OptimizeVertexFetch then renumbers vertices in order of
+//    first use, so the vertex buffer is read front to back
+// - Neither pass changes what the mesh looks like
+// --------------------------------------------------------
+namespace MeshOptimizer
+{
+	// Size of the FIFO cache used when reporting stats
+	const unsigned int SimulatedCacheSize = 16;
+
+	void OptimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount);
+
+	// Returns the new vertex count (unreferenced vertices are dropped)
+	unsigned int OptimizeVertexFetch(Vertex* vertices, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount);
+
+	VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize = SimulatedCacheSize);
+}
@@ -0,0 +1,616 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const unsigned int NoVertex = ~0u;
+
+	// Border and seam edges are this much harder to move than
+	// the surface around them, so LODs keep their outline
+	const float BorderWeight = 10.0f;
+
+	// LODs stop once a halving step would remove less than this
+	// fraction of the triangles or move the surface too far
+	const float MinLodReduction = 0.2f;
+	const float MaxLodError = 0.05f;
+	const unsigned int MinLodTriangles = 16;
+
+	// --------------------------------------------------------
+	// How a position may move
+	// - Manifold: inside the surface, can collapse anywhere
+	// - Border:   on an open edge, only along that edge
+	// - Locked:   anything else (border corners, non-manifold)
+	//
+	// UV/normal seams are handled when a collapse is applied:
+	// each vertex at the position must find a partner at the
+	// target, which only happens when moving along the seam
+	// --------------------------------------------------------
+	enum VertexKind : unsigned char
+	{
+		Manifold,
+		Border,
+		Locked
+	};
+
+	// CanCollapse[from][to]
+	const bool CanCollapse[3][3] =
+	{
+		{ true,  true,  true  },
+		{ false, true,  true  },
+		{ false, false, false },
+	};
+
+	struct Vec3
+	{
+		float x, y, z;
+	};
+
+	inline Vec3 Sub(const Vec3& a, const Vec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	inline float Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline Vec3 Cross(const Vec3& a, const Vec3& b)
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+	inline float Length(const Vec3& v) { return sqrtf(Dot(v, v)); }
+
+	// --------------------------------------------------------
+	// Symmetric 4x4 matrix measuring the summed, weighted
+	// squared distance from a point to a set of planes
+	// --------------------------------------------------------
+	struct Quadric
+	{
+		float A00, A11, A22;
+		float A10, A20, A21;
+		float B0, B1, B2;
+		float C;
+		float Weight;
+	};
+
+	void AddPlane(Quadric& q, const Vec3& normal, float d, float weight)
+	{
+		float wx = normal.x * weight;
+		float wy = normal.y * weight;
+		float wz = normal.z * weight;
+
+		q.A00 += normal.x * wx;
+		q.A11 += normal.y * wy;
+		q.A22 += normal.z * wz;
+		q.A10 += normal.y * wx;
+		q.A20 += normal.z * wx;
+		q.A21 += normal.z * wy;
+		q.B0 += d * wx;
+		q.B1 += d * wy;
+		q.B2 += d * wz;
+		q.C += d * d * weight;
+		q.Weight += weight;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& other)
+	{
+		q.A00 += other.A00;
+		q.A11 += other.A11;
+		q.A22 += other.A22;
+		q.A10 += other.A10;
+		q.A20 += other.A20;
+		q.A21 += other.A21;
+		q.B0 += other.B0;
+		q.B1 += other.B1;
+		q.B2 += other.B2;
+		q.C += other.C;
+		q.Weight += other.Weight;
+	}
+
+	// Weighted sum of squared plane distances from p
+	float Evaluate(const Quadric& q, const Vec3& p)
+	{
+		float rx = q.A00 * p.x + q.A10 * p.y + q.A20 * p.z;
+		float ry = q.A10 * p.x + q.A11 * p.y + q.A21 * p.z;
+		float rz = q.A20 * p.x + q.A21 * p.y + q.A22 * p.z;
+
+		float r = rx * p.x + ry * p.y + rz * p.z;
+		r += 2 * (q.B0 * p.x + q.B1 * p.y + q.B2 * p.z);
+		r += q.C;
+		return fabsf(r);
+	}
+
+	struct Collapse
+	{
+		unsigned int From;	// Position groups (see BuildPositionGroups)
+		unsigned int To;
+		float Error;		// Mean squared distance
+	};
+
+	// --------------------------------------------------------
+	// Outgoing half-edges of every vertex (index space)
+	// --------------------------------------------------------
+	struct EdgeAdjacency
+	{
+		std::vector<unsigned int> Offsets;
+		std::vector<unsigned int> Counts;
+		std::vector<unsigned int> Targets;
+
+		void Build(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount)
+		{
+			Counts.assign(vertexCount, 0);
+			for (unsigned int i = 0; i < indexCount; i++)
+				Counts[indices[i]]++;
+
+			Offsets.resize(vertexCount);
+			unsigned int offset = 0;
+			for (unsigned int v = 0; v < vertexCount; v++)
+			{
+				Offsets[v] = offset;
+				offset += Counts[v];
+			}
+
+			Targets.resize(indexCount);
+			std::fill(Counts.begin(), Counts.end(), 0);
+			for (unsigned int i = 0; i < indexCount; i += 3)
+			{
+				for (int e = 0; e < 3; e++)
+				{
+					unsigned int from = indices[i + e];
+					unsigned int to = indices[i + (e + 1) % 3];
+					Targets[Offsets[from] + Counts[from]++] = to;
+				}
+			}
+		}
+
+		bool HasEdge(unsigned int from, unsigned int to) const
+		{
+			const unsigned int* targets = &Targets[0] + Offsets[from];
+			for (unsigned int i = 0; i < Counts[from]; i++)
+			{
+				if (targets[i] == to)
+					return true;
+			}
+			return false;
+		}
+	};
+
+	// --------------------------------------------------------
+	// Groups vertices that share an exact position
+	// - remap[v] is the first vertex of v's group
+	// - wedge[v] is the next vertex of the group (a cycle)
+	// --------------------------------------------------------
+	void BuildPositionGroups(const Vertex* vertices, unsigned int vertexCount, std::vector<unsigned int>& remap, std::vector<unsigned int>& wedge)
+	{
+		std::vector<unsigned int> order(vertexCount);
+		for (unsigned int v = 0; v < vertexCount; v++)
+			order[v] = v;
+
+		auto less = [&](unsigned int a, unsigned int b)
+		{
+			int c = memcmp(&vertices[a].Position, &vertices[b].Position, sizeof(XMFLOAT3));
+			return c != 0 ? c < 0 : a < b;
+		};
+		std::sort(order.begin(), order.end(), less);
+
+		remap.resize(vertexCount);
+		wedge.resize(vertexCount);
+		for (unsigned int i = 0; i < vertexCount;)
+		{
+			unsigned int end = i + 1;
+			while (end < vertexCount && memcmp(&vertices[order[i]].Position, &vertices[order[end]].Position, sizeof(XMFLOAT3)) == 0)
+				end++;
+
+			for (unsigned int j = i; j < end; j++)
+			{
+				remap[order[j]] = order[i];
+				wedge[order[j]] = order[j + 1 < end ? j + 1 : i];
+			}
+			i = end;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Simplifies a triangle list with greedy edge collapses
+//
+// - Each pass scores every allowed collapse by the quadric
+//    error of moving one vertex onto the other, sorts them and
+//    applies the cheapest until enough triangles are gone
+// - Vertices touched by a collapse wait for the next pass, so
+//    every collapse in a pass sees up to date neighbors
+// --------------------------------------------------------
+unsigned int MeshSimplifier::Simplify(
+	unsigned int* destination,
+	const unsigned int* indices,
+	unsigned int indexCount,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	unsigned int targetIndexCount,
+	float targetError,
+	float* resultError)
+{
+	std::vector<unsigned int> result(indices, indices + indexCount);
+	if (resultError)
+		*resultError = 0;
+
+	if (indexCount == 0 || vertexCount == 0)
+		return 0;
+
+	// Work in a unit sized space so errors are relative to the mesh
+	Vec3 boundsMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+	Vec3 boundsMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		const XMFLOAT3& p = vertices[v].Position;
+		boundsMin = { std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z) };
+		boundsMax = { std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z) };
+	}
+	float extent = std::max({ boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z });
+	float scale = extent > 0 ? 1.0f / extent : 1.0f;
+
+	std::vector<Vec3> positions(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		const XMFLOAT3& p = vertices[v].Position;
+		positions[v] = { (p.x - boundsMin.x) * scale, (p.y - boundsMin.y) * scale, (p.z - boundsMin.z) * scale };
+	}
+
+	std::vector<unsigned int> remap;
+	std::vector<unsigned int> wedge;
+	BuildPositionGroups(vertices, vertexCount, remap, wedge);
+
+	// Open edges between positions are the mesh's real borders
+	// - openOut/openIn hold the single open neighbor of a position,
+	//    NoVertex when there is none, or the position itself when
+	//    there are several
+	std::vector<unsigned int> positionIndices(indexCount);
+	for (unsigned int i = 0; i < indexCount; i++)
+		positionIndices[i] = remap[result[i]];
+
+	EdgeAdjacency positionEdges;
+	positionEdges.Build(&positionIndices[0], indexCount, vertexCount);
+
+	std::vector<unsigned int> openOut(vertexCount, NoVertex);
+	std::vector<unsigned int> openIn(vertexCount, NoVertex);
+	for (unsigned int r = 0; r < vertexCount; r++)
+	{
+		const unsigned int* targets = &positionEdges.Targets[0] + positionEdges.Offsets[r];
+		for (unsigned int i = 0; i < positionEdges.Counts[r]; i++)
+		{
+			unsigned int t = targets[i];
+			if (positionEdges.HasEdge(t, r))
+				continue;
+
+			openOut[r] = openOut[r] == NoVertex ? t : r;
+			openIn[t] = openIn[t] == NoVertex ? r : t;
+		}
+	}
+
+	std::vector<VertexKind> kinds(vertexCount, Locked);
+	for (unsigned int r = 0; r < vertexCount; r++)
+	{
+		if (remap[r] != r)
+			continue;
+
+		if (openIn[r] == NoVertex && openOut[r] == NoVertex)
+			kinds[r] = Manifold;
+		else if (openIn[r] != NoVertex && openIn[r] != r && openOut[r] != NoVertex && openOut[r] != r)
+			kinds[r] = Border;
+	}
+
+	// Plane quadrics of every triangle (weighted by area), plus
+	// perpendicular planes along borders and UV/normal seams
+	// (edges without a matching edge back in index space)
+	EdgeAdjacency edges;
+	edges.Build(&result[0], indexCount, vertexCount);
+
+	std::vector<Quadric> quadrics(vertexCount, Quadric{});
+	for (unsigned int i = 0; i < indexCount; i += 3)
+	{
+		unsigned int corners[3] = { result[i], result[i + 1], result[i + 2] };
+		const Vec3& p0 = positions[corners[0]];
+		Vec3 normal = Cross(Sub(positions[corners[1]], p0), Sub(positions[corners[2]], p0));
+		float length = Length(normal);
+		if (length <= 0)
+			continue;
+
+		Vec3 unit = { normal.x / length, normal.y / length, normal.z / length };
+		float area = length * 0.5f;
+		for (unsigned int c : corners)
+			AddPlane(quadrics[remap[c]], unit, -Dot(unit, p0), area);
+
+		for (int e = 0; e < 3; e++)
+		{
+			unsigned int from = corners[e];
+			unsigned int to = corners[(e + 1) % 3];
+			if (edges.HasEdge(to, from))
+				continue;
+
+			Vec3 edge = Sub(positions[to], positions[from]);
+			float edgeLength = Length(edge);
+			Vec3 side = Cross(edge, unit);
+			float sideLength = Length(side);
+			if (sideLength <= 0)
+				continue;
+
+			Vec3 sideUnit = { side.x / sideLength, side.y / sideLength, side.z / sideLength };
+			float d = -Dot(sideUnit, positions[from]);
+			float weight = edgeLength * edgeLength * BorderWeight;
+			AddPlane(quadrics[remap[from]], sideUnit, d, weight);
+			AddPlane(quadrics[remap[to]], sideUnit, d, weight);
+		}
+	}
+
+	// Error of moving position r0 onto r1 (mean squared distance)
+	auto collapseError = [&](unsigned int r0, unsigned int r1)
+	{
+		const Quadric& q0 = quadrics[r0];
+		const Quadric& q1 = quadrics[r1];
+		float weight = q0.Weight + q1.Weight;
+		return weight > 0 ? (Evaluate(q0, positions[r1]) + Evaluate(q1, positions[r1])) / weight : 0.0f;
+	};
+
+	// Border positions may only slide along their border
+	auto canCollapse = [&](unsigned int r0, unsigned int r1)
+	{
+		if (!CanCollapse[kinds[r0]][kinds[r1]])
+			return false;
+		if (kinds[r0] == Border)
+			return openOut[r0] == r1 || openIn[r0] == r1;
+		return true;
+	};
+
+	float maxError = targetError * targetError;
+	float reachedError = 0;
+
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> collapseRemap(vertexCount);
+	std::vector<unsigned int> positionRemap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<unsigned int> triangleOffsets(vertexCount + 1);
+	std::vector<unsigned int> triangles;
+	std::vector<unsigned int> wedgeTargets;
+
+	unsigned int resultCount = indexCount;
+	while (resultCount > targetIndexCount)
+	{
+		// Current edges (to match up wedges) and the triangles around
+		// each position (for the flip checks)
+		if (resultCount != indexCount)
+			edges.Build(&result[0], resultCount, vertexCount);
+
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (unsigned int i = 0; i < resultCount; i++)
+			triangleOffsets[remap[result[i]] + 1]++;
+		for (unsigned int v = 0; v < vertexCount; v++)
+			triangleOffsets[v + 1] += triangleOffsets[v];
+		triangles.resize(resultCount);
+		{
+			std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (unsigned int i = 0; i < resultCount; i++)
+				triangles[fill[remap[result[i]]]++] = i / 3;
+		}
+
+		// Score every edge in the direction(s) it may collapse
+		collapses.clear();
+		for (unsigned int i = 0; i < resultCount; i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned int a = remap[result[i + e]];
+				unsigned int b = remap[result[i + (e + 1) % 3]];
+				if (a == b)
+					continue;
+
+				bool forward = canCollapse(a, b);
+				bool backward = canCollapse(b, a);
+				if (!forward && !backward)
+					continue;
+
+				float forwardError = forward ? collapseError(a, b) : FLT_MAX;
+				float backwardError = backward ? collapseError(b, a) : FLT_MAX;
+				if (forwardError <= backwardError)
+					collapses.push_back({ a, b, forwardError });
+				else
+					collapses.push_back({ b, a, backwardError });
+			}
+		}
+
+		if (collapses.empty())
+			break;
+
+		std::sort(collapses.begin(), collapses.end(),
+			[](const Collapse& a, const Collapse& b) { return a.Error < b.Error; });
+
+		// A manifold collapse removes two triangles, so aim for half
+		// as many collapses as triangles left to remove, and don't let
+		// this pass reach far past the errors that goal needs
+		size_t triangleGoal = (resultCount - targetIndexCount) / 3;
+		size_t collapseGoal = std::max<size_t>(1, triangleGoal / 2);
+		float errorLimit = maxError;
+		if (collapseGoal < collapses.size())
+			errorLimit = std::min(errorLimit, collapses[collapseGoal].Error * 1.5f);
+
+		for (unsigned int v = 0; v < vertexCount; v++)
+		{
+			collapseRemap[v] = v;
+			positionRemap[v] = v;
+		}
+		std::fill(touched.begin(), touched.end(), false);
+
+		size_t applied = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.Error > errorLimit || applied >= collapseGoal)
+				break;
+
+			unsigned int r0 = collapse.From;
+			unsigned int r1 = collapse.To;
+			if (touched[r0] || touched[r1])
+				continue;
+
+			// Every vertex at r0 (one per UV/normal seam side) hands
+			// its triangles to a vertex at r1 it shares an edge with
+			// - If one has no such neighbor, the collapse would drag a
+			//    seam sideways and smear its texture, so skip it
+			wedgeTargets.clear();
+			bool matched = true;
+			for (unsigned int w = r0; matched;)
+			{
+				unsigned int target = NoVertex;
+				if (edges.Counts[w] > 0)
+				{
+					for (unsigned int t = r1;;)
+					{
+						if (edges.HasEdge(w, t) || edges.HasEdge(t, w))
+						{
+							target = t;
+							break;
+						}
+						t = wedge[t];
+						if (t == r1)
+							break;
+					}
+					matched = target != NoVertex;
+				}
+				wedgeTargets.push_back(target);
+
+				w = wedge[w];
+				if (w == r0)
+					break;
+			}
+			if (!matched)
+				continue;
+
+			// Skip collapses that would turn a triangle around
+			bool flips = false;
+			const Vec3& target = positions[r1];
+			for (unsigned int t = triangleOffsets[r0]; t < triangleOffsets[r0 + 1] && !flips; t++)
+			{
+				const unsigned int* tri = &result[triangles[t] * 3];
+				Vec3 before[3];
+				Vec3 after[3];
+				bool removed = false;
+				for (int c = 0; c < 3; c++)
+				{
+					unsigned int r = remap[tri[c]];
+					removed |= r == r1;
+					before[c] = positions[tri[c]];
+					after[c] = r == r0 ? target : before[c];
+				}
+				if (removed)
+					continue;
+
+				Vec3 normalBefore = Cross(Sub(before[1], before[0]), Sub(before[2], before[0]));
+				Vec3 normalAfter = Cross(Sub(after[1], after[0]), Sub(after[2], after[0]));
+				flips = Dot(normalBefore, normalAfter) <= 0;
+			}
+			if (flips)
+				continue;
+
+			unsigned int w = r0;
+			for (unsigned int target : wedgeTargets)
+			{
+				if (target != NoVertex)
+					collapseRemap[w] = target;
+				w = wedge[w];
+			}
+			positionRemap[r0] = r1;
+
+			AddQuadric(quadrics[r1], quadrics[r0]);
+			touched[r0] = true;
+			touched[r1] = true;
+			reachedError = std::max(reachedError, collapse.Error);
+			applied++;
+		}
+
+		if (applied == 0)
+			break;
+
+		// Apply the collapses and drop triangles that lost an edge
+		unsigned int writeCount = 0;
+		for (unsigned int i = 0; i < resultCount; i += 3)
+		{
+			unsigned int a = collapseRemap[result[i]];
+			unsigned int b = collapseRemap[result[i + 1]];
+			unsigned int c = collapseRemap[result[i + 2]];
+			if (remap[a] == remap[b] || remap[b] == remap[c] || remap[c] == remap[a])
+				continue;
+
+			result[writeCount++] = a;
+			result[writeCount++] = b;
+			result[writeCount++] = c;
+		}
+		resultCount = writeCount;
+
+		// Border edges that led to a collapsed position now lead to its target
+		for (unsigned int r = 0; r < vertexCount; r++)
+		{
+			if (openOut[r] != NoVertex && openOut[r] != r)
+				openOut[r] = positionRemap[openOut[r]];
+			if (openIn[r] != NoVertex && openIn[r] != r)
+				openIn[r] = positionRemap[openIn[r]];
+		}
+	}
+
+	std::copy(result.begin(), result.begin() + resultCount, destination);
+	if (resultError)
+		*resultError = sqrtf(reachedError);
+	return resultCount;
+}
+
+// --------------------------------------------------------
+// Builds an LOD chain by halving the triangle count of the
+// previous LOD until that stops paying off
+//
+// - Each LOD is vertex cache optimized on its own
+// - Errors add up along the chain, so each LOD's error is a
+//    safe upper bound relative to the original mesh
+// --------------------------------------------------------
+std::vector<MeshLod> MeshSimplifier::GenerateLods(
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	std::vector<unsigned int>& indices)
+{
+	std::vector<MeshLod> lods;
+	lods.push_back({ 0, (unsigned int)indices.size(), 0.0f });
+
+	float extent = 0;
+	if (vertexCount > 0)
+	{
+		XMFLOAT3 boundsMin = vertices[0].Position;
+		XMFLOAT3 boundsMax = vertices[0].Position;
+		for (unsigned int v = 1; v < vertexCount; v++)
+		{
+			const XMFLOAT3& p = vertices[v].Position;
+			boundsMin = XMFLOAT3(std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z));
+			boundsMax = XMFLOAT3(std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z));
+		}
+		extent = std::max({ boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z });
+	}
+
+	std::vector<unsigned int> previous(indices);
+	std::vector<unsigned int> simplified(indices.size());
+	float totalError = 0;
+
+	while (lods.size() < MaxLods)
+	{
+		unsigned int previousCount = (unsigned int)previous.size();
+		unsigned int target = (previousCount / 6) * 3;
+		if (target / 3 < MinLodTriangles)
+			break;
+
+		float error = 0;
+		unsigned int count = Simplify(&simplified[0], &previous[0], previousCount, vertices, vertexCount, target, MaxLodError, &error);
+		if (count == 0 || count > previousCount * (1.0f - MinLodReduction))
+			break;
+
+		MeshOptimizer::OptimizeVertexCache(&simplified[0], count, vertexCount);
+
+		totalError += error;
+		lods.push_back({ (unsigned int)indices.size(), count, totalError * extent });
+		indices.insert(indices.end(), simplified.begin(), simplified.begin() + count);
+		previous.assign(simplified.begin(), simplified.begin() + count);
+	}
+
+	return lods;
+}
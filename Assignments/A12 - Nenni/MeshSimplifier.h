@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// One level of detail: a range of the mesh's index buffer
+//
+// - Every LOD indexes the same vertex buffer
+// - Error is how far (in the mesh's local units) the LOD's
+//    surface may be from the full resolution one
+// --------------------------------------------------------
+struct MeshLod
+{
+	unsigned int IndexStart;
+	unsigned int IndexCount;
+	float Error;
+};
+
+// --------------------------------------------------------
+// Quadric error metric mesh simplification (Garland-Heckbert)
+//
+// - Collapses edges onto one of their existing vertices, so
+//    LODs only need new indices, never new vertices
+// - UV/normal seams and open borders may only collapse along
+//    themselves, and border corners are locked, so LODs keep
+//    their texture mapping and outline
+// - Collapses that would flip a triangle are skipped
+// --------------------------------------------------------
+namespace MeshSimplifier
+{
+	// Most LODs generated per mesh (including the original)
+	const unsigned int MaxLods = 5;
+
+	// Simplifies indices until targetIndexCount is reached or
+	// the next collapse would move the surface by more than
+	// targetError (a fraction of the mesh's largest extent)
+	// - destination may be the same array as indices
+	// - Returns the new index count; resultError receives the
+	//    error actually reached, in the same units
+	unsigned int Simplify(
+		unsigned int* destination,
+		const unsigned int* indices,
+		unsigned int indexCount,
+		const Vertex* vertices,
+		unsigned int vertexCount,
+		unsigned int targetIndexCount,
+		float targetError,
+		float* resultError = nullptr);
+
+	// Appends successively halved LODs of the first indexCount
+	// indices to the end of indices and returns all LODs,
+	// starting with the original as LOD 0
+	std::vector<MeshLod> GenerateLods(
+		const Vertex* vertices,
+		unsigned int vertexCount,
+		std::vector<unsigned int>& indices);
+}
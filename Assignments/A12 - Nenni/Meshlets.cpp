@@ -0,0 +1,404 @@
+#include "Meshlets.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	const unsigned int NoMeshlet = ~0u;
+
+	// Meshlets whose normals spread wider than this (the smallest
+	// dot product with the cone axis) get no cone, since it could
+	// only cull from a sliver of directions
+	const float MinConeDot = 0.1f;
+
+	// Cutoff of a meshlet without a usable cone (never culled)
+	const float NoCone = 2.0f;
+
+	// How much a neighbor facing away from the meshlet's average
+	// normal counts against it, in new vertices (at 90 degrees)
+	const float ConeWeight = 1.0f;
+
+	// Packed positions are a little off the float ones (see
+	// VertexPacking), so spheres are grown by this fraction
+	const float RadiusMargin = 1e-3f;
+
+	inline XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline float Length(const XMFLOAT3& v) { return sqrtf(Dot(v, v)); }
+	inline XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	// --------------------------------------------------------
+	// Bounding sphere and normal cone of one meshlet
+	//
+	// - Sphere: centered on the bounding box, reaching the
+	//    farthest corner
+	// - Cone: the axis is the average triangle normal; the apex
+	//    is moved back along it until every triangle's plane is
+	//    in front of it (as in meshoptimizer's cluster bounds)
+	// --------------------------------------------------------
+	Meshlet ComputeBounds(const Vertex* vertices, const unsigned int* indices, unsigned int indexStart, unsigned int indexCount)
+	{
+		Meshlet meshlet = {};
+		meshlet.IndexStart = indexStart;
+		meshlet.IndexCount = indexCount;
+
+		const unsigned int* tris = indices + indexStart;
+
+		XMFLOAT3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (unsigned int i = 0; i < indexCount; i++)
+		{
+			const XMFLOAT3& p = vertices[tris[i]].Position;
+			boundsMin = XMFLOAT3(std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z));
+			boundsMax = XMFLOAT3(std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z));
+		}
+
+		XMFLOAT3 center(
+			(boundsMin.x + boundsMax.x) * 0.5f,
+			(boundsMin.y + boundsMax.y) * 0.5f,
+			(boundsMin.z + boundsMax.z) * 0.5f);
+
+		float radius = 0;
+		for (unsigned int i = 0; i < indexCount; i++)
+			radius = std::max(radius, Length(Sub(vertices[tris[i]].Position, center)));
+
+		meshlet.Center = center;
+		meshlet.Radius = radius * (1.0f + RadiusMargin);
+
+		// Unit normals of every (non-degenerate) triangle
+		XMFLOAT3 axis(0, 0, 0);
+		unsigned int faceCount = 0;
+		XMFLOAT3 normals[Meshlets::MaxTriangles];
+		const XMFLOAT3* corners[Meshlets::MaxTriangles];
+		for (unsigned int i = 0; i < indexCount; i += 3)
+		{
+			const XMFLOAT3& p0 = vertices[tris[i]].Position;
+			XMFLOAT3 normal = Cross(Sub(vertices[tris[i + 1]].Position, p0), Sub(vertices[tris[i + 2]].Position, p0));
+			float length = Length(normal);
+			if (!(length > 0))
+				continue;
+
+			normal = XMFLOAT3(normal.x / length, normal.y / length, normal.z / length);
+			normals[faceCount] = normal;
+			corners[faceCount] = &p0;
+			faceCount++;
+
+			axis = XMFLOAT3(axis.x + normal.x, axis.y + normal.y, axis.z + normal.z);
+		}
+
+		meshlet.ConeCutoff = NoCone;
+		meshlet.ConeAxis = XMFLOAT3(0, 0, 1);
+		meshlet.ConeApex = center;
+
+		float axisLength = Length(axis);
+		if (faceCount == 0 || !(axisLength > 0))
+			return meshlet;
+		axis = XMFLOAT3(axis.x / axisLength, axis.y / axisLength, axis.z / axisLength);
+
+		float minDot = 1;
+		for (unsigned int f = 0; f < faceCount; f++)
+			minDot = std::min(minDot, Dot(normals[f], axis));
+		if (minDot <= MinConeDot)
+			return meshlet;
+
+		// Distance back along the axis at which every triangle's
+		// plane passes in front of the apex
+		float maxT = 0;
+		for (unsigned int f = 0; f < faceCount; f++)
+		{
+			float t = Dot(Sub(center, *corners[f]), normals[f]) / Dot(axis, normals[f]);
+			maxT = std::max(maxT, t);
+		}
+
+		meshlet.ConeAxis = axis;
+		meshlet.ConeApex = XMFLOAT3(center.x - axis.x * maxT, center.y - axis.y * maxT, center.z - axis.z * maxT);
+		meshlet.ConeCutoff = sqrtf(1.0f - minDot * minDot);
+		return meshlet;
+	}
+}
+
+// --------------------------------------------------------
+// Splits a range of triangles into meshlets of at most
+// MaxVertices unique vertices and MaxTriangles triangles
+//
+// - Each meshlet grows from the first unused triangle in
+//    index order, adding the neighboring triangle that brings
+//    the fewest new vertices and best matches the meshlet's
+//    average normal, so meshlets are compact with tight cones
+// - The range is rewritten meshlet by meshlet, and each
+//    meshlet's triangles are then vertex cache optimized
+// --------------------------------------------------------
+void Meshlets::Build(
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	unsigned int* indices,
+	unsigned int indexStart,
+	unsigned int indexCount,
+	std::vector<Meshlet>& meshlets)
+{
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	const unsigned int* tris = indices + indexStart;
+
+	// Triangles around each vertex
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+		offsets[tris[i] + 1]++;
+	for (unsigned int v = 0; v < vertexCount; v++)
+		offsets[v + 1] += offsets[v];
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	{
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (unsigned int i = 0; i < triangleCount * 3; i++)
+			adjacency[fill[tris[i]]++] = i / 3;
+	}
+
+	// Unit normals of every triangle (zero when degenerate)
+	std::vector<XMFLOAT3> normals(triangleCount);
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		const XMFLOAT3& p0 = vertices[tris[t * 3]].Position;
+		XMFLOAT3 normal = Cross(Sub(vertices[tris[t * 3 + 1]].Position, p0), Sub(vertices[tris[t * 3 + 2]].Position, p0));
+		float length = Length(normal);
+		normals[t] = length > 0 ? XMFLOAT3(normal.x / length, normal.y / length, normal.z / length) : XMFLOAT3(0, 0, 0);
+	}
+
+	std::vector<unsigned int> order;
+	order.reserve(triangleCount);
+	std::vector<bool> used(triangleCount, false);
+	std::vector<unsigned int> lastMeshlet(vertexCount, NoMeshlet);
+	std::vector<unsigned int> candidates;
+
+	unsigned int current = 0;
+	unsigned int meshletStart = 0;
+	unsigned int meshletVertices = 0;
+	XMFLOAT3 normalSum(0, 0, 0);
+	unsigned int nextSeed = 0;
+
+	auto newVertices = [&](unsigned int t)
+	{
+		const unsigned int* tri = tris + t * 3;
+		unsigned int count = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			bool repeated = (c > 0 && tri[c] == tri[0]) || (c > 1 && tri[c] == tri[1]);
+			count += lastMeshlet[tri[c]] != current && !repeated;
+		}
+		return count;
+	};
+
+	// Bounds are filled in once the triangles are in their new order
+	size_t firstMeshlet = meshlets.size();
+	auto finishMeshlet = [&]()
+	{
+		Meshlet meshlet = {};
+		meshlet.IndexStart = indexStart + meshletStart * 3;
+		meshlet.IndexCount = ((unsigned int)order.size() - meshletStart) * 3;
+		meshlets.push_back(meshlet);
+		current++;
+		meshletStart = (unsigned int)order.size();
+		meshletVertices = 0;
+		normalSum = XMFLOAT3(0, 0, 0);
+		candidates.clear();
+	};
+
+	while (order.size() < triangleCount)
+	{
+		// Best neighbor of the meshlet so far
+		unsigned int best = NoMeshlet;
+		float bestScore = FLT_MAX;
+		float sumLength = Length(normalSum);
+		for (size_t i = 0; i < candidates.size();)
+		{
+			unsigned int t = candidates[i];
+			if (used[t])
+			{
+				candidates[i] = candidates.back();
+				candidates.pop_back();
+				continue;
+			}
+
+			float alignment = sumLength > 0 ? Dot(normals[t], normalSum) / sumLength : 1.0f;
+			float score = newVertices(t) + (1.0f - alignment) * ConeWeight;
+			if (score < bestScore)
+			{
+				bestScore = score;
+				best = t;
+			}
+			i++;
+		}
+
+		// Nothing connected left, so continue from the next
+		// triangle in index order
+		if (best == NoMeshlet)
+		{
+			while (used[nextSeed])
+				nextSeed++;
+			best = nextSeed;
+		}
+
+		unsigned int added = newVertices(best);
+		if (meshletVertices + added > MaxVertices || order.size() - meshletStart >= MaxTriangles)
+		{
+			finishMeshlet();
+			continue;
+		}
+
+		used[best] = true;
+		order.push_back(best);
+		meshletVertices += added;
+		normalSum = XMFLOAT3(normalSum.x + normals[best].x, normalSum.y + normals[best].y, normalSum.z + normals[best].z);
+
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = tris[best * 3 + c];
+			if (lastMeshlet[v] == current)
+				continue;
+
+			lastMeshlet[v] = current;
+			for (unsigned int a = offsets[v]; a < offsets[v + 1]; a++)
+				if (!used[adjacency[a]])
+					candidates.push_back(adjacency[a]);
+		}
+	}
+
+	finishMeshlet();
+
+	std::vector<unsigned int> reordered(triangleCount * 3);
+	for (unsigned int i = 0; i < triangleCount; i++)
+		for (int c = 0; c < 3; c++)
+			reordered[i * 3 + c] = tris[order[i] * 3 + c];
+	std::copy(reordered.begin(), reordered.end(), indices + indexStart);
+
+	// Growing by fewest new vertices isn't the best vertex cache
+	// order, so each meshlet's triangles are cache optimized again
+	// - On meshlet-local vertex numbers, so each pass only needs
+	//    tables for up to MaxVertices vertices
+	std::vector<unsigned int> local;
+	std::vector<unsigned int> localToGlobal;
+	std::fill(lastMeshlet.begin(), lastMeshlet.end(), NoMeshlet);
+	for (size_t m = firstMeshlet; m < meshlets.size(); m++)
+	{
+		unsigned int* range = indices + meshlets[m].IndexStart;
+		unsigned int count = meshlets[m].IndexCount;
+
+		local.resize(count);
+		localToGlobal.clear();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned int v = range[i];
+			if (lastMeshlet[v] == NoMeshlet)
+			{
+				lastMeshlet[v] = (unsigned int)localToGlobal.size();
+				localToGlobal.push_back(v);
+			}
+			local[i] = lastMeshlet[v];
+		}
+
+		MeshOptimizer::OptimizeVertexCache(&local[0], count, (unsigned int)localToGlobal.size());
+
+		for (unsigned int i = 0; i < count; i++)
+			range[i] = localToGlobal[local[i]];
+		for (unsigned int v : localToGlobal)
+			lastMeshlet[v] = NoMeshlet;
+
+		meshlets[m] = ComputeBounds(vertices, indices, meshlets[m].IndexStart, count);
+	}
+}
+
+// --------------------------------------------------------
+// Gribb/Hartmann plane extraction
+// - Row vector matrices, so each plane combines columns
+// - Direct3D clip space has 0 <= z <= w
+// --------------------------------------------------------
+MeshletFrustum Meshlets::MakeFrustum(const XMFLOAT4X4& localToClip, const XMFLOAT3& localCamera, bool coneCulling)
+{
+	const XMFLOAT4X4& m = localToClip;
+	XMFLOAT4 column[4];
+	for (int c = 0; c < 4; c++)
+		column[c] = XMFLOAT4(m.m[0][c], m.m[1][c], m.m[2][c], m.m[3][c]);
+
+	auto combine = [&](int c, float sign)
+	{
+		return XMFLOAT4(
+			column[3].x + sign * column[c].x,
+			column[3].y + sign * column[c].y,
+			column[3].z + sign * column[c].z,
+			column[3].w + sign * column[c].w);
+	};
+
+	MeshletFrustum frustum;
+	frustum.Planes[0] = combine(0, 1);		// Left
+	frustum.Planes[1] = combine(0, -1);		// Right
+	frustum.Planes[2] = combine(1, 1);		// Bottom
+	frustum.Planes[3] = combine(1, -1);		// Top
+	frustum.Planes[4] = column[2];			// Near
+	frustum.Planes[5] = combine(2, -1);		// Far
+
+	for (XMFLOAT4& plane : frustum.Planes)
+	{
+		float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		if (length > 0)
+			plane = XMFLOAT4(plane.x / length, plane.y / length, plane.z / length, plane.w / length);
+	}
+
+	frustum.CameraPosition = localCamera;
+	frustum.ConeCulling = coneCulling;
+	return frustum;
+}
+
+bool Meshlets::IsVisible(const Meshlet& meshlet, const MeshletFrustum& frustum)
+{
+	for (const XMFLOAT4& plane : frustum.Planes)
+	{
+		float distance = plane.x * meshlet.Center.x + plane.y * meshlet.Center.y + plane.z * meshlet.Center.z + plane.w;
+		if (distance < -meshlet.Radius)
+			return false;
+	}
+
+	if (frustum.ConeCulling && meshlet.ConeCutoff <= 1.0f)
+	{
+		XMFLOAT3 view = Sub(meshlet.ConeApex, frustum.CameraPosition);
+		float length = Length(view);
+		if (length > 0 && Dot(view, meshlet.ConeAxis) >= meshlet.ConeCutoff * length)
+			return false;
+	}
+
+	return true;
+}
+
+unsigned int Meshlets::Cull(
+	const Meshlet* meshlets,
+	unsigned int meshletCount,
+	const MeshletFrustum& frustum,
+	std::vector<IndexRange>& ranges)
+{
+	ranges.clear();
+	unsigned int visibleIndices = 0;
+
+	for (unsigned int i = 0; i < meshletCount; i++)
+	{
+		const Meshlet& meshlet = meshlets[i];
+		if (!IsVisible(meshlet, frustum))
+			continue;
+
+		// Meshlets are contiguous, so a visible run is one draw
+		if (!ranges.empty() && ranges.back().Start + ranges.back().Count == meshlet.IndexStart)
+			ranges.back().Count += meshlet.IndexCount;
+		else
+			ranges.push_back({ meshlet.IndexStart, meshlet.IndexCount });
+
+		visibleIndices += meshlet.IndexCount;
+	}
+
+	return visibleIndices;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// A small cluster of a mesh's triangles: a contiguous range
+// of its index buffer, with bounds for culling it as a whole
+//
+// - Center/Radius: bounding sphere of the cluster
+// - ConeAxis/ConeCutoff/ConeApex: every triangle faces away
+//    from a camera inside the cone behind the apex, which is
+//    when dot(normalize(ConeApex - camera), ConeAxis) >= ConeCutoff
+// - ConeCutoff is above 1 when the normals spread too far for
+//    the cone to ever cull anything
+// --------------------------------------------------------
+struct Meshlet
+{
+	XMFLOAT3 Center;
+	float Radius;
+	XMFLOAT3 ConeAxis;
+	float ConeCutoff;
+	XMFLOAT3 ConeApex;
+	unsigned int IndexStart;
+	unsigned int IndexCount;
+};
+
+// A range of an index buffer to draw
+struct IndexRange
+{
+	unsigned int Start;
+	unsigned int Count;
+};
+
+// --------------------------------------------------------
+// Everything a meshlet is culled against, in the mesh's
+// local space (so meshlet bounds never need transforming)
+// --------------------------------------------------------
+struct MeshletFrustum
+{
+	XMFLOAT4 Planes[6];		// Normalized, pointing inwards
+	XMFLOAT3 CameraPosition;
+	bool ConeCulling;
+};
+
+// --------------------------------------------------------
+// Splitting meshes into meshlets and culling them on the CPU
+//
+// - Meshlets grow across neighboring triangles that face the
+//    same way, so they are compact and have tight normal cones
+// - Culling rejects meshlets outside the frustum or facing
+//    away as a whole; neighboring survivors are merged into
+//    as few index ranges (draw calls) as possible
+// --------------------------------------------------------
+namespace Meshlets
+{
+	// A new meshlet starts when either limit would be exceeded
+	const unsigned int MaxVertices = 64;
+	const unsigned int MaxTriangles = 124;
+
+	// Appends meshlets covering indices [indexStart, indexStart + indexCount)
+	// - Reorders the triangles of that range so every meshlet is
+	//    a contiguous range of it
+	void Build(
+		const Vertex* vertices,
+		unsigned int vertexCount,
+		unsigned int* indices,
+		unsigned int indexStart,
+		unsigned int indexCount,
+		std::vector<Meshlet>& meshlets);
+
+	// Frustum planes of a local-to-clip (world * view * projection)
+	// matrix, plus the camera's position in the same local space
+	MeshletFrustum MakeFrustum(const XMFLOAT4X4& localToClip, const XMFLOAT3& localCamera, bool coneCulling);
+
+	bool IsVisible(const Meshlet& meshlet, const MeshletFrustum& frustum);
+
+	// Fills ranges with the visible meshlets and returns how many
+	// indices they cover
+	unsigned int Cull(
+		const Meshlet* meshlets,
+		unsigned int meshletCount,
+		const MeshletFrustum& frustum,
+		std::vector<IndexRange>& ranges);
+}
@@ -0,0 +1,164 @@
+#include "MtlParser.h"
+#include "Vfs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+namespace
+{
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	// Splits a line into whitespace separated words
+	void SplitWords(const char* p, const char* end, std::vector<std::string>& words)
+	{
+		words.clear();
+		while (p < end)
+		{
+			while (p < end && IsSpace(*p))
+				p++;
+
+			const char* start = p;
+			while (p < end && !IsSpace(*p))
+				p++;
+
+			if (p > start)
+				words.emplace_back(start, p);
+		}
+	}
+
+	float ToFloat(const std::vector<std::string>& words, size_t index, float fallback)
+	{
+		return index < words.size() ? strtof(words[index].c_str(), nullptr) : fallback;
+	}
+
+	// Map lines may put options before the file name, so use the last word
+	// - Empty (so no map) when the name can't be converted, like
+	//    bytes that aren't valid UTF-8
+	std::wstring MapPath(const std::vector<std::string>& words)
+	{
+		try
+		{
+			return std::filesystem::path(words.back()).wstring();
+		}
+		catch (const std::exception&)
+		{
+			return std::wstring();
+		}
+	}
+
+	// --------------------------------------------------------
+	// Phong exponent to GGX roughness (the alpha the lighting
+	// shader squares), by matching the lobes' widths:
+	// alpha = sqrt(2 / (Ns + 2))
+	// --------------------------------------------------------
+	float RoughnessFromExponent(float exponent)
+	{
+		return sqrtf(2.0f / (std::max(exponent, 0.0f) + 2.0f));
+	}
+}
+
+// --------------------------------------------------------
+// Reads a .MTL file and makes its texture paths full paths
+// - Returns false if the file can't be read
+// --------------------------------------------------------
+bool MtlParser::Load(const std::wstring& path, std::vector<MtlMaterial>& out)
+{
+	out.clear();
+
+	MappedFile file;
+	ByteSpan data;
+	if (!Vfs::Read(path, file, data))
+		return false;
+
+	Parse(data.Data, data.Size, out);
+
+	std::filesystem::path folder = std::filesystem::path(path).parent_path();
+	for (MtlMaterial& material : out)
+	{
+		for (std::wstring* map : { &material.DiffuseMap, &material.NormalMap, &material.RoughnessMap, &material.MetalnessMap })
+		{
+			if (!map->empty())
+				*map = (folder / *map).wstring();
+		}
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Parses .MTL text that is already in memory, appending
+// one material per "newmtl" line
+// --------------------------------------------------------
+void MtlParser::Parse(const char* data, size_t size, std::vector<MtlMaterial>& out)
+{
+	const char* end = data + size;
+	std::vector<std::string> words;
+	MtlMaterial* material = nullptr;
+	bool hasRoughness = false;
+
+	for (const char* line = data; line < end;)
+	{
+		const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+		if (!lineEnd)
+			lineEnd = end;
+
+		SplitWords(line, lineEnd, words);
+		line = lineEnd + 1;
+
+		if (words.empty() || words[0][0] == '#')
+			continue;
+
+		const std::string& keyword = words[0];
+		if (keyword == "newmtl")
+		{
+			out.emplace_back();
+			material = &out.back();
+			material->Name = words.size() > 1 ? words[1] : "";
+			hasRoughness = false;
+			continue;
+		}
+
+		// Everything else belongs to the current material
+		if (!material || words.size() < 2)
+			continue;
+
+		if (keyword == "Kd")
+			material->Diffuse = XMFLOAT3(ToFloat(words, 1, 1), ToFloat(words, 2, 1), ToFloat(words, 3, 1));
+		else if (keyword == "d")
+			material->Opacity = ToFloat(words, 1, 1);
+		else if (keyword == "Tr")
+			material->Opacity = 1.0f - ToFloat(words, 1, 0);
+		else if (keyword == "Pr")
+		{
+			material->Roughness = ToFloat(words, 1, 0.5f);
+			hasRoughness = true;
+		}
+		else if (keyword == "Ns" && !hasRoughness)
+			material->Roughness = RoughnessFromExponent(ToFloat(words, 1, 0));
+		else if (keyword == "Pm")
+			material->Metalness = ToFloat(words, 1, 0);
+		else if (keyword == "map_Kd")
+			material->DiffuseMap = MapPath(words);
+		else if (keyword == "norm" || keyword == "map_Bump" || keyword == "map_bump" || keyword == "bump")
+			material->NormalMap = MapPath(words);
+		else if (keyword == "map_Pr")
+			material->RoughnessMap = MapPath(words);
+		else if (keyword == "map_Pm")
+			material->MetalnessMap = MapPath(words);
+	}
+}
+
+const MtlMaterial* MtlParser::Find(const std::vector<MtlMaterial>& materials, const std::string& name)
+{
+	for (const MtlMaterial& material : materials)
+	{
+		if (material.Name == name)
+			return &material;
+	}
+	return nullptr;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// One "newmtl" entry of a .MTL material library
+//
+// - Texture paths are relative to the .MTL's folder after
+//    Parse(), and full paths after Load()
+// - Roughness comes from "Pr" when present, otherwise it is
+//    converted from the Phong exponent "Ns"
+// --------------------------------------------------------
+struct MtlMaterial
+{
+	std::string Name;
+	XMFLOAT3 Diffuse = XMFLOAT3(1, 1, 1);	// Kd
+	float Opacity = 1.0f;					// d, or 1 - Tr
+	float Roughness = 0.5f;					// Pr, or from Ns
+	float Metalness = 0.0f;					// Pm
+
+	std::wstring DiffuseMap;	// map_Kd
+	std::wstring NormalMap;		// norm, map_Bump or bump
+	std::wstring RoughnessMap;	// map_Pr
+	std::wstring MetalnessMap;	// map_Pm
+};
+
+// --------------------------------------------------------
+// Reads the .MTL files that .OBJ "mtllib" lines refer to
+//
+// - Unknown statements are ignored, and texture options
+//    (like "-bm 1.0") are skipped: the last word of a map
+//    line is its file name
+// --------------------------------------------------------
+namespace MtlParser
+{
+	bool Load(const std::wstring& path, std::vector<MtlMaterial>& out);
+	void Parse(const char* data, size_t size, std::vector<MtlMaterial>& out);
+
+	// The material with the given name, or nullptr
+	const MtlMaterial* Find(const std::vector<MtlMaterial>& materials, const std::string& name);
+}
@@ -0,0 +1,1055 @@
+#include "ObjParser.h"
+#include "Vfs.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OBJ_PARSER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	// Marks a missing uv/normal reference in a face corner
+	const unsigned int NoIndex = UINT_MAX;
+
+	// Index triple (position, uv, normal) from an OBJ face, used to weld
+	// identical face corners into a single shared vertex
+	// - Part keeps submeshes from sharing vertices: chunk-local
+	//    while parsing (see ObjChunk), the submesh when merging
+	struct VertexKey
+	{
+		unsigned int Position;
+		unsigned int UV;
+		unsigned int Normal;
+		unsigned int Part;
+	};
+
+	inline bool SameAttributes(const VertexKey& a, const VertexKey& b)
+	{
+		return a.UV == b.UV && a.Normal == b.Normal && a.Part == b.Part;
+	}
+
+	inline size_t HashKey(const VertexKey& key)
+	{
+		// Mix each index with a large odd constant so nearby
+		// triples don't collide in the low bits
+		uint64_t h = key.Position * 0x9E3779B97F4A7C15ull;
+		h ^= (key.UV + 0x7F4A7C15ull) * 0xC2B2AE3D27D4EB4Full + (h >> 29);
+		h ^= (key.Normal + 0x165667B1ull) * 0x165667B19E3779F9ull + (h >> 32);
+		h ^= (key.Part + 0x27D4EB2Full) * 0x85EBCA77C2B2AE63ull + (h >> 27);
+		return (size_t)(h ^ (h >> 31));
+	}
+
+	// --------------------------------------------------------
+	// Hash map from VertexKey to vertex index
+	// - The position index is a perfect hash into a table of
+	//    bucket heads, and each bucket chains the (usually 1-4)
+	//    vertices that share that position
+	// - Faces reference nearby positions, so lookups stay in
+	//    cache instead of jumping around a scattered table
+	// - Vertex indices must be handed out in insertion order
+	// --------------------------------------------------------
+	class VertexWelder
+	{
+	public:
+		explicit VertexWelder(size_t positionCount)
+			: heads(positionCount, NoIndex)
+		{
+			entries.reserve(positionCount + positionCount / 2);
+		}
+
+		// Returns the existing index for this key, or the index
+		// of a newly added vertex (always the next one in order)
+		unsigned int FindOrInsert(const VertexKey& key)
+		{
+			if (key.Position >= heads.size())
+				heads.resize(key.Position + 1, NoIndex);
+
+			for (unsigned int v = heads[key.Position]; v != NoIndex; v = entries[v].Next)
+			{
+				if (SameAttributes(entries[v].Key, key))
+					return v;
+			}
+
+			unsigned int index = (unsigned int)entries.size();
+			entries.push_back({ key, heads[key.Position] });
+			heads[key.Position] = index;
+			return index;
+		}
+
+	private:
+		struct Entry
+		{
+			VertexKey Key;
+			unsigned int Next;
+		};
+
+		std::vector<unsigned int> heads;
+		std::vector<Entry> entries;
+	};
+
+	// --------------------------------------------------------
+	// Open-addressing hash table that welds corners within one
+	// chunk, before the chunk's global vertex ids are known
+	// - Only the chunk's unique keys reach the (serial) global
+	//    merge, so most of the per-corner work runs in parallel
+	// --------------------------------------------------------
+	class ChunkWelder
+	{
+	public:
+		explicit ChunkWelder(size_t expectedVertices)
+		{
+			size_t capacity = 64;
+			while (capacity < expectedVertices * 2)
+				capacity <<= 1;
+
+			slots.assign(capacity, NoIndex);
+			uniqueKeys.reserve(expectedVertices);
+		}
+
+		// Returns the chunk-local index for this key (new keys
+		// are numbered in first-use order)
+		unsigned int FindOrInsert(const VertexKey& key)
+		{
+			if ((uniqueKeys.size() + 1) * 2 > slots.size())
+				Grow();
+
+			size_t mask = slots.size() - 1;
+			for (size_t i = HashKey(key) & mask;; i = (i + 1) & mask)
+			{
+				unsigned int slot = slots[i];
+				if (slot == NoIndex)
+				{
+					slots[i] = (unsigned int)uniqueKeys.size();
+					uniqueKeys.push_back(key);
+					return slots[i];
+				}
+
+				const VertexKey& existing = uniqueKeys[slot];
+				if (existing.Position == key.Position && SameAttributes(existing, key))
+					return slot;
+			}
+		}
+
+		std::vector<VertexKey>& GetUniqueKeys()
+		{
+			return uniqueKeys;
+		}
+
+	private:
+		std::vector<unsigned int> slots;
+		std::vector<VertexKey> uniqueKeys;
+
+		void Grow()
+		{
+			slots.assign(slots.size() * 2, NoIndex);
+
+			size_t mask = slots.size() - 1;
+			for (unsigned int k = 0; k < uniqueKeys.size(); k++)
+			{
+				size_t i = HashKey(uniqueKeys[k]) & mask;
+				while (slots[i] != NoIndex)
+					i = (i + 1) & mask;
+				slots[i] = k;
+			}
+		}
+	};
+
+	inline unsigned int CountTrailingZeros(unsigned int mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return (unsigned int)index;
+#else
+		return (unsigned int)__builtin_ctz(mask);
+#endif
+	}
+
+	// --------------------------------------------------------
+	// Finds the next '\n' at or after p (or end)
+	// - Compares 16 bytes per step with SSE2
+	// --------------------------------------------------------
+	const char* FindLineEnd(const char* p, const char* end)
+	{
+#ifdef OBJ_PARSER_SSE2
+		const __m128i newline = _mm_set1_epi8('\n');
+		while (end - p >= 16)
+		{
+			__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+			unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+			if (mask)
+				return p + CountTrailingZeros(mask);
+			p += 16;
+		}
+#endif
+		const char* found = (const char*)memchr(p, '\n', end - p);
+		return found ? found : end;
+	}
+
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline bool IsDigit(char c)
+	{
+		return (unsigned char)(c - '0') < 10;
+	}
+
+	inline const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && IsSpace(*p))
+			p++;
+		return p;
+	}
+
+	// --------------------------------------------------------
+	// SWAR ("SIMD within a register") digit parsing
+	// - Checks and converts 8 ASCII digits with a handful of
+	//    64-bit multiplies instead of 8 dependent steps
+	// - Assumes a little-endian load (x86/x64/ARM)
+	// --------------------------------------------------------
+	inline bool IsEightDigits(uint64_t chunk)
+	{
+		return (((chunk & 0xF0F0F0F0F0F0F0F0ull) |
+			(((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) ==
+			0x3333333333333333ull);
+	}
+
+	inline uint32_t ParseEightDigits(uint64_t chunk)
+	{
+		const uint64_t mask = 0x000000FF000000FFull;
+		const uint64_t mul1 = 100 + (1000000ull << 32);
+		const uint64_t mul2 = 1 + (10000ull << 32);
+		chunk -= 0x3030303030303030ull;
+		chunk = (chunk * 10) + (chunk >> 8);
+		chunk = (((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32;
+		return (uint32_t)chunk;
+	}
+
+	// Accumulates a run of digits into mantissa (up to 19 significant digits)
+	// - Digits that don't fit are counted in dropped so the caller can scale
+	inline const char* AccumulateDigits(const char* p, const char* end, uint64_t& mantissa, int& digitCount, int& dropped)
+	{
+		while (end - p >= 8 && digitCount <= 11)
+		{
+			uint64_t chunk;
+			memcpy(&chunk, p, 8);
+			if (!IsEightDigits(chunk))
+				break;
+
+			mantissa = mantissa * 100000000ull + ParseEightDigits(chunk);
+			digitCount += 8;
+			p += 8;
+		}
+
+		while (p < end && IsDigit(*p))
+		{
+			if (digitCount < 19)
+			{
+				mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+				digitCount++;
+			}
+			else
+			{
+				dropped++;
+			}
+			p++;
+		}
+
+		return p;
+	}
+
+	const double PowersOfTen[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	// Parses [+-]digits[.digits][(e|E)[+-]digits] and advances p past it
+	bool ParseFloat(const char*& p, const char* end, float& out)
+	{
+		const char* start = p;
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			p++;
+		}
+
+		uint64_t mantissa = 0;
+		int digitCount = 0;
+		int dropped = 0;
+
+		const char* digitsStart = p;
+		p = AccumulateDigits(p, end, mantissa, digitCount, dropped);
+		bool anyDigits = p != digitsStart;
+		int exponent = dropped;
+
+		if (p < end && *p == '.')
+		{
+			p++;
+			const char* fractionStart = p;
+			int before = digitCount;
+			int ignored = 0;
+			p = AccumulateDigits(p, end, mantissa, digitCount, ignored);
+			exponent -= digitCount - before;
+			anyDigits |= p != fractionStart;
+		}
+
+		if (!anyDigits)
+		{
+			p = start;
+			return false;
+		}
+
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* e = p + 1;
+			bool negativeExponent = false;
+			if (e < end && (*e == '-' || *e == '+'))
+			{
+				negativeExponent = *e == '-';
+				e++;
+			}
+
+			int value = 0;
+			const char* exponentStart = e;
+			while (e < end && IsDigit(*e))
+			{
+				if (value < 10000)
+					value = value * 10 + (*e - '0');
+				e++;
+			}
+
+			if (e != exponentStart)
+			{
+				exponent += negativeExponent ? -value : value;
+				p = e;
+			}
+		}
+
+		double result = (double)mantissa;
+		if (exponent < 0)
+			result = exponent >= -22 ? result / PowersOfTen[-exponent] : result * std::pow(10.0, exponent);
+		else if (exponent > 0)
+			result = exponent <= 22 ? result * PowersOfTen[exponent] : result * std::pow(10.0, exponent);
+
+		out = (float)(negative ? -result : result);
+		return true;
+	}
+
+	// Parses [+-]digits and advances p past it
+	bool ParseInt(const char*& p, const char* end, long long& out)
+	{
+		bool negative = false;
+		const char* start = p;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			p++;
+		}
+
+		uint64_t value = 0;
+		int digitCount = 0;
+		int dropped = 0;
+		const char* digitsStart = p;
+		p = AccumulateDigits(p, end, value, digitCount, dropped);
+
+		if (p == digitsStart || dropped > 0)
+		{
+			p = start;
+			return false;
+		}
+
+		out = negative ? -(long long)value : (long long)value;
+		return true;
+	}
+
+	// Converts a 1-based (or negative, relative) OBJ index to 0-based
+	// - Negative indices count back from what was read before this line
+	// - Positive indices are checked against the whole file
+	inline unsigned int ResolveIndex(long long index, size_t countSoFar, size_t total)
+	{
+		if (index > 0 && (size_t)index <= total)
+			return (unsigned int)(index - 1);
+		if (index < 0 && (size_t)(-index) <= countSoFar)
+			return (unsigned int)(countSoFar + index);
+		return NoIndex;
+	}
+
+	// Parses one "p", "p/t", "p//n" or "p/t/n" face corner
+	// - Missing uv/normal references come back as 0
+	bool ParseCorner(const char*& p, const char* end, long long& position, long long& uv, long long& normal)
+	{
+		uv = 0;
+		normal = 0;
+
+		if (!ParseInt(p, end, position))
+			return false;
+
+		if (p < end && *p == '/')
+		{
+			p++;
+			if (p < end && *p == '/')
+			{
+				p++;
+				ParseInt(p, end, normal);
+			}
+			else
+			{
+				ParseInt(p, end, uv);
+				if (p < end && *p == '/')
+				{
+					p++;
+					ParseInt(p, end, normal);
+				}
+			}
+		}
+
+		// Skip anything else stuck to this corner
+		while (p < end && !IsSpace(*p))
+			p++;
+
+		return true;
+	}
+
+	enum class LineType
+	{
+		Other,
+		Position,
+		UV,
+		Normal,
+		Face,
+		Group,			// "o" or "g"
+		UseMaterial,
+		MaterialLibrary
+	};
+
+	// True (and moves p past it) if the line starts with keyword and a space
+	inline bool MatchKeyword(const char*& p, const char* end, const char* keyword, size_t length)
+	{
+		if ((size_t)(end - p) <= length || memcmp(p, keyword, length) != 0 || !IsSpace(p[length]))
+			return false;
+
+		p += length;
+		return true;
+	}
+
+	// Determines the line's type and moves p past the keyword
+	inline LineType ClassifyLine(const char*& p, const char* end)
+	{
+		p = SkipSpaces(p, end);
+		if (end - p < 2)
+			return LineType::Other;
+
+		if (p[0] == 'v')
+		{
+			if (IsSpace(p[1]))
+			{
+				p += 1;
+				return LineType::Position;
+			}
+			if (end - p >= 3 && IsSpace(p[2]))
+			{
+				if (p[1] == 't')
+				{
+					p += 2;
+					return LineType::UV;
+				}
+				if (p[1] == 'n')
+				{
+					p += 2;
+					return LineType::Normal;
+				}
+			}
+		}
+		else if (p[0] == 'f' && IsSpace(p[1]))
+		{
+			p += 1;
+			return LineType::Face;
+		}
+		else if ((p[0] == 'o' || p[0] == 'g') && IsSpace(p[1]))
+		{
+			p += 1;
+			return LineType::Group;
+		}
+		else if (MatchKeyword(p, end, "usemtl", 6))
+			return LineType::UseMaterial;
+		else if (MatchKeyword(p, end, "mtllib", 6))
+			return LineType::MaterialLibrary;
+
+		return LineType::Other;
+	}
+
+	// The rest of a line without surrounding spaces (names may contain spaces)
+	inline std::string ReadName(const char* p, const char* end)
+	{
+		p = SkipSpaces(p, end);
+		while (end > p && IsSpace(end[-1]))
+			end--;
+		return std::string(p, end);
+	}
+
+	// Counts whitespace separated tokens (face corners) on the rest of a line
+	inline size_t CountTokens(const char* p, const char* end)
+	{
+		size_t tokens = 0;
+		bool inToken = false;
+		for (; p < end; p++)
+		{
+			bool space = IsSpace(*p);
+			tokens += (!space && !inToken) ? 1 : 0;
+			inToken = !space;
+		}
+		return tokens;
+	}
+
+	// Gives every vertex without a normal the area-weighted
+	// average of the face normals around it
+	void GenerateMissingNormals(ObjMeshData& out, const std::vector<bool>& needsNormal)
+	{
+		for (size_t i = 0; i + 2 < out.Indices.size(); i += 3)
+		{
+			Vertex& a = out.Vertices[out.Indices[i]];
+			Vertex& b = out.Vertices[out.Indices[i + 1]];
+			Vertex& c = out.Vertices[out.Indices[i + 2]];
+
+			// Clockwise front faces in a left-handed space
+			float e1x = b.Position.x - a.Position.x, e1y = b.Position.y - a.Position.y, e1z = b.Position.z - a.Position.z;
+			float e2x = c.Position.x - a.Position.x, e2y = c.Position.y - a.Position.y, e2z = c.Position.z - a.Position.z;
+			float nx = e1y * e2z - e1z * e2y;
+			float ny = e1z * e2x - e1x * e2z;
+			float nz = e1x * e2y - e1y * e2x;
+
+			for (unsigned int corner = 0; corner < 3; corner++)
+			{
+				unsigned int index = out.Indices[i + corner];
+				if (!needsNormal[index])
+					continue;
+
+				out.Vertices[index].Normal.x += nx;
+				out.Vertices[index].Normal.y += ny;
+				out.Vertices[index].Normal.z += nz;
+			}
+		}
+
+		for (size_t i = 0; i < out.Vertices.size(); i++)
+		{
+			if (!needsNormal[i])
+				continue;
+
+			XMFLOAT3& n = out.Vertices[i].Normal;
+			float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+			n = length > 0.0f ? XMFLOAT3(n.x / length, n.y / length, n.z / length) : XMFLOAT3(0, 1, 0);
+		}
+	}
+
+	// Files smaller than this are not worth splitting
+	const size_t MinChunkSize = 256 * 1024;
+
+	// An "o"/"g" or "usemtl" line, which starts a new part
+	struct PartChange
+	{
+		bool IsMaterial;
+		std::string Name;
+	};
+
+	// --------------------------------------------------------
+	// A newline-aligned slice of the file parsed by one thread
+	// --------------------------------------------------------
+	struct ObjChunk
+	{
+		const char* Begin = nullptr;
+		const char* End = nullptr;
+
+		// Counting pass
+		size_t PositionCount = 0;
+		size_t UVCount = 0;
+		size_t NormalCount = 0;
+		size_t TriangleCount = 0;
+
+		// Prefix sums: how many of each came before this chunk
+		size_t PositionOffset = 0;
+		size_t UVOffset = 0;
+		size_t NormalOffset = 0;
+		size_t IndexOffset = 0;
+
+		// Parse pass
+		// - Faces after the nth PartChange are in chunk-local part
+		//    n; part 0 continues whatever the chunks before set
+		std::vector<PartChange> PartChanges;
+		std::string MaterialLibrary;
+		std::vector<VertexKey> CornerKeys;		// Every face corner, in file order
+		std::vector<VertexKey> UniqueKeys;		// Chunk-local vertices, in first-use order
+		std::vector<unsigned int> LocalIndices;	// Triangles indexing CornerKeys, then UniqueKeys
+
+		// Merge: chunk-local part -> submesh, and
+		// chunk-local vertex -> final vertex index
+		std::vector<unsigned int> PartToSubmesh;
+		std::vector<unsigned int> Remap;
+	};
+
+	// Counts v/vt/vn lines and triangles in a chunk
+	void CountChunk(ObjChunk& chunk)
+	{
+		for (const char* line = chunk.Begin; line < chunk.End;)
+		{
+			const char* lineEnd = FindLineEnd(line, chunk.End);
+			const char* p = line;
+
+			switch (ClassifyLine(p, lineEnd))
+			{
+			case LineType::Position: chunk.PositionCount++; break;
+			case LineType::UV: chunk.UVCount++; break;
+			case LineType::Normal: chunk.NormalCount++; break;
+			case LineType::Face:
+			{
+				size_t corners = CountTokens(p, lineEnd);
+				if (corners >= 3)
+					chunk.TriangleCount += corners - 2;
+				break;
+			}
+			default: break;
+			}
+
+			line = lineEnd + 1;
+		}
+	}
+
+	// --------------------------------------------------------
+	// Parses a chunk
+	// - v/vt/vn values go straight into their slots of the
+	//    shared arrays (chunks never overlap)
+	// - Faces resolve to global attribute indices using the
+	//    chunk's offsets (welding happens afterwards)
+	// --------------------------------------------------------
+	void ParseChunk(ObjChunk& chunk, std::vector<XMFLOAT3>& positions, std::vector<XMFLOAT2>& uvs, std::vector<XMFLOAT3>& normals)
+	{
+		size_t positionIndex = chunk.PositionOffset;
+		size_t uvIndex = chunk.UVOffset;
+		size_t normalIndex = chunk.NormalOffset;
+
+		chunk.CornerKeys.reserve(chunk.TriangleCount + chunk.TriangleCount / 2);
+		chunk.LocalIndices.reserve(chunk.TriangleCount * 3);
+		std::vector<unsigned int> corners;
+
+		for (const char* line = chunk.Begin; line < chunk.End;)
+		{
+			const char* lineEnd = FindLineEnd(line, chunk.End);
+			const char* p = line;
+
+			switch (ClassifyLine(p, lineEnd))
+			{
+			case LineType::Position:
+			{
+				XMFLOAT3 pos(0, 0, 0);
+				p = SkipSpaces(p, lineEnd); ParseFloat(p, lineEnd, pos.x);
+				p = SkipSpaces(p, lineEnd); ParseFloat(p, lineEnd, pos.y);
+				p = SkipSpaces(p, lineEnd); ParseFloat(p, lineEnd, pos.z);
+				positions[positionIndex++] = pos;
+				break;
+			}
+
+			case LineType::UV:
+			{
+				XMFLOAT2 uv(0, 0);
+				p = SkipSpaces(p, lineEnd); ParseFloat(p, lineEnd, uv.x);
+				p = SkipSpaces(p, lineEnd); ParseFloat(p, lineEnd, uv.y);
+				uvs[uvIndex++] = uv;
+				break;
+			}
+
+			case LineType::Normal:
+			{
+				XMFLOAT3 norm(0, 0, 0);
+				p = SkipSpaces(p, lineEnd); ParseFloat(p, lineEnd, norm.x);
+				p = SkipSpaces(p, lineEnd); ParseFloat(p, lineEnd, norm.y);
+				p = SkipSpaces(p, lineEnd); ParseFloat(p, lineEnd, norm.z);
+				normals[normalIndex++] = norm;
+				break;
+			}
+
+			case LineType::Face:
+			{
+				corners.clear();
+				bool valid = true;
+
+				for (p = SkipSpaces(p, lineEnd); p < lineEnd; p = SkipSpaces(p, lineEnd))
+				{
+					long long pi, ti, ni;
+					if (!ParseCorner(p, lineEnd, pi, ti, ni))
+					{
+						valid = false;
+						break;
+					}
+
+					VertexKey key;
+					key.Position = ResolveIndex(pi, positionIndex, positions.size());
+					key.UV = ResolveIndex(ti, uvIndex, uvs.size());
+					key.Normal = ResolveIndex(ni, normalIndex, normals.size());
+					key.Part = (unsigned int)chunk.PartChanges.size();
+					if (key.Position == NoIndex)
+					{
+						valid = false;
+						break;
+					}
+
+					corners.push_back((unsigned int)chunk.CornerKeys.size());
+					chunk.CornerKeys.push_back(key);
+				}
+
+				// Triangulate as a fan, flipping the winding order
+				// (see the right- to left-handed notes in BuildVertex)
+				if (!valid)
+					chunk.CornerKeys.resize(chunk.CornerKeys.size() - corners.size());
+				else if (corners.size() >= 3)
+				{
+					for (size_t c = 1; c + 1 < corners.size(); c++)
+					{
+						chunk.LocalIndices.push_back(corners[0]);
+						chunk.LocalIndices.push_back(corners[c + 1]);
+						chunk.LocalIndices.push_back(corners[c]);
+					}
+				}
+				break;
+			}
+
+			case LineType::Group:
+				chunk.PartChanges.push_back({ false, ReadName(p, lineEnd) });
+				break;
+
+			case LineType::UseMaterial:
+				chunk.PartChanges.push_back({ true, ReadName(p, lineEnd) });
+				break;
+
+			case LineType::MaterialLibrary:
+				if (chunk.MaterialLibrary.empty())
+					chunk.MaterialLibrary = ReadName(p, lineEnd);
+				break;
+
+			default: break;
+			}
+
+			line = lineEnd + 1;
+		}
+
+	}
+
+	// --------------------------------------------------------
+	// Gives every chunk-local part its submesh: one per
+	// object/group name and material pair, numbered in order
+	// of first appearance (empty ones are dropped later)
+	// - Serial, since a part continues the name and material
+	//    set by earlier chunks
+	// --------------------------------------------------------
+	void ResolveParts(std::vector<ObjChunk>& chunks, std::vector<ObjSubmesh>& submeshes)
+	{
+		std::map<std::pair<std::string, std::string>, unsigned int> ids;
+		std::string name;
+		std::string material;
+
+		auto currentSubmesh = [&]()
+		{
+			auto found = ids.emplace(std::make_pair(name, material), (unsigned int)submeshes.size());
+			if (found.second)
+				submeshes.push_back({ name, material, 0, 0 });
+			return found.first->second;
+		};
+
+		for (ObjChunk& chunk : chunks)
+		{
+			chunk.PartToSubmesh.push_back(currentSubmesh());
+			for (const PartChange& change : chunk.PartChanges)
+			{
+				(change.IsMaterial ? material : name) = change.Name;
+				chunk.PartToSubmesh.push_back(currentSubmesh());
+			}
+		}
+	}
+
+	// --------------------------------------------------------
+	// Sorts the triangles by submesh (keeping their order within
+	// each) and fills in the submeshes' index ranges
+	// --------------------------------------------------------
+	void GroupBySubmesh(ObjMeshData& out, const std::vector<VertexKey>& keys, std::vector<ObjSubmesh>& submeshes)
+	{
+		size_t triangleCount = out.Indices.size() / 3;
+		std::vector<unsigned int> triangleSubmesh(triangleCount);
+		std::vector<unsigned int> starts(submeshes.size() + 1, 0);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			triangleSubmesh[t] = keys[out.Indices[t * 3]].Part;
+			starts[triangleSubmesh[t] + 1]++;
+		}
+
+		for (size_t s = 0; s < submeshes.size(); s++)
+		{
+			starts[s + 1] += starts[s];
+			submeshes[s].IndexStart = starts[s] * 3;
+			submeshes[s].IndexCount = (starts[s + 1] - starts[s]) * 3;
+		}
+
+		if (submeshes.size() > 1)
+		{
+			std::vector<unsigned int> grouped(out.Indices.size());
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				unsigned int destination = starts[triangleSubmesh[t]]++;
+				memcpy(&grouped[(size_t)destination * 3], &out.Indices[t * 3], sizeof(unsigned int) * 3);
+			}
+			out.Indices.swap(grouped);
+		}
+
+		for (ObjSubmesh& submesh : submeshes)
+		{
+			if (submesh.IndexCount > 0)
+				out.Submeshes.push_back(std::move(submesh));
+		}
+	}
+
+	// --------------------------------------------------------
+	// Welds a parsed chunk's corners into its unique vertices
+	// - Faces usually reference a narrow band of positions, so
+	//    position buckets over just that band are used when it
+	//    is small enough; otherwise fall back to hashing
+	// --------------------------------------------------------
+	void WeldChunk(ObjChunk& chunk)
+	{
+		if (chunk.CornerKeys.empty())
+			return;
+
+		unsigned int minPosition = UINT_MAX;
+		unsigned int maxPosition = 0;
+		for (const VertexKey& key : chunk.CornerKeys)
+		{
+			minPosition = std::min(minPosition, key.Position);
+			maxPosition = std::max(maxPosition, key.Position);
+		}
+
+		std::vector<unsigned int> cornerToVertex(chunk.CornerKeys.size());
+		size_t range = (size_t)(maxPosition - minPosition) + 1;
+
+		if (range <= chunk.CornerKeys.size() * 4 + 1024)
+		{
+			VertexWelder welder(range);
+			chunk.UniqueKeys.reserve(range + range / 2);
+
+			for (size_t c = 0; c < chunk.CornerKeys.size(); c++)
+			{
+				VertexKey key = chunk.CornerKeys[c];
+				key.Position -= minPosition;
+
+				unsigned int index = welder.FindOrInsert(key);
+				if (index == chunk.UniqueKeys.size())
+					chunk.UniqueKeys.push_back(chunk.CornerKeys[c]);
+				cornerToVertex[c] = index;
+			}
+		}
+		else
+		{
+			ChunkWelder welder(chunk.CornerKeys.size() / 2);
+			for (size_t c = 0; c < chunk.CornerKeys.size(); c++)
+				cornerToVertex[c] = welder.FindOrInsert(chunk.CornerKeys[c]);
+			chunk.UniqueKeys = std::move(welder.GetUniqueKeys());
+		}
+
+		for (unsigned int& index : chunk.LocalIndices)
+			index = cornerToVertex[index];
+
+		chunk.CornerKeys.clear();
+		chunk.CornerKeys.shrink_to_fit();
+	}
+
+	Vertex BuildVertex(const VertexKey& key, const std::vector<XMFLOAT3>& positions, const std::vector<XMFLOAT2>& uvs, const std::vector<XMFLOAT3>& normals)
+	{
+		Vertex v;
+		v.Position = positions[key.Position];
+		v.UV = key.UV != NoIndex ? uvs[key.UV] : XMFLOAT2(0, 0);
+		v.Normal = key.Normal != NoIndex ? normals[key.Normal] : XMFLOAT3(0, 0, 0);
+		v.Tangent = XMFLOAT3(0, 0, 0);
+
+		// The model is most likely in a right-handed space,
+		// especially if it came from Maya.  We want to convert
+		// to a left-handed space for DirectX.  This means we
+		// need to:
+		//  - Invert the Z position
+		//  - Invert the normal's Z
+		//  - Flip the winding order (done when triangulating)
+		// We also need to flip the UV coordinate since DirectX
+		// defines (0,0) as the top left of the texture, and many
+		// 3D modeling packages use the bottom left as (0,0)
+		v.UV.y = 1.0f - v.UV.y;
+		v.Position.z *= -1.0f;
+		v.Normal.z *= -1.0f;
+		return v;
+	}
+}
+
+// --------------------------------------------------------
+// Reads (see Vfs) and parses an .OBJ file
+// - Returns false if the file can't be read or has no triangles
+// --------------------------------------------------------
+bool ObjParser::Load(const std::wstring& path, ObjMeshData& out)
+{
+	MappedFile file;
+	ByteSpan data;
+	if (!Vfs::Read(path, file, data))
+		return false;
+
+	return Parse(data.Data, data.Size, out);
+}
+
+// --------------------------------------------------------
+// Parses .OBJ text that is already in memory
+//
+// - chunkCount of 0 picks one chunk per pool thread (files
+//    under MinChunkSize stay on the calling thread)
+// - The result is identical for any chunk count: vertices
+//    are numbered in order of first use through the file
+// --------------------------------------------------------
+bool ObjParser::Parse(const char* data, size_t size, ObjMeshData& out, unsigned int chunkCount)
+{
+	out = ObjMeshData();
+	if (!data || size == 0)
+		return false;
+
+	const char* end = data + size;
+	ThreadPool& pool = ThreadPool::Get();
+
+	if (chunkCount == 0)
+		chunkCount = (unsigned int)std::min<size_t>(pool.GetThreadCount(), std::max<size_t>(1, size / MinChunkSize));
+
+	// Split the file into roughly equal chunks, moving each
+	// split point forward to just after a newline
+	std::vector<ObjChunk> chunks;
+	chunks.reserve(chunkCount);
+	for (const char* begin = data; begin < end;)
+	{
+		size_t c = chunks.size() + 1;
+		const char* chunkEnd = c >= chunkCount ? end : std::max(begin, data + size / chunkCount * c);
+		if (chunkEnd < end)
+			chunkEnd = std::min(FindLineEnd(chunkEnd, end) + 1, end);
+
+		ObjChunk chunk;
+		chunk.Begin = begin;
+		chunk.End = chunkEnd;
+		chunks.push_back(std::move(chunk));
+		begin = chunkEnd;
+	}
+
+	// Counting pass, then prefix sums so every chunk knows
+	// where its v/vt/vn lines land in the shared arrays
+	pool.ParallelFor(chunks.size(), [&](size_t i) { CountChunk(chunks[i]); });
+
+	size_t positionCount = 0;
+	size_t uvCount = 0;
+	size_t normalCount = 0;
+	for (ObjChunk& chunk : chunks)
+	{
+		chunk.PositionOffset = positionCount;
+		chunk.UVOffset = uvCount;
+		chunk.NormalOffset = normalCount;
+		positionCount += chunk.PositionCount;
+		uvCount += chunk.UVCount;
+		normalCount += chunk.NormalCount;
+	}
+
+	std::vector<XMFLOAT3> positions(positionCount);
+	std::vector<XMFLOAT2> uvs(uvCount);
+	std::vector<XMFLOAT3> normals(normalCount);
+
+	// Parse pass (parallel)
+	pool.ParallelFor(chunks.size(), [&](size_t i)
+	{
+		ParseChunk(chunks[i], positions, uvs, normals);
+		WeldChunk(chunks[i]);
+	});
+
+	std::vector<ObjSubmesh> submeshes;
+	ResolveParts(chunks, submeshes);
+	for (const ObjChunk& chunk : chunks)
+	{
+		if (out.MaterialLibrary.empty())
+			out.MaterialLibrary = chunk.MaterialLibrary;
+	}
+
+	// Merge pass (serial, but only over each chunk's unique
+	// vertices) - welds vertices shared across chunk borders
+	VertexWelder welder(positionCount);
+	std::vector<VertexKey> keys;
+	keys.reserve(positionCount + positionCount / 2);
+
+	size_t indexCount = 0;
+	for (ObjChunk& chunk : chunks)
+	{
+		chunk.IndexOffset = indexCount;
+		indexCount += chunk.LocalIndices.size();
+
+		chunk.Remap.resize(chunk.UniqueKeys.size());
+		for (size_t k = 0; k < chunk.UniqueKeys.size(); k++)
+		{
+			VertexKey key = chunk.UniqueKeys[k];
+			key.Part = chunk.PartToSubmesh[key.Part];
+
+			unsigned int index = welder.FindOrInsert(key);
+			if (index == keys.size())
+				keys.push_back(key);
+			chunk.Remap[k] = index;
+		}
+	}
+
+	if (indexCount == 0)
+		return false;
+
+	// Write final indices and vertices (parallel)
+	out.Indices.resize(indexCount);
+	pool.ParallelFor(chunks.size(), [&](size_t i)
+	{
+		const ObjChunk& chunk = chunks[i];
+		unsigned int* dest = &out.Indices[chunk.IndexOffset];
+		for (size_t j = 0; j < chunk.LocalIndices.size(); j++)
+			dest[j] = chunk.Remap[chunk.LocalIndices[j]];
+	});
+
+	const size_t vertexBlock = 16384;
+	out.Vertices.resize(keys.size());
+	pool.ParallelFor((keys.size() + vertexBlock - 1) / vertexBlock, [&](size_t block)
+	{
+		size_t last = std::min(keys.size(), (block + 1) * vertexBlock);
+		for (size_t v = block * vertexBlock; v < last; v++)
+			out.Vertices[v] = BuildVertex(keys[v], positions, uvs, normals);
+	});
+
+	out.FaceCorners = indexCount;
+	GroupBySubmesh(out, keys, submeshes);
+
+	// Any corners that referenced no normal?
+	std::vector<bool> needsNormal(keys.size(), false);
+	bool anyMissingNormals = false;
+	for (size_t v = 0; v < keys.size(); v++)
+	{
+		if (keys[v].Normal == NoIndex)
+		{
+			needsNormal[v] = true;
+			anyMissingNormals = true;
+		}
+	}
+
+	if (anyMissingNormals)
+		GenerateMissingNormals(out, needsNormal);
+
+	return true;
+}
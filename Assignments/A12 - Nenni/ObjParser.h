@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// A run of an .OBJ's triangles sharing an object/group
+// name and a material (from "o"/"g" and "usemtl" lines)
+// --------------------------------------------------------
+struct ObjSubmesh
+{
+	std::string Name;
+	std::string Material;
+	unsigned int IndexStart;
+	unsigned int IndexCount;
+};
+
+// --------------------------------------------------------
+// Result of parsing an .OBJ file
+//
+// - Vertices are welded: each unique (position, uv, normal)
+//    triple appears once and triangles share it by index
+// - Already converted to DirectX's left-handed space
+//    (Z flipped, winding flipped, V flipped)
+// - Tangents are NOT calculated here
+// - Indices are grouped by submesh (in order of first use),
+//    and vertices are never shared between submeshes
+// --------------------------------------------------------
+struct ObjMeshData
+{
+	std::vector<Vertex> Vertices;
+	std::vector<unsigned int> Indices;
+	std::vector<ObjSubmesh> Submeshes;
+
+	// File named by the first "mtllib" line (relative to the .OBJ)
+	std::string MaterialLibrary;
+
+	// How many vertices the mesh would need with one
+	// vertex per face corner (for reporting welding savings)
+	size_t FaceCorners = 0;
+};
+
+// --------------------------------------------------------
+// Fast .OBJ parsing
+//
+// - Memory maps the file and splits it at newlines into one
+//    chunk per thread; each chunk is counted, prefix sums
+//    place its v/vt/vn lines in the shared arrays, then all
+//    chunks parse and weld in parallel before a final merge
+// - Numbers are parsed by hand (8 digits at a time) and
+//    lines are found 16 bytes at a time, so no sscanf and
+//    no fixed-length line buffer
+// - Supports v, vt, vn and f lines with any number of
+//    corners, missing uvs/normals and negative indices, plus
+//    o, g, usemtl and mtllib for splitting into submeshes
+// --------------------------------------------------------
+namespace ObjParser
+{
+	bool Load(const std::wstring& path, ObjMeshData& out);
+	bool Parse(const char* data, size_t size, ObjMeshData& out, unsigned int chunkCount = 0);
+}
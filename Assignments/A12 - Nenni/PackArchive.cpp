@@ -0,0 +1,324 @@
+#include "PackArchive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cwctype>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+	// 64-bit FNV-1a
+	uint64_t HashName(const char* name, size_t length)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < length; i++)
+		{
+			hash ^= (uint8_t)name[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// One file of the folder being packed (or compared to a pack)
+	struct SourceFile
+	{
+		std::filesystem::path Path;
+		std::string Name;
+		uint64_t Size;
+		uint64_t Time;
+	};
+
+	// Packs (or temp files being written) must not end up
+	// inside each other
+	bool IsPackable(const std::filesystem::path& path)
+	{
+		std::wstring extension = path.extension().wstring();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](wchar_t c) { return (wchar_t)towlower(c); });
+		return extension != L".tmp" && extension != L".pack";
+	}
+
+	bool GatherFiles(const std::wstring& folder, std::vector<SourceFile>& files)
+	{
+		std::error_code error;
+		std::filesystem::recursive_directory_iterator it(folder, error);
+		if (error)
+			return false;
+
+		for (; it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+		{
+			if (error)
+				return false;
+			if (!it->is_regular_file(error) || !IsPackable(it->path()))
+				continue;
+
+			SourceFile file;
+			file.Path = it->path();
+			file.Name = PackArchive::NormalizeName(std::filesystem::relative(it->path(), folder, error).wstring());
+			file.Size = (uint64_t)it->file_size(error);
+			if (error)
+				return false;
+			file.Time = (uint64_t)it->last_write_time(error).time_since_epoch().count();
+			if (error)
+				return false;
+			files.push_back(file);
+		}
+
+		// Sorted so the same folder always packs the same way
+		std::sort(files.begin(), files.end(), [](const SourceFile& a, const SourceFile& b) { return a.Name < b.Name; });
+		return true;
+	}
+}
+
+PackArchive::PackArchive() : header(nullptr), entries(nullptr), slots(nullptr), names(nullptr)
+{
+}
+
+// --------------------------------------------------------
+// Maps the archive and checks its tables
+// - Every offset and size is validated here, so Find() and
+//    GetData() never need to
+// --------------------------------------------------------
+bool PackArchive::Open(const std::wstring& path)
+{
+	Close();
+	if (!file.Open(path) || file.GetSize() < sizeof(Header))
+	{
+		Close();
+		return false;
+	}
+
+	const char* data = file.GetData();
+	uint64_t size = file.GetSize();
+	const Header* h = (const Header*)data;
+
+	bool valid =
+		h->Magic == Magic &&
+		h->Version == Version &&
+		h->FileSize == size &&
+		h->SlotCount > 0 && (h->SlotCount & (h->SlotCount - 1)) == 0 &&
+		h->EntryCount < h->SlotCount &&
+		h->EntryOffset % alignof(Entry) == 0 &&
+		h->SlotOffset % alignof(uint32_t) == 0 &&
+		h->EntryOffset <= size && (size - h->EntryOffset) / sizeof(Entry) >= h->EntryCount &&
+		h->SlotOffset <= size && (size - h->SlotOffset) / sizeof(uint32_t) >= h->SlotCount &&
+		h->NameOffset <= size;
+	if (!valid)
+	{
+		Close();
+		return false;
+	}
+
+	const Entry* e = (const Entry*)(data + h->EntryOffset);
+	const uint32_t* s = (const uint32_t*)(data + h->SlotOffset);
+	uint64_t nameBytes = size - h->NameOffset;
+	for (uint32_t i = 0; i < h->EntryCount; i++)
+	{
+		if (e[i].Offset > size || e[i].Size > size - e[i].Offset ||
+			e[i].NameStart > nameBytes || e[i].NameLength > nameBytes - e[i].NameStart)
+		{
+			Close();
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < h->SlotCount; i++)
+	{
+		if (s[i] > h->EntryCount)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	header = h;
+	entries = e;
+	slots = s;
+	names = data + h->NameOffset;
+	return true;
+}
+
+void PackArchive::Close()
+{
+	file.Close();
+	header = nullptr;
+	entries = nullptr;
+	slots = nullptr;
+	names = nullptr;
+}
+
+bool PackArchive::IsOpen() const { return header != nullptr; }
+unsigned int PackArchive::GetEntryCount() const { return header ? header->EntryCount : 0; }
+
+// --------------------------------------------------------
+// Looks up an entry by its normalized name (see NormalizeName)
+// - One hash and usually a single probe, with the name only
+//    compared once the hashes match
+// --------------------------------------------------------
+const PackArchive::Entry* PackArchive::Find(const std::string& name) const
+{
+	if (!header)
+		return nullptr;
+
+	uint64_t hash = HashName(name.data(), name.size());
+	uint32_t mask = header->SlotCount - 1;
+	for (uint32_t probe = 0, slot = (uint32_t)hash & mask; probe < header->SlotCount; probe++, slot = (slot + 1) & mask)
+	{
+		uint32_t index = slots[slot];
+		if (index == 0)
+			return nullptr;
+
+		const Entry& entry = entries[index - 1];
+		if (entry.NameHash == hash &&
+			entry.NameLength == name.size() &&
+			memcmp(names + entry.NameStart, name.data(), name.size()) == 0)
+			return &entry;
+	}
+	return nullptr;
+}
+
+ByteSpan PackArchive::GetData(const Entry& entry) const
+{
+	ByteSpan span;
+	span.Data = file.GetData() + entry.Offset;
+	span.Size = (size_t)entry.Size;
+	return span;
+}
+
+// --------------------------------------------------------
+// Lower case (ASCII), '/' separated UTF-8, without any
+// leading "./" or separators
+// --------------------------------------------------------
+std::string PackArchive::NormalizeName(const std::wstring& relativePath)
+{
+	auto utf8 = std::filesystem::path(relativePath).lexically_normal().generic_u8string();
+	std::string name((const char*)utf8.data(), utf8.size());
+	for (char& c : name)
+		c = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+
+	size_t start = 0;
+	while (start < name.size() && name[start] == '/')
+		start++;
+	if (name.compare(start, 2, "./") == 0)
+		start += 2;
+	return name.substr(start);
+}
+
+// --------------------------------------------------------
+// Writes a new archive of every packable file in a folder
+// - Written to a temp file and renamed over the old one, so a
+//    failed build never leaves a half-written archive
+// --------------------------------------------------------
+bool PackArchive::Build(const std::wstring& folder, const std::wstring& packPath)
+{
+	std::vector<SourceFile> sources;
+	if (!GatherFiles(folder, sources) || sources.size() >= 0x40000000)
+		return false;
+
+	Header packHeader = {};
+	packHeader.Magic = Magic;
+	packHeader.Version = Version;
+	packHeader.EntryCount = (uint32_t)sources.size();
+	packHeader.SlotCount = 16;
+	while (packHeader.SlotCount < packHeader.EntryCount * 2)
+		packHeader.SlotCount *= 2;
+
+	// Entries and names, with data laid out after the tables
+	std::vector<Entry> entryTable(sources.size());
+	std::string nameTable;
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		entryTable[i].NameHash = HashName(sources[i].Name.data(), sources[i].Name.size());
+		entryTable[i].Size = sources[i].Size;
+		entryTable[i].SourceTime = sources[i].Time;
+		entryTable[i].NameStart = (uint32_t)nameTable.size();
+		entryTable[i].NameLength = (uint32_t)sources[i].Name.size();
+		nameTable += sources[i].Name;
+	}
+
+	std::vector<uint32_t> slotTable(packHeader.SlotCount, 0);
+	uint32_t mask = packHeader.SlotCount - 1;
+	for (uint32_t i = 0; i < packHeader.EntryCount; i++)
+	{
+		uint32_t slot = (uint32_t)entryTable[i].NameHash & mask;
+		while (slotTable[slot] != 0)
+			slot = (slot + 1) & mask;
+		slotTable[slot] = i + 1;
+	}
+
+	packHeader.EntryOffset = sizeof(Header);
+	packHeader.SlotOffset = packHeader.EntryOffset + entryTable.size() * sizeof(Entry);
+	packHeader.NameOffset = packHeader.SlotOffset + slotTable.size() * sizeof(uint32_t);
+	uint64_t offset = packHeader.NameOffset + nameTable.size();
+	for (Entry& entry : entryTable)
+	{
+		entry.Offset = AlignUp(offset, EntryAlignment);
+		offset = entry.Offset + entry.Size;
+	}
+	packHeader.FileSize = offset;
+
+	std::filesystem::path tempPath(packPath);
+	tempPath += L".tmp";
+	bool written = false;
+	{
+		std::ofstream out(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (out)
+		{
+			out.write((const char*)&packHeader, sizeof(packHeader));
+			out.write((const char*)entryTable.data(), entryTable.size() * sizeof(Entry));
+			out.write((const char*)slotTable.data(), slotTable.size() * sizeof(uint32_t));
+			out.write(nameTable.data(), nameTable.size());
+
+			const char padding[EntryAlignment] = {};
+			uint64_t position = packHeader.NameOffset + nameTable.size();
+			for (size_t i = 0; i < sources.size() && out; i++)
+			{
+				out.write(padding, entryTable[i].Offset - position);
+
+				// Files that changed size since they were listed would
+				// break the layout, so they fail the build
+				MappedFile source;
+				if (!source.Open(sources[i].Path.wstring()) || source.GetSize() != entryTable[i].Size)
+				{
+					out.setstate(std::ios::failbit);
+					break;
+				}
+				if (source.GetSize() > 0)
+					out.write(source.GetData(), source.GetSize());
+				position = entryTable[i].Offset + entryTable[i].Size;
+			}
+			written = (bool)out;
+		}
+	}
+
+	std::error_code error;
+	if (written)
+		std::filesystem::rename(tempPath, packPath, error);
+	if (!written || error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
+
+bool PackArchive::IsUpToDate(const std::wstring& folder, const std::wstring& packPath)
+{
+	PackArchive pack;
+	std::vector<SourceFile> sources;
+	if (!pack.Open(packPath) || !GatherFiles(folder, sources) || sources.size() != pack.GetEntryCount())
+		return false;
+
+	for (const SourceFile& source : sources)
+	{
+		const Entry* entry = pack.Find(source.Name);
+		if (!entry || entry->Size != source.Size || entry->SourceTime != source.Time)
+			return false;
+	}
+	return true;
+}
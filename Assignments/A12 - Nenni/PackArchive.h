@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "MappedFile.h"
+
+// --------------------------------------------------------
+// A read-only run of bytes, valid for as long as whatever
+// it points into
+// --------------------------------------------------------
+struct ByteSpan
+{
+	const char* Data = nullptr;
+	size_t Size = 0;
+};
+
+// --------------------------------------------------------
+// A single file holding every file of an asset folder (.pack)
+//
+// Layout:
+// - Header
+// - Entries: name hash, data offset, size and the source
+//    file's modification time of every packed file
+// - Slots: open addressing hash table of entry index + 1
+//    (0 is empty), a power of two in size and at most half
+//    full, probed linearly from hash & (slot count - 1)
+// - Names: every entry's name (relative to the folder, lower
+//    case, '/' separated), one after another
+// - File data, each entry starting on a 4 KB boundary so it
+//    lines up with memory pages
+// --------------------------------------------------------
+class PackArchive
+{
+public:
+	static const uint32_t Magic = 0x4B434150; // "PACK"
+	static const uint32_t Version = 1;
+	static const uint64_t EntryAlignment = 4096;
+
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t EntryCount;
+		uint32_t SlotCount;
+
+		uint64_t EntryOffset;
+		uint64_t SlotOffset;
+		uint64_t NameOffset;
+		uint64_t FileSize;
+	};
+
+	struct Entry
+	{
+		uint64_t NameHash;
+		uint64_t Offset;
+		uint64_t Size;
+		uint64_t SourceTime;
+		uint32_t NameStart;		// From the start of the names
+		uint32_t NameLength;
+	};
+
+	PackArchive();
+
+	PackArchive(const PackArchive&) = delete;
+	PackArchive& operator=(const PackArchive&) = delete;
+
+	// Maps the whole archive; false if it's missing or damaged
+	bool Open(const std::wstring& path);
+	void Close();
+
+	// Getter Methods
+	bool IsOpen() const;
+	unsigned int GetEntryCount() const;
+
+	// The entry with a (normalized) name, or nullptr
+	const Entry* Find(const std::string& name) const;
+	ByteSpan GetData(const Entry& entry) const;
+
+	// Entry name of a path relative to the packed folder
+	static std::string NormalizeName(const std::wstring& relativePath);
+
+	// Packs every file under a folder (except temp files and
+	// other archives), replacing any existing archive
+	static bool Build(const std::wstring& folder, const std::wstring& packPath);
+
+	// Whether the archive holds exactly the folder's files, with
+	// the same sizes and modification times
+	static bool IsUpToDate(const std::wstring& folder, const std::wstring& packPath);
+
+private:
+	MappedFile file;
+	const Header* header;
+	const Entry* entries;
+	const uint32_t* slots;
+	const char* names;
+};
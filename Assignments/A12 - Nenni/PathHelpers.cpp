@@ -19,8 +19,10 @@
 //    that option is stored in a user file (.suo), which is ignored by most
 //    version control packages by default.  Meaning: the option must be
 //    changed on every PC.  Ugh.  So instead, here's a helper.
+// - The executable never moves, so Windows is only asked once (FixPath()
+//    runs for every file that's loaded)
 // --------------------------------------------------------------------------
-std::string GetExePath()
+static std::string FindExePath()
 {
 	// Assume the path is just the "current directory" for now
 	std::string path = ".\\";
@@ -47,6 +49,12 @@ std::string GetExePath()
 	return path;
 }
 
+std::string GetExePath()
+{
+	static const std::string exePath = FindExePath();
+	return exePath;
+}
+
 
 // ----------------------------------------------------
 //  Fixes a relative path so that it is consistently
@@ -74,7 +82,8 @@ std::string FixPath(const std::string& relativeFilePath)
 // ---------------------------------------------------- 
 std::wstring FixPath(const std::wstring& relativeFilePath)
 {
-	return NarrowToWide(GetExePath()) + L"\\" + relativeFilePath;
+	static const std::wstring exePath = NarrowToWide(GetExePath());
+	return exePath + L"\\" + relativeFilePath;
 }
 
 
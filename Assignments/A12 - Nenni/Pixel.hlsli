@@ -18,6 +18,12 @@ cbuffer ExternalData : register(b0)
     float time;
     
     Light lights[5];
+    
+    float4 irradiance[9];
+    
+    float specularMipCount;
+    float roughnessOnlyMasks;
+    float2 padding0;
 }
 
 #endif
\ No newline at end of file
@@ -3,12 +3,14 @@
 // Texture Resources
 Texture2D Albedo                        : register(t0);
 Texture2D NormalMap                     : register(t1);
-Texture2D RoughnessMap                  : register(t2);
-Texture2D MetalnessMap                  : register(t3);
-Texture2D ShadowMap                     : register(t4);
+Texture2D MaskMap                       : register(t2); // Occlusion, roughness, metalness
+Texture2D ShadowMap                     : register(t3);
+TextureCube SpecularMap                 : register(t4); // Sky, prefiltered by roughness
+Texture2D EnvironmentBrdfLut            : register(t5); // Split sum scale and bias
 
 SamplerState BasicSampler               : register(s0);
 SamplerComparisonState ShadowSampler    : register(s1);
+SamplerState ClampSampler               : register(s2);
 
 // --------------------------------------------------------
 // The entry point (main method) for our pixel shader
@@ -47,11 +49,14 @@ float4 main(VertexToPixel input) : SV_TARGET
     // Apply normal map
     input.normal = NormalMapping(NormalMap, BasicSampler, input.uv, input.normal, input.tangent);
     
-    // Sample roughness
-    float roughness = RoughnessMap.Sample(BasicSampler, input.uv).r;
-    
-    // Sample metal
-    float metal = MetalnessMap.Sample(BasicSampler, input.uv).r;
+    // Sample occlusion, roughness and metal together
+    // - One channel mask maps hold roughness alone
+    float3 masks = MaskMap.Sample(BasicSampler, input.uv).rgb;
+    if (roughnessOnlyMasks > 0)
+        masks = float3(1, masks.r, 0);
+    float occlusion = masks.r;
+    float roughness = masks.g;
+    float metal = masks.b;
     
     // Establish surface color
     float3 surfaceColor = Albedo.Sample(BasicSampler, input.uv).rgb * color.rgb;
@@ -60,11 +65,27 @@ float4 main(VertexToPixel input) : SV_TARGET
     // Establish specular color
     float3 specularColor = lerp(0.04f, surfaceColor.rgb, metal);
     
-    // Ambient lighting
-    float3 totalLight = 0;
+    // Ambient lighting, both parts dimmed by occlusion
+    // - Diffuse from the SH irradiance: the entity's light
+    //    probes, fading to the sky's (zero if neither was cooked)
+    // - Specular from the sky's mip blurred to this roughness,
+    //    only once it's prefiltered
+    float3 view = normalize(camPosition - input.worldPosition);
+    float3 envBrdf = EnvironmentBRDF(EnvironmentBrdfLut, ClampSampler, specularColor, roughness, saturate(dot(input.normal, view)));
+    
+    float3 ambientDiffuse = max(ShIrradiance(irradiance, input.normal), 0) * surfaceColor * (1 - envBrdf) * (1 - metal);
+    
+    float3 ambientSpecular = 0;
+    if (specularMipCount > 0)
+    {
+        float3 reflection = reflect(-view, input.normal);
+        ambientSpecular = pow(SpecularMap.SampleLevel(BasicSampler, reflection, roughness * (specularMipCount - 1)).rgb, 2.2f) * envBrdf;
+    }
+    
+    float3 totalLight = (ambientDiffuse + ambientSpecular) * occlusion;
     
     // Additional lighting
-    for (int i = 0; i < 1; i++)
+    for (int i = 0; i < SHADED_LIGHT_COUNT; i++)
     {
         Light light = lights[i];
         light.Direction = normalize(light.Direction);
@@ -0,0 +1,846 @@
+#include "PngDecoder.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	const uint8_t Signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+	inline uint32_t ReadBigEndian32(const uint8_t* p)
+	{
+		return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+	}
+
+	// --------------------------------------------------------
+	// Reads a deflate stream's bits, least significant first
+	//
+	// - Refill() tops the buffer up to at least 56 bits, which
+	//    is enough for a whole length/distance pair
+	// - Past the end it reads zeros, and Overran() tells
+	//    whether any of them were used
+	// --------------------------------------------------------
+	class BitReader
+	{
+	public:
+		BitReader(const uint8_t* data, size_t size)
+			: p(data), end(data + size), bits(0), count(0), padding(0)
+		{
+		}
+
+		void Refill()
+		{
+			// Whole words while there are 8 bytes left: the bytes that
+			// don't fit are loaded again, to the same bits, next time
+			// - Assumes a little-endian CPU (x86, ARM)
+			if (end - p >= 8)
+			{
+				uint64_t next;
+				memcpy(&next, p, sizeof(next));
+				bits |= next << count;
+				p += (63 - count) >> 3;
+				count |= 56;
+				return;
+			}
+
+			while (count <= 56)
+			{
+				if (p < end)
+					bits |= (uint64_t)*p++ << count;
+				else
+					padding++;
+				count += 8;
+			}
+		}
+
+		uint32_t Peek(unsigned int bitCount) const
+		{
+			return (uint32_t)(bits & ((1ull << bitCount) - 1));
+		}
+
+		void Consume(unsigned int bitCount)
+		{
+			bits >>= bitCount;
+			count -= bitCount;
+		}
+
+		uint32_t Read(unsigned int bitCount)
+		{
+			uint32_t value = Peek(bitCount);
+			Consume(bitCount);
+			return value;
+		}
+
+		// Copies whole bytes (after AlignToByte()); false if the
+		// stream ends first
+		bool ReadBytes(uint8_t* out, size_t size)
+		{
+			while (size > 0 && count >= 8)
+			{
+				*out++ = (uint8_t)Read(8);
+				size--;
+			}
+			if (size == 0)
+				return true;
+
+			// The buffer is empty, so the rest comes straight from
+			// the input (what was left in bits is loaded again)
+			bits = 0;
+			count = 0;
+			if ((size_t)(end - p) < size || padding > 0)
+				return false;
+			memcpy(out, p, size);
+			p += size;
+			return true;
+		}
+
+		void AlignToByte()
+		{
+			Consume(count & 7);
+		}
+
+		bool Overran() const
+		{
+			return count < padding * 8;
+		}
+
+	private:
+		const uint8_t* p;
+		const uint8_t* end;
+		uint64_t bits;
+		unsigned int count;
+		unsigned int padding;
+	};
+
+	// --------------------------------------------------------
+	// Canonical Huffman code of a deflate block
+	//
+	// - Codes up to FastBits long are decoded with one table
+	//    lookup; longer ones walk the code lengths
+	// - Incomplete codes are allowed (a distance code may have
+	//    a single symbol); their unused codes fail to decode
+	// --------------------------------------------------------
+	class Huffman
+	{
+	public:
+		static const unsigned int FastBits = 10;
+		static const unsigned int MaxBits = 15;
+
+		bool Build(const uint8_t* lengths, unsigned int symbolCount)
+		{
+			memset(counts, 0, sizeof(counts));
+			for (unsigned int s = 0; s < symbolCount; s++)
+				counts[lengths[s]]++;
+			counts[0] = 0;
+
+			// More codes of a length than there is room for
+			int left = 1;
+			for (unsigned int length = 1; length <= MaxBits; length++)
+			{
+				left = (left << 1) - counts[length];
+				if (left < 0)
+					return false;
+			}
+
+			// Symbols sorted by code (by length, then symbol)
+			uint16_t offsets[MaxBits + 1] = {};
+			for (unsigned int length = 1; length < MaxBits; length++)
+				offsets[length + 1] = offsets[length] + counts[length];
+			for (unsigned int s = 0; s < symbolCount; s++)
+			{
+				if (lengths[s] != 0)
+					symbols[offsets[lengths[s]]++] = (uint16_t)s;
+			}
+
+			// Codes are stored most significant bit first, so the
+			// table is indexed by their reversed bits
+			memset(fast, 0, sizeof(fast));
+			unsigned int code = 0;
+			unsigned int index = 0;
+			for (unsigned int length = 1; length <= FastBits; length++)
+			{
+				for (unsigned int i = 0; i < counts[length]; i++, code++)
+				{
+					unsigned int reversed = 0;
+					for (unsigned int b = 0; b < length; b++)
+						reversed |= ((code >> b) & 1) << (length - 1 - b);
+
+					uint16_t entry = (uint16_t)(length << 9 | symbols[index++]);
+					for (unsigned int j = reversed; j < (1u << FastBits); j += 1u << length)
+						fast[j] = entry;
+				}
+				code <<= 1;
+			}
+			return true;
+		}
+
+		// The next symbol, or -1 for a code that isn't in use
+		// (the reader must have been refilled)
+		int Decode(BitReader& reader) const
+		{
+			uint16_t entry = fast[reader.Peek(FastBits)];
+			if (entry != 0)
+			{
+				reader.Consume(entry >> 9);
+				return entry & 511;
+			}
+
+			uint32_t bits = reader.Peek(MaxBits);
+			int code = 0;
+			int first = 0;
+			int index = 0;
+			for (unsigned int length = 1; length <= MaxBits; length++)
+			{
+				code |= (bits >> (length - 1)) & 1;
+				int count = counts[length];
+				if (code - first < count)
+				{
+					reader.Consume(length);
+					return symbols[index + code - first];
+				}
+				index += count;
+				first = (first + count) << 1;
+				code <<= 1;
+			}
+			return -1;
+		}
+
+	private:
+		uint16_t fast[1 << FastBits];	// length << 9 | symbol, 0 if longer
+		uint16_t counts[MaxBits + 1];
+		uint16_t symbols[288];
+	};
+
+	const uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	// Order the code length code's lengths are stored in
+	const uint8_t CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	// Decodes one compressed block's symbols into out
+	bool InflateBlock(BitReader& reader, const Huffman& literals, const Huffman& distances, uint8_t* out, size_t& position, size_t outSize)
+	{
+		while (true)
+		{
+			reader.Refill();
+			int symbol = literals.Decode(reader);
+			if (symbol < 0)
+				return false;
+
+			if (symbol < 256)
+			{
+				if (position >= outSize)
+					return false;
+				out[position++] = (uint8_t)symbol;
+				continue;
+			}
+			if (symbol == 256)
+				return true;
+
+			symbol -= 257;
+			if (symbol >= 29)
+				return false;
+			size_t length = LengthBase[symbol] + reader.Read(LengthExtra[symbol]);
+
+			int distanceSymbol = distances.Decode(reader);
+			if (distanceSymbol < 0 || distanceSymbol >= 30)
+				return false;
+			size_t distance = DistanceBase[distanceSymbol] + reader.Read(DistanceExtra[distanceSymbol]);
+
+			if (distance > position || length > outSize - position)
+				return false;
+
+			// Overlapping copies repeat the last distance bytes
+			uint8_t* target = out + position;
+			const uint8_t* source = target - distance;
+			if (distance >= length)
+				memcpy(target, source, length);
+			else if (distance == 1)
+				memset(target, *source, length);
+			else
+			{
+				for (size_t i = 0; i < length; i++)
+					target[i] = source[i];
+			}
+			position += length;
+		}
+	}
+
+	// Reads the code lengths of a dynamic block and builds its codes
+	bool ReadDynamicCodes(BitReader& reader, Huffman& literals, Huffman& distances)
+	{
+		reader.Refill();
+		unsigned int literalCount = reader.Read(5) + 257;
+		unsigned int distanceCount = reader.Read(5) + 1;
+		unsigned int codeLengthCount = reader.Read(4) + 4;
+		if (literalCount > 286 || distanceCount > 30)
+			return false;
+
+		uint8_t codeLengths[19] = {};
+		for (unsigned int i = 0; i < codeLengthCount; i++)
+		{
+			reader.Refill();
+			codeLengths[CodeLengthOrder[i]] = (uint8_t)reader.Read(3);
+		}
+
+		Huffman lengthCode;
+		if (!lengthCode.Build(codeLengths, 19))
+			return false;
+
+		uint8_t lengths[286 + 30] = {};
+		unsigned int total = literalCount + distanceCount;
+		for (unsigned int n = 0; n < total;)
+		{
+			reader.Refill();
+			int symbol = lengthCode.Decode(reader);
+			if (symbol < 0)
+				return false;
+
+			if (symbol < 16)
+			{
+				lengths[n++] = (uint8_t)symbol;
+				continue;
+			}
+
+			unsigned int repeat;
+			uint8_t value = 0;
+			if (symbol == 16)
+			{
+				if (n == 0)
+					return false;
+				repeat = 3 + reader.Read(2);
+				value = lengths[n - 1];
+			}
+			else if (symbol == 17)
+				repeat = 3 + reader.Read(3);
+			else
+				repeat = 11 + reader.Read(7);
+
+			if (n + repeat > total)
+				return false;
+			memset(lengths + n, value, repeat);
+			n += repeat;
+		}
+
+		return
+			literals.Build(lengths, literalCount) &&
+			distances.Build(lengths + literalCount, distanceCount);
+	}
+
+	// --------------------------------------------------------
+	// Decompresses a zlib stream (RFC 1950 around RFC 1951)
+	// into out, which must come out exactly outSize bytes
+	// --------------------------------------------------------
+	bool Inflate(const uint8_t* data, size_t size, uint8_t* out, size_t outSize)
+	{
+		// Deflate, no preset dictionary, header checksum
+		if (size < 2 || (data[0] & 15) != 8 || (data[1] & 32) != 0 || ((data[0] << 8) | data[1]) % 31 != 0)
+			return false;
+
+		BitReader reader(data + 2, size - 2);
+		size_t position = 0;
+		bool last = false;
+		while (!last)
+		{
+			reader.Refill();
+			last = reader.Read(1) != 0;
+			unsigned int type = reader.Read(2);
+
+			if (type == 0)
+			{
+				reader.AlignToByte();
+				uint8_t lengths[4];
+				if (!reader.ReadBytes(lengths, 4))
+					return false;
+
+				size_t length = lengths[0] | lengths[1] << 8;
+				size_t complement = lengths[2] | lengths[3] << 8;
+				if (length != (~complement & 0xFFFF) || length > outSize - position ||
+					!reader.ReadBytes(out + position, length))
+					return false;
+				position += length;
+			}
+			else if (type == 1 || type == 2)
+			{
+				Huffman literals;
+				Huffman distances;
+				if (type == 1)
+				{
+					uint8_t lengths[288 + 30];
+					memset(lengths, 8, 144);
+					memset(lengths + 144, 9, 112);
+					memset(lengths + 256, 7, 24);
+					memset(lengths + 280, 8, 8);
+					memset(lengths + 288, 5, 30);
+					literals.Build(lengths, 288);
+					distances.Build(lengths + 288, 30);
+				}
+				else if (!ReadDynamicCodes(reader, literals, distances))
+					return false;
+
+				if (!InflateBlock(reader, literals, distances, out, position, outSize))
+					return false;
+			}
+			else
+				return false;
+
+			if (reader.Overran())
+				return false;
+		}
+		return position == outSize;
+	}
+
+	// --------------------------------------------------------
+	// What the IHDR (and PLTE/tRNS) chunks say about the pixels
+	// --------------------------------------------------------
+	struct PngFormat
+	{
+		unsigned int Width = 0;
+		unsigned int Height = 0;
+		unsigned int BitDepth = 0;
+		unsigned int ColorType = 0;
+		bool Interlaced = false;
+
+		unsigned int Channels = 0;		// Samples per pixel in the file
+		unsigned int OutChannels = 0;	// 1 or 4, see Image
+
+		uint8_t Palette[256][4] = {};
+		unsigned int PaletteSize = 0;
+		bool HasKey = false;			// tRNS color for gray and RGB
+		uint16_t Key[3] = {};
+
+		size_t GetRowBytes(unsigned int width) const
+		{
+			return ((size_t)width * Channels * BitDepth + 7) / 8;
+		}
+
+		// Distance to the byte the filters compare with
+		unsigned int GetFilterStride() const
+		{
+			return std::max(Channels * BitDepth / 8, 1u);
+		}
+	};
+
+	bool IsValidDepth(unsigned int colorType, unsigned int depth)
+	{
+		switch (colorType)
+		{
+		case 0: return depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16;
+		case 3: return depth == 1 || depth == 2 || depth == 4 || depth == 8;
+		case 2:
+		case 4:
+		case 6: return depth == 8 || depth == 16;
+		default: return false;
+		}
+	}
+
+	unsigned int ChannelsOf(unsigned int colorType)
+	{
+		switch (colorType)
+		{
+		case 0: return 1;
+		case 2: return 3;
+		case 3: return 1;
+		case 4: return 2;
+		default: return 4;
+		}
+	}
+
+	// Whichever of left, up and up-left is closest to left + up
+	// - up-left, written so the compiler can use selects
+	inline uint8_t PaethPredictor(int a, int b, int c)
+	{
+		int pa = abs(b - c);
+		int pb = abs(a - c);
+		int pc = abs(a + b - 2 * c);
+		int bc = pb <= pc ? b : c;
+		return (uint8_t)(pa <= pb && pa <= pc ? a : bc);
+	}
+
+	// --------------------------------------------------------
+	// The Paeth filter, the slowest to undo, with the left and
+	// up-left pixels kept in registers
+	// - A row is whole pixels, so it's a multiple of Stride
+	// --------------------------------------------------------
+	template<unsigned int Stride>
+	void UnfilterPaeth(uint8_t* row, const uint8_t* previous, size_t size)
+	{
+		int left[Stride] = {};
+		int upLeft[Stride] = {};
+		for (size_t i = 0; i < size; i += Stride)
+		{
+			for (unsigned int k = 0; k < Stride; k++)
+			{
+				int up = previous[i + k];
+				uint8_t value = (uint8_t)(row[i + k] + PaethPredictor(left[k], up, upLeft[k]));
+				row[i + k] = value;
+				left[k] = value;
+				upLeft[k] = up;
+			}
+		}
+	}
+
+	// --------------------------------------------------------
+	// Undoes a row's filter in place; previous is the row above
+	// (already unfiltered), or zeros for the first row
+	// --------------------------------------------------------
+	bool Unfilter(unsigned int filter, uint8_t* row, const uint8_t* previous, size_t size, unsigned int stride)
+	{
+		switch (filter)
+		{
+		case 0:
+			return true;
+		case 1:
+			for (size_t i = stride; i < size; i++)
+				row[i] = (uint8_t)(row[i] + row[i - stride]);
+			return true;
+		case 2:
+			for (size_t i = 0; i < size; i++)
+				row[i] = (uint8_t)(row[i] + previous[i]);
+			return true;
+		case 3:
+			for (size_t i = 0; i < stride && i < size; i++)
+				row[i] = (uint8_t)(row[i] + previous[i] / 2);
+			for (size_t i = stride; i < size; i++)
+				row[i] = (uint8_t)(row[i] + (row[i - stride] + previous[i]) / 2);
+			return true;
+		case 4:
+			switch (stride)
+			{
+			case 1: UnfilterPaeth<1>(row, previous, size); break;
+			case 2: UnfilterPaeth<2>(row, previous, size); break;
+			case 3: UnfilterPaeth<3>(row, previous, size); break;
+			case 4: UnfilterPaeth<4>(row, previous, size); break;
+			case 6: UnfilterPaeth<6>(row, previous, size); break;
+			default: UnfilterPaeth<8>(row, previous, size); break;
+			}
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// Sample index of an unfiltered row, at its own bit depth
+	inline unsigned int ReadSample(const uint8_t* row, size_t index, unsigned int depth)
+	{
+		switch (depth)
+		{
+		case 8: return row[index];
+		case 16: return (unsigned int)row[index * 2] << 8 | row[index * 2 + 1];
+		default:
+		{
+			size_t bit = index * depth;
+			return (row[bit >> 3] >> (8 - depth - (bit & 7))) & ((1u << depth) - 1);
+		}
+		}
+	}
+
+	inline uint8_t To8Bits(unsigned int sample, unsigned int depth)
+	{
+		if (depth == 16)
+			return (uint8_t)(sample >> 8);
+		if (depth == 8)
+			return (uint8_t)sample;
+		return (uint8_t)(sample * 255 / ((1u << depth) - 1));
+	}
+
+	// --------------------------------------------------------
+	// Converts an unfiltered row to output pixels, step pixels
+	// apart (more than one for interlaced passes)
+	// --------------------------------------------------------
+	void ConvertRow(const PngFormat& format, const uint8_t* row, unsigned int width, uint8_t* out, size_t step)
+	{
+		unsigned int depth = format.BitDepth;
+		size_t outStride = step * format.OutChannels;
+
+		// The common cases, straight copies or adding alpha
+		if (depth == 8 && step == 1 && !format.HasKey)
+		{
+			if (format.ColorType == 0 || format.ColorType == 6)
+			{
+				memcpy(out, row, (size_t)width * format.OutChannels);
+				return;
+			}
+			if (format.ColorType == 2)
+			{
+				for (unsigned int x = 0; x < width; x++, row += 3, out += 4)
+				{
+					out[0] = row[0];
+					out[1] = row[1];
+					out[2] = row[2];
+					out[3] = 255;
+				}
+				return;
+			}
+		}
+
+		for (unsigned int x = 0; x < width; x++, out += outStride)
+		{
+			switch (format.ColorType)
+			{
+			case 0:
+			{
+				unsigned int gray = ReadSample(row, x, depth);
+				uint8_t value = To8Bits(gray, depth);
+				if (format.OutChannels == 1)
+				{
+					out[0] = value;
+					break;
+				}
+				out[0] = out[1] = out[2] = value;
+				out[3] = format.HasKey && gray == format.Key[0] ? 0 : 255;
+				break;
+			}
+			case 2:
+			{
+				unsigned int r = ReadSample(row, (size_t)x * 3, depth);
+				unsigned int g = ReadSample(row, (size_t)x * 3 + 1, depth);
+				unsigned int b = ReadSample(row, (size_t)x * 3 + 2, depth);
+				out[0] = To8Bits(r, depth);
+				out[1] = To8Bits(g, depth);
+				out[2] = To8Bits(b, depth);
+				out[3] = format.HasKey && r == format.Key[0] && g == format.Key[1] && b == format.Key[2] ? 0 : 255;
+				break;
+			}
+			case 3:
+			{
+				// Indices past the palette are an error; black is shown
+				unsigned int index = ReadSample(row, x, depth);
+				static const uint8_t missing[4] = { 0, 0, 0, 255 };
+				memcpy(out, index < format.PaletteSize ? format.Palette[index] : missing, 4);
+				break;
+			}
+			case 4:
+			{
+				uint8_t gray = To8Bits(ReadSample(row, (size_t)x * 2, depth), depth);
+				out[0] = out[1] = out[2] = gray;
+				out[3] = To8Bits(ReadSample(row, (size_t)x * 2 + 1, depth), depth);
+				break;
+			}
+			default:
+				for (unsigned int c = 0; c < 4; c++)
+					out[c] = To8Bits(ReadSample(row, (size_t)x * 4 + c, depth), depth);
+				break;
+			}
+		}
+	}
+
+	// One pass of an interlaced image (or the whole image): its
+	// first pixel and the spacing of its pixels
+	struct Pass
+	{
+		unsigned int X;
+		unsigned int Y;
+		unsigned int StepX;
+		unsigned int StepY;
+	};
+
+	const Pass Adam7[7] =
+	{
+		{ 0, 0, 8, 8 },
+		{ 4, 0, 8, 8 },
+		{ 0, 4, 4, 8 },
+		{ 2, 0, 4, 4 },
+		{ 0, 2, 2, 4 },
+		{ 1, 0, 2, 2 },
+		{ 0, 1, 1, 2 },
+	};
+	const Pass WholeImage[1] = { { 0, 0, 1, 1 } };
+
+	inline unsigned int PassSize(unsigned int size, unsigned int start, unsigned int step)
+	{
+		return size > start ? (size - start + step - 1) / step : 0;
+	}
+
+	bool ReadHeader(const uint8_t* body, uint32_t length, PngFormat& format)
+	{
+		if (length != 13)
+			return false;
+
+		format.Width = ReadBigEndian32(body);
+		format.Height = ReadBigEndian32(body + 4);
+		format.BitDepth = body[8];
+		format.ColorType = body[9];
+		format.Interlaced = body[12] == 1;
+
+		// Compression and filter methods only have one value, and
+		// anything bigger than 16K x 16K isn't a texture
+		const unsigned int MaxSize = 16384;
+		return
+			format.Width > 0 && format.Height > 0 &&
+			format.Width <= MaxSize && format.Height <= MaxSize &&
+			IsValidDepth(format.ColorType, format.BitDepth) &&
+			body[10] == 0 && body[11] == 0 && body[12] <= 1;
+	}
+}
+
+bool PngDecoder::IsPng(const void* data, size_t size)
+{
+	return size >= sizeof(Signature) && memcmp(data, Signature, sizeof(Signature)) == 0;
+}
+
+// --------------------------------------------------------
+// Decodes a whole .PNG in memory
+//
+// - The IDAT chunks are joined (when there's more than one)
+//    and inflated in one go, straight into the filtered rows
+// - Rows are unfiltered in place, then converted into out
+// --------------------------------------------------------
+bool PngDecoder::Decode(const void* data, size_t size, Image& out)
+{
+	out = Image();
+	if (!IsPng(data, size))
+		return false;
+
+	const uint8_t* p = (const uint8_t*)data + sizeof(Signature);
+	const uint8_t* end = (const uint8_t*)data + size;
+
+	PngFormat format;
+	bool hasHeader = false;
+	std::vector<const uint8_t*> idatData;
+	std::vector<uint32_t> idatSizes;
+	size_t compressedSize = 0;
+	bool ended = false;
+
+	while (!ended && end - p >= 12)
+	{
+		uint32_t length = ReadBigEndian32(p);
+		const uint8_t* type = p + 4;
+		const uint8_t* body = p + 8;
+		if (length > (size_t)(end - p) - 12)
+			return false;
+
+		// Everything but the header has to come after it
+		if (!hasHeader && memcmp(type, "IHDR", 4) != 0)
+			return false;
+
+		if (memcmp(type, "IHDR", 4) == 0)
+		{
+			if (hasHeader || !ReadHeader(body, length, format))
+				return false;
+			hasHeader = true;
+		}
+		else if (memcmp(type, "PLTE", 4) == 0)
+		{
+			if (length % 3 != 0 || length / 3 > 256)
+				return false;
+
+			format.PaletteSize = length / 3;
+			for (unsigned int i = 0; i < format.PaletteSize; i++)
+			{
+				memcpy(format.Palette[i], body + i * 3, 3);
+				format.Palette[i][3] = 255;
+			}
+		}
+		else if (memcmp(type, "tRNS", 4) == 0)
+		{
+			if (format.ColorType == 3)
+			{
+				for (unsigned int i = 0; i < length && i < 256; i++)
+					format.Palette[i][3] = body[i];
+			}
+			else if (format.ColorType == 0 && length >= 2)
+			{
+				format.HasKey = true;
+				format.Key[0] = (uint16_t)(body[0] << 8 | body[1]);
+			}
+			else if (format.ColorType == 2 && length >= 6)
+			{
+				format.HasKey = true;
+				for (unsigned int c = 0; c < 3; c++)
+					format.Key[c] = (uint16_t)(body[c * 2] << 8 | body[c * 2 + 1]);
+			}
+		}
+		else if (memcmp(type, "IDAT", 4) == 0)
+		{
+			idatData.push_back(body);
+			idatSizes.push_back(length);
+			compressedSize += length;
+		}
+		else if (memcmp(type, "IEND", 4) == 0)
+			ended = true;
+		else if ((type[0] & 32) == 0)
+			return false;	// Unknown critical chunk
+
+		p += 12 + (size_t)length;
+	}
+
+	if (!hasHeader || idatData.empty() || (format.ColorType == 3 && format.PaletteSize == 0))
+		return false;
+
+	format.Channels = ChannelsOf(format.ColorType);
+	format.OutChannels = format.ColorType == 0 && !format.HasKey ? 1 : 4;
+
+	// Filtered rows of every pass: a filter byte, then the row
+	const Pass* passes = format.Interlaced ? Adam7 : WholeImage;
+	unsigned int passCount = format.Interlaced ? 7 : 1;
+	size_t filteredSize = 0;
+	for (unsigned int i = 0; i < passCount; i++)
+	{
+		unsigned int width = PassSize(format.Width, passes[i].X, passes[i].StepX);
+		unsigned int height = PassSize(format.Height, passes[i].Y, passes[i].StepY);
+		if (width > 0)
+			filteredSize += (size_t)height * (1 + format.GetRowBytes(width));
+	}
+
+	// Most files split the stream over many IDAT chunks
+	std::vector<uint8_t> joined;
+	const uint8_t* compressed = idatData[0];
+	if (idatData.size() > 1)
+	{
+		joined.resize(compressedSize);
+		size_t offset = 0;
+		for (size_t i = 0; i < idatData.size(); i++)
+		{
+			memcpy(&joined[offset], idatData[i], idatSizes[i]);
+			offset += idatSizes[i];
+		}
+		compressed = joined.data();
+	}
+
+	std::vector<uint8_t> filtered(filteredSize);
+	if (!Inflate(compressed, compressedSize, filtered.data(), filteredSize))
+		return false;
+
+	Image image;
+	image.Width = format.Width;
+	image.Height = format.Height;
+	image.Format = format.OutChannels == 1 ? ImageFormat::R8 : ImageFormat::RGBA8;
+	image.Pixels.resize(image.GetSize());
+
+	unsigned int stride = format.GetFilterStride();
+	std::vector<uint8_t> zeros(format.GetRowBytes(format.Width));
+	uint8_t* row = filtered.data();
+	for (unsigned int i = 0; i < passCount; i++)
+	{
+		const Pass& pass = passes[i];
+		unsigned int width = PassSize(format.Width, pass.X, pass.StepX);
+		unsigned int height = PassSize(format.Height, pass.Y, pass.StepY);
+		if (width == 0 || height == 0)
+			continue;
+
+		size_t rowBytes = format.GetRowBytes(width);
+		const uint8_t* previous = zeros.data();
+		for (unsigned int y = 0; y < height; y++)
+		{
+			if (!Unfilter(row[0], row + 1, previous, rowBytes, stride))
+				return false;
+
+			size_t targetY = (size_t)pass.Y + (size_t)y * pass.StepY;
+			uint8_t* target = &image.Pixels[targetY * image.GetRowPitch() + (size_t)pass.X * format.OutChannels];
+			ConvertRow(format, row + 1, width, target, pass.StepX);
+
+			previous = row + 1;
+			row += 1 + rowBytes;
+		}
+	}
+
+	out = std::move(image);
+	return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include "Image.h"
+
+// --------------------------------------------------------
+// Portable .PNG decoder (no WIC, so it runs on any thread and
+// any platform)
+//
+// - Reads every standard PNG: gray, gray + alpha, RGB, RGBA
+//    and palette images, 1 to 16 bits per channel, interlaced
+//    or not, with tRNS transparency
+// - Gray images without transparency stay 1 channel; every
+//    other kind becomes RGBA (16-bit channels keep their high
+//    byte)
+// - Colors are left as stored: gAMA, cHRM, sRGB and iCCP are
+//    ignored, like the shaders expect
+// - Chunk CRCs and the zlib checksum aren't checked; damaged
+//    data fails to inflate or decodes to the wrong pixels
+// --------------------------------------------------------
+namespace PngDecoder
+{
+	// Whether data starts with the PNG signature
+	bool IsPng(const void* data, size_t size);
+
+	// False if the file isn't a PNG or is malformed
+	bool Decode(const void* data, size_t size, Image& out);
+}
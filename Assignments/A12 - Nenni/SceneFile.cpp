@@ -0,0 +1,523 @@
+#include "SceneFile.h"
+#include "Vfs.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <unordered_map>
+
+using namespace DirectX;
+
+static_assert(sizeof(SceneFile::Header) % 16 == 0, "Scene header must keep the arrays after it aligned");
+
+namespace
+{
+	// Everything after the header starts on this boundary
+	const uint64_t SectionAlignment = 16;
+
+	inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	// Splits a line into whitespace separated words
+	void SplitWords(const char* p, const char* end, std::vector<std::string>& words)
+	{
+		words.clear();
+		while (p < end)
+		{
+			while (p < end && IsSpace(*p))
+				p++;
+
+			const char* start = p;
+			while (p < end && !IsSpace(*p))
+				p++;
+
+			if (p > start)
+				words.emplace_back(start, p);
+		}
+	}
+
+	// Reads count floats starting at words[index]; false unless
+	// they are all there and are numbers
+	bool ReadFloats(const std::vector<std::string>& words, size_t index, unsigned int count, float* out)
+	{
+		if (index + count > words.size())
+			return false;
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			char* end = nullptr;
+			out[i] = strtof(words[index + i].c_str(), &end);
+			if (*end != '\0')
+				return false;
+		}
+		return true;
+	}
+
+	// Light types by LIGHT_TYPE_ value
+	const char* LightTypeNames[] = { "directional", "point", "spot" };
+	const int LightTypeCount = (int)(sizeof(LightTypeNames) / sizeof(LightTypeNames[0]));
+
+	// Reads a light line (words[0] is "light"); false for unknown
+	// types or keywords
+	bool ParseLight(const std::vector<std::string>& words, Light& light)
+	{
+		light = {};
+		light.Color = XMFLOAT3(1, 1, 1);
+		light.Intensity = 1.0f;
+
+		if (words.size() < 2)
+			return false;
+		light.Type = (int)(std::find(LightTypeNames, LightTypeNames + LightTypeCount, words[1]) - LightTypeNames);
+		if (light.Type == LightTypeCount)
+			return false;
+
+		for (size_t w = 2; w < words.size();)
+		{
+			const std::string& keyword = words[w];
+			if (keyword == "direction" && ReadFloats(words, w + 1, 3, &light.Direction.x))
+				w += 4;
+			else if (keyword == "position" && ReadFloats(words, w + 1, 3, &light.Position.x))
+				w += 4;
+			else if (keyword == "color" && ReadFloats(words, w + 1, 3, &light.Color.x))
+				w += 4;
+			else if (keyword == "intensity" && ReadFloats(words, w + 1, 1, &light.Intensity))
+				w += 2;
+			else if (keyword == "range" && ReadFloats(words, w + 1, 1, &light.Range))
+				w += 2;
+			else if (keyword == "angles" && ReadFloats(words, w + 1, 2, &light.SpotInnerAngle))
+			{
+				light.SpotInnerAngle = XMConvertToRadians(light.SpotInnerAngle);
+				light.SpotOuterAngle = XMConvertToRadians(light.SpotOuterAngle);
+				w += 3;
+			}
+			else
+				return false;
+		}
+		return true;
+	}
+
+	// Index of a name in a table, adding it the first time
+	bool FindOrAddName(const std::string& name, std::vector<SceneName>& names, std::unordered_map<std::string, uint32_t>& indices, uint32_t& index)
+	{
+		if (name.size() > SceneName::MaxLength)
+			return false;
+
+		auto found = indices.find(name);
+		if (found != indices.end())
+		{
+			index = found->second;
+			return true;
+		}
+
+		SceneName entry = {};
+		memcpy(entry.Text, name.data(), name.size());
+		index = (uint32_t)names.size();
+		names.push_back(entry);
+		indices[name] = index;
+		return true;
+	}
+
+	// Every name must end inside its field
+	bool AreNamesValid(const SceneName* names, unsigned int count)
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (!memchr(names[i].Text, 0, sizeof(names[i].Text)))
+				return false;
+		}
+		return true;
+	}
+
+	bool AreIndicesValid(const uint32_t* indices, unsigned int count, unsigned int limit)
+	{
+		uint32_t largest = 0;
+		for (unsigned int i = 0; i < count; i++)
+			largest = indices[i] > largest ? indices[i] : largest;
+		return count == 0 || largest < limit;
+	}
+
+	// Every light's type is one the shaders know
+	bool AreLightsValid(const Light* lights, unsigned int count)
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (lights[i].Type < 0 || lights[i].Type >= LightTypeCount)
+				return false;
+		}
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// Checks that a mapped scene is complete and readable by
+	// this build before any of its offsets are trusted
+	// --------------------------------------------------------
+	bool IsHeaderValid(const SceneFile::Header& header, size_t fileSize)
+	{
+		if (header.Magic != SceneFile::Magic ||
+			header.Version != SceneFile::Version ||
+			header.NameLength != sizeof(SceneName) ||
+			header.FileSize != fileSize)
+			return false;
+
+		if (header.EntityCount > 0 && (header.MeshCount == 0 || header.MaterialCount == 0))
+			return false;
+
+		uint64_t meshBytes = (uint64_t)header.MeshCount * sizeof(SceneName);
+		uint64_t materialBytes = (uint64_t)header.MaterialCount * sizeof(SceneName);
+		uint64_t indexBytes = (uint64_t)header.EntityCount * sizeof(uint32_t);
+		uint64_t vectorBytes = (uint64_t)header.EntityCount * sizeof(XMFLOAT3);
+		uint64_t lightBytes = (uint64_t)header.LightCount * sizeof(Light);
+
+		return
+			header.MeshOffset % SectionAlignment == 0 &&
+			header.MaterialOffset % SectionAlignment == 0 &&
+			header.MeshIndexOffset % SectionAlignment == 0 &&
+			header.MaterialIndexOffset % SectionAlignment == 0 &&
+			header.PositionOffset % SectionAlignment == 0 &&
+			header.RotationOffset % SectionAlignment == 0 &&
+			header.ScaleOffset % SectionAlignment == 0 &&
+			header.FlagOffset % SectionAlignment == 0 &&
+			header.LightOffset % SectionAlignment == 0 &&
+			header.MeshOffset >= sizeof(SceneFile::Header) &&
+			header.MeshOffset + meshBytes <= header.MaterialOffset &&
+			header.MaterialOffset + materialBytes <= header.MeshIndexOffset &&
+			header.MeshIndexOffset + indexBytes <= header.MaterialIndexOffset &&
+			header.MaterialIndexOffset + indexBytes <= header.PositionOffset &&
+			header.PositionOffset + vectorBytes <= header.RotationOffset &&
+			header.RotationOffset + vectorBytes <= header.ScaleOffset &&
+			header.ScaleOffset + vectorBytes <= header.FlagOffset &&
+			header.FlagOffset + indexBytes <= header.LightOffset &&
+			header.LightOffset + lightBytes <= fileSize;
+	}
+
+	void AppendVector(std::string& text, const char* keyword, const XMFLOAT3& v)
+	{
+		char buffer[128];
+		snprintf(buffer, sizeof(buffer), " %s %.9g %.9g %.9g", keyword, v.x, v.y, v.z);
+		text += buffer;
+	}
+}
+
+// --------------------------------------------------------
+// Parses .scene text that is already in memory
+//
+// - Meshes and materials are added to the tables in order of
+//    first use
+// - Unknown statements, and words after a complete entity
+//    or light line, are errors, so typos don't go unnoticed
+// --------------------------------------------------------
+bool SceneFile::ParseText(const char* data, size_t size, SceneArrays& out)
+{
+	out = SceneArrays();
+
+	const char* end = data + size;
+	std::vector<std::string> words;
+	std::unordered_map<std::string, uint32_t> meshIndices;
+	std::unordered_map<std::string, uint32_t> materialIndices;
+
+	for (const char* line = data; line < end;)
+	{
+		const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+		if (!lineEnd)
+			lineEnd = end;
+
+		SplitWords(line, lineEnd, words);
+		line = lineEnd + 1;
+
+		if (words.empty() || words[0][0] == '#')
+			continue;
+
+		if (words[0] == "light")
+		{
+			Light light;
+			if (!ParseLight(words, light))
+				return false;
+			out.Lights.push_back(light);
+			continue;
+		}
+
+		if (words[0] != "entity" || words.size() < 3)
+			return false;
+
+		uint32_t mesh = 0;
+		uint32_t material = 0;
+		if (!FindOrAddName(words[1], out.Meshes, meshIndices, mesh) ||
+			!FindOrAddName(words[2], out.Materials, materialIndices, material))
+			return false;
+
+		XMFLOAT3 position(0, 0, 0);
+		XMFLOAT3 rotation(0, 0, 0);
+		XMFLOAT3 scale(1, 1, 1);
+		uint32_t flags = 0;
+		for (size_t w = 3; w < words.size();)
+		{
+			const std::string& keyword = words[w];
+			if (keyword == "static")
+			{
+				flags |= EntityStatic;
+				w++;
+			}
+			else if (keyword == "position" && ReadFloats(words, w + 1, 3, &position.x))
+				w += 4;
+			else if (keyword == "rotation" && ReadFloats(words, w + 1, 3, &rotation.x))
+			{
+				rotation = XMFLOAT3(XMConvertToRadians(rotation.x), XMConvertToRadians(rotation.y), XMConvertToRadians(rotation.z));
+				w += 4;
+			}
+			else if (keyword == "scale" && ReadFloats(words, w + 1, 3, &scale.x))
+				w += 4;
+			else if (keyword == "scale" && ReadFloats(words, w + 1, 1, &scale.x))
+			{
+				scale = XMFLOAT3(scale.x, scale.x, scale.x);
+				w += 2;
+			}
+			else
+				return false;
+		}
+
+		out.MeshIndices.push_back(mesh);
+		out.MaterialIndices.push_back(material);
+		out.Positions.push_back(position);
+		out.Rotations.push_back(rotation);
+		out.Scales.push_back(scale);
+		out.Flags.push_back(flags);
+	}
+	return true;
+}
+
+bool SceneFile::LoadText(const std::wstring& path, SceneArrays& out)
+{
+	MappedFile file;
+	ByteSpan data;
+	if (!Vfs::Read(path, file, data))
+	{
+		out = SceneArrays();
+		return false;
+	}
+	return ParseText(data.Data, data.Size, out);
+}
+
+std::string SceneFile::ToText(const SceneData& scene)
+{
+	std::string text;
+	text.reserve(((size_t)scene.EntityCount + scene.LightCount) * 128);
+	for (unsigned int i = 0; i < scene.LightCount; i++)
+	{
+		const Light& light = scene.Lights[i];
+		text += "light ";
+		text += light.Type >= 0 && light.Type < LightTypeCount ? LightTypeNames[light.Type] : "directional";
+		AppendVector(text, "direction", light.Direction);
+		AppendVector(text, "position", light.Position);
+		AppendVector(text, "color", light.Color);
+
+		char buffer[128];
+		snprintf(buffer, sizeof(buffer), " intensity %.9g range %.9g angles %.9g %.9g", light.Intensity, light.Range,
+			XMConvertToDegrees(light.SpotInnerAngle), XMConvertToDegrees(light.SpotOuterAngle));
+		text += buffer;
+		text += '\n';
+	}
+
+	for (unsigned int i = 0; i < scene.EntityCount; i++)
+	{
+		text += "entity ";
+		text += scene.Meshes[scene.MeshIndices[i]].Text;
+		text += ' ';
+		text += scene.Materials[scene.MaterialIndices[i]].Text;
+		if (scene.Flags[i] & EntityStatic)
+			text += " static";
+
+		const XMFLOAT3& rotation = scene.Rotations[i];
+		AppendVector(text, "position", scene.Positions[i]);
+		AppendVector(text, "rotation", XMFLOAT3(XMConvertToDegrees(rotation.x), XMConvertToDegrees(rotation.y), XMConvertToDegrees(rotation.z)));
+		AppendVector(text, "scale", scene.Scales[i]);
+		text += '\n';
+	}
+	return text;
+}
+
+// --------------------------------------------------------
+// Maps a .scenebin and points out at its arrays
+//
+// - The indices are the only thing checked per entity (a max
+//    over two arrays), so nothing outside the tables is read;
+//    lights are few, so their types are checked too
+// --------------------------------------------------------
+bool SceneFile::Load(const std::wstring& path, MappedFile& file, SceneData& out)
+{
+	out = SceneData();
+
+	ByteSpan data;
+	if (!Vfs::Read(path, file, data) || data.Size < sizeof(Header))
+	{
+		file.Close();
+		return false;
+	}
+
+	Header header;
+	memcpy(&header, data.Data, sizeof(header));
+	if (!IsHeaderValid(header, data.Size))
+	{
+		file.Close();
+		return false;
+	}
+
+	const SceneName* meshes = (const SceneName*)(data.Data + header.MeshOffset);
+	const SceneName* materials = (const SceneName*)(data.Data + header.MaterialOffset);
+	const uint32_t* meshIndices = (const uint32_t*)(data.Data + header.MeshIndexOffset);
+	const uint32_t* materialIndices = (const uint32_t*)(data.Data + header.MaterialIndexOffset);
+	if (!AreNamesValid(meshes, header.MeshCount) ||
+		!AreNamesValid(materials, header.MaterialCount) ||
+		!AreIndicesValid(meshIndices, header.EntityCount, header.MeshCount) ||
+		!AreIndicesValid(materialIndices, header.EntityCount, header.MaterialCount) ||
+		!AreLightsValid((const Light*)(data.Data + header.LightOffset), header.LightCount))
+	{
+		file.Close();
+		return false;
+	}
+
+	out.Meshes = meshes;
+	out.MeshCount = header.MeshCount;
+	out.Materials = materials;
+	out.MaterialCount = header.MaterialCount;
+	out.MeshIndices = meshIndices;
+	out.MaterialIndices = materialIndices;
+	out.Positions = (const XMFLOAT3*)(data.Data + header.PositionOffset);
+	out.Rotations = (const XMFLOAT3*)(data.Data + header.RotationOffset);
+	out.Scales = (const XMFLOAT3*)(data.Data + header.ScaleOffset);
+	out.Flags = (const uint32_t*)(data.Data + header.FlagOffset);
+	out.EntityCount = header.EntityCount;
+	out.Lights = (const Light*)(data.Data + header.LightOffset);
+	out.LightCount = header.LightCount;
+	return true;
+}
+
+// --------------------------------------------------------
+// Writes a .scenebin
+//
+// - Written to a temporary file first and then renamed, so
+//    an interrupted write never leaves a half-finished scene
+// --------------------------------------------------------
+bool SceneFile::Save(const std::wstring& path, const SceneData& scene)
+{
+	if (scene.EntityCount > 0 &&
+		(!scene.MeshIndices || !scene.MaterialIndices || !scene.Positions || !scene.Rotations || !scene.Scales || !scene.Flags))
+		return false;
+	if ((!scene.Meshes && scene.MeshCount > 0) || (!scene.Materials && scene.MaterialCount > 0) || (!scene.Lights && scene.LightCount > 0))
+		return false;
+	if (!AreIndicesValid(scene.MeshIndices, scene.EntityCount, scene.MeshCount) ||
+		!AreIndicesValid(scene.MaterialIndices, scene.EntityCount, scene.MaterialCount) ||
+		!AreLightsValid(scene.Lights, scene.LightCount))
+		return false;
+
+	uint64_t meshBytes = (uint64_t)scene.MeshCount * sizeof(SceneName);
+	uint64_t materialBytes = (uint64_t)scene.MaterialCount * sizeof(SceneName);
+	uint64_t indexBytes = (uint64_t)scene.EntityCount * sizeof(uint32_t);
+	uint64_t vectorBytes = (uint64_t)scene.EntityCount * sizeof(XMFLOAT3);
+	uint64_t lightBytes = (uint64_t)scene.LightCount * sizeof(Light);
+
+	Header header = {};
+	header.Magic = Magic;
+	header.Version = Version;
+	header.NameLength = sizeof(SceneName);
+	header.EntityCount = scene.EntityCount;
+	header.MeshCount = scene.MeshCount;
+	header.MaterialCount = scene.MaterialCount;
+	header.LightCount = scene.LightCount;
+	header.MeshOffset = AlignUp(sizeof(Header), SectionAlignment);
+	header.MaterialOffset = AlignUp(header.MeshOffset + meshBytes, SectionAlignment);
+	header.MeshIndexOffset = AlignUp(header.MaterialOffset + materialBytes, SectionAlignment);
+	header.MaterialIndexOffset = AlignUp(header.MeshIndexOffset + indexBytes, SectionAlignment);
+	header.PositionOffset = AlignUp(header.MaterialIndexOffset + indexBytes, SectionAlignment);
+	header.RotationOffset = AlignUp(header.PositionOffset + vectorBytes, SectionAlignment);
+	header.ScaleOffset = AlignUp(header.RotationOffset + vectorBytes, SectionAlignment);
+	header.FlagOffset = AlignUp(header.ScaleOffset + vectorBytes, SectionAlignment);
+	header.LightOffset = AlignUp(header.FlagOffset + indexBytes, SectionAlignment);
+	header.FileSize = header.LightOffset + lightBytes;
+
+	std::filesystem::path tempPath(path);
+	tempPath += L".tmp";
+
+	{
+		std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		// Each section, and the padding up to where the next starts
+		struct Section
+		{
+			const void* Data;
+			uint64_t Size;
+			uint64_t Offset;
+		};
+		const Section sections[] =
+		{
+			{ &header, sizeof(header), 0 },
+			{ scene.Meshes, meshBytes, header.MeshOffset },
+			{ scene.Materials, materialBytes, header.MaterialOffset },
+			{ scene.MeshIndices, indexBytes, header.MeshIndexOffset },
+			{ scene.MaterialIndices, indexBytes, header.MaterialIndexOffset },
+			{ scene.Positions, vectorBytes, header.PositionOffset },
+			{ scene.Rotations, vectorBytes, header.RotationOffset },
+			{ scene.Scales, vectorBytes, header.ScaleOffset },
+			{ scene.Flags, indexBytes, header.FlagOffset },
+			{ scene.Lights, lightBytes, header.LightOffset },
+		};
+
+		const char padding[SectionAlignment] = {};
+		uint64_t written = 0;
+		for (const Section& section : sections)
+		{
+			file.write(padding, section.Offset - written);
+			if (section.Size > 0)
+				file.write((const char*)section.Data, section.Size);
+			written = section.Offset + section.Size;
+		}
+
+		if (!file)
+		{
+			file.close();
+			std::error_code ignored;
+			std::filesystem::remove(tempPath, ignored);
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
+
+SceneData SceneFile::GetData(const SceneArrays& scene)
+{
+	SceneData data;
+	data.Meshes = scene.Meshes.data();
+	data.MeshCount = (unsigned int)scene.Meshes.size();
+	data.Materials = scene.Materials.data();
+	data.MaterialCount = (unsigned int)scene.Materials.size();
+	data.MeshIndices = scene.MeshIndices.data();
+	data.MaterialIndices = scene.MaterialIndices.data();
+	data.Positions = scene.Positions.data();
+	data.Rotations = scene.Rotations.data();
+	data.Scales = scene.Scales.data();
+	data.Flags = scene.Flags.data();
+	data.EntityCount = (unsigned int)scene.MeshIndices.size();
+	data.Lights = scene.Lights.data();
+	data.LightCount = (unsigned int)scene.Lights.size();
+	return data;
+}
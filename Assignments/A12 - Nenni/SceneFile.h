@@ -0,0 +1,155 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Lights.h"
+#include "MappedFile.h"
+
+// --------------------------------------------------------
+// Name of a mesh or material a scene refers to, fixed size so
+// the .scenebin can store it as is
+// - Longer names don't fit, so the text form rejects them
+// --------------------------------------------------------
+struct SceneName
+{
+	static const unsigned int MaxLength = 127;
+
+	char Text[MaxLength + 1];
+};
+
+// --------------------------------------------------------
+// The entities of a scene as parallel arrays (one entry per
+// entity in each), either pointing into a memory mapped
+// .scenebin or at a SceneArrays
+//
+// - Meshes and materials are listed once; entities refer to
+//    them by index
+// - Rotations are pitch/yaw/roll in radians
+// - Flags are SceneFile::EntityStatic and so on, or'd together
+// - Lights are a separate list, as the shaders take them
+// --------------------------------------------------------
+struct SceneData
+{
+	const SceneName* Meshes = nullptr;
+	unsigned int MeshCount = 0;
+	const SceneName* Materials = nullptr;
+	unsigned int MaterialCount = 0;
+
+	const uint32_t* MeshIndices = nullptr;
+	const uint32_t* MaterialIndices = nullptr;
+	const DirectX::XMFLOAT3* Positions = nullptr;
+	const DirectX::XMFLOAT3* Rotations = nullptr;
+	const DirectX::XMFLOAT3* Scales = nullptr;
+	const uint32_t* Flags = nullptr;
+	unsigned int EntityCount = 0;
+
+	const Light* Lights = nullptr;
+	unsigned int LightCount = 0;
+};
+
+// --------------------------------------------------------
+// A scene that owns its arrays (parsed from text, or built
+// in code)
+// --------------------------------------------------------
+struct SceneArrays
+{
+	std::vector<SceneName> Meshes;
+	std::vector<SceneName> Materials;
+
+	std::vector<uint32_t> MeshIndices;
+	std::vector<uint32_t> MaterialIndices;
+	std::vector<DirectX::XMFLOAT3> Positions;
+	std::vector<DirectX::XMFLOAT3> Rotations;
+	std::vector<DirectX::XMFLOAT3> Scales;
+	std::vector<uint32_t> Flags;
+
+	std::vector<Light> Lights;
+};
+
+// --------------------------------------------------------
+// Scene files: which meshes and materials the entities use,
+// where they are, and the lights
+//
+// - .scene is the text form, for editing by hand:
+//
+//      # Comment
+//      entity <mesh> <material> [static] [position x y z]
+//             [rotation pitch yaw roll] [scale x y z | scale s]
+//      light <directional | point | spot> [direction x y z]
+//            [position x y z] [color r g b] [intensity i]
+//            [range r] [angles inner outer]
+//
+//    one entity or light per line; rotations and spot angles
+//    are in degrees, and what isn't given is 0 (or a scale,
+//    color or intensity of 1)
+// - Lights keep their order: the game shades the first
+//    SHADED_LIGHT_COUNT per pixel, and the rest only reach
+//    the scene through the light probes
+// - Static entities never move, so light can be baked around
+//    them (see LightProbes); the rest are free to
+// - .scenebin is the binary form the asset cooker writes for
+//    each .scene: a header, the name tables and then one array
+//    per field (structure of arrays), 16-byte aligned, so
+//    loading is a memory map and a bounds check, with nothing
+//    parsed per entity
+// - Mesh and material names are only names; the game decides
+//    what they refer to
+// --------------------------------------------------------
+namespace SceneFile
+{
+	const uint32_t Magic = 0x4E454353; // "SCEN"
+
+	// Bump whenever the stored data changes so old scenes re-cook
+	const uint32_t Version = 3;
+
+	// Entity flags
+	const uint32_t EntityStatic = 1 << 0;
+
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t NameLength;	// sizeof(SceneName) when written
+		uint32_t EntityCount;
+
+		uint32_t MeshCount;
+		uint32_t MaterialCount;
+		uint64_t FileSize;
+
+		uint64_t MeshOffset;
+		uint64_t MaterialOffset;
+		uint64_t MeshIndexOffset;
+		uint64_t MaterialIndexOffset;
+		uint64_t PositionOffset;
+		uint64_t RotationOffset;
+		uint64_t ScaleOffset;
+		uint64_t FlagOffset;
+
+		uint64_t LightOffset;
+		uint32_t LightCount;
+		uint32_t Reserved;
+	};
+
+	// Parses .scene text, replacing out; false (with out left
+	// partly filled) at the first malformed line
+	bool ParseText(const char* data, size_t size, SceneArrays& out);
+	bool LoadText(const std::wstring& path, SceneArrays& out);
+
+	// The .scene text of a scene (which parses back to the same
+	// scene, give or take float rounding of the angles)
+	std::string ToText(const SceneData& scene);
+
+	// Maps a .scenebin through Vfs
+	// - out points into the mounted pack, or into file when the
+	//    .scenebin is a loose file
+	bool Load(const std::wstring& path, MappedFile& file, SceneData& out);
+
+	// Writes (or replaces) a .scenebin
+	bool Save(const std::wstring& path, const SceneData& scene);
+
+	// Points at the arrays of a scene
+	SceneData GetData(const SceneArrays& scene);
+}
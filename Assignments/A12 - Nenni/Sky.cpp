@@ -1,7 +1,7 @@
 #include "Sky.h"
-#include "WICTextureLoader.h"
+#include "DdsFile.h"
 
-Sky::Sky(const wchar_t* right, const wchar_t* left, const wchar_t* up, const wchar_t* down, const wchar_t* front, const wchar_t* back, shared_ptr<Mesh> mesh, Microsoft::WRL::ComPtr<ID3D11VertexShader> inSkyVS, Microsoft::WRL::ComPtr<ID3D11PixelShader> inSkyPS, Microsoft::WRL::ComPtr<ID3D11SamplerState> inSamplerOptions)
+Sky::Sky(AssetManager& assets, const wstring& right, const wstring& left, const wstring& up, const wstring& down, const wstring& front, const wstring& back, const wstring& environmentFile, shared_ptr<MeshAsset> mesh, Microsoft::WRL::ComPtr<ID3D11VertexShader> inSkyVS, Microsoft::WRL::ComPtr<ID3D11PixelShader> inSkyPS, Microsoft::WRL::ComPtr<ID3D11SamplerState> inSamplerOptions)
 {
 	skyMesh = mesh;
 	skyVS = inSkyVS;
@@ -10,7 +10,19 @@ Sky::Sky(const wchar_t* right, const wchar_t* left, const wchar_t* up, const wch
 
 	InitRenderState();
 
-	skySRV = CreateCubemap(right, left, up, down, front, back);
+	// Until the faces are in, the clear color shows instead
+	skyTexture = assets.LoadTexture({ right, left, up, down, front, back }, CreateCubemap, nullptr);
+
+	// Already prefiltered by the cooker, so it's only a copy
+	// out of the pack (no job that could outlive the mount)
+	PrefilteredEnvironment environment;
+	specularMipCount = 0;
+	if (IblPrefilter::Load(environmentFile, environment))
+	{
+		irradiance = environment.Irradiance;
+		specularTexture = CreateSpecularCubemap(environment);
+		specularMipCount = specularTexture ? environment.SpecularMipCount : 0;
+	}
 }
 
 Sky::~Sky()
@@ -19,6 +31,9 @@ Sky::~Sky()
 
 void Sky::Draw(shared_ptr<Camera> cam)
 {
+	if (!skyTexture->Use())
+		return;
+
 	Graphics::Context->RSSetState(rasterState.Get());
 	Graphics::Context->OMSetDepthStencilState(depthState.Get(), 0);
 
@@ -28,17 +43,24 @@ void Sky::Draw(shared_ptr<Camera> cam)
 	struct SkyVSData {
 		XMFLOAT4X4 view;
 		XMFLOAT4X4 proj;
+		XMFLOAT3 positionCenter;
+		float padding0;
+		XMFLOAT3 positionExtent;
+		float padding1;
 	};
 
 	SkyVSData data{};
 	data.view = cam->GetViewMatrix();
 	data.proj = cam->GetProjectionMatrix();
+	shared_ptr<Mesh> mesh = skyMesh->Use();
+	data.positionCenter = mesh->GetQuantization().Center;
+	data.positionExtent = mesh->GetQuantization().Extent;
 	Graphics::FillAndBindNextConstantBuffer(&data, sizeof(SkyVSData), D3D11_VERTEX_SHADER, 0);
 
-	Graphics::Context->PSSetShaderResources(0, 1, skySRV.GetAddressOf());
+	Graphics::Context->PSSetShaderResources(0, 1, skyTexture->Get().GetAddressOf());
 	Graphics::Context->PSSetSamplers(0, 1, samplerOptions.GetAddressOf());
 
-	skyMesh->SetBuffersAndDraw();
+	mesh->SetBuffersAndDraw();
 
 	Graphics::Context->RSSetState(0);
 	Graphics::Context->OMSetDepthStencilState(0, 0);
@@ -46,7 +68,18 @@ void Sky::Draw(shared_ptr<Camera> cam)
 
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::GetSkyTexture()
 {
-	return skySRV;
+	return skyTexture->Get();
+}
+
+bool Sky::GetEnvironment(SphericalHarmonics9& outIrradiance, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& outSpecular, unsigned int& outSpecularMipCount)
+{
+	if (!specularTexture)
+		return false;
+
+	outIrradiance = irradiance;
+	outSpecular = specularTexture;
+	outSpecularMipCount = specularMipCount;
+	return true;
 }
 
 void Sky::InitRenderState()
@@ -81,24 +114,19 @@ void Sky::InitRenderState()
 //   ComPtr called device.  Make any adjustments necessary for
 //   your own implementation.
 // --------------------------------------------------------
-Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(const wchar_t* right, const wchar_t* left, const wchar_t* up, const wchar_t* down, const wchar_t* front, const wchar_t* back)
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(const vector<Image>& faces)
 {
-	// Load the 6 textures into an array.
-	// - We need references to the TEXTURES, not SHADER RESOURCE VIEWS!
+	// The 6 faces have already been decoded (see AssetManager)
 	// - Explicitly NOT generating mipmaps, as we don't need them for the sky!
 	// - Order matters here!  +X, -X, +Y, -Y, +Z, -Z
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> textures[6] = {};
-	CreateWICTextureFromFile(Graphics::Device.Get(), right, (ID3D11Resource**)textures[0].GetAddressOf(), 0);
-	CreateWICTextureFromFile(Graphics::Device.Get(), left, (ID3D11Resource**)textures[1].GetAddressOf(), 0);
-	CreateWICTextureFromFile(Graphics::Device.Get(), up, (ID3D11Resource**)textures[2].GetAddressOf(), 0);
-	CreateWICTextureFromFile(Graphics::Device.Get(), down, (ID3D11Resource**)textures[3].GetAddressOf(), 0);
-	CreateWICTextureFromFile(Graphics::Device.Get(), front, (ID3D11Resource**)textures[4].GetAddressOf(), 0);
-	CreateWICTextureFromFile(Graphics::Device.Get(), back, (ID3D11Resource**)textures[5].GetAddressOf(), 0);
-
-	// We'll assume all of the textures are the same color format and resolution,
-	// so get the description of the first texture
-	D3D11_TEXTURE2D_DESC faceDesc = {};
-	textures[0]->GetDesc(&faceDesc);
+	// - No cube map without all 6, in the same size and format
+	if (faces.size() != 6)
+		return 0;
+	for (const Image& face : faces)
+	{
+		if (face.Width != faces[0].Width || face.Height != faces[0].Height || face.Format != faces[0].Format)
+			return 0;
+	}
 
 	// Describe the resource for the cube map, which is simply 
 	// a "texture 2d array" with the TEXTURECUBE flag set.  
@@ -108,40 +136,30 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(const wchar_
 	cubeDesc.ArraySize = 6;            // Cube map!
 	cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE; // We'll be using as a texture in a shader
 	cubeDesc.CPUAccessFlags = 0;       // No read back
-	cubeDesc.Format = faceDesc.Format; // Match the loaded texture's color format
-	cubeDesc.Width = faceDesc.Width;   // Match the size
-	cubeDesc.Height = faceDesc.Height; // Match the size
+	cubeDesc.Format = (DXGI_FORMAT)DdsFile::GetDxgiFormat(faces[0].Format); // Match the faces (decoded or block compressed)
+	cubeDesc.Width = faces[0].Width;   // Match the size
+	cubeDesc.Height = faces[0].Height; // Match the size
 	cubeDesc.MipLevels = 1;            // Only need 1
 	cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE; // This should be treated as a CUBE, not 6 separate textures
-	cubeDesc.Usage = D3D11_USAGE_DEFAULT; // Standard usage
+	cubeDesc.Usage = D3D11_USAGE_IMMUTABLE; // Never changes once created
 	cubeDesc.SampleDesc.Count = 1;
 	cubeDesc.SampleDesc.Quality = 0;
 
-	// Create the final texture resource to hold the cube map
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> cubeMapTexture;
-	Graphics::Device->CreateTexture2D(&cubeDesc, 0, cubeMapTexture.GetAddressOf());
-
-	// Loop through the individual face textures and copy them,
-	// one at a time, to the cube map texure
+	// One subresource per face (a single mip each), so the device
+	// fills the cube map as it creates it, without the context
+	D3D11_SUBRESOURCE_DATA faceData[6] = {};
 	for (int i = 0; i < 6; i++)
 	{
-		// Calculate the subresource position to copy into
-		unsigned int subresource = D3D11CalcSubresource(
-			0,  // Which mip (zero, since there's only one)
-			i,  // Which array element?
-			1); // How many mip levels are in the texture?
-
-		// Copy from one resource (texture) to another
-		Graphics::Context->CopySubresourceRegion(
-			cubeMapTexture.Get(),  // Destination resource
-			subresource,           // Dest subresource index (one of the array elements)
-			0, 0, 0,               // XYZ location of copy
-			textures[i].Get(),     // Source resource
-			0,                     // Source subresource index (we're assuming there's only one)
-			0);                    // Source subresource "box" of data to copy (zero means the whole thing)
+		faceData[i].pSysMem = faces[i].Pixels.data();
+		faceData[i].SysMemPitch = (UINT)faces[i].GetRowPitch();
 	}
 
-	// At this point, all of the faces have been copied into the 
+	// Create the final texture resource to hold the cube map
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> cubeMapTexture;
+	if (FAILED(Graphics::Device->CreateTexture2D(&cubeDesc, faceData, cubeMapTexture.GetAddressOf())))
+		return 0;
+
+	// At this point, all of the faces are in the 
 	// cube map texture, so we can describe a shader resource view for it
 	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Format = cubeDesc.Format;         // Same format as texture
@@ -156,3 +174,45 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(const wchar_
 	// Send back the SRV, which is what we need for our shaders
 	return cubeSRV;
 }
+
+// --------------------------------------------------------
+// Same as CreateCubemap(), but with every mip of every face
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateSpecularCubemap(const PrefilteredEnvironment& environment)
+{
+	if (environment.SpecularMipCount == 0 || environment.Specular.size() != 6 * environment.SpecularMipCount)
+		return 0;
+
+	D3D11_TEXTURE2D_DESC cubeDesc = {};
+	cubeDesc.ArraySize = 6;
+	cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	cubeDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	cubeDesc.Width = environment.SpecularSize;
+	cubeDesc.Height = environment.SpecularSize;
+	cubeDesc.MipLevels = environment.SpecularMipCount;
+	cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+	cubeDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	cubeDesc.SampleDesc.Count = 1;
+
+	// Already in subresource order: each face's mips in turn
+	vector<D3D11_SUBRESOURCE_DATA> subresources(environment.Specular.size());
+	for (size_t i = 0; i < subresources.size(); i++)
+	{
+		subresources[i].pSysMem = environment.Specular[i].Pixels.data();
+		subresources[i].SysMemPitch = (UINT)environment.Specular[i].GetRowPitch();
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> cubeMapTexture;
+	if (FAILED(Graphics::Device->CreateTexture2D(&cubeDesc, subresources.data(), cubeMapTexture.GetAddressOf())))
+		return 0;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = cubeDesc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+	srvDesc.TextureCube.MipLevels = cubeDesc.MipLevels;
+	srvDesc.TextureCube.MostDetailedMip = 0;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cubeSRV;
+	Graphics::Device->CreateShaderResourceView(cubeMapTexture.Get(), &srvDesc, cubeSRV.GetAddressOf());
+	return cubeSRV;
+}
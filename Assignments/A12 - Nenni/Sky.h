@@ -2,6 +2,8 @@
 
 #include "Mesh.h"
 #include "Camera.h"
+#include "AssetManager.h"
+#include "IblPrefilter.h"
 
 #include <wrl/client.h>
 
@@ -10,8 +12,14 @@ using namespace std;
 class Sky
 {
 public:
-	Sky(const wchar_t* right, const wchar_t* left, const wchar_t* up, const wchar_t* down, const wchar_t* front, const wchar_t* back,
-		shared_ptr<Mesh> mesh, Microsoft::WRL::ComPtr<ID3D11VertexShader> inSkyVS, Microsoft::WRL::ComPtr<ID3D11PixelShader> inSkyPS, Microsoft::WRL::ComPtr<ID3D11SamplerState> inSamplerOptions);
+	// The faces are loaded by assets; the sky isn't drawn
+	// until all 6 are
+	// - Its image based lighting is read from environmentFile,
+	//    prefiltered from the same faces by the cooker (see
+	//    IblPrefilter)
+	Sky(AssetManager& assets, const wstring& right, const wstring& left, const wstring& up, const wstring& down, const wstring& front, const wstring& back,
+		const wstring& environmentFile,
+		shared_ptr<MeshAsset> mesh, Microsoft::WRL::ComPtr<ID3D11VertexShader> inSkyVS, Microsoft::WRL::ComPtr<ID3D11PixelShader> inSkyPS, Microsoft::WRL::ComPtr<ID3D11SamplerState> inSamplerOptions);
 
 	~Sky();
 
@@ -19,27 +27,32 @@ public:
 
 	Microsoft::WRL::ComPtr< ID3D11ShaderResourceView> GetSkyTexture();
 
+	// The sky's diffuse light (SH irradiance) and prefiltered
+	// specular cube map; false if the file couldn't be read
+	bool GetEnvironment(SphericalHarmonics9& irradiance, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& specular, unsigned int& specularMipCount);
+
 private:
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerOptions;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> skySRV;
+	shared_ptr<TextureAsset> skyTexture;
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> depthState;
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> rasterState;
 
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> skyPS;
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> skyVS;
 
-	shared_ptr<Mesh> skyMesh;
+	shared_ptr<MeshAsset> skyMesh;
+
+	SphericalHarmonics9 irradiance;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> specularTexture;
+	unsigned int specularMipCount;
 
 	void InitRenderState();
 
-// Helper for creating a cubemap from 6 individual textures
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(
-		const wchar_t* right,
-		const wchar_t* left,
-		const wchar_t* up,
-		const wchar_t* down,
-		const wchar_t* front,
-		const wchar_t* back);
+// Helper for creating a cubemap from 6 individual textures (+X, -X, +Y, -Y, +Z, -Z files)
+	static Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(const vector<Image>& faces);
+
+	// The prefiltered specular cube map, with all its mips
+	static Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateSpecularCubemap(const PrefilteredEnvironment& environment);
 
 };
 
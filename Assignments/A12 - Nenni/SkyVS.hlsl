@@ -4,12 +4,16 @@ cbuffer ExternalData : register(b0)
 {
     float4x4 view;
     float4x4 projection;
+    float3 positionCenter;
+    float3 positionExtent;
 }
 
 VertexToPixel_Sky main(VertexShaderInput input)
 {
     VertexToPixel_Sky output;
     
+    float3 localPosition = DequantizePosition(input.localPosition, positionCenter, positionExtent);
+    
     float4x4 viewNoTranslation = view;
     
     viewNoTranslation._14 = 0;
@@ -17,11 +21,11 @@ VertexToPixel_Sky main(VertexShaderInput input)
     viewNoTranslation._34 = 0;
     
     float4x4 vp = mul(projection, viewNoTranslation);
-    output.screenPosition = mul(vp, float4(input.localPosition, 1.0f));
+    output.screenPosition = mul(vp, float4(localPosition, 1.0f));
     
     output.screenPosition.z = output.screenPosition.w;
     
-    output.sampleDir = input.localPosition;
+    output.sampleDir = localPosition;
     
     return output;
 
@@ -0,0 +1,84 @@
+#include "SphericalHarmonics.h"
+
+namespace
+{
+	// Normalization of each basis function
+	const float Band0 = 0.282095f;
+	const float Band1 = 0.488603f;
+	const float Band2 = 1.092548f;
+	const float Band2Zonal = 0.315392f;
+	const float Band2Sectoral = 0.546274f;
+
+	// Cosine lobe convolution of each band, divided by pi
+	// (pi, 2pi/3 and pi/4 before)
+	const float CosineBands[3] = { 1.0f, 2.0f / 3.0f, 0.25f };
+}
+
+void SphericalHarmonics::EvaluateBasis(float x, float y, float z, float basis[CoefficientCount])
+{
+	basis[0] = Band0;
+	basis[1] = Band1 * y;
+	basis[2] = Band1 * z;
+	basis[3] = Band1 * x;
+	basis[4] = Band2 * x * y;
+	basis[5] = Band2 * y * z;
+	basis[6] = Band2Zonal * (3.0f * z * z - 1.0f);
+	basis[7] = Band2 * x * z;
+	basis[8] = Band2Sectoral * (x * x - y * y);
+}
+
+void SphericalHarmonics::AddSample(SphericalHarmonics9& sh, const XMFLOAT3& direction, const XMFLOAT3& color, float weight)
+{
+	float basis[CoefficientCount];
+	EvaluateBasis(direction.x, direction.y, direction.z, basis);
+	for (unsigned int i = 0; i < CoefficientCount; i++)
+	{
+		sh.Coefficients[i].x += color.x * basis[i] * weight;
+		sh.Coefficients[i].y += color.y * basis[i] * weight;
+		sh.Coefficients[i].z += color.z * basis[i] * weight;
+	}
+}
+
+SphericalHarmonics9 SphericalHarmonics::ToIrradiance(const SphericalHarmonics9& radiance)
+{
+	SphericalHarmonics9 irradiance;
+	for (unsigned int i = 0; i < CoefficientCount; i++)
+	{
+		float band = CosineBands[i == 0 ? 0 : i < 4 ? 1 : 2];
+		irradiance.Coefficients[i] = XMFLOAT3(radiance.Coefficients[i].x * band, radiance.Coefficients[i].y * band, radiance.Coefficients[i].z * band);
+	}
+	return irradiance;
+}
+
+SphericalHarmonics9 SphericalHarmonics::ToRadiance(const SphericalHarmonics9& irradiance)
+{
+	SphericalHarmonics9 radiance;
+	for (unsigned int i = 0; i < CoefficientCount; i++)
+	{
+		float band = 1.0f / CosineBands[i == 0 ? 0 : i < 4 ? 1 : 2];
+		radiance.Coefficients[i] = XMFLOAT3(irradiance.Coefficients[i].x * band, irradiance.Coefficients[i].y * band, irradiance.Coefficients[i].z * band);
+	}
+	return radiance;
+}
+
+SphericalHarmonics9 SphericalHarmonics::Constant(const XMFLOAT3& color)
+{
+	SphericalHarmonics9 sh;
+	sh.Coefficients[0] = XMFLOAT3(color.x / Band0, color.y / Band0, color.z / Band0);
+	return sh;
+}
+
+XMFLOAT3 SphericalHarmonics::Evaluate(const SphericalHarmonics9& sh, const XMFLOAT3& direction)
+{
+	float basis[CoefficientCount];
+	EvaluateBasis(direction.x, direction.y, direction.z, basis);
+
+	XMFLOAT3 color(0, 0, 0);
+	for (unsigned int i = 0; i < CoefficientCount; i++)
+	{
+		color.x += sh.Coefficients[i].x * basis[i];
+		color.y += sh.Coefficients[i].y * basis[i];
+		color.z += sh.Coefficients[i].z * basis[i];
+	}
+	return color;
+}
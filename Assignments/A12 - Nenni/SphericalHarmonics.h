@@ -0,0 +1,49 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// RGB light over all directions as 9 spherical harmonics
+// coefficients (bands 0 to 2), enough for diffuse lighting
+// --------------------------------------------------------
+struct SphericalHarmonics9
+{
+	XMFLOAT3 Coefficients[9] = {};
+};
+
+// --------------------------------------------------------
+// Building and evaluating spherical harmonics
+//
+// - Coefficients are in the usual real basis order: 1, y, z,
+//    x, xy, yz, 3z^2 - 1, xz, x^2 - y^2 (Pixel.hlsli evaluates
+//    the same order)
+// - Project radiance with AddSample(), then ToIrradiance()
+//    turns it into what a white Lambertian surface facing each
+//    direction reflects
+// --------------------------------------------------------
+namespace SphericalHarmonics
+{
+	const unsigned int CoefficientCount = 9;
+
+	// Basis functions at a unit direction
+	void EvaluateBasis(float x, float y, float z, float basis[CoefficientCount]);
+
+	// Adds color coming from a unit direction, weighted (by the
+	// solid angle it covers, for a projection)
+	void AddSample(SphericalHarmonics9& sh, const XMFLOAT3& direction, const XMFLOAT3& color, float weight);
+
+	// Convolves radiance with the cosine lobe and divides by pi,
+	// so Evaluate() at a normal gives the diffuse light there
+	SphericalHarmonics9 ToIrradiance(const SphericalHarmonics9& radiance);
+
+	// The inverse: radiance (bands 0 to 2 of it) that would give
+	// this irradiance, e.g. to look up the sky along a ray
+	SphericalHarmonics9 ToRadiance(const SphericalHarmonics9& irradiance);
+
+	// The same color in every direction
+	SphericalHarmonics9 Constant(const XMFLOAT3& color);
+
+	XMFLOAT3 Evaluate(const SphericalHarmonics9& sh, const XMFLOAT3& direction);
+}
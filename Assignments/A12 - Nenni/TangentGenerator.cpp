@@ -0,0 +1,444 @@
+#include "TangentGenerator.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TANGENT_GENERATOR_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	// Fewest triangles worth a chunk of their own, and the most
+	// chunks (so partial buffers) a mesh is ever split into
+	// - The chunk count only depends on the triangle count, which
+	//    is what keeps the result independent of the thread count
+	const unsigned int MinChunkTriangles = 16384;
+	const unsigned int MaxChunks = 16;
+
+	// Vertices per job when summing the partials
+	const unsigned int VertexBlockSize = 16384;
+
+	// A UV triangle is degenerate when its (doubled, signed) area
+	// is this small relative to the products it's made of, which
+	// catches both identical UVs and catastrophic cancellation
+	const float DegenerateUVEpsilon = 1e-6f;
+
+	// Tangents shorter than this (after removing the normal part)
+	// are treated as missing
+	const float MinTangentLength = 1e-12f;
+
+	// Distance between two vertices, in floats (for gathering normals)
+	const size_t VertexStride = sizeof(Vertex) / sizeof(float);
+
+	// --------------------------------------------------------
+	// Four floats processed together: SSE when available,
+	// plain loops otherwise (same results either way)
+	// --------------------------------------------------------
+#ifdef TANGENT_GENERATOR_SSE
+	struct Float4
+	{
+		__m128 v;
+	};
+
+	inline Float4 Load(const float* lanes) { return { _mm_loadu_ps(lanes) }; }
+	inline Float4 Gather(const float* p, const size_t* i) { return { _mm_setr_ps(p[i[0]], p[i[1]], p[i[2]], p[i[3]]) }; }
+	inline Float4 Splat(float a) { return { _mm_set1_ps(a) }; }
+	inline void Store(float* lanes, Float4 a) { _mm_storeu_ps(lanes, a.v); }
+	inline Float4 operator+(Float4 a, Float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+	inline Float4 operator-(Float4 a, Float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+	inline Float4 operator*(Float4 a, Float4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+	inline Float4 operator/(Float4 a, Float4 b) { return { _mm_div_ps(a.v, b.v) }; }
+	inline Float4 Sqrt(Float4 a) { return { _mm_sqrt_ps(a.v) }; }
+
+	// value where a > b, zero elsewhere (including where a is NaN)
+	inline Float4 SelectGreater(Float4 a, Float4 b, Float4 value) { return { _mm_and_ps(_mm_cmpgt_ps(a.v, b.v), value.v) }; }
+
+	inline void Transpose(Float4& a, Float4& b, Float4& c, Float4& d) { _MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v); }
+#else
+	struct Float4
+	{
+		float v[4];
+	};
+
+	template<typename Op>
+	inline Float4 Map(Float4 a, Float4 b, Op op)
+	{
+		Float4 r;
+		for (int i = 0; i < 4; i++)
+			r.v[i] = op(a.v[i], b.v[i]);
+		return r;
+	}
+
+	inline Float4 Load(const float* lanes) { return { { lanes[0], lanes[1], lanes[2], lanes[3] } }; }
+	inline Float4 Gather(const float* p, const size_t* i) { return { { p[i[0]], p[i[1]], p[i[2]], p[i[3]] } }; }
+	inline Float4 Splat(float a) { return { { a, a, a, a } }; }
+	inline void Store(float* lanes, Float4 a) { for (int i = 0; i < 4; i++) lanes[i] = a.v[i]; }
+	inline Float4 operator+(Float4 a, Float4 b) { return Map(a, b, [](float x, float y) { return x + y; }); }
+	inline Float4 operator-(Float4 a, Float4 b) { return Map(a, b, [](float x, float y) { return x - y; }); }
+	inline Float4 operator*(Float4 a, Float4 b) { return Map(a, b, [](float x, float y) { return x * y; }); }
+	inline Float4 operator/(Float4 a, Float4 b) { return Map(a, b, [](float x, float y) { return x / y; }); }
+	inline Float4 Sqrt(Float4 a) { return Map(a, a, [](float x, float) { return sqrtf(x); }); }
+
+	inline Float4 SelectGreater(Float4 a, Float4 b, Float4 value)
+	{
+		Float4 r;
+		for (int i = 0; i < 4; i++)
+			r.v[i] = a.v[i] > b.v[i] ? value.v[i] : 0.0f;
+		return r;
+	}
+
+	inline void Transpose(Float4& a, Float4& b, Float4& c, Float4& d)
+	{
+		Float4 rows[4] = { a, b, c, d };
+		for (int i = 0; i < 4; i++)
+		{
+			a.v[i] = rows[i].v[0];
+			b.v[i] = rows[i].v[1];
+			c.v[i] = rows[i].v[2];
+			d.v[i] = rows[i].v[3];
+		}
+	}
+#endif
+
+	inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	inline XMFLOAT3 ProjectOffNormal(const XMFLOAT3& v, const XMFLOAT3& n)
+	{
+		float d = Dot(n, v);
+		return XMFLOAT3(v.x - n.x * d, v.y - n.y * d, v.z - n.z * d);
+	}
+
+	// Any unit vector perpendicular to the normal, for vertices
+	// whose triangles all had degenerate UVs
+	XMFLOAT3 PerpendicularTangent(const XMFLOAT3& normal)
+	{
+		XMFLOAT3 axis = fabsf(normal.x) < 0.9f ? XMFLOAT3(1, 0, 0) : XMFLOAT3(0, 1, 0);
+		XMFLOAT3 t = ProjectOffNormal(axis, normal);
+		float length = sqrtf(Dot(t, t));
+		return XMFLOAT3(t.x / length, t.y / length, t.z / length);
+	}
+
+	// Removes the normal's part of a summed tangent and normalizes it
+	XMFLOAT3 FinishTangent(const XMFLOAT3& sum, const XMFLOAT3& normal)
+	{
+		XMFLOAT3 t = ProjectOffNormal(sum, normal);
+		float lengthSquared = Dot(t, t);
+		if (!(lengthSquared > MinTangentLength * MinTangentLength))
+			return PerpendicularTangent(normal);
+
+		float length = sqrtf(lengthSquared);
+		return XMFLOAT3(t.x / length, t.y / length, t.z / length);
+	}
+
+	// --------------------------------------------------------
+	// One contiguous run of triangles and the tangents it adds
+	// to the vertices [MinVertex, MaxVertex]
+	// - Sums holds x, y, z and a spare lane for each vertex, so
+	//    FinishBlock loads a whole tangent with one 4-wide load
+	// --------------------------------------------------------
+	struct TriangleChunk
+	{
+		unsigned int FirstTriangle = 0;
+		unsigned int TriangleCount = 0;
+		unsigned int MinVertex = 0;
+		unsigned int MaxVertex = 0;
+		std::vector<float> Sums;
+	};
+
+	// --------------------------------------------------------
+	// Adds the tangents of one chunk's triangles into its sums
+	//
+	// - One triangle at a time, with GenerateScalar's math: the
+	//    few operations per triangle are cheap next to loading
+	//    its vertices and adding to their sums, so SIMD (4
+	//    triangles at a time, either way round) measured no
+	//    faster here
+	// --------------------------------------------------------
+	template<TangentMode Mode>
+	void AccumulateChunk(TriangleChunk& chunk, const Vertex* vertices, const unsigned int* indices)
+	{
+		const unsigned int* tris = indices + (size_t)chunk.FirstTriangle * 3;
+		unsigned int triCount = chunk.TriangleCount;
+
+		unsigned int minVertex = ~0u;
+		unsigned int maxVertex = 0;
+		for (unsigned int i = 0; i < triCount * 3; i++)
+		{
+			minVertex = std::min(minVertex, tris[i]);
+			maxVertex = std::max(maxVertex, tris[i]);
+		}
+		chunk.MinVertex = minVertex;
+		chunk.MaxVertex = maxVertex;
+		chunk.Sums.assign(((size_t)maxVertex - minVertex + 1) * 4, 0.0f);
+		float* sums = &chunk.Sums[0] - (size_t)minVertex * 4;
+
+		for (unsigned int t = 0; t < triCount; t++)
+		{
+			const unsigned int* tri = tris + (size_t)t * 3;
+			const Vertex& v0 = vertices[tri[0]];
+			const Vertex& v1 = vertices[tri[1]];
+			const Vertex& v2 = vertices[tri[2]];
+
+			// Edges and UV differences, relative to the first corner
+			float x1 = v1.Position.x - v0.Position.x;
+			float y1 = v1.Position.y - v0.Position.y;
+			float z1 = v1.Position.z - v0.Position.z;
+			float x2 = v2.Position.x - v0.Position.x;
+			float y2 = v2.Position.y - v0.Position.y;
+			float z2 = v2.Position.z - v0.Position.z;
+			float s1 = v1.UV.x - v0.UV.x;
+			float t1 = v1.UV.y - v0.UV.y;
+			float s2 = v2.UV.x - v0.UV.x;
+			float t2 = v2.UV.y - v0.UV.y;
+
+			// Skip triangles without a usable UV mapping
+			float det = s1 * t2 - s2 * t1;
+			if (!(fabsf(det) > (fabsf(s1 * t2) + fabsf(s2 * t1)) * DegenerateUVEpsilon))
+				continue;
+
+			float r = 1.0f / det;
+			XMFLOAT3 triangleTangent((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r, (t2 * z1 - t1 * z2) * r);
+
+			if (Mode == TangentMode::Accumulated)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					float* sum = sums + (size_t)tri[c] * 4;
+					sum[0] += triangleTangent.x;
+					sum[1] += triangleTangent.y;
+					sum[2] += triangleTangent.z;
+				}
+				continue;
+			}
+
+			// MikkTSpace: per corner, project onto the normal's
+			// plane, normalize, and weight by the corner angle
+			// (measured between edges in that plane too)
+			for (int c = 0; c < 3; c++)
+			{
+				const Vertex& vertex = vertices[tri[c]];
+				const XMFLOAT3& p = vertex.Position;
+				const XMFLOAT3& next = vertices[tri[(c + 1) % 3]].Position;
+				const XMFLOAT3& prev = vertices[tri[(c + 2) % 3]].Position;
+				const XMFLOAT3& n = vertex.Normal;
+
+				XMFLOAT3 corner = ProjectOffNormal(triangleTangent, n);
+				float cornerLength = sqrtf(Dot(corner, corner));
+				if (!(cornerLength > MinTangentLength))
+					continue;
+
+				XMFLOAT3 edge0 = ProjectOffNormal(XMFLOAT3(next.x - p.x, next.y - p.y, next.z - p.z), n);
+				XMFLOAT3 edge1 = ProjectOffNormal(XMFLOAT3(prev.x - p.x, prev.y - p.y, prev.z - p.z), n);
+				float edgeLengths = sqrtf(Dot(edge0, edge0) * Dot(edge1, edge1));
+				if (!(edgeLengths > 0))
+					continue;
+
+				float angle = acosf(std::clamp(Dot(edge0, edge1) / edgeLengths, -1.0f, 1.0f));
+				float weight = angle / cornerLength;
+				float* sum = sums + (size_t)tri[c] * 4;
+				sum[0] += corner.x * weight;
+				sum[1] += corner.y * weight;
+				sum[2] += corner.z * weight;
+			}
+		}
+	}
+
+	// --------------------------------------------------------
+	// Sums every chunk's partials for a block of vertices (in
+	// chunk order) and writes the finished tangents
+	//
+	// - 4 vertices per step, transposed into x/y/z registers
+	//    (structure of arrays) for the orthonormalization
+	// --------------------------------------------------------
+	void FinishBlock(
+		unsigned int first,
+		unsigned int count,
+		const std::vector<TriangleChunk>& chunks,
+		Vertex* vertices)
+	{
+		unsigned int last = first + count - 1;
+		std::vector<const TriangleChunk*> overlapping;
+		for (const TriangleChunk& chunk : chunks)
+			if (chunk.TriangleCount > 0 && chunk.MinVertex <= last && chunk.MaxVertex >= first)
+				overlapping.push_back(&chunk);
+
+		const float zero[4] = {};
+		for (unsigned int v = first; v <= last; v += 4)
+		{
+			unsigned int lanes = std::min(4u, last - v + 1);
+
+			// One row per vertex: the sum of every chunk's partial
+			Float4 rows[4] = { Splat(0), Splat(0), Splat(0), Splat(0) };
+			for (const TriangleChunk* chunk : overlapping)
+			{
+				for (unsigned int l = 0; l < lanes; l++)
+				{
+					unsigned int vertex = v + l;
+					bool inChunk = vertex >= chunk->MinVertex && vertex <= chunk->MaxVertex;
+					rows[l] = rows[l] + Load(inChunk ? &chunk->Sums[(size_t)(vertex - chunk->MinVertex) * 4] : zero);
+				}
+			}
+
+			Float4 tx = rows[0], ty = rows[1], tz = rows[2], unused = rows[3];
+			Transpose(tx, ty, tz, unused);
+
+			size_t normals[4];
+			for (unsigned int l = 0; l < 4; l++)
+				normals[l] = (v + (l < lanes ? l : 0)) * VertexStride;
+			Float4 nx = Gather(&vertices[0].Normal.x, normals);
+			Float4 ny = Gather(&vertices[0].Normal.y, normals);
+			Float4 nz = Gather(&vertices[0].Normal.z, normals);
+
+			// Gram-Schmidt: remove the normal's part, then normalize
+			Float4 d = nx * tx + ny * ty + nz * tz;
+			tx = tx - nx * d;
+			ty = ty - ny * d;
+			tz = tz - nz * d;
+
+			Float4 length = Sqrt(tx * tx + ty * ty + tz * tz);
+			Float4 inverse = SelectGreater(length, Splat(MinTangentLength), Splat(1.0f) / length);
+
+			float outX[4], outY[4], outZ[4], valid[4];
+			Store(outX, tx * inverse);
+			Store(outY, ty * inverse);
+			Store(outZ, tz * inverse);
+			Store(valid, inverse);
+
+			for (unsigned int l = 0; l < lanes; l++)
+			{
+				Vertex& vertex = vertices[v + l];
+				vertex.Tangent = valid[l] != 0 ? XMFLOAT3(outX[l], outY[l], outZ[l]) : PerpendicularTangent(vertex.Normal);
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Calculates the tangent of every vertex
+//
+// - Same per-triangle math as GenerateScalar (see there for
+//    credits), reorganized for threads
+// --------------------------------------------------------
+void TangentGenerator::Generate(
+	Vertex* vertices,
+	unsigned int vertexCount,
+	const unsigned int* indices,
+	unsigned int indexCount,
+	TangentMode mode)
+{
+	if (vertexCount == 0)
+		return;
+
+	ThreadPool& pool = ThreadPool::Get();
+	unsigned int triangleCount = indexCount / 3;
+	unsigned int blockCount = (vertexCount + VertexBlockSize - 1) / VertexBlockSize;
+
+	unsigned int chunkCount = std::clamp(triangleCount / MinChunkTriangles, 1u, MaxChunks);
+	unsigned int chunkSize = (triangleCount + chunkCount - 1) / chunkCount;
+	std::vector<TriangleChunk> chunks(chunkCount);
+	for (unsigned int c = 0; c < chunkCount; c++)
+	{
+		chunks[c].FirstTriangle = std::min(c * chunkSize, triangleCount);
+		chunks[c].TriangleCount = std::min(chunkSize, triangleCount - chunks[c].FirstTriangle);
+	}
+
+	pool.ParallelFor(chunkCount, [&](size_t c)
+	{
+		if (chunks[c].TriangleCount == 0)
+			return;
+		if (mode == TangentMode::MikkTSpace)
+			AccumulateChunk<TangentMode::MikkTSpace>(chunks[c], vertices, indices);
+		else
+			AccumulateChunk<TangentMode::Accumulated>(chunks[c], vertices, indices);
+	});
+
+	pool.ParallelFor(blockCount, [&](size_t block)
+	{
+		unsigned int first = (unsigned int)block * VertexBlockSize;
+		FinishBlock(first, std::min(VertexBlockSize, vertexCount - first), chunks, vertices);
+	});
+}
+
+// --------------------------------------------------------
+// Author: Chris Cascioli
+// Purpose: Calculates the tangents of the vertices in a mesh
+//
+// - You are allowed to directly copy/paste this into your code base
+//   for assignments, given that you clearly cite that this is not
+//   code of your own design.
+//
+// - Code originally adapted from: http://www.terathon.com/code/tangent.html
+//   - Updated version now found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
+//   - See listing 7.4 in section 7.5 (page 9 of the PDF)
+//
+// - Changed here: triangles with degenerate UVs are skipped
+//   instead of dividing by zero, and vertices left without a
+//   tangent get one perpendicular to their normal
+// --------------------------------------------------------
+void TangentGenerator::GenerateScalar(
+	Vertex* vertices,
+	unsigned int vertexCount,
+	const unsigned int* indices,
+	unsigned int indexCount)
+{
+	std::vector<XMFLOAT3> sums(vertexCount, XMFLOAT3(0, 0, 0));
+
+	// Calculate tangents one whole triangle at a time
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+	{
+		unsigned int i1 = indices[i];
+		unsigned int i2 = indices[i + 1];
+		unsigned int i3 = indices[i + 2];
+		const Vertex* v1 = &vertices[i1];
+		const Vertex* v2 = &vertices[i2];
+		const Vertex* v3 = &vertices[i3];
+
+		// Calculate vectors relative to triangle positions
+		float x1 = v2->Position.x - v1->Position.x;
+		float y1 = v2->Position.y - v1->Position.y;
+		float z1 = v2->Position.z - v1->Position.z;
+
+		float x2 = v3->Position.x - v1->Position.x;
+		float y2 = v3->Position.y - v1->Position.y;
+		float z2 = v3->Position.z - v1->Position.z;
+
+		// Do the same for vectors relative to triangle uv's
+		float s1 = v2->UV.x - v1->UV.x;
+		float t1 = v2->UV.y - v1->UV.y;
+
+		float s2 = v3->UV.x - v1->UV.x;
+		float t2 = v3->UV.y - v1->UV.y;
+
+		// Skip triangles without a usable UV mapping
+		float det = s1 * t2 - s2 * t1;
+		if (!(fabsf(det) > (fabsf(s1 * t2) + fabsf(s2 * t1)) * DegenerateUVEpsilon))
+			continue;
+
+		// Create vectors for tangent calculation
+		float r = 1.0f / det;
+
+		float tx = (t2 * x1 - t1 * x2) * r;
+		float ty = (t2 * y1 - t1 * y2) * r;
+		float tz = (t2 * z1 - t1 * z2) * r;
+
+		// Adjust tangents of each vert of the triangle
+		for (unsigned int v : { i1, i2, i3 })
+		{
+			sums[v].x += tx;
+			sums[v].y += ty;
+			sums[v].z += tz;
+		}
+	}
+
+	// Ensure all of the tangents are orthogonal to the normals
+	for (unsigned int v = 0; v < vertexCount; v++)
+		vertices[v].Tangent = FinishTangent(sums[v], vertices[v].Normal);
+}
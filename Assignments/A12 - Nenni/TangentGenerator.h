@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// How per-triangle tangents are combined at a vertex
+//
+// - Accumulated: plain sum of every triangle's tangent, then
+//    orthonormalized against the normal (what the original
+//    Mesh::CalculateTangents did)
+// - MikkTSpace: each corner's tangent is first projected onto
+//    the vertex normal's plane and normalized, then weighted by
+//    the corner's angle, as MikkTSpace does
+//    - Matches MikkTSpace on meshes whose vertices are already
+//       split at UV seams (ours are, by the OBJ welding)
+//    - Vertex has no bitangent sign, so mirrored UVs still rely
+//       on the shader's cross(normal, tangent)
+// --------------------------------------------------------
+enum class TangentMode
+{
+	Accumulated,
+	MikkTSpace
+};
+
+// --------------------------------------------------------
+// Tangent generation for indexed triangle meshes
+//
+// - Generate() adds up triangles one at a time (SIMD measured
+//    no faster there: it's bound by loading vertices and adding
+//    to their sums), and uses SSE for the final
+//    orthonormalization, 4 vertices at a time
+// - Triangles are split into a fixed number of chunks that
+//    each accumulate into their own partial buffer (covering
+//    just the vertices they touch) on the thread pool; the
+//    partials are summed in chunk order, so the result is the
+//    same on any number of threads
+// - Triangles with degenerate UVs (zero area in UV space, like
+//    every triangle of a mesh without UVs) are skipped; vertices
+//    left without a tangent get one perpendicular to the normal
+// --------------------------------------------------------
+namespace TangentGenerator
+{
+	void Generate(
+		Vertex* vertices,
+		unsigned int vertexCount,
+		const unsigned int* indices,
+		unsigned int indexCount,
+		TangentMode mode = TangentMode::Accumulated);
+
+	// Single threaded, one triangle at a time (the original
+	// algorithm plus the degenerate UV guard), for comparison
+	void GenerateScalar(
+		Vertex* vertices,
+		unsigned int vertexCount,
+		const unsigned int* indices,
+		unsigned int indexCount);
+}
@@ -0,0 +1,331 @@
+#include "TextureCooker.h"
+#include "BcEncoder.h"
+#include "MappedFile.h"
+#include "PngDecoder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cwchar>
+#include <cwctype>
+#include <filesystem>
+
+namespace
+{
+	bool EndsWith(const std::wstring& text, const std::wstring& suffix)
+	{
+		return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	// Just the red channel, which is all the shaders read of masks
+	Image ToRed(const Image& image)
+	{
+		if (image.Format == ImageFormat::R8)
+			return image;
+
+		Image red;
+		red.Width = image.Width;
+		red.Height = image.Height;
+		red.Format = ImageFormat::R8;
+		red.Pixels.resize(red.GetSize());
+		for (size_t i = 0; i < red.Pixels.size(); i++)
+			red.Pixels[i] = image.Pixels[i * 4];
+		return red;
+	}
+
+	// The suffix that marks a mask of each channel, and every
+	// other one accepted
+	struct MaskSuffix
+	{
+		const wchar_t* Suffix;
+		MaskChannel Channel;
+	};
+
+	const MaskSuffix MaskSuffixes[] =
+	{
+		{ L"_ao", MaskChannel::Occlusion },
+		{ L"_occlusion", MaskChannel::Occlusion },
+		{ L"_roughness", MaskChannel::Roughness },
+		{ L"_metal", MaskChannel::Metalness },
+		{ L"_metalness", MaskChannel::Metalness },
+	};
+
+	std::wstring LowerStem(const std::wstring& path)
+	{
+		std::wstring name = std::filesystem::path(path).stem().wstring();
+		std::transform(name.begin(), name.end(), name.begin(), [](wchar_t c) { return (wchar_t)towlower(c); });
+		return name;
+	}
+
+	const MaskSuffix* FindMaskSuffix(const std::wstring& path)
+	{
+		std::wstring name = LowerStem(path);
+		for (const MaskSuffix& suffix : MaskSuffixes)
+		{
+			if (EndsWith(name, suffix.Suffix))
+				return &suffix;
+		}
+		return nullptr;
+	}
+
+	// Red of image at the center of pixel (x, y) of a width x
+	// height image, bilinearly filtered when the sizes differ
+	uint8_t SampleRed(const Image& image, unsigned int x, unsigned int y, unsigned int width, unsigned int height)
+	{
+		unsigned int stride = image.Format == ImageFormat::R8 ? 1 : 4;
+		if (image.Width == width && image.Height == height)
+			return image.Pixels[((size_t)y * width + x) * stride];
+
+		float u = std::clamp((x + 0.5f) * image.Width / width - 0.5f, 0.0f, image.Width - 1.0f);
+		float v = std::clamp((y + 0.5f) * image.Height / height - 0.5f, 0.0f, image.Height - 1.0f);
+		unsigned int x0 = (unsigned int)u;
+		unsigned int y0 = (unsigned int)v;
+		unsigned int x1 = std::min(x0 + 1, image.Width - 1);
+		unsigned int y1 = std::min(y0 + 1, image.Height - 1);
+		float fx = u - x0;
+		float fy = v - y0;
+
+		auto at = [&](unsigned int px, unsigned int py) { return (float)image.Pixels[((size_t)py * image.Width + px) * stride]; };
+		float top = at(x0, y0) + (at(x1, y0) - at(x0, y0)) * fx;
+		float bottom = at(x0, y1) + (at(x1, y1) - at(x0, y1)) * fx;
+		return (uint8_t)(top + (bottom - top) * fy + 0.5f);
+	}
+
+	// Bytes of a full mip chain of a width x height image
+	size_t GetChainSize(unsigned int width, unsigned int height, ImageFormat format)
+	{
+		Image mip;
+		mip.Format = format;
+		size_t size = 0;
+		for (unsigned int level = 0; (width >> level) || (height >> level); level++)
+		{
+			mip.Width = std::max(width >> level, 1u);
+			mip.Height = std::max(height >> level, 1u);
+			size += mip.GetSize();
+		}
+		return size;
+	}
+
+	// Whether a mask (decoded, R8 or RGBA8) is value all over;
+	// missing masks are, as value is what they default to
+	bool IsUniform(const Image* mask, uint8_t value)
+	{
+		if (!mask)
+			return true;
+
+		Image red = ToRed(*mask);
+		return std::all_of(red.Pixels.begin(), red.Pixels.end(), [value](uint8_t pixel) { return pixel == value; });
+	}
+
+	// Channels each kind uses, for PSNR: RGB, XY, R or ORM
+	unsigned int UsedChannels(TextureKind kind)
+	{
+		switch (kind)
+		{
+		case TextureKind::Normal: return 2;
+		case TextureKind::Mask: return 1;
+		default: return 3;
+		}
+	}
+}
+
+TextureKind TextureCooker::GetKind(const std::wstring& path)
+{
+	std::wstring name = LowerStem(path);
+	if (EndsWith(name, L"_normal") || EndsWith(name, L"_normals"))
+		return TextureKind::Normal;
+	if (EndsWith(name, L"_orm"))
+		return TextureKind::Packed;
+	if (FindMaskSuffix(path))
+		return TextureKind::Mask;
+	return TextureKind::Color;
+}
+
+MaskChannel TextureCooker::GetMaskChannel(const std::wstring& path)
+{
+	const MaskSuffix* suffix = FindMaskSuffix(path);
+	return suffix ? suffix->Channel : MaskChannel::None;
+}
+
+std::wstring TextureCooker::GetPackedPath(const std::wstring& maskPath)
+{
+	const MaskSuffix* suffix = FindMaskSuffix(maskPath);
+	if (!suffix)
+		return std::wstring();
+
+	std::filesystem::path path(maskPath);
+	std::wstring stem = path.stem().wstring();
+	stem.resize(stem.size() - wcslen(suffix->Suffix));
+	return path.replace_filename(stem + L"_orm" + path.extension().wstring()).wstring();
+}
+
+const char* TextureCooker::GetFormatName(ImageFormat format)
+{
+	switch (format)
+	{
+	case ImageFormat::R8: return "R8";
+	case ImageFormat::RG16: return "RG16";
+	case ImageFormat::BC1: return "BC1";
+	case ImageFormat::BC4: return "BC4";
+	case ImageFormat::BC5: return "BC5";
+	case ImageFormat::BC7: return "BC7";
+	default: return "RGBA8";
+	}
+}
+
+ImageFormat TextureCooker::GetFormat(TextureKind kind)
+{
+	switch (kind)
+	{
+	case TextureKind::Normal: return ImageFormat::BC5;
+	case TextureKind::Mask: return ImageFormat::BC4;
+	case TextureKind::Packed: return ImageFormat::BC1;
+	default: return ImageFormat::BC7;
+	}
+}
+
+bool TextureCooker::CookPng(const std::wstring& pngFile, std::vector<Image>& mips)
+{
+	MappedFile file;
+	Image source;
+	if (!file.Open(pngFile) || !PngDecoder::Decode(file.GetData(), file.GetSize(), source))
+		return false;
+
+	TextureKind kind = GetKind(pngFile);
+	ImageFormat format = GetFormat(kind);
+	if (source.Width % 4 != 0 || source.Height % 4 != 0)
+		format = kind == TextureKind::Mask ? ImageFormat::R8 : ImageFormat::RGBA8;
+
+	double psnr = 0.0;
+	Cook(source, kind, format, mips, &psnr);
+
+	// Compared to the mips the .PNG would have had at runtime
+	size_t before = 0;
+	size_t after = 0;
+	for (const Image& mip : mips)
+	{
+		before += (size_t)mip.Width * mip.Height * source.GetElementSize();
+		after += mip.GetSize();
+	}
+
+	std::wstring fileName = std::filesystem::path(pngFile).filename().wstring();
+	printf("%ls: %ux%u %s, %zu mips, %.2f -> %.2f MB (%.1fx smaller), PSNR %.2f dB\n",
+		fileName.c_str(), source.Width, source.Height, GetFormatName(format), mips.size(),
+		before / 1048576.0, after / 1048576.0, (double)before / after, psnr);
+	return true;
+}
+
+bool TextureCooker::CookPackedMasks(const std::vector<std::wstring>& maskFiles, std::vector<Image>& mips)
+{
+	Image masks[3];
+	for (const std::wstring& maskFile : maskFiles)
+	{
+		int channel = (int)GetMaskChannel(maskFile);
+		MappedFile file;
+		if (channel < 0 || !masks[channel].Pixels.empty() || !file.Open(maskFile) ||
+			!PngDecoder::Decode(file.GetData(), file.GetSize(), masks[channel]))
+			return false;
+	}
+
+	auto present = [&](MaskChannel channel) { const Image& mask = masks[(int)channel]; return mask.Pixels.empty() ? nullptr : &mask; };
+	const Image* occlusion = present(MaskChannel::Occlusion);
+	const Image* roughness = present(MaskChannel::Roughness);
+	const Image* metalness = present(MaskChannel::Metalness);
+
+	// Roughness alone (the others are missing, or what they'd
+	// default to all over) is kept as a one channel mask, at its
+	// own size
+	bool roughnessOnly = roughness && IsUniform(occlusion, 255) && IsUniform(metalness, 0);
+
+	Image packed = roughnessOnly ? ToRed(*roughness) : PackMasks(occlusion, roughness, metalness);
+	if (packed.Pixels.empty())
+		return false;
+
+	TextureKind kind = roughnessOnly ? TextureKind::Mask : TextureKind::Packed;
+	ImageFormat format = GetFormat(kind);
+	if (packed.Width % 4 != 0 || packed.Height % 4 != 0)
+		format = roughnessOnly ? ImageFormat::R8 : ImageFormat::RGBA8;
+
+	double psnr = 0.0;
+	Cook(packed, kind, format, mips, &psnr);
+
+	// Compared to cooking every mask on its own
+	size_t before = 0;
+	size_t after = GetChainSize(packed.Width, packed.Height, mips[0].Format);
+	for (const Image& mask : masks)
+	{
+		if (!mask.Pixels.empty())
+			before += GetChainSize(mask.Width, mask.Height, mask.Width % 4 == 0 && mask.Height % 4 == 0 ? GetFormat(TextureKind::Mask) : ImageFormat::R8);
+	}
+
+	std::wstring fileName = std::filesystem::path(GetPackedPath(maskFiles[0])).filename().replace_extension(L".dds").wstring();
+	printf("%ls: %ux%u %s%s from %zu masks, %.2f -> %.2f MB (%.0f%% of the masks on their own), PSNR %.2f dB\n",
+		fileName.c_str(), packed.Width, packed.Height, GetFormatName(format), roughnessOnly ? " (roughness only)" : "", maskFiles.size(),
+		before / 1048576.0, after / 1048576.0, 100.0 * after / before, psnr);
+	return true;
+}
+
+Image TextureCooker::PackMasks(const Image* occlusion, const Image* roughness, const Image* metalness)
+{
+	// What a missing mask means, like the runtime placeholder
+	const Image* masks[] = { occlusion, roughness, metalness };
+	const uint8_t defaults[] = { 255, 255, 0 };
+
+	Image packed;
+	for (const Image* mask : masks)
+	{
+		if (mask && (mask->IsBlockCompressed() || mask->Pixels.size() != mask->GetSize()))
+			return Image();
+		if (mask)
+		{
+			packed.Width = std::max(packed.Width, mask->Width);
+			packed.Height = std::max(packed.Height, mask->Height);
+		}
+	}
+	if (packed.Width == 0 || packed.Height == 0)
+		return Image();
+
+	packed.Format = ImageFormat::RGBA8;
+	packed.Pixels.resize(packed.GetSize());
+	for (unsigned int y = 0; y < packed.Height; y++)
+	{
+		for (unsigned int x = 0; x < packed.Width; x++)
+		{
+			uint8_t* pixel = &packed.Pixels[((size_t)y * packed.Width + x) * 4];
+			for (int c = 0; c < 3; c++)
+				pixel[c] = masks[c] ? SampleRed(*masks[c], x, y, packed.Width, packed.Height) : defaults[c];
+			pixel[3] = 255;
+		}
+	}
+	return packed;
+}
+
+void TextureCooker::Cook(const Image& source, TextureKind kind, ImageFormat format, std::vector<Image>& mips, double* psnr)
+{
+	Image top;
+	MipFilter filter = MipFilter::Linear;
+	switch (kind)
+	{
+	case TextureKind::Color: top = Images::ToRgba(source); filter = MipFilter::Gamma; break;
+	case TextureKind::Normal: top = Images::ToRgba(source); filter = MipFilter::Normals; break;
+	case TextureKind::Mask: top = ToRed(source); break;
+	case TextureKind::Packed: top = Images::ToRgba(source); break;
+	}
+
+	Image reference = top;
+	Images::GenerateMips(std::move(top), mips, filter);
+
+	Image compressed;
+	for (Image& mip : mips)
+	{
+		if (BcEncoder::Encode(mip, format, compressed))
+			std::swap(mip, compressed);
+	}
+
+	if (psnr)
+	{
+		Image decoded;
+		*psnr = BcEncoder::Decode(mips[0], decoded) ?
+			Images::Psnr(reference, decoded, UsedChannels(kind)) :
+			Images::Psnr(reference, mips[0], UsedChannels(kind));
+	}
+}
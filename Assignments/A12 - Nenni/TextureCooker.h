@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Image.h"
+
+// What a texture is used for, which decides how it's cooked
+enum class TextureKind
+{
+	Color,		// Albedo (and sky faces): BC7, gamma correct mips
+	Normal,		// Tangent space normal maps: BC5 (X and Y), renormalized mips
+	Mask,		// One channel maps (roughness, metalness): BC4
+	Packed		// Occlusion, roughness and metalness in R, G and B: BC1
+};
+
+// Which channel of a packed texture each mask goes in (glTF's
+// occlusion, roughness, metalness order)
+enum class MaskChannel
+{
+	None = -1,
+	Occlusion,
+	Roughness,
+	Metalness
+};
+
+// --------------------------------------------------------
+// Turns source .PNG textures into block compressed mip
+// chains for .DDS files (see BcEncoder, DdsFile), without
+// touching the GPU
+//
+// - The kind comes from the file name: "_normal(s)" ends a
+//    normal map, "_roughness", "_metal(ness)" or "_ao" a mask,
+//    "_orm" an already packed one, anything else is color
+// - The masks of a material ("wood_roughness.png",
+//    "wood_metal.png") are packed into one texture
+//    ("wood_orm.dds"), so it binds and samples once; missing
+//    ones are unoccluded, fully rough or not metal, and
+//    smaller ones are stretched to the largest
+// - Packed masks are BC1, half a byte per pixel like one BC4
+//    mask, so packing never takes more memory than the
+//    largest mask alone did
+// - A material whose only varying mask is roughness (the
+//    others missing, or their default all over) keeps just
+//    the roughness, as a one channel BC4 "_orm" texture the
+//    pixel shader reads as roughness alone: nothing is
+//    stretched, and it keeps BC4's 8 levels per block
+// - Mips are filtered from the full precision image, then
+//    each one is compressed
+// - Sizes that aren't multiples of 4 stay uncompressed (R8 or
+//    RGBA8), since D3D11 can't create block compressed
+//    textures of them
+// --------------------------------------------------------
+namespace TextureCooker
+{
+	// Bump whenever cooked textures change, so they re-cook
+	const uint32_t Version = 4;
+
+	TextureKind GetKind(const std::wstring& path);
+
+	// The packed channel a mask's file name asks for
+	MaskChannel GetMaskChannel(const std::wstring& path);
+
+	// The packed texture a mask goes into ("_roughness" becomes
+	// "_orm", same folder and extension); empty if path isn't a
+	// mask
+	std::wstring GetPackedPath(const std::wstring& maskPath);
+
+	// The format a kind is compressed to
+	ImageFormat GetFormat(TextureKind kind);
+
+	// Short name of a format ("BC7"), for reports
+	const char* GetFormatName(ImageFormat format);
+
+	// Decodes a .PNG and compresses its mips, printing the size
+	// saved and the quality of the full size image (PSNR
+	// against the .PNG)
+	bool CookPng(const std::wstring& pngFile, std::vector<Image>& mips);
+
+	// Decodes the .PNG masks of one material and packs them
+	// into one texture's mips (or keeps roughness alone, see
+	// above), reporting its size against the masks cooked on
+	// their own; false if any can't be read or two are the
+	// same channel
+	bool CookPackedMasks(const std::vector<std::wstring>& maskFiles, std::vector<Image>& mips);
+
+	// The one RGBA8 image packing masks (R8 or RGBA8, red
+	// read) into their channels
+	Image PackMasks(const Image* occlusion, const Image* roughness, const Image* metalness);
+
+	// Filters mips of a decoded image and compresses them to
+	// format; an uncompressed format leaves them as the kind
+	// keeps them (R8 for masks, RGBA8 otherwise)
+	// - psnr (if not null) is the full size image's, in dB,
+	//    over the channels the kind uses (RGB, XY or R; ORM for
+	//    packed masks)
+	void Cook(const Image& source, TextureKind kind, ImageFormat format, std::vector<Image>& mips, double* psnr = nullptr);
+}
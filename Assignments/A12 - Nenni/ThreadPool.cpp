@@ -0,0 +1,128 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned int workerCount) : stopping(false)
+{
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		stopping = true;
+	}
+	jobsAvailable.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+// --------------------------------------------------------
+// The shared pool, created on first use
+// - The main thread also works during ParallelFor, so we
+//    leave one hardware thread for it
+// --------------------------------------------------------
+ThreadPool& ThreadPool::Get()
+{
+	unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	static ThreadPool pool(hardwareThreads > 1 ? hardwareThreads - 1 : 0);
+	return pool;
+}
+
+// --------------------------------------------------------
+// Queues a job for the next free worker
+// - Without any workers (single core) it simply runs now
+// --------------------------------------------------------
+void ThreadPool::Submit(std::function<void()> job)
+{
+	if (workers.empty())
+	{
+		job();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		jobs.push_back(std::move(job));
+	}
+	jobsAvailable.notify_one();
+}
+
+// --------------------------------------------------------
+// Runs job(0) ... job(count - 1) across the pool and waits
+// - Indices are handed out from a shared counter, so the
+//    caller and any free workers all pull from the same batch
+// --------------------------------------------------------
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& job)
+{
+	if (count == 0)
+		return;
+
+	if (count == 1)
+	{
+		job(0);
+		return;
+	}
+
+	struct Batch
+	{
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+		std::mutex doneMutex;
+		std::condition_variable allDone;
+	};
+	std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+	const std::function<void(size_t)>* work = &job;
+
+	// Pulls indices until the batch is empty
+	auto run = [batch, work, count]()
+	{
+		for (size_t i = batch->next++; i < count; i = batch->next++)
+		{
+			(*work)(i);
+			if (++batch->done == count)
+			{
+				std::lock_guard<std::mutex> lock(batch->doneMutex);
+				batch->allDone.notify_all();
+			}
+		}
+	};
+
+	size_t helpers = std::min(count - 1, workers.size());
+	for (size_t i = 0; i < helpers; i++)
+		Submit(run);
+
+	run();
+
+	std::unique_lock<std::mutex> lock(batch->doneMutex);
+	batch->allDone.wait(lock, [&]() { return batch->done == count; });
+}
+
+unsigned int ThreadPool::GetThreadCount() const
+{
+	return (unsigned int)workers.size() + 1;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(jobsMutex);
+			jobsAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+			if (stopping && jobs.empty())
+				return;
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		job();
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// A fixed set of worker threads shared by the whole program
+//
+// - Submit() queues a fire-and-forget job
+// - ParallelFor() runs job(i) for every i in [0, count) and
+//    returns once all of them are done; the calling thread
+//    helps, so it is safe to call from inside another job
+// --------------------------------------------------------
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned int workerCount);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// The shared pool (one worker per hardware thread)
+	static ThreadPool& Get();
+
+	void Submit(std::function<void()> job);
+	void ParallelFor(size_t count, const std::function<void(size_t)>& job);
+
+	// Worker threads plus the calling thread
+	unsigned int GetThreadCount() const;
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex jobsMutex;
+	std::condition_variable jobsAvailable;
+	bool stopping;
+
+	void WorkerLoop();
+};
@@ -0,0 +1,233 @@
+#include "VertexPacking.h"
+
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	// Smallest normal half float; below this UVs are denormal
+	const float SmallestNormalHalf = 1.0f / 16384.0f;
+
+	inline int16_t FloatToSnorm16(float value)
+	{
+		value = std::clamp(value, -1.0f, 1.0f);
+		return (int16_t)lroundf(value * 32767.0f);
+	}
+
+	// Matches how the GPU reads R16_SNORM (-32768 also means -1)
+	inline float Snorm16ToFloat(int16_t value)
+	{
+		return std::max(value / 32767.0f, -1.0f);
+	}
+
+	inline float Length(const XMFLOAT3& v)
+	{
+		return sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+	}
+
+	inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	inline float SignNotZero(float value)
+	{
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	// Decodes an octahedral point without snorm rounding
+	XMFLOAT3 OctahedralToDirection(float x, float y)
+	{
+		XMFLOAT3 n(x, y, 1.0f - fabsf(x) - fabsf(y));
+		if (n.z < 0)
+		{
+			float oldX = n.x;
+			n.x = (1.0f - fabsf(n.y)) * SignNotZero(oldX);
+			n.y = (1.0f - fabsf(oldX)) * SignNotZero(n.y);
+		}
+
+		float length = Length(n);
+		return XMFLOAT3(n.x / length, n.y / length, n.z / length);
+	}
+
+	// Angle between two directions (either may be unnormalized)
+	// - atan2 of |cross| and dot stays accurate for tiny angles,
+	//    where acos of a float dot product can't go below ~0.02 degrees
+	float AngleDegrees(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		XMFLOAT3 cross(
+			a.y * b.z - a.z * b.y,
+			a.z * b.x - a.x * b.z,
+			a.x * b.y - a.y * b.x);
+		return atan2f(Length(cross), Dot(a, b)) * (180.0f / XM_PI);
+	}
+
+	// Directions that were never valid (like the tangent of a
+	// vertex with degenerate UVs) can't be compared meaningfully
+	inline bool IsUnitLength(const XMFLOAT3& v)
+	{
+		float length = Length(v);
+		return length > 0.5f && length < 1.5f;
+	}
+}
+
+// --------------------------------------------------------
+// Centers the quantization grid on the bounds
+// - Flat axes (like a quad's Y) get an extent of 1 so they
+//    never divide by zero; every vertex then packs to 0
+// --------------------------------------------------------
+VertexQuantization VertexPacking::QuantizationFromBounds(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+{
+	VertexQuantization quantization;
+	quantization.Center = XMFLOAT3(
+		(boundsMin.x + boundsMax.x) * 0.5f,
+		(boundsMin.y + boundsMax.y) * 0.5f,
+		(boundsMin.z + boundsMax.z) * 0.5f);
+	quantization.Extent = XMFLOAT3(
+		(boundsMax.x - boundsMin.x) * 0.5f,
+		(boundsMax.y - boundsMin.y) * 0.5f,
+		(boundsMax.z - boundsMin.z) * 0.5f);
+
+	if (quantization.Extent.x <= 0) quantization.Extent.x = 1;
+	if (quantization.Extent.y <= 0) quantization.Extent.y = 1;
+	if (quantization.Extent.z <= 0) quantization.Extent.z = 1;
+	return quantization;
+}
+
+PackedVertex VertexPacking::Pack(const Vertex& vertex, const VertexQuantization& quantization)
+{
+	PackedVertex packed;
+	packed.Position[0] = FloatToSnorm16((vertex.Position.x - quantization.Center.x) / quantization.Extent.x);
+	packed.Position[1] = FloatToSnorm16((vertex.Position.y - quantization.Center.y) / quantization.Extent.y);
+	packed.Position[2] = FloatToSnorm16((vertex.Position.z - quantization.Center.z) / quantization.Extent.z);
+	packed.Position[3] = 32767;
+
+	packed.UV[0] = XMConvertFloatToHalf(vertex.UV.x);
+	packed.UV[1] = XMConvertFloatToHalf(vertex.UV.y);
+
+	EncodeOctahedral(vertex.Normal, packed.Normal);
+	EncodeOctahedral(vertex.Tangent, packed.Tangent);
+	return packed;
+}
+
+Vertex VertexPacking::Unpack(const PackedVertex& packed, const VertexQuantization& quantization)
+{
+	Vertex vertex;
+	vertex.Position.x = quantization.Center.x + Snorm16ToFloat(packed.Position[0]) * quantization.Extent.x;
+	vertex.Position.y = quantization.Center.y + Snorm16ToFloat(packed.Position[1]) * quantization.Extent.y;
+	vertex.Position.z = quantization.Center.z + Snorm16ToFloat(packed.Position[2]) * quantization.Extent.z;
+
+	vertex.UV.x = XMConvertHalfToFloat(packed.UV[0]);
+	vertex.UV.y = XMConvertHalfToFloat(packed.UV[1]);
+
+	vertex.Normal = DecodeOctahedral(packed.Normal);
+	vertex.Tangent = DecodeOctahedral(packed.Tangent);
+	return vertex;
+}
+
+void VertexPacking::PackVertices(const Vertex* vertices, unsigned int vertexCount, const VertexQuantization& quantization, PackedVertex* out)
+{
+	for (unsigned int i = 0; i < vertexCount; i++)
+		out[i] = Pack(vertices[i], quantization);
+}
+
+// --------------------------------------------------------
+// Octahedral encoding (Cigolle et al. 2014)
+//
+// - Projects the direction onto an octahedron and unfolds
+//    the lower half over the corners, giving a square
+// - Instead of plain rounding, tries the four surrounding
+//    snorm grid points and keeps the one that decodes closest
+//    to the original, which roughly halves the worst error
+// - Zero length directions encode as +Z
+// --------------------------------------------------------
+void VertexPacking::EncodeOctahedral(const XMFLOAT3& direction, int16_t out[2])
+{
+	float l1 = fabsf(direction.x) + fabsf(direction.y) + fabsf(direction.z);
+	if (!(l1 > 0))
+	{
+		out[0] = 0;
+		out[1] = 0;
+		return;
+	}
+
+	float x = direction.x / l1;
+	float y = direction.y / l1;
+	if (direction.z < 0)
+	{
+		float oldX = x;
+		x = (1.0f - fabsf(y)) * SignNotZero(oldX);
+		y = (1.0f - fabsf(oldX)) * SignNotZero(y);
+	}
+
+	float gridX = floorf(std::clamp(x, -1.0f, 1.0f) * 32767.0f);
+	float gridY = floorf(std::clamp(y, -1.0f, 1.0f) * 32767.0f);
+
+	float bestDot = -2.0f;
+	for (int i = 0; i < 4; i++)
+	{
+		float candidateX = std::min(gridX + (i & 1), 32767.0f);
+		float candidateY = std::min(gridY + (i >> 1), 32767.0f);
+		XMFLOAT3 decoded = OctahedralToDirection(candidateX / 32767.0f, candidateY / 32767.0f);
+
+		float dot = Dot(decoded, direction);
+		if (dot > bestDot)
+		{
+			bestDot = dot;
+			out[0] = (int16_t)candidateX;
+			out[1] = (int16_t)candidateY;
+		}
+	}
+}
+
+XMFLOAT3 VertexPacking::DecodeOctahedral(const int16_t encoded[2])
+{
+	return OctahedralToDirection(Snorm16ToFloat(encoded[0]), Snorm16ToFloat(encoded[1]));
+}
+
+std::vector<uint16_t> VertexPacking::NarrowIndices(const unsigned int* indices, unsigned int indexCount)
+{
+	return std::vector<uint16_t>(indices, indices + indexCount);
+}
+
+// --------------------------------------------------------
+// Round trips every vertex through the packed format and
+// measures the worst error of each attribute, in the same
+// units as the documented bounds
+// --------------------------------------------------------
+PackingError VertexPacking::ValidateRoundTrip(const Vertex* vertices, unsigned int vertexCount, const VertexQuantization& quantization)
+{
+	PackingError error;
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const Vertex& original = vertices[i];
+		Vertex decoded = Unpack(Pack(original, quantization), quantization);
+
+		error.Position = std::max({ error.Position,
+			fabsf(decoded.Position.x - original.Position.x) / quantization.Extent.x,
+			fabsf(decoded.Position.y - original.Position.y) / quantization.Extent.y,
+			fabsf(decoded.Position.z - original.Position.z) / quantization.Extent.z });
+
+		error.UV = std::max({ error.UV,
+			fabsf(decoded.UV.x - original.UV.x) / std::max(fabsf(original.UV.x), SmallestNormalHalf),
+			fabsf(decoded.UV.y - original.UV.y) / std::max(fabsf(original.UV.y), SmallestNormalHalf) });
+
+		if (IsUnitLength(original.Normal))
+			error.NormalDegrees = std::max(error.NormalDegrees, AngleDegrees(original.Normal, decoded.Normal));
+		if (IsUnitLength(original.Tangent))
+			error.TangentDegrees = std::max(error.TangentDegrees, AngleDegrees(original.Tangent, decoded.Tangent));
+	}
+	return error;
+}
+
+bool VertexPacking::IsWithinBounds(const PackingError& error)
+{
+	return
+		error.Position <= MaxPositionError &&
+		error.UV <= MaxUVError &&
+		error.NormalDegrees <= MaxDirectionErrorDegrees &&
+		error.TangentDegrees <= MaxDirectionErrorDegrees;
+}
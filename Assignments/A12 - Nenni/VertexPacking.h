@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Compact vertex format used by the GPU vertex buffers
+//
+// - Position: R16G16B16A16_SNORM, quantized to the mesh's
+//    bounds (w is always 1)
+// - UV:       R16G16_FLOAT (half floats)
+// - Normal:   R16G16_SNORM, octahedral encoded
+// - Tangent:  R16G16_SNORM, octahedral encoded
+//
+// 20 bytes instead of the 44 of a full float Vertex
+// --------------------------------------------------------
+struct PackedVertex
+{
+	int16_t Position[4];
+	uint16_t UV[2];
+	int16_t Normal[2];
+	int16_t Tangent[2];
+};
+
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must match the input layout");
+
+// --------------------------------------------------------
+// Maps snorm positions back into the mesh's local space:
+// position = Center + packed * Extent
+// --------------------------------------------------------
+struct VertexQuantization
+{
+	XMFLOAT3 Center;
+	XMFLOAT3 Extent;
+};
+
+// --------------------------------------------------------
+// Largest differences between vertices and their packed
+// round trip, as measured by ValidateRoundTrip()
+// --------------------------------------------------------
+struct PackingError
+{
+	float Position = 0;		// Worst axis, as a fraction of that axis' extent
+	float UV = 0;			// Worst component, relative to its magnitude
+	float NormalDegrees = 0;
+	float TangentDegrees = 0;
+};
+
+namespace VertexPacking
+{
+	// Documented error bounds for a round trip
+	// - Position: rounding to 1/32767 of the extent is at most
+	//    half a step (plus float rounding of center + extent)
+	// - UV: half floats keep 11 significant bits, so rounding
+	//    is at most 2^-11 relative (UVs under 2^-14 are denormal
+	//    and have an absolute error of at most 2^-25 instead)
+	// - Normal/Tangent: 16-bit octahedral encoding with the best
+	//    of the neighboring grid points stays under 0.01 degrees
+	//    (0.0074 worst case over 2 million random directions)
+	const float MaxPositionError = 0.5f / 32767.0f + 1e-6f;
+	const float MaxUVError = 1.0f / 2048.0f;
+	const float MaxDirectionErrorDegrees = 0.01f;
+
+	// Meshes with fewer vertices than this use 16-bit indices
+	const unsigned int MaxShortIndexVertices = 65536;
+
+	VertexQuantization QuantizationFromBounds(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax);
+
+	PackedVertex Pack(const Vertex& vertex, const VertexQuantization& quantization);
+	Vertex Unpack(const PackedVertex& packed, const VertexQuantization& quantization);
+	void PackVertices(const Vertex* vertices, unsigned int vertexCount, const VertexQuantization& quantization, PackedVertex* out);
+
+	// Octahedral encoding of a unit vector into two snorm16 values
+	void EncodeOctahedral(const XMFLOAT3& direction, int16_t out[2]);
+	XMFLOAT3 DecodeOctahedral(const int16_t encoded[2]);
+
+	// Copies indices into 16 bits (all must be below 65536)
+	std::vector<uint16_t> NarrowIndices(const unsigned int* indices, unsigned int indexCount);
+
+	// Packs and unpacks every vertex, returning the worst errors
+	PackingError ValidateRoundTrip(const Vertex* vertices, unsigned int vertexCount, const VertexQuantization& quantization);
+	bool IsWithinBounds(const PackingError& error);
+}
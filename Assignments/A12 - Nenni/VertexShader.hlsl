@@ -8,6 +8,8 @@ cbuffer ExternalData : register(b0)
     float4x4 worldInvTranspose;
     float4x4 lightView;
     float4x4 lightProjection;
+    float3 positionCenter;
+    float3 positionExtent;
 }
 
 // --------------------------------------------------------
@@ -22,10 +24,15 @@ VertexToPixel main( VertexShaderInput input )
 	// Set up output struct
 	VertexToPixel output;
 	
+    // Unpack the compact vertex format
+    float3 localPosition = DequantizePosition(input.localPosition, positionCenter, positionExtent);
+    float3 normal = OctahedralDecode(input.normal);
+    float3 tangent = OctahedralDecode(input.tangent);
+	
     output.uv = input.uv;
-    output.normal = mul((float3x3)worldInvTranspose, input.normal);
-    output.tangent = mul((float3x3) world, input.tangent);
-    output.worldPosition = mul(world, float4(input.localPosition, 1)).xyz;
+    output.normal = mul((float3x3)worldInvTranspose, normal);
+    output.tangent = mul((float3x3) world, tangent);
+    output.worldPosition = mul(world, float4(localPosition, 1)).xyz;
 
 	// Here we're essentially passing the input position directly through to the next
 	// stage (rasterizer), though it needs to be a 4-component vector now.  
@@ -36,10 +43,10 @@ VertexToPixel main( VertexShaderInput input )
 	//   which we're leaving at 1.0 for now (this is more useful when dealing with 
 	//   a perspective projection matrix, which we'll get to in the future).
     matrix wvp = mul(projection, mul(view, world));
-    output.screenPosition = mul(wvp, float4(input.localPosition, 1.0f));
+    output.screenPosition = mul(wvp, float4(localPosition, 1.0f));
 	
     matrix shadowWVP = mul(lightProjection, mul(lightView, world));
-    output.shadowMapPos = mul(shadowWVP, float4(input.localPosition, 1.0f));
+    output.shadowMapPos = mul(shadowWVP, float4(localPosition, 1.0f));
 
 	// Whatever we return will make its way through the pipeline to the
 	// next programmable stage we're using (the pixel shader for now)
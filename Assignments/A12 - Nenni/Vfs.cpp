@@ -0,0 +1,89 @@
+#include "Vfs.h"
+
+#include <filesystem>
+
+namespace
+{
+	PackArchive pack;
+	std::filesystem::path packFolder;
+
+	// The pack entry for a path, if it's inside the mounted folder
+	const PackArchive::Entry* FindPacked(const std::wstring& path)
+	{
+		if (!pack.IsOpen())
+			return nullptr;
+
+		std::filesystem::path relative = std::filesystem::path(path).lexically_normal().lexically_relative(packFolder);
+		if (relative.empty() || *relative.begin() == L"..")
+			return nullptr;
+		return pack.Find(PackArchive::NormalizeName(relative.wstring()));
+	}
+}
+
+bool Vfs::Mount(const std::wstring& packPath, const std::wstring& folder)
+{
+	Unmount();
+	if (!pack.Open(packPath))
+		return false;
+
+	// Without a trailing separator, so it compares as a parent
+	packFolder = std::filesystem::path(folder).lexically_normal();
+	if (!packFolder.has_filename())
+		packFolder = packFolder.parent_path();
+	return true;
+}
+
+void Vfs::Unmount()
+{
+	pack.Close();
+	packFolder.clear();
+}
+
+bool Vfs::Read(const std::wstring& path, MappedFile& looseFile, ByteSpan& out)
+{
+	if (const PackArchive::Entry* entry = FindPacked(path))
+	{
+		out = pack.GetData(*entry);
+		return true;
+	}
+
+	if (!looseFile.Open(path))
+		return false;
+
+	out.Data = looseFile.GetData();
+	out.Size = looseFile.GetSize();
+	return true;
+}
+
+bool Vfs::ReadPacked(const std::wstring& path, ByteSpan& out)
+{
+	const PackArchive::Entry* entry = FindPacked(path);
+	if (!entry)
+		return false;
+
+	out = pack.GetData(*entry);
+	return true;
+}
+
+bool Vfs::Stat(const std::wstring& path, uint64_t& size, uint64_t& time)
+{
+	if (const PackArchive::Entry* entry = FindPacked(path))
+	{
+		size = entry->Size;
+		time = entry->SourceTime;
+		return true;
+	}
+
+	std::error_code error;
+	std::filesystem::path filePath(path);
+	uintmax_t fileSize = std::filesystem::file_size(filePath, error);
+	if (error)
+		return false;
+	std::filesystem::file_time_type fileTime = std::filesystem::last_write_time(filePath, error);
+	if (error)
+		return false;
+
+	size = (uint64_t)fileSize;
+	time = (uint64_t)fileTime.time_since_epoch().count();
+	return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "MappedFile.h"
+#include "PackArchive.h"
+
+// --------------------------------------------------------
+// Read-only access to asset files, from a mounted .pack when
+// it has them and from loose files otherwise
+//
+// - Paths are the same full paths as always (from FixPath());
+//    ones inside the mounted folder are looked up in the pack
+//    by their relative name, so no file is opened or stat'ed
+// - Packed files are spans of the archive mapped once by
+//    Mount(), valid until Unmount(); loose files are mapped
+//    into the caller's MappedFile, valid while it stays open
+// - Safe to use from several threads at once (but Mount()
+//    and Unmount() must not overlap any other call)
+// --------------------------------------------------------
+namespace Vfs
+{
+	// Maps a pack built from a folder (see PackArchive::Build)
+	bool Mount(const std::wstring& packPath, const std::wstring& folder);
+	void Unmount();
+
+	// The whole contents of a file (looseFile is only opened
+	// when the file isn't packed)
+	bool Read(const std::wstring& path, MappedFile& looseFile, ByteSpan& out);
+
+	// Only packed files (false for anything else, without
+	// touching the file system)
+	bool ReadPacked(const std::wstring& path, ByteSpan& out);
+
+	// Size and modification time (file_time_type ticks) of a file
+	bool Stat(const std::wstring& path, uint64_t& size, uint64_t& time);
+}
@@ -0,0 +1,167 @@
+#include "WorldPartition.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+WorldPartition::WorldPartition(AssetManager& assets, std::vector<std::shared_ptr<Material>> materials,
+	XMFLOAT2 origin, float cellSize, unsigned int cellsX, unsigned int cellsZ,
+	float loadRadius, float unloadRadius)
+	: assets(assets)
+{
+	this->materials = materials;
+	this->origin = origin;
+	this->cellSize = cellSize;
+	this->cellsX = cellsX;
+	this->cellsZ = cellsZ;
+	this->loadRadius = loadRadius;
+	this->unloadRadius = std::max(unloadRadius, loadRadius);
+	cells.resize((size_t)cellsX * cellsZ);
+}
+
+void WorldPartition::AddEntity(const CellEntity& entity)
+{
+	float x = floorf((entity.Position.x - origin.x) / cellSize);
+	float z = floorf((entity.Position.z - origin.y) / cellSize);
+	if (x < 0 || z < 0 || x >= cellsX || z >= cellsZ)
+		return;
+
+	cells[(size_t)z * cellsX + (size_t)x].Definitions.push_back(entity);
+}
+
+// --------------------------------------------------------
+// Requests every unloaded cell within the load radius, then
+// walks the active cells: far ones unload, and loading ones
+// whose meshes are all in create their entities
+// --------------------------------------------------------
+bool WorldPartition::Update(XMFLOAT3 cameraPosition, const EntityCallback& onCreated)
+{
+	// Cells overlapping the square around the load radius
+	float minX = (cameraPosition.x - loadRadius - origin.x) / cellSize;
+	float maxX = (cameraPosition.x + loadRadius - origin.x) / cellSize;
+	float minZ = (cameraPosition.z - loadRadius - origin.y) / cellSize;
+	float maxZ = (cameraPosition.z + loadRadius - origin.y) / cellSize;
+	int firstX = std::max((int)floorf(minX), 0);
+	int lastX = std::min((int)floorf(maxX), (int)cellsX - 1);
+	int firstZ = std::max((int)floorf(minZ), 0);
+	int lastZ = std::min((int)floorf(maxZ), (int)cellsZ - 1);
+
+	for (int z = firstZ; z <= lastZ; z++)
+	{
+		for (int x = firstX; x <= lastX; x++)
+		{
+			unsigned int index = (unsigned int)z * cellsX + x;
+			if (cells[index].State != CellState::Unloaded || cells[index].Definitions.empty())
+				continue;
+			if (DistanceToCell(index, cameraPosition) > loadRadius)
+				continue;
+
+			LoadCell(cells[index]);
+			activeCells.push_back(index);
+		}
+	}
+
+	bool changed = false;
+	for (size_t i = 0; i < activeCells.size();)
+	{
+		Cell& cell = cells[activeCells[i]];
+		if (DistanceToCell(activeCells[i], cameraPosition) > unloadRadius)
+		{
+			changed |= cell.State == CellState::Loaded;
+			UnloadCell(cell);
+			activeCells[i] = activeCells.back();
+			activeCells.pop_back();
+			continue;
+		}
+
+		if (cell.State == CellState::Loading)
+		{
+			// Using them has evicted ones load again
+			bool ready = true;
+			for (const std::shared_ptr<MeshAsset>& mesh : cell.Meshes)
+			{
+				mesh->Use();
+				ready &= mesh->IsReady() || mesh->GetState() == AssetState::Failed;
+			}
+			if (ready)
+			{
+				CreateEntities(cell, onCreated);
+				changed = true;
+			}
+		}
+		i++;
+	}
+
+	if (changed)
+	{
+		entities.clear();
+		for (unsigned int index : activeCells)
+			entities.insert(entities.end(), cells[index].Entities.begin(), cells[index].Entities.end());
+	}
+	return changed;
+}
+
+const std::vector<std::shared_ptr<Entity>>& WorldPartition::GetEntities() const
+{
+	return entities;
+}
+
+unsigned int WorldPartition::GetCellCount() const
+{
+	return (unsigned int)cells.size();
+}
+
+unsigned int WorldPartition::GetLoadedCellCount() const
+{
+	return (unsigned int)std::count_if(activeCells.begin(), activeCells.end(),
+		[this](unsigned int index) { return cells[index].State == CellState::Loaded; });
+}
+
+unsigned int WorldPartition::GetLoadingCellCount() const
+{
+	return (unsigned int)activeCells.size() - GetLoadedCellCount();
+}
+
+// Distance on the XZ plane to the nearest point of a cell
+float WorldPartition::DistanceToCell(unsigned int cell, XMFLOAT3 position) const
+{
+	float minX = origin.x + (cell % cellsX) * cellSize;
+	float minZ = origin.y + (cell / cellsX) * cellSize;
+	float dx = std::max({ minX - position.x, 0.0f, position.x - (minX + cellSize) });
+	float dz = std::max({ minZ - position.z, 0.0f, position.z - (minZ + cellSize) });
+	return sqrtf(dx * dx + dz * dz);
+}
+
+void WorldPartition::LoadCell(Cell& cell)
+{
+	cell.State = CellState::Loading;
+	cell.Meshes.reserve(cell.Definitions.size());
+	for (const CellEntity& definition : cell.Definitions)
+		cell.Meshes.push_back(assets.LoadMesh(definition.MeshPath));
+}
+
+void WorldPartition::CreateEntities(Cell& cell, const EntityCallback& onCreated)
+{
+	cell.State = CellState::Loaded;
+	cell.Entities.reserve(cell.Definitions.size());
+	for (size_t i = 0; i < cell.Definitions.size(); i++)
+	{
+		const CellEntity& definition = cell.Definitions[i];
+		std::shared_ptr<Entity> entity = std::make_shared<Entity>(cell.Meshes[i], materials[definition.MaterialIndex % materials.size()]);
+		entity->GetTransform()->SetPosition(definition.Position);
+		entity->GetTransform()->SetRotation(definition.Rotation);
+		entity->GetTransform()->SetScale(definition.Scale);
+		cell.Entities.push_back(entity);
+		onCreated(entity);
+	}
+}
+
+// Handles are dropped, so the asset manager can evict the
+// meshes once nothing else draws them
+void WorldPartition::UnloadCell(Cell& cell)
+{
+	cell.State = CellState::Unloaded;
+	cell.Meshes.clear();
+	cell.Entities.clear();
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AssetManager.h"
+#include "Entity.h"
+#include "Material.h"
+
+// --------------------------------------------------------
+// One entity of a world cell, before it's loaded
+// --------------------------------------------------------
+struct CellEntity
+{
+	std::wstring MeshPath;
+	unsigned int MaterialIndex = 0;	// Into the partition's materials
+	DirectX::XMFLOAT3 Position = { 0, 0, 0 };
+	DirectX::XMFLOAT3 Rotation = { 0, 0, 0 };
+	DirectX::XMFLOAT3 Scale = { 1, 1, 1 };
+};
+
+// --------------------------------------------------------
+// Splits the world into a grid of square cells (on the XZ
+// plane) that stream in and out around the camera
+//
+// - Each cell has its own list of entities and the meshes
+//    they use
+// - A cell starts loading once the camera is within the load
+//    radius of it: its meshes are requested from the asset
+//    manager (which builds them on worker threads), and its
+//    entities are created once none of them is still loading,
+//    so they never show up as placeholders
+// - A cell unloads (drops its entities and handles) once the
+//    camera is past the unload radius, which is larger so a
+//    camera on the edge doesn't load and unload every frame
+// - Only cells near the camera and loaded cells are checked,
+//    so the size of the world doesn't matter per frame
+// - Uploads of what the cells load are spread over frames by
+//    the asset manager's upload budget
+// --------------------------------------------------------
+class WorldPartition
+{
+public:
+	// Called for every entity a cell creates
+	using EntityCallback = std::function<void(std::shared_ptr<Entity>)>;
+
+	WorldPartition(AssetManager& assets, std::vector<std::shared_ptr<Material>> materials,
+		DirectX::XMFLOAT2 origin, float cellSize, unsigned int cellsX, unsigned int cellsZ,
+		float loadRadius, float unloadRadius);
+
+	// Goes in the cell under its position (entities outside the
+	// grid are dropped)
+	void AddEntity(const CellEntity& entity);
+
+	// Loads and unloads cells around the camera; true if the
+	// loaded entities changed
+	bool Update(DirectX::XMFLOAT3 cameraPosition, const EntityCallback& onCreated);
+
+	// Entities of every loaded cell
+	const std::vector<std::shared_ptr<Entity>>& GetEntities() const;
+
+	unsigned int GetCellCount() const;
+	unsigned int GetLoadedCellCount() const;
+	unsigned int GetLoadingCellCount() const;
+
+private:
+	enum class CellState
+	{
+		Unloaded,
+		Loading,
+		Loaded
+	};
+
+	struct Cell
+	{
+		std::vector<CellEntity> Definitions;
+		std::vector<std::shared_ptr<MeshAsset>> Meshes;	// One per definition
+		std::vector<std::shared_ptr<Entity>> Entities;
+		CellState State = CellState::Unloaded;
+	};
+
+	AssetManager& assets;
+	std::vector<std::shared_ptr<Material>> materials;
+
+	DirectX::XMFLOAT2 origin;
+	float cellSize;
+	unsigned int cellsX;
+	unsigned int cellsZ;
+	float loadRadius;
+	float unloadRadius;
+
+	std::vector<Cell> cells;
+	std::vector<unsigned int> activeCells;	// Loading or loaded
+	std::vector<std::shared_ptr<Entity>> entities;
+
+	float DistanceToCell(unsigned int cell, DirectX::XMFLOAT3 position) const;
+	void LoadCell(Cell& cell);
+	void CreateEntities(Cell& cell, const EntityCallback& onCreated);
+	void UnloadCell(Cell& cell);
+};